@@ -22,6 +22,11 @@
 #include "gdunewdiskimagedialog.h"
 #include "gduwindow.h"
 #include "gdulocaljob.h"
+#include "gdubenchmark.h"
+#include "gdumultibenchmarkdialog.h"
+#include "gdusmarthistory.h"
+#include "gdusmartdashboarddialog.h"
+#include "gduerasemultipledisksdialog.h"
 
 struct _GduApplication
 {
@@ -32,6 +37,11 @@ struct _GduApplication
 
   /* Maps from UDisksObject* -> GList<GduLocalJob*> */
   GHashTable *local_jobs;
+
+  /* Maps from object path -> UDisksObjectInfo, see gdu_application_get_object_info() */
+  GHashTable *object_infos;
+
+  GduSmartRecorder *smart_recorder;
 };
 
 typedef struct
@@ -39,6 +49,14 @@ typedef struct
   GtkApplicationClass parent_class;
 } GduApplicationClass;
 
+enum
+{
+  LOCAL_JOBS_CHANGED_SIGNAL,
+  LAST_SIGNAL
+};
+
+static guint signals[LAST_SIGNAL] = {0};
+
 G_DEFINE_TYPE (GduApplication, gdu_application, GTK_TYPE_APPLICATION);
 
 static void gdu_application_set_options (GduApplication *app);
@@ -47,6 +65,7 @@ static void
 gdu_application_init (GduApplication *app)
 {
   app->local_jobs = g_hash_table_new (g_direct_hash, g_direct_equal);
+  app->object_infos = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_object_unref);
 
   gdu_application_set_options (app);
 }
@@ -70,8 +89,15 @@ gdu_application_finalize (GObject *object)
       g_hash_table_destroy (app->local_jobs);
     }
 
+  if (app->smart_recorder != NULL)
+    gdu_smart_recorder_free (app->smart_recorder);
+
   if (app->client != NULL)
-    g_object_unref (app->client);
+    {
+      g_signal_handlers_disconnect_by_data (udisks_client_get_object_manager (app->client), app);
+      g_object_unref (app->client);
+    }
+  g_hash_table_unref (app->object_infos);
 
   G_OBJECT_CLASS (gdu_application_parent_class)->finalize (object);
 }
@@ -107,9 +133,137 @@ gdu_application_should_exit (GduApplication *app)
 
 /* ---------------------------------------------------------------------------------------------------- */
 
+/* udisks_client_get_object_info() formats names, descriptions and sort
+ * keys from scratch on every call while the device list, the window and
+ * the dialogs keep asking for the same objects. Infos are kept until the
+ * object changes.
+ */
+
 static void
-gdu_application_ensure_client (GduApplication *app)
+invalidate_object_info (GduApplication *app,
+                        GDBusObject    *object,
+                        GDBusInterface *interface)
 {
+  gboolean affects_others;
+  UDisksBlock *block;
+
+  /* changes all the time but isn't part of the info */
+  if (interface != NULL && UDISKS_IS_JOB (interface))
+    return;
+
+  /* these show up in the info of other objects as well, e.g. the vendor
+   * and model of a drive in the info of its block devices
+   */
+  if (interface != NULL)
+    affects_others = (UDISKS_IS_DRIVE (interface) ||
+                      UDISKS_IS_MDRAID (interface) ||
+                      UDISKS_IS_PARTITION_TABLE (interface));
+  else
+    affects_others = (udisks_object_peek_drive (UDISKS_OBJECT (object)) != NULL ||
+                      udisks_object_peek_mdraid (UDISKS_OBJECT (object)) != NULL ||
+                      udisks_object_peek_partition_table (UDISKS_OBJECT (object)) != NULL);
+
+  if (affects_others)
+    {
+      g_hash_table_remove_all (app->object_infos);
+      return;
+    }
+
+  g_hash_table_remove (app->object_infos, g_dbus_object_get_object_path (object));
+
+  /* an unlocked device is described in terms of its crypto device, so
+   * either of them changing makes the info of the other one stale
+   */
+  block = udisks_object_peek_block (UDISKS_OBJECT (object));
+  if (block != NULL)
+    {
+      g_hash_table_remove (app->object_infos, udisks_block_get_crypto_backing_device (block));
+      if (udisks_object_peek_encrypted (UDISKS_OBJECT (object)) != NULL)
+        {
+          UDisksBlock *cleartext_block;
+          GDBusObject *cleartext_object;
+
+          cleartext_block = udisks_client_get_cleartext_block (app->client, block);
+          if (cleartext_block != NULL)
+            {
+              cleartext_object = g_dbus_interface_get_object (G_DBUS_INTERFACE (cleartext_block));
+              if (cleartext_object != NULL)
+                g_hash_table_remove (app->object_infos, g_dbus_object_get_object_path (cleartext_object));
+              g_object_unref (cleartext_block);
+            }
+        }
+    }
+}
+
+static void
+on_object_added_or_removed (GDBusObjectManager *manager,
+                            GDBusObject        *object,
+                            gpointer            user_data)
+{
+  invalidate_object_info (GDU_APPLICATION (user_data), object, NULL);
+}
+
+static void
+on_interface_added_or_removed (GDBusObjectManager *manager,
+                               GDBusObject        *object,
+                               GDBusInterface     *interface,
+                               gpointer            user_data)
+{
+  invalidate_object_info (GDU_APPLICATION (user_data), object, interface);
+}
+
+static void
+on_interface_proxy_properties_changed (GDBusObjectManagerClient *manager,
+                                       GDBusObjectProxy         *object_proxy,
+                                       GDBusProxy               *interface_proxy,
+                                       GVariant                 *changed_properties,
+                                       const gchar *const       *invalidated_properties,
+                                       gpointer                  user_data)
+{
+  invalidate_object_info (GDU_APPLICATION (user_data),
+                          G_DBUS_OBJECT (object_proxy),
+                          G_DBUS_INTERFACE (interface_proxy));
+}
+
+/**
+ * gdu_application_get_object_info:
+ * @application: A #GduApplication.
+ * @object: A #UDisksObject.
+ *
+ * Like udisks_client_get_object_info() but the result is cached until
+ * @object, or an object its info is derived from, changes.
+ *
+ * Returns: (transfer full): A #UDisksObjectInfo. Free with g_object_unref().
+ */
+UDisksObjectInfo *
+gdu_application_get_object_info (GduApplication *application,
+                                 UDisksObject   *object)
+{
+  UDisksObjectInfo *info;
+  const gchar *object_path;
+
+  g_return_val_if_fail (GDU_IS_APPLICATION (application), NULL);
+  g_return_val_if_fail (UDISKS_IS_OBJECT (object), NULL);
+
+  object_path = g_dbus_object_get_object_path (G_DBUS_OBJECT (object));
+  info = g_hash_table_lookup (application->object_infos, object_path);
+  if (info == NULL || udisks_object_info_get_object (info) != object)
+    {
+      info = udisks_client_get_object_info (application->client, object);
+      g_hash_table_replace (application->object_infos, g_strdup (object_path), info);
+    }
+
+  return g_object_ref (info);
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+/* @interactive is FALSE when benchmarking from the command line */
+static void
+gdu_application_ensure_client (GduApplication *app,
+                               gboolean        interactive)
+{
+  GDBusObjectManager *object_manager;
   GError *error;
 
   if (app->client != NULL)
@@ -123,6 +277,21 @@ gdu_application_ensure_client (GduApplication *app)
       g_error ("Error getting udisks client: %s", error->message);
       g_error_free (error);
     }
+
+  object_manager = udisks_client_get_object_manager (app->client);
+  g_signal_connect (object_manager, "object-added", G_CALLBACK (on_object_added_or_removed), app);
+  g_signal_connect (object_manager, "object-removed", G_CALLBACK (on_object_added_or_removed), app);
+  g_signal_connect (object_manager, "interface-added", G_CALLBACK (on_interface_added_or_removed), app);
+  g_signal_connect (object_manager, "interface-removed", G_CALLBACK (on_interface_added_or_removed), app);
+  g_signal_connect (object_manager,
+                    "interface-proxy-properties-changed",
+                    G_CALLBACK (on_interface_proxy_properties_changed),
+                    app);
+
+  /* so the first window update doesn't block on asking udisks about every filesystem */
+  if (interactive)
+    gdu_utils_prefetch_capabilities (app->client);
+
  out:
   ;
 }
@@ -174,6 +343,13 @@ static GOptionEntry opt_entries[] = {
     {"format-device", 0, 0, G_OPTION_ARG_NONE, NULL, N_("Format selected device"), NULL },
     {"xid", 0, 0, G_OPTION_ARG_INT, NULL, N_("Parent window XID for the format dialog"), "ID" },
     {"restore-disk-image", 0, 0, G_OPTION_ARG_FILENAME, NULL, N_("Restore disk image"), "FILE" },
+    {"benchmark", 0, 0, G_OPTION_ARG_FILENAME, NULL, N_("Benchmark device, file or mounted filesystem without showing a window"), "DEVICE" },
+    {"benchmark-format", 0, 0, G_OPTION_ARG_STRING, NULL, N_("Output format for --benchmark: json, csv or gvariant (default: json)"), "FORMAT" },
+    {"benchmark-samples", 0, 0, G_OPTION_ARG_INT, NULL, N_("Number of transfer rate samples (default: 100)"), "NUM" },
+    {"benchmark-sample-size", 0, 0, G_OPTION_ARG_INT, NULL, N_("Transfer rate sample size in MiB (default: 10)"), "MIB" },
+    {"benchmark-access-samples", 0, 0, G_OPTION_ARG_INT, NULL, N_("Number of access time samples (default: 1000)"), "NUM" },
+    {"benchmark-write", 0, 0, G_OPTION_ARG_NONE, NULL, N_("Also measure write transfer rate (the device must not be in use)"), NULL },
+    {"benchmark-files", 0, 0, G_OPTION_ARG_INT, NULL, N_("Number of files to create and delete when benchmarking a filesystem (default: 1000)"), "NUM" },
     {NULL}
 };
 
@@ -183,6 +359,227 @@ gdu_application_set_options (GduApplication *app)
   g_application_add_main_option_entries (G_APPLICATION (app), opt_entries);
 }
 
+/* Runs the filesystem benchmark for --benchmark on a directory. The
+ * test file must fit on the filesystem so there are fewer samples by
+ * default than for devices.
+ */
+static gint
+gdu_application_benchmark_filesystem (GduApplication *app,
+                                      const gchar    *target,
+                                      const gchar    *format,
+                                      GVariantDict   *options)
+{
+  GduFilesystemBenchmark *benchmark;
+  gchar *output = NULL;
+  GError *error = NULL;
+  gint ret = 1;
+
+  benchmark = gdu_filesystem_benchmark_new ();
+  benchmark->num_samples = 50;
+  benchmark->sample_size_mib = 10;
+  benchmark->num_access_samples = 1000;
+  benchmark->num_files = 1000;
+
+  g_variant_dict_lookup (options, "benchmark-samples", "i", &benchmark->num_samples);
+  g_variant_dict_lookup (options, "benchmark-sample-size", "i", &benchmark->sample_size_mib);
+  g_variant_dict_lookup (options, "benchmark-access-samples", "i", &benchmark->num_access_samples);
+  g_variant_dict_lookup (options, "benchmark-files", "i", &benchmark->num_files);
+
+  /* Keep in sync with the adjustments in filesystem-benchmark-dialog.ui */
+  if (benchmark->num_samples < 2 || benchmark->num_samples > 1000 ||
+      benchmark->sample_size_mib < 1 || benchmark->sample_size_mib > 1000 ||
+      benchmark->num_access_samples < 2 || benchmark->num_access_samples > 10000 ||
+      benchmark->num_files < 1 || benchmark->num_files > 100000)
+    {
+      g_printerr (_("Invalid benchmark parameters\n"));
+      goto out;
+    }
+
+  if (!gdu_filesystem_benchmark_run (benchmark, target, NULL, NULL, NULL, &error))
+    goto out;
+
+  if (g_strcmp0 (format, "csv") == 0)
+    {
+      output = gdu_filesystem_benchmark_to_csv (benchmark, target);
+    }
+  else if (g_strcmp0 (format, "gvariant") == 0)
+    {
+      GVariant *value;
+      value = g_variant_ref_sink (gdu_filesystem_benchmark_to_gvariant (benchmark));
+      output = g_variant_print (value, TRUE);
+      g_variant_unref (value);
+    }
+  else
+    {
+      output = gdu_filesystem_benchmark_to_json (benchmark, target);
+    }
+  g_print ("%s", output);
+  if (!g_str_has_suffix (output, "\n"))
+    g_print ("\n");
+
+  ret = 0;
+
+ out:
+  if (error != NULL)
+    {
+      g_printerr (_("Error benchmarking %s: %s\n"), target, error->message);
+      g_clear_error (&error);
+    }
+  g_free (output);
+  gdu_filesystem_benchmark_free (benchmark);
+  return ret;
+}
+
+/* Runs the benchmark for --benchmark in the local process and prints
+ * the result on stdout. This never registers the application or
+ * initializes GTK+ so it works on hosts without a display.
+ */
+static gint
+gdu_application_benchmark (GduApplication *app,
+                           const gchar    *target,
+                           GVariantDict   *options)
+{
+  GduBenchmark *benchmark;
+  UDisksBlock *block = NULL;
+  UDisksObject *object = NULL;
+  const gchar *opt_format = "json";
+  gchar *filename = NULL;
+  gchar *history_filename = NULL;
+  gchar *output = NULL;
+  GError *error = NULL;
+  struct stat statbuf;
+  gint fd = -1;
+  gint ret = 1;
+
+  benchmark = gdu_benchmark_new ();
+  benchmark->num_samples = 100;
+  benchmark->sample_size_mib = 10;
+  benchmark->num_access_samples = 1000;
+
+  g_variant_dict_lookup (options, "benchmark-format", "&s", &opt_format);
+  g_variant_dict_lookup (options, "benchmark-samples", "i", &benchmark->num_samples);
+  g_variant_dict_lookup (options, "benchmark-sample-size", "i", &benchmark->sample_size_mib);
+  g_variant_dict_lookup (options, "benchmark-access-samples", "i", &benchmark->num_access_samples);
+  g_variant_dict_lookup (options, "benchmark-write", "b", &benchmark->do_write);
+
+  if (g_strcmp0 (opt_format, "json") != 0 &&
+      g_strcmp0 (opt_format, "csv") != 0 &&
+      g_strcmp0 (opt_format, "gvariant") != 0)
+    {
+      g_printerr (_("Unknown benchmark format “%s”\n"), opt_format);
+      goto out;
+    }
+
+  if (stat (target, &statbuf) != 0)
+    {
+      g_printerr (_("Error opening %s: %s\n"), target, g_strerror (errno));
+      goto out;
+    }
+
+  if (S_ISDIR (statbuf.st_mode))
+    {
+      ret = gdu_application_benchmark_filesystem (app, target, opt_format, options);
+      goto out;
+    }
+
+  /* Keep in sync with the adjustments in benchmark-dialog.ui */
+  if (benchmark->num_samples < 2 || benchmark->num_samples > 1000 ||
+      benchmark->sample_size_mib < 1 || benchmark->sample_size_mib > 1000 ||
+      benchmark->num_access_samples < 2 || benchmark->num_access_samples > 10000)
+    {
+      g_printerr (_("Invalid benchmark parameters\n"));
+      goto out;
+    }
+
+  if (S_ISBLK (statbuf.st_mode))
+    {
+      gdu_application_ensure_client (app, FALSE);
+
+      block = udisks_client_get_block_for_dev (app->client, statbuf.st_rdev);
+      if (block == NULL)
+        {
+          g_printerr (_("Error looking up block device for %s\n"), target);
+          goto out;
+        }
+      object = UDISKS_OBJECT (g_dbus_interface_dup_object (G_DBUS_INTERFACE (block)));
+
+      if (benchmark->do_write && gdu_utils_is_in_use (app->client, object))
+        {
+          g_printerr (_("%s is in use, not performing write benchmark\n"), target);
+          goto out;
+        }
+
+      fd = gdu_benchmark_open_block (block, benchmark->do_write, NULL, &error);
+      filename = gdu_benchmark_get_filename_for_block (block);
+      history_filename = gdu_benchmark_get_history_filename_for_block (block);
+    }
+  else
+    {
+      fd = gdu_benchmark_open_file (target, benchmark->do_write, &error);
+    }
+
+  if (fd == -1)
+    goto out;
+
+  /* Also update the data and history shown in the benchmark dialog */
+  if (!gdu_benchmark_run (benchmark, fd, filename, NULL, NULL, NULL, &error))
+    goto out;
+  if (history_filename != NULL && !gdu_benchmark_append_to_history (benchmark, history_filename, &error))
+    goto out;
+
+  if (g_strcmp0 (opt_format, "csv") == 0)
+    {
+      output = gdu_benchmark_to_csv (benchmark, target);
+    }
+  else if (g_strcmp0 (opt_format, "gvariant") == 0)
+    {
+      GVariant *value;
+      value = g_variant_ref_sink (gdu_benchmark_to_gvariant (benchmark));
+      output = g_variant_print (value, TRUE);
+      g_variant_unref (value);
+    }
+  else
+    {
+      output = gdu_benchmark_to_json (benchmark, target);
+    }
+  g_print ("%s", output);
+  if (!g_str_has_suffix (output, "\n"))
+    g_print ("\n");
+
+  ret = 0;
+
+ out:
+  if (error != NULL)
+    {
+      g_printerr (_("Error benchmarking %s: %s\n"), target, error->message);
+      g_clear_error (&error);
+    }
+  if (fd != -1)
+    close (fd);
+  g_free (output);
+  g_free (history_filename);
+  g_free (filename);
+  g_clear_object (&object);
+  g_clear_object (&block);
+  gdu_benchmark_free (benchmark);
+  return ret;
+}
+
+/* called in local instance, before registering */
+static gint
+gdu_application_handle_local_options (GApplication *_app,
+                                      GVariantDict *options)
+{
+  GduApplication *app = GDU_APPLICATION (_app);
+  const gchar *opt_benchmark = NULL;
+
+  if (g_variant_dict_lookup (options, "benchmark", "^&ay", &opt_benchmark))
+    return gdu_application_benchmark (app, opt_benchmark, options);
+
+  /* continue with default processing */
+  return -1;
+}
+
 /* called in primary instance */
 static gint
 gdu_application_command_line (GApplication            *_app,
@@ -217,7 +614,7 @@ gdu_application_command_line (GApplication            *_app,
       goto out;
     }
 
-  gdu_application_ensure_client (app);
+  gdu_application_ensure_client (app, TRUE);
 
   if (opt_block_device != NULL)
     {
@@ -287,7 +684,11 @@ gdu_application_activate (GApplication *_app)
 {
   GduApplication *app = GDU_APPLICATION (_app);
 
-  gdu_application_ensure_client (app);
+  gdu_application_ensure_client (app, TRUE);
+
+  /* only record SMART history while running interactively */
+  if (app->smart_recorder == NULL)
+    app->smart_recorder = gdu_smart_recorder_new (app->client);
 
   app->window = gdu_window_new (app, app->client);
   gtk_application_add_window (GTK_APPLICATION (app),
@@ -315,6 +716,33 @@ attach_disk_image_activated (GSimpleAction *action,
   gdu_window_show_attach_disk_image (app->window);
 }
 
+static void
+benchmark_multiple_disks_activated (GSimpleAction *action,
+                                    GVariant      *parameter,
+                                    gpointer       user_data)
+{
+  GduApplication *app = GDU_APPLICATION (user_data);
+  gdu_multi_benchmark_dialog_show (app->window);
+}
+
+static void
+erase_multiple_disks_activated (GSimpleAction *action,
+                                GVariant      *parameter,
+                                gpointer       user_data)
+{
+  GduApplication *app = GDU_APPLICATION (user_data);
+  gdu_erase_multiple_disks_dialog_show (app->window);
+}
+
+static void
+smart_dashboard_activated (GSimpleAction *action,
+                           GVariant      *parameter,
+                           gpointer       user_data)
+{
+  GduApplication *app = GDU_APPLICATION (user_data);
+  gdu_smart_dashboard_dialog_show (app->window);
+}
+
 static void
 shortcuts_activated (GSimpleAction *action,
                      GVariant      *parameter,
@@ -394,6 +822,9 @@ static GActionEntry app_entries[] =
 {
   { "new_disk_image", new_disk_image_activated, NULL, NULL, NULL },
   { "attach_disk_image", attach_disk_image_activated, NULL, NULL, NULL },
+  { "benchmark_multiple_disks", benchmark_multiple_disks_activated, NULL, NULL, NULL },
+  { "erase_multiple_disks", erase_multiple_disks_activated, NULL, NULL, NULL },
+  { "smart_dashboard", smart_dashboard_activated, NULL, NULL, NULL },
   { "shortcuts", shortcuts_activated, NULL, NULL, NULL },
   { "help", help_activated, NULL, NULL, NULL },
   { "about", about_activated, NULL, NULL, NULL },
@@ -451,8 +882,29 @@ gdu_application_class_init (GduApplicationClass *klass)
 
   application_class = G_APPLICATION_CLASS (klass);
   application_class->command_line = gdu_application_command_line;
+  application_class->handle_local_options = gdu_application_handle_local_options;
   application_class->activate     = gdu_application_activate;
   application_class->startup      = gdu_application_startup;
+
+  /**
+   * GduApplication::local-jobs-changed:
+   * @application: A #GduApplication.
+   * @object: The #UDisksObject the local jobs are for.
+   *
+   * Emitted when a local job for @object is created, destroyed or
+   * changes. Unlike #UDisksClient::changed this says which object is
+   * affected.
+   */
+  signals[LOCAL_JOBS_CHANGED_SIGNAL] = g_signal_new ("local-jobs-changed",
+                                                     GDU_TYPE_APPLICATION,
+                                                     G_SIGNAL_RUN_LAST,
+                                                     0,
+                                                     NULL,
+                                                     NULL,
+                                                     g_cclosure_marshal_VOID__OBJECT,
+                                                     G_TYPE_NONE,
+                                                     1,
+                                                     UDISKS_TYPE_OBJECT);
 }
 
 GApplication *
@@ -521,6 +973,7 @@ on_local_job_notify (GObject    *object,
                      gpointer    user_data)
 {
   GduApplication *app = GDU_APPLICATION (user_data);
+  g_signal_emit (app, signals[LOCAL_JOBS_CHANGED_SIGNAL], 0, gdu_local_job_get_object (GDU_LOCAL_JOB (object)));
   udisks_client_queue_changed (app->client);
 }
 
@@ -543,6 +996,7 @@ gdu_application_create_local_job  (GduApplication *application,
 
   g_signal_connect (job, "notify", G_CALLBACK (on_local_job_notify), application);
 
+  g_signal_emit (application, signals[LOCAL_JOBS_CHANGED_SIGNAL], 0, object);
   udisks_client_queue_changed (application->client);
 
   return job;
@@ -573,6 +1027,8 @@ gdu_application_destroy_local_job (GduApplication *application,
   else
     g_hash_table_remove (application->local_jobs, object);
 
+  /* @object belongs to @job */
+  g_signal_emit (application, signals[LOCAL_JOBS_CHANGED_SIGNAL], 0, object);
   g_object_unref (job);
 
   udisks_client_queue_changed (application->client);
@@ -633,19 +1089,13 @@ gdu_application_has_running_job (GduApplication *application,
       encrypted_for_object = udisks_object_peek_encrypted (object_iter);
       if (encrypted_for_object != NULL)
         {
-          UDisksBlock *block_for_object;
-          UDisksBlock *cleartext;
+          UDisksObject *cleartext_object;
 
-          block_for_object = udisks_object_peek_block (object_iter);
-          cleartext = udisks_client_get_cleartext_block (client, block_for_object);
-          if (cleartext != NULL)
+          cleartext_object = gdu_utils_get_cleartext_object (client, object_iter);
+          if (cleartext_object != NULL)
             {
-              UDisksObject *cleartext_object;
-
-              cleartext_object = (UDisksObject *) g_dbus_interface_get_object (G_DBUS_INTERFACE (cleartext));
-              g_object_unref (cleartext);
-
               ret = gdu_application_has_running_job (application, cleartext_object);
+              g_object_unref (cleartext_object);
               if (ret)
                 break;
             }
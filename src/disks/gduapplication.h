@@ -39,6 +39,9 @@ GList        *gdu_application_get_local_jobs_for_object (GduApplication *applica
 gboolean      gdu_application_has_running_job (GduApplication *application,
                                                UDisksObject   *object);
 
+UDisksObjectInfo *gdu_application_get_object_info (GduApplication *application,
+                                                   UDisksObject   *object);
+
 
 G_END_DECLS
 
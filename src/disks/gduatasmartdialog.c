@@ -14,6 +14,7 @@
 #include "gduapplication.h"
 #include "gduwindow.h"
 #include "gduatasmartdialog.h"
+#include "gdusmarthistory.h"
 
 enum
 {
@@ -42,6 +43,7 @@ typedef struct
   GtkBuilder *builder;
 
   GtkListStore *attributes_list;
+  GHashTable *attribute_rows; /* attribute id -> AttributeRow */
 
   GtkWidget *enabled_switch;
   GtkWidget *status_grid;
@@ -57,6 +59,7 @@ typedef struct
   GtkWidget *overall_assessment_label;
 
   GtkWidget *attributes_treeview;
+  GtkWidget *trends_drawingarea;
 
   GtkWidget *start_selftest_button;
   GtkWidget *stop_selftest_button;
@@ -66,6 +69,10 @@ typedef struct
   GtkWidget *selftest_short_menuitem;
   GtkWidget *selftest_extended_menuitem;
   GtkWidget *selftest_conveyance_menuitem;
+
+  gchar *history_filename;
+  goffset history_size;
+  GArray *history; /* of GduSmartSample, NULL if not loaded */
 } DialogData;
 
 static const struct {
@@ -85,6 +92,7 @@ static const struct {
   {G_STRUCT_OFFSET (DialogData, self_assessment_label), "self-assessment-label"},
   {G_STRUCT_OFFSET (DialogData, overall_assessment_label), "overall-assessment-label"},
   {G_STRUCT_OFFSET (DialogData, attributes_treeview), "attributes-treeview"},
+  {G_STRUCT_OFFSET (DialogData, trends_drawingarea), "trends-drawingarea"},
   {G_STRUCT_OFFSET (DialogData, selftest_menu), "selftest-menu"},
   {G_STRUCT_OFFSET (DialogData, selftest_short_menuitem), "selftest-short-menuitem"},
   {G_STRUCT_OFFSET (DialogData, selftest_extended_menuitem), "selftest-extended-menuitem"},
@@ -123,6 +131,12 @@ dialog_data_unref (DialogData *data)
 
       if (data->attributes_list != NULL)
         g_object_unref (data->attributes_list);
+      if (data->attribute_rows != NULL)
+        g_hash_table_unref (data->attribute_rows);
+
+      if (data->history != NULL)
+        g_array_unref (data->history);
+      g_free (data->history_filename);
 
       g_free (data);
     }
@@ -864,31 +878,14 @@ update_updated_label (DialogData *data)
   g_free (s);
 }
 
-static gchar *
-format_temp (UDisksDriveAta *ata)
+gchar *
+gdu_ata_smart_format_temperature (UDisksDriveAta *ata)
 {
-  gdouble temp;
-  gchar *ret = NULL;
-
-  temp = udisks_drive_ata_get_smart_temperature (ata);
-  if (temp > 1.0)
-    {
-      gdouble celcius;
-      gdouble fahrenheit;
-
-      celcius = temp - 273.15;
-      fahrenheit = 9.0 * celcius / 5.0 + 32.0;
-      /* Translators: Used to format a temperature.
-       * The first %f is the temperature in degrees Celcius and
-       * the second %f is the temperature in degrees Fahrenheit.
-       */
-      ret = g_strdup_printf (_("%.0f° C / %.0f° F"), celcius, fahrenheit);
-    }
-  return ret;
+  return gdu_smart_format_temperature (udisks_drive_ata_get_smart_temperature (ata));
 }
 
-static gchar *
-format_powered_on (UDisksDriveAta *ata)
+gchar *
+gdu_ata_smart_format_powered_on (UDisksDriveAta *ata)
 {
   guint64 secs;
   gchar *ret = NULL;
@@ -1026,7 +1023,7 @@ gdu_ata_smart_get_overall_assessment (UDisksDriveAta *ata,
   if (one_liner)
     {
       gchar *s, *s1;
-      s = format_temp (ata);
+      s = gdu_ata_smart_format_temperature (ata);
       if (s != NULL)
         {
           /* Translators: Used to convey the status and temperature in one line.
@@ -1056,30 +1053,44 @@ gdu_ata_smart_get_one_liner_assessment (UDisksDriveAta *ata,
   return gdu_ata_smart_get_overall_assessment (ata, TRUE, out_smart_is_supported, out_warn);
 }
 
+gchar *
+gdu_ata_smart_get_assessment (UDisksDriveAta *ata,
+                              gboolean       *out_smart_is_supported,
+                              gboolean       *out_warn)
+{
+  return gdu_ata_smart_get_overall_assessment (ata, FALSE, out_smart_is_supported, out_warn);
+}
+
 /* ---------------------------------------------------------------------------------------------------- */
 
+/* A row in the attributes list along with the values it was last updated with */
+typedef struct
+{
+  GtkTreeIter iter;
+  gboolean seen;
+  guint16 flags;
+  gint current;
+  gint worst;
+  gint threshold;
+  guint64 pretty;
+  gint pretty_unit;
+} AttributeRow;
+
 static void
 update_attributes_list (DialogData *data,
                         GVariant   *attributes)
 {
-  GtkTreeIter tree_iter;
-  GtkTreeIter *tree_iter_to_select;
-  gint selected_id;
+  GtkTreeSelection *selection;
+  GHashTableIter hash_iter;
+  AttributeRow *row;
 
-  /* record currently selected row so we can reselect it */
-  selected_id = -1;
-  tree_iter_to_select = NULL;
-  if (gtk_tree_selection_get_selected (gtk_tree_view_get_selection (GTK_TREE_VIEW (data->attributes_treeview)),
-                                       NULL,
-                                       &tree_iter))
-    {
-      gtk_tree_model_get (GTK_TREE_MODEL (data->attributes_list),
-                          &tree_iter,
-                          ID_COLUMN, &selected_id,
-                          -1);
-    }
+  /* rows are keyed by attribute id and only touched when their values
+   * change - this keeps the selection and scroll position intact
+   */
+  g_hash_table_iter_init (&hash_iter, data->attribute_rows);
+  while (g_hash_table_iter_next (&hash_iter, NULL, (gpointer) &row))
+    row->seen = FALSE;
 
-  gtk_list_store_clear (data->attributes_list);
   if (attributes != NULL)
     {
       GVariantIter iter;
@@ -1100,87 +1111,125 @@ update_attributes_list (DialogData *data,
                                   &pretty, &pretty_unit,
                                   &expansion))
         {
-          GtkTreeIter titer;
-          gchar *long_desc_str;
-          gchar *desc_str;
-          gchar *assessment_str;
-          gchar *pretty_str;
-          gchar *current_str;
-          gchar *threshold_str;
-          gchar *worst_str;
-          const gchar *type_str;
-          const gchar *updates_str;
-          const gchar *na_str;
-
-          desc_str = attr_format_desc (id, name);
-          long_desc_str = attr_format_long_desc (id, name);
-          assessment_str = attr_format_assessment (current, worst, threshold, flags);
-          pretty_str = pretty_to_string (pretty, pretty_unit);
-
-          if (flags & 0x0001)
-            type_str = _("Pre-Fail");
-          else
-            type_str = _("Old-Age");
-
-          if (flags & 0x0002)
-            updates_str = _("Online");
-          else
-            updates_str = _("Offline");
-
-          /* Translators: Shown for normalized values (current, worst, threshold) if the value is
-           * not applicable, e.g. meaningless. See http://en.wikipedia.org/wiki/N/A
-           */
-          na_str = _("N/A");
-          current_str   = (current == -1   ? g_strdup (na_str) : g_strdup_printf ("%d", current));
-          threshold_str = (threshold == -1 ? g_strdup (na_str) : g_strdup_printf ("%d", threshold));
-          worst_str     = (worst == -1     ? g_strdup (na_str) : g_strdup_printf ("%d", worst));
-
-          gtk_list_store_append (data->attributes_list, &titer);
-          gtk_list_store_set (data->attributes_list, &titer,
-                              ID_COLUMN, (gint) id,
-                              DESC_COLUMN, desc_str,
-                              LONG_DESC_COLUMN, long_desc_str,
-                              ASSESSMENT_COLUMN, assessment_str,
-                              PRETTY_COLUMN, pretty_str,
-                              NORMALIZED_COLUMN, current_str,
-                              THRESHOLD_COLUMN, threshold_str,
-                              WORST_COLUMN, worst_str,
-                              TYPE_COLUMN, type_str,
-                              UPDATES_COLUMN, updates_str,
-                              FLAGS_COLUMN, flags,
-                              -1);
-
-          if (id == selected_id)
-            tree_iter_to_select = gtk_tree_iter_copy (&titer);
-
-          g_free (desc_str);
-          g_free (long_desc_str);
-          g_free (assessment_str);
-          g_free (pretty_str);
-          g_free (current_str);
-          g_free (threshold_str);
-          g_free (worst_str);
+          gboolean is_new = FALSE;
+
+          row = g_hash_table_lookup (data->attribute_rows, GINT_TO_POINTER ((gint) id));
+          if (row == NULL)
+            {
+              gchar *long_desc_str;
+              gchar *desc_str;
+
+              /* the name and descriptions never change */
+              desc_str = attr_format_desc (id, name);
+              long_desc_str = attr_format_long_desc (id, name);
+
+              row = g_new0 (AttributeRow, 1);
+              gtk_list_store_insert_with_values (data->attributes_list, &row->iter, -1,
+                                                 ID_COLUMN, (gint) id,
+                                                 DESC_COLUMN, desc_str,
+                                                 LONG_DESC_COLUMN, long_desc_str,
+                                                 -1);
+              g_hash_table_insert (data->attribute_rows, GINT_TO_POINTER ((gint) id), row);
+              is_new = TRUE;
+
+              g_free (desc_str);
+              g_free (long_desc_str);
+            }
+          row->seen = TRUE;
+
+          if (is_new || row->flags != flags)
+            {
+              const gchar *type_str;
+              const gchar *updates_str;
+
+              if (flags & 0x0001)
+                type_str = _("Pre-Fail");
+              else
+                type_str = _("Old-Age");
+
+              if (flags & 0x0002)
+                updates_str = _("Online");
+              else
+                updates_str = _("Offline");
+
+              gtk_list_store_set (data->attributes_list, &row->iter,
+                                  TYPE_COLUMN, type_str,
+                                  UPDATES_COLUMN, updates_str,
+                                  FLAGS_COLUMN, flags,
+                                  -1);
+            }
+
+          if (is_new || row->pretty != pretty || row->pretty_unit != pretty_unit)
+            {
+              gchar *pretty_str;
+
+              pretty_str = pretty_to_string (pretty, pretty_unit);
+              gtk_list_store_set (data->attributes_list, &row->iter,
+                                  PRETTY_COLUMN, pretty_str,
+                                  -1);
+              g_free (pretty_str);
+            }
+
+          if (is_new || row->current != current || row->worst != worst || row->threshold != threshold || row->flags != flags)
+            {
+              gchar *assessment_str;
+              gchar *current_str;
+              gchar *threshold_str;
+              gchar *worst_str;
+              const gchar *na_str;
+
+              assessment_str = attr_format_assessment (current, worst, threshold, flags);
+
+              /* Translators: Shown for normalized values (current, worst, threshold) if the value is
+               * not applicable, e.g. meaningless. See http://en.wikipedia.org/wiki/N/A
+               */
+              na_str = _("N/A");
+              current_str   = (current == -1   ? g_strdup (na_str) : g_strdup_printf ("%d", current));
+              threshold_str = (threshold == -1 ? g_strdup (na_str) : g_strdup_printf ("%d", threshold));
+              worst_str     = (worst == -1     ? g_strdup (na_str) : g_strdup_printf ("%d", worst));
+
+              gtk_list_store_set (data->attributes_list, &row->iter,
+                                  ASSESSMENT_COLUMN, assessment_str,
+                                  NORMALIZED_COLUMN, current_str,
+                                  THRESHOLD_COLUMN, threshold_str,
+                                  WORST_COLUMN, worst_str,
+                                  -1);
+
+              g_free (assessment_str);
+              g_free (current_str);
+              g_free (threshold_str);
+              g_free (worst_str);
+            }
+
+          row->flags = flags;
+          row->current = current;
+          row->worst = worst;
+          row->threshold = threshold;
+          row->pretty = pretty;
+          row->pretty_unit = pretty_unit;
 
           g_variant_unref (expansion);
         }
     }
 
-  /* reselect the previously selected row */
-  if (tree_iter_to_select != NULL)
+  /* remove attributes that went away */
+  g_hash_table_iter_init (&hash_iter, data->attribute_rows);
+  while (g_hash_table_iter_next (&hash_iter, NULL, (gpointer) &row))
     {
-      gtk_tree_selection_select_iter (gtk_tree_view_get_selection (GTK_TREE_VIEW (data->attributes_treeview)),
-                                      tree_iter_to_select);
-      gtk_tree_iter_free (tree_iter_to_select);
+      if (!row->seen)
+        {
+          gtk_list_store_remove (data->attributes_list, &row->iter);
+          g_hash_table_iter_remove (&hash_iter);
+        }
     }
-  else
+
+  /* select the first row, if the previously selected one does not exist anymore */
+  selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (data->attributes_treeview));
+  if (!gtk_tree_selection_get_selected (selection, NULL, NULL))
     {
       GtkTreeIter titer;
-      /* or the first row, if the previously selected one does not exist anymore */
       if (gtk_tree_model_get_iter_first (GTK_TREE_MODEL (data->attributes_list), &titer))
-        {
-          gtk_tree_selection_select_iter (gtk_tree_view_get_selection (GTK_TREE_VIEW (data->attributes_treeview)),
-                                          &titer);
-        }
+        gtk_tree_selection_select_iter (selection, &titer);
     }
 }
 
@@ -1244,13 +1293,13 @@ update_dialog (DialogData *data)
       gtk_label_set_markup (GTK_LABEL (data->self_assessment_label), s);
       g_free (s);
 
-      s = format_powered_on (data->ata);
+      s = gdu_ata_smart_format_powered_on (data->ata);
       if (s == NULL)
         s = g_strdup ("—");
       gtk_label_set_markup (GTK_LABEL (data->powered_on_label), s);
       g_free (s);
 
-      s = format_temp (data->ata);
+      s = gdu_ata_smart_format_temperature (data->ata);
       if (s == NULL)
         s = g_strdup ("—");
       gtk_label_set_markup (GTK_LABEL (data->temperature_label), s);
@@ -1281,6 +1330,34 @@ update_dialog (DialogData *data)
   gtk_widget_set_sensitive (data->attributes_vbox, enabled);
 }
 
+static const GduSmartTrend trends[] =
+{
+  GDU_SMART_TREND_REALLOCATED_SECTORS,
+  GDU_SMART_TREND_PENDING_SECTORS,
+  GDU_SMART_TREND_TEMPERATURE,
+  GDU_SMART_TREND_POWER_ON_HOURS
+};
+
+/* reloads the history if the recorder has appended to it */
+static void
+update_history (DialogData *data)
+{
+  if (gdu_smart_history_reload (data->history_filename, &data->history_size, &data->history))
+    gtk_widget_queue_draw (data->trends_drawingarea);
+}
+
+static gboolean
+on_trends_drawingarea_draw (GtkWidget *widget,
+                            cairo_t   *cr,
+                            gpointer   user_data)
+{
+  DialogData *data = user_data;
+  gdu_smart_history_draw (widget, cr, data->history, trends, G_N_ELEMENTS (trends));
+  return FALSE;
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
 /* called when properties on the Drive.Ata object changes */
 static void
 on_ata_notify (GObject     *object,
@@ -1297,6 +1374,7 @@ on_timeout (gpointer user_data)
 {
   DialogData *data = user_data;
   update_updated_label (data);
+  update_history (data);
   return TRUE; /* keep timeout around */
 }
 
@@ -1516,6 +1594,7 @@ gdu_ata_smart_dialog_show (GduWindow    *window,
                                               G_TYPE_STRING,      /* type */
                                               G_TYPE_STRING,      /* updates */
                                               G_TYPE_INT);        /* flags */
+  data->attribute_rows = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, g_free);
   gtk_tree_sortable_set_sort_column_id (GTK_TREE_SORTABLE (data->attributes_list),
                                         ID_COLUMN,
                                         GTK_SORT_ASCENDING);
@@ -1649,6 +1728,11 @@ gdu_ata_smart_dialog_show (GduWindow    *window,
   g_signal_connect (data->selftest_extended_menuitem, "activate", G_CALLBACK (on_selftest_extended), data);
   g_signal_connect (data->selftest_conveyance_menuitem, "activate", G_CALLBACK (on_selftest_conveyance), data);
 
+  if (udisks_object_peek_drive (object) != NULL)
+    data->history_filename = gdu_smart_history_get_filename_for_drive (udisks_object_peek_drive (object));
+  g_signal_connect (data->trends_drawingarea, "draw", G_CALLBACK (on_trends_drawingarea_draw), data);
+  update_history (data);
+
   update_dialog (data);
   gtk_widget_grab_focus (data->attributes_treeview);
 
@@ -21,6 +21,13 @@ void   gdu_ata_smart_dialog_show (GduWindow    *window,
 gchar *gdu_ata_smart_get_one_liner_assessment (UDisksDriveAta *ata,
                                                gboolean       *out_smart_is_supported,
                                                gboolean       *out_warn);
+gchar *gdu_ata_smart_get_assessment           (UDisksDriveAta *ata,
+                                               gboolean       *out_smart_is_supported,
+                                               gboolean       *out_warn);
+
+/* returns NULL if not available */
+gchar *gdu_ata_smart_format_temperature       (UDisksDriveAta *ata);
+gchar *gdu_ata_smart_format_powered_on        (UDisksDriveAta *ata);
 
 G_END_DECLS
 
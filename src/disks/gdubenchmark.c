@@ -0,0 +1,2388 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*-
+ *
+ * Copyright (C) 2008-2013 Red Hat, Inc.
+ *
+ * Licensed under GPL version 2 or later.
+ *
+ * Author: David Zeuthen <zeuthen@gmail.com>
+ */
+
+#include "config.h"
+
+#define _GNU_SOURCE
+#include <fcntl.h>
+
+#include <glib/gi18n.h>
+#include <gio/gunixfdlist.h>
+
+#include <glib-unix.h>
+#include <glib/gstdio.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#include <linux/fs.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+
+#include "gdubenchmark.h"
+
+/* The benchmark engine - used by the benchmark dialogs and the
+ * headless --benchmark command-line option. Nothing in here touches
+ * GTK+ widgets so it is safe to run without a display.
+ */
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+GduBenchmark *
+gdu_benchmark_new (void)
+{
+  GduBenchmark *benchmark;
+
+  benchmark = g_new0 (GduBenchmark, 1);
+  g_mutex_init (&benchmark->lock);
+  return benchmark;
+}
+
+/* must be called with the lock held, if the benchmark is shared */
+static void
+release_storage (GduBenchmark *benchmark)
+{
+  if (benchmark->storage != NULL)
+    {
+      if (benchmark->storage_is_mmap)
+        munmap (benchmark->storage, benchmark->storage_size);
+      else
+        g_free (benchmark->storage);
+    }
+  g_clear_pointer (&benchmark->mapped_file, g_mapped_file_unref);
+  benchmark->storage = NULL;
+  benchmark->storage_size = 0;
+  benchmark->storage_is_mmap = FALSE;
+  benchmark->read_samples = NULL;
+  benchmark->num_read_samples = 0;
+  benchmark->write_samples = NULL;
+  benchmark->num_write_samples = 0;
+  benchmark->access_time_samples = NULL;
+  benchmark->num_access_time_samples = 0;
+}
+
+void
+gdu_benchmark_free (GduBenchmark *benchmark)
+{
+  release_storage (benchmark);
+  g_mutex_clear (&benchmark->lock);
+  g_free (benchmark);
+}
+
+void
+gdu_benchmark_lock (GduBenchmark *benchmark)
+{
+  g_mutex_lock (&benchmark->lock);
+}
+
+void
+gdu_benchmark_unlock (GduBenchmark *benchmark)
+{
+  g_mutex_unlock (&benchmark->lock);
+}
+
+/* Forgets all results - takes the lock */
+void
+gdu_benchmark_clear (GduBenchmark *benchmark)
+{
+  gdu_benchmark_lock (benchmark);
+  release_storage (benchmark);
+  benchmark->time_benchmarked_usec = 0;
+  benchmark->incomplete = FALSE;
+  benchmark->sample_size = 0;
+  benchmark->size = 0;
+  gdu_benchmark_unlock (benchmark);
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+void
+gdu_benchmark_get_max_min_avg (const GduBenchmarkSample *samples,
+                               guint                     num_samples,
+                               gdouble                  *out_max,
+                               gdouble                  *out_min,
+                               gdouble                  *out_avg)
+{
+  guint n;
+  gdouble max = 0;
+  gdouble min = 0;
+  gdouble avg = 0;
+  gdouble sum = 0;
+
+  if (num_samples == 0)
+    goto out;
+
+  max = -G_MAXDOUBLE;
+  min = G_MAXDOUBLE;
+  sum = 0;
+
+  for (n = 0; n < num_samples; n++)
+    {
+      const GduBenchmarkSample *s = &samples[n];
+      if (s->value > max)
+        max = s->value;
+      if (s->value < min)
+        min = s->value;
+      sum += s->value;
+    }
+  avg = sum / num_samples;
+
+ out:
+  if (out_max != NULL)
+    *out_max = max;
+  if (out_min != NULL)
+    *out_min = min;
+  if (out_avg != NULL)
+    *out_avg = avg;
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+/* Returns a file descriptor for @block opened via udisks or -1 if @error is set */
+gint
+gdu_benchmark_open_block (UDisksBlock   *block,
+                          gboolean       writable,
+                          GCancellable  *cancellable,
+                          GError       **error)
+{
+  GVariant *fd_index = NULL;
+  GUnixFDList *fd_list = NULL;
+  GVariantBuilder options_builder;
+  gint fd = -1;
+
+  g_variant_builder_init (&options_builder, G_VARIANT_TYPE_VARDICT);
+  g_variant_builder_add (&options_builder, "{sv}", "writable", g_variant_new_boolean (writable));
+
+  if (!udisks_block_call_open_for_benchmark_sync (block,
+                                                  g_variant_builder_end (&options_builder),
+                                                  NULL, /* fd_list */
+                                                  &fd_index,
+                                                  &fd_list,
+                                                  cancellable,
+                                                  error))
+    goto out;
+
+  fd = g_unix_fd_list_get (fd_list, g_variant_get_handle (fd_index), error);
+
+ out:
+  g_clear_object (&fd_list);
+  if (fd_index != NULL)
+    g_variant_unref (fd_index);
+  return fd;
+}
+
+/* Returns a file descriptor for @filename or -1 if @error is set. Like
+ * udisks does for OpenForBenchmark, tries to bypass the page cache but
+ * falls back to buffered I/O on filesystems not supporting O_DIRECT.
+ */
+gint
+gdu_benchmark_open_file (const gchar  *filename,
+                         gboolean      writable,
+                         GError      **error)
+{
+  gint flags;
+  gint fd;
+
+  flags = (writable ? O_RDWR : O_RDONLY) | O_CLOEXEC;
+  fd = open (filename, flags | O_DIRECT);
+  if (fd == -1 && errno == EINVAL)
+    fd = open (filename, flags);
+  if (fd == -1)
+    {
+      g_set_error (error,
+                   G_IO_ERROR,
+                   g_io_error_from_errno (errno),
+                   C_("benchmarking", "Error opening %s: %m"),
+                   filename);
+    }
+  return fd;
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+static gboolean
+get_size (gint      fd,
+          guint64  *out_size,
+          GError  **error)
+{
+  struct stat statbuf;
+
+  if (fstat (fd, &statbuf) != 0)
+    {
+      g_set_error (error,
+                   G_IO_ERROR,
+                   g_io_error_from_errno (errno),
+                   C_("benchmarking", "Error getting size of device: %m"));
+      return FALSE;
+    }
+
+  if (S_ISREG (statbuf.st_mode))
+    {
+      *out_size = statbuf.st_size;
+      return TRUE;
+    }
+
+  /* We can't use udisks_block_get_size() because the media may have
+   * changed and udisks may not have noticed. TODO: maybe have a
+   * Block.GetSize() method instead...
+   */
+  if (ioctl (fd, BLKGETSIZE64, out_size) != 0)
+    {
+      g_set_error (error,
+                   G_IO_ERROR,
+                   g_io_error_from_errno (errno),
+                   C_("benchmarking", "Error getting size of device: %m"));
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+/* The results file for the last run of a device. It is written while
+ * benchmarking through a shared writable mapping - each sample lands in
+ * a slot preallocated from the run parameters and the count in the
+ * header is bumped afterwards. A run is written to <results>.partial
+ * which replaces the results file once the run is complete. If the run
+ * is cancelled, fails or the process dies, the samples gathered so far
+ * stay in the partial file, without RESULTS_FLAGS_COMPLETE, and are
+ * loaded (marked as incomplete) in favour of the older results. The
+ * next run replaces the partial file. Loading maps the file read-only
+ * and points the samples straight into the mapping instead of parsing
+ * and copying them.
+ *
+ * A ResultsHeader is followed by the read, write and access time
+ * sections (in that order) of read_capacity, write_capacity and
+ * access_time_capacity samples each. Like the history file everything
+ * is in host byte-order. Files from before this format was introduced
+ * are serialized a{sv} GVariants and are still loaded (by copying).
+ */
+
+#define RESULTS_MAGIC      "GDUBMRES"
+#define RESULTS_VERSION    1
+#define RESULTS_BYTE_ORDER 0x01020304
+
+#define RESULTS_FLAGS_COMPLETE (1<<0)
+
+typedef struct
+{
+  gchar   magic[8];
+  guint32 version;
+  guint32 byte_order;
+  gint64  timestamp_usec; /* start of the run until complete, then end of the run */
+  guint32 flags;
+  guint32 reserved;
+  guint64 device_size;
+  guint64 sample_size;
+  guint32 read_capacity;
+  guint32 num_read_samples;
+  guint32 write_capacity;
+  guint32 num_write_samples;
+  guint32 access_time_capacity;
+  guint32 num_access_time_samples;
+} ResultsHeader;
+
+G_STATIC_ASSERT (sizeof (ResultsHeader) == 72);
+G_STATIC_ASSERT (sizeof (GduBenchmarkSample) == 16);
+
+static gsize
+get_results_size (guint32 read_capacity,
+                  guint32 write_capacity,
+                  guint32 access_time_capacity)
+{
+  return sizeof (ResultsHeader) + sizeof (GduBenchmarkSample) * (((gsize) read_capacity) +
+                                                                  write_capacity +
+                                                                  access_time_capacity);
+}
+
+static GduBenchmarkSample *
+get_results_section (ResultsHeader *header,
+                     guint          section)
+{
+  GduBenchmarkSample *samples = (GduBenchmarkSample *) (header + 1);
+
+  if (section > 0)
+    samples += header->read_capacity;
+  if (section > 1)
+    samples += header->write_capacity;
+  return samples;
+}
+
+static gboolean
+check_results_header (const ResultsHeader  *header,
+                      gsize                 length,
+                      const gchar          *filename,
+                      GError              **error)
+{
+  if (header->byte_order != RESULTS_BYTE_ORDER)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                   "%s was written on a host with another byte-order", filename);
+      return FALSE;
+    }
+  if (header->version != RESULTS_VERSION)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                   "Cannot decode version %d data", header->version);
+      return FALSE;
+    }
+  if (length != get_results_size (header->read_capacity,
+                                  header->write_capacity,
+                                  header->access_time_capacity) ||
+      header->num_read_samples > header->read_capacity ||
+      header->num_write_samples > header->write_capacity ||
+      header->num_access_time_samples > header->access_time_capacity)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                   "%s is corrupt", filename);
+      return FALSE;
+    }
+  return TRUE;
+}
+
+/* Makes the results in @header (which must stay valid until the storage
+ * is released) the current results - must be called with the lock held
+ */
+static void
+use_results (GduBenchmark  *benchmark,
+             ResultsHeader *header)
+{
+  benchmark->size = header->device_size;
+  benchmark->sample_size = header->sample_size;
+  benchmark->read_samples = get_results_section (header, 0);
+  benchmark->num_read_samples = header->num_read_samples;
+  benchmark->write_samples = get_results_section (header, 1);
+  benchmark->num_write_samples = header->num_write_samples;
+  benchmark->access_time_samples = get_results_section (header, 2);
+  benchmark->num_access_time_samples = header->num_access_time_samples;
+  benchmark->incomplete = (header->flags & RESULTS_FLAGS_COMPLETE) == 0;
+  benchmark->time_benchmarked_usec = header->timestamp_usec;
+}
+
+/* Storage of a run in progress. It only replaces the results shown by
+ * the benchmark once the first sample is in, see add_sample().
+ */
+typedef struct
+{
+  ResultsHeader *header;
+  gsize size;
+  gboolean is_mmap;
+  gboolean in_use;
+  gchar *partial_filename; /* NULL if the results are kept in memory only */
+} RunResults;
+
+static gchar *
+get_partial_filename (const gchar *results_filename)
+{
+  return g_strdup_printf ("%s.partial", results_filename);
+}
+
+/* Sets up storage for a new run in @results, backed by the partial file
+ * for @results_filename if not %NULL
+ */
+static void
+create_results (GduBenchmark *benchmark,
+                const gchar  *results_filename,
+                guint64       disk_size,
+                guint64       sample_size,
+                RunResults   *results)
+{
+  ResultsHeader *header = NULL;
+  guint32 read_capacity;
+  guint32 write_capacity;
+  guint32 access_time_capacity;
+  gsize size;
+
+  read_capacity = benchmark->num_samples;
+  write_capacity = benchmark->do_write ? benchmark->num_samples : 0;
+  access_time_capacity = MAX (benchmark->num_access_samples, 0);
+  size = get_results_size (read_capacity, write_capacity, access_time_capacity);
+
+  memset (results, 0, sizeof (RunResults));
+
+  if (results_filename != NULL)
+    {
+      gchar *partial_filename;
+      gint fd;
+
+      /* Replace rather than truncate the partial file of an earlier
+       * run - someone (e.g. the dialog showing it) may still have it mapped
+       */
+      partial_filename = get_partial_filename (results_filename);
+      if (unlink (partial_filename) != 0 && errno != ENOENT)
+        g_warning ("Error removing %s: %m", partial_filename);
+      fd = open (partial_filename, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0666);
+      if (fd == -1)
+        {
+          g_warning ("Error creating %s: %m", partial_filename);
+        }
+      else
+        {
+          if (ftruncate (fd, size) != 0)
+            {
+              g_warning ("Error resizing %s: %m", partial_filename);
+            }
+          else
+            {
+              header = mmap (NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+              if (header == MAP_FAILED)
+                {
+                  g_warning ("Error mapping %s: %m", partial_filename);
+                  header = NULL;
+                }
+            }
+          close (fd);
+          if (header == NULL)
+            unlink (partial_filename);
+        }
+
+      if (header != NULL)
+        {
+          results->is_mmap = TRUE;
+          results->partial_filename = partial_filename;
+        }
+      else
+        {
+          g_free (partial_filename);
+        }
+    }
+
+  /* not saving the results shouldn't stop the benchmark */
+  if (header == NULL)
+    header = g_malloc0 (size);
+
+  memcpy (header->magic, RESULTS_MAGIC, sizeof header->magic);
+  header->version = RESULTS_VERSION;
+  header->byte_order = RESULTS_BYTE_ORDER;
+  header->timestamp_usec = g_get_real_time ();
+  header->device_size = disk_size;
+  header->sample_size = sample_size;
+  header->read_capacity = read_capacity;
+  header->write_capacity = write_capacity;
+  header->access_time_capacity = access_time_capacity;
+
+  results->header = header;
+  results->size = size;
+}
+
+/* Makes @results the results of @benchmark - must be called with the lock held */
+static void
+use_run_results (GduBenchmark *benchmark,
+                 RunResults   *results)
+{
+  release_storage (benchmark);
+  benchmark->storage = results->header;
+  benchmark->storage_size = results->size;
+  benchmark->storage_is_mmap = results->is_mmap;
+  use_results (benchmark, results->header);
+  /* not benchmarked until the run is complete */
+  benchmark->time_benchmarked_usec = 0;
+  benchmark->incomplete = FALSE;
+  results->in_use = TRUE;
+}
+
+/* Frees @results unless they were ever shown - a run without a single
+ * sample isn't worth keeping, not even as the partial file
+ */
+static void
+free_run_results (RunResults *results)
+{
+  if (!results->in_use)
+    {
+      if (results->is_mmap)
+        munmap (results->header, results->size);
+      else
+        g_free (results->header);
+      if (results->partial_filename != NULL)
+        unlink (results->partial_filename);
+    }
+  g_free (results->partial_filename);
+}
+
+static void
+add_sample (GduBenchmark           *benchmark,
+            RunResults             *results,
+            guint                   section,
+            guint64                 offset,
+            gdouble                 value,
+            GduBenchmarkUpdateFunc  update_func,
+            gpointer                user_data)
+{
+  ResultsHeader *header = results->header;
+  GduBenchmarkSample *samples;
+  guint32 *num;
+
+  switch (section)
+    {
+    case 0:
+      num = &header->num_read_samples;
+      break;
+    case 1:
+      num = &header->num_write_samples;
+      break;
+    default:
+      num = &header->num_access_time_samples;
+      break;
+    }
+
+  gdu_benchmark_lock (benchmark);
+  samples = get_results_section (header, section);
+  samples[*num].offset = offset;
+  samples[*num].value = value;
+  /* only count the sample once it has been written */
+  *num += 1;
+  if (!results->in_use)
+    use_run_results (benchmark, results);
+  benchmark->num_read_samples = header->num_read_samples;
+  benchmark->num_write_samples = header->num_write_samples;
+  benchmark->num_access_time_samples = header->num_access_time_samples;
+  gdu_benchmark_unlock (benchmark);
+
+  if (update_func != NULL)
+    update_func (benchmark, user_data);
+}
+
+/* Runs the benchmark on @fd - this blocks so it should be called from a
+ * dedicated thread. Results are appended to @benchmark as they come in
+ * and @update_func (if not %NULL) is called after each sample - until
+ * the first one, @benchmark keeps its previous results. If
+ * @results_filename is not %NULL, the samples are written to its partial
+ * file as they come in and it is replaced with them once the run is
+ * complete - see gdu_benchmark_load(). If the run doesn't complete,
+ * the samples gathered so far are marked as incomplete.
+ */
+gboolean
+gdu_benchmark_run (GduBenchmark            *benchmark,
+                   gint                     fd,
+                   const gchar             *results_filename,
+                   GCancellable            *cancellable,
+                   GduBenchmarkUpdateFunc   update_func,
+                   gpointer                 user_data,
+                   GError                 **error)
+{
+  gboolean ret = FALSE;
+  guchar *buffer_unaligned = NULL;
+  guchar *buffer = NULL;
+  GRand *rand = NULL;
+  RunResults results = { NULL, };
+  gint n;
+  long page_size;
+  guint64 disk_size;
+  gsize sample_size;
+
+  g_return_val_if_fail (benchmark->num_samples > 0, FALSE);
+  g_return_val_if_fail (benchmark->sample_size_mib > 0, FALSE);
+
+  if (!get_size (fd, &disk_size, error))
+    goto out;
+
+  page_size = sysconf (_SC_PAGESIZE);
+  if (page_size < 1)
+    {
+      g_set_error (error,
+                   G_IO_ERROR,
+                   g_io_error_from_errno (errno),
+                   C_("benchmarking", "Error getting page size: %m\n"));
+      goto out;
+    }
+
+  if (disk_size < (guint64) page_size)
+    {
+      g_set_error (error,
+                   G_IO_ERROR,
+                   G_IO_ERROR_INVALID_ARGUMENT,
+                   C_("benchmarking", "Device is too small to benchmark"));
+      goto out;
+    }
+
+  sample_size = ((gsize) benchmark->sample_size_mib) * 1024 * 1024;
+  buffer_unaligned = g_new0 (guchar, sample_size + page_size);
+  buffer = (guchar*) (((gintptr) (buffer_unaligned + page_size)) & (~(page_size - 1)));
+
+  create_results (benchmark, results_filename, disk_size, sample_size, &results);
+
+  /* When @fd is a file opened without O_DIRECT, make sure we're
+   * measuring the storage and not what is left in the page cache
+   */
+  posix_fadvise (fd, 0, 0, POSIX_FADV_DONTNEED);
+
+  /* transfer rate... */
+  gdu_benchmark_lock (benchmark);
+  benchmark->state = GDU_BENCHMARK_STATE_TRANSFER_RATE;
+  gdu_benchmark_unlock (benchmark);
+  for (n = 0; n < benchmark->num_samples; n++)
+    {
+      gchar *s, *s2;
+      gint64 begin_usec;
+      gint64 end_usec;
+      gint64 offset;
+      ssize_t num_read;
+
+      if (g_cancellable_set_error_if_cancelled (cancellable, error))
+        goto out;
+
+      /* figure out offset and align to page-size */
+      offset = n * disk_size / benchmark->num_samples;
+      offset &= ~(page_size - 1);
+
+      if (lseek (fd, offset, SEEK_SET) != offset)
+        {
+          g_set_error (error,
+                       G_IO_ERROR,
+                       g_io_error_from_errno (errno),
+                       C_("benchmarking", "Error seeking to offset %lld"),
+                       (long long int) offset);
+          goto out;
+        }
+      if (read (fd, buffer, page_size) != page_size)
+        {
+          s = g_format_size_full (page_size, G_FORMAT_SIZE_LONG_FORMAT);
+          s2 = g_format_size_full (offset, G_FORMAT_SIZE_LONG_FORMAT);
+          g_set_error (error,
+                       G_IO_ERROR,
+                       g_io_error_from_errno (errno),
+                       C_("benchmarking", "Error pre-reading %s from offset %s"),
+                       s, s2);
+          g_free (s2);
+          g_free (s);
+          goto out;
+        }
+      if (lseek (fd, offset, SEEK_SET) != offset)
+        {
+          s = g_format_size_full (offset, G_FORMAT_SIZE_LONG_FORMAT);
+          g_set_error (error,
+                       G_IO_ERROR,
+                       g_io_error_from_errno (errno),
+                       C_("benchmarking", "Error seeking to offset %s"),
+                       s);
+          g_free (s);
+          goto out;
+        }
+      begin_usec = g_get_monotonic_time ();
+      num_read = read (fd, buffer, sample_size);
+      if (G_UNLIKELY (num_read < 0))
+        {
+          s = g_format_size_full (sample_size, G_FORMAT_SIZE_LONG_FORMAT);
+          s2 = g_format_size_full (offset, G_FORMAT_SIZE_LONG_FORMAT);
+          g_set_error (error,
+                       G_IO_ERROR,
+                       g_io_error_from_errno (errno),
+                       C_("benchmarking", "Error reading %s from offset %s"),
+                       s, s2);
+          g_free (s2);
+          g_free (s);
+          goto out;
+        }
+      end_usec = g_get_monotonic_time ();
+
+      add_sample (benchmark, &results, 0, offset,
+                  ((gdouble) G_USEC_PER_SEC) * num_read / MAX (end_usec - begin_usec, 1),
+                  update_func, user_data);
+
+      if (benchmark->do_write)
+        {
+          ssize_t num_written;
+
+          /* and now write the same block again... */
+          if (lseek (fd, offset, SEEK_SET) != offset)
+            {
+              g_set_error (error,
+                           G_IO_ERROR,
+                           g_io_error_from_errno (errno),
+                           C_("benchmarking", "Error seeking to offset %lld"),
+                           (long long int) offset);
+              goto out;
+            }
+          if (read (fd, buffer, page_size) != page_size)
+            {
+              g_set_error (error,
+                           G_IO_ERROR,
+                           g_io_error_from_errno (errno),
+                           C_("benchmarking", "Error pre-reading %lld bytes from offset %lld"),
+                           (long long int) page_size,
+                           (long long int) offset);
+              goto out;
+            }
+          if (lseek (fd, offset, SEEK_SET) != offset)
+            {
+              g_set_error (error,
+                           G_IO_ERROR,
+                           g_io_error_from_errno (errno),
+                           C_("benchmarking", "Error seeking to offset %lld"),
+                           (long long int) offset);
+              goto out;
+            }
+          begin_usec = g_get_monotonic_time ();
+          num_written = write (fd, buffer, num_read);
+          if (G_UNLIKELY (num_written < 0))
+            {
+              g_set_error (error,
+                           G_IO_ERROR,
+                           g_io_error_from_errno (errno),
+                           C_("benchmarking", "Error writing %lld bytes at offset %lld: %m"),
+                           (long long int) num_read,
+                           (long long int) offset);
+              goto out;
+            }
+          if (num_written != num_read)
+            {
+              g_set_error (error,
+                           G_IO_ERROR,
+                           g_io_error_from_errno (errno),
+                           C_("benchmarking", "Expected to write %lld bytes, only wrote %lld: %m"),
+                           (long long int) num_read,
+                           (long long int) num_written);
+              goto out;
+            }
+          if (fsync (fd) != 0)
+            {
+              g_set_error (error,
+                           G_IO_ERROR,
+                           g_io_error_from_errno (errno),
+                           C_("benchmarking", "Error syncing (at offset %lld): %m"),
+                           (long long int) offset);
+              goto out;
+            }
+          end_usec = g_get_monotonic_time ();
+
+          add_sample (benchmark, &results, 1, offset,
+                      ((gdouble) G_USEC_PER_SEC) * num_written / MAX (end_usec - begin_usec, 1),
+                      update_func, user_data);
+        }
+    }
+
+  /* access time... */
+  gdu_benchmark_lock (benchmark);
+  benchmark->state = GDU_BENCHMARK_STATE_ACCESS_TIME;
+  gdu_benchmark_unlock (benchmark);
+  posix_fadvise (fd, 0, 0, POSIX_FADV_DONTNEED);
+  rand = g_rand_new_with_seed (42); /* want this to be deterministic (per size) so it's repeatable */
+  for (n = 0; n < benchmark->num_access_samples; n++)
+    {
+      gint64 begin_usec;
+      gint64 end_usec;
+      gint64 offset;
+      ssize_t num_read;
+
+      if (g_cancellable_set_error_if_cancelled (cancellable, error))
+        goto out;
+
+      offset = (guint64) g_rand_double_range (rand, 0, (gdouble) disk_size);
+      offset &= ~(page_size - 1);
+
+      if (lseek (fd, offset, SEEK_SET) != offset)
+        {
+          g_set_error (error,
+                       G_IO_ERROR,
+                       g_io_error_from_errno (errno),
+                       C_("benchmarking", "Error seeking to offset %lld: %m"),
+                       (long long int) offset);
+          goto out;
+        }
+
+      begin_usec = g_get_monotonic_time ();
+      num_read = read (fd, buffer, page_size);
+      if (G_UNLIKELY (num_read < 0))
+        {
+          g_set_error (error,
+                       G_IO_ERROR,
+                       g_io_error_from_errno (errno),
+                       C_("benchmarking", "Error reading %lld bytes from offset %lld"),
+                       (long long int) page_size,
+                       (long long int) offset);
+          goto out;
+        }
+      end_usec = g_get_monotonic_time ();
+
+      add_sample (benchmark, &results, 2, offset,
+                  (end_usec - begin_usec) / ((gdouble) G_USEC_PER_SEC),
+                  update_func, user_data);
+    }
+
+  gdu_benchmark_lock (benchmark);
+  if (!results.in_use)
+    use_run_results (benchmark, &results);
+  results.header->timestamp_usec = g_get_real_time ();
+  results.header->flags |= RESULTS_FLAGS_COMPLETE;
+  benchmark->time_benchmarked_usec = results.header->timestamp_usec;
+  gdu_benchmark_unlock (benchmark);
+
+  /* the mapping stays valid after the rename */
+  if (results.partial_filename != NULL)
+    {
+      msync (results.header, results.size, MS_ASYNC);
+      if (rename (results.partial_filename, results_filename) != 0)
+        g_warning ("Error renaming %s to %s: %m", results.partial_filename, results_filename);
+    }
+
+  ret = TRUE;
+
+ out:
+  gdu_benchmark_lock (benchmark);
+  benchmark->state = GDU_BENCHMARK_STATE_NONE;
+  /* cancelled or failed - the samples so far are what the partial file holds */
+  if (!ret && results.in_use)
+    {
+      benchmark->time_benchmarked_usec = results.header->timestamp_usec;
+      benchmark->incomplete = TRUE;
+      if (results.is_mmap)
+        msync (results.header, results.size, MS_ASYNC);
+    }
+  gdu_benchmark_unlock (benchmark);
+  if (results.header != NULL)
+    free_run_results (&results);
+  if (rand != NULL)
+    g_rand_free (rand);
+  g_free (buffer_unaligned);
+  return ret;
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+/* returns NULL if it doesn't make sense to load/save benchmark data (removable media,
+ * non-drive devices etc.)
+ */
+gchar *
+gdu_benchmark_get_filename_for_block (UDisksBlock *block)
+{
+  gchar *ret = NULL;
+  gchar *bench_dir = NULL;
+  const gchar *id = NULL;
+
+  id = udisks_block_get_id (block);
+  if (id == NULL || strlen (id) == 0)
+    goto out;
+
+  bench_dir = g_strdup_printf ("%s/mate-disks/benchmarks", g_get_user_cache_dir ());
+  if (g_mkdir_with_parents (bench_dir, 0777) != 0)
+    {
+      g_warning ("Error creating directory %s: %m", bench_dir);
+      goto out;
+    }
+
+  ret = g_strdup_printf ("%s/%s.mate-disks-benchmark", bench_dir, id);
+
+ out:
+  g_free (bench_dir);
+  return ret;
+}
+
+static guint
+count_samples (GVariant *variant)
+{
+  return variant != NULL ? g_variant_n_children (variant) : 0;
+}
+
+static void
+samples_from_gvariant (GduBenchmarkSample *samples,
+                       GVariant           *variant)
+{
+  GVariantIter iter;
+  guint n = 0;
+
+  g_variant_iter_init (&iter, variant);
+  while (g_variant_iter_next (&iter, "(td)", &samples[n].offset, &samples[n].value))
+    n++;
+}
+
+/* Files written before the results were memory-mapped */
+static gboolean
+load_legacy (GduBenchmark  *benchmark,
+             GMappedFile   *mapped_file,
+             GError       **error)
+{
+  gboolean ret = FALSE;
+  GVariant *value = NULL;
+  GVariant *read_samples_variant = NULL;
+  GVariant *write_samples_variant = NULL;
+  GVariant *access_time_samples_variant = NULL;
+  ResultsHeader *header;
+  gint32 version;
+  gint64 timestamp_usec;
+  guint64 device_size;
+  guint64 sample_size;
+  gsize size;
+
+  value = g_variant_new_from_data (G_VARIANT_TYPE_VARDICT,
+                                   g_mapped_file_get_contents (mapped_file),
+                                   g_mapped_file_get_length (mapped_file),
+                                   FALSE,
+                                   NULL, NULL);
+  g_variant_ref_sink (value);
+
+  if (!g_variant_lookup (value, "version", "i", &version))
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                   "No version key");
+      goto out;
+    }
+  if (version != 1)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                   "Cannot decode version %d data", version);
+      goto out;
+    }
+
+  if (!g_variant_lookup (value, "timestamp-usec", "x", &timestamp_usec))
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                   "No timestamp-usec");
+      goto out;
+    }
+
+  if (!g_variant_lookup (value, "device-size", "t", &device_size))
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                   "No device-size");
+      goto out;
+    }
+
+  if (!g_variant_lookup (value, "read-samples", "@a(td)", &read_samples_variant))
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                   "No read-samples");
+      goto out;
+    }
+
+  if (!g_variant_lookup (value, "write-samples", "@a(td)", &write_samples_variant))
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                   "No write-samples");
+      goto out;
+    }
+
+  if (!g_variant_lookup (value, "access-time-samples", "@a(td)", &access_time_samples_variant))
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                   "No access-time-samples");
+      goto out;
+    }
+
+  if (!g_variant_lookup (value, "sample-size", "t", &sample_size))
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                   "No sample-size");
+      goto out;
+    }
+
+  size = get_results_size (count_samples (read_samples_variant),
+                           count_samples (write_samples_variant),
+                           count_samples (access_time_samples_variant));
+  header = g_malloc0 (size);
+  memcpy (header->magic, RESULTS_MAGIC, sizeof header->magic);
+  header->version = RESULTS_VERSION;
+  header->byte_order = RESULTS_BYTE_ORDER;
+  header->timestamp_usec = timestamp_usec;
+  header->flags = RESULTS_FLAGS_COMPLETE;
+  header->device_size = device_size;
+  header->sample_size = sample_size;
+  header->read_capacity = header->num_read_samples = count_samples (read_samples_variant);
+  header->write_capacity = header->num_write_samples = count_samples (write_samples_variant);
+  header->access_time_capacity = header->num_access_time_samples = count_samples (access_time_samples_variant);
+  samples_from_gvariant (get_results_section (header, 0), read_samples_variant);
+  samples_from_gvariant (get_results_section (header, 1), write_samples_variant);
+  samples_from_gvariant (get_results_section (header, 2), access_time_samples_variant);
+
+  gdu_benchmark_lock (benchmark);
+  release_storage (benchmark);
+  benchmark->storage = header;
+  benchmark->storage_size = size;
+  use_results (benchmark, header);
+  gdu_benchmark_unlock (benchmark);
+
+  ret = TRUE;
+
+ out:
+  if (read_samples_variant != NULL)
+    g_variant_unref (read_samples_variant);
+  if (write_samples_variant != NULL)
+    g_variant_unref (write_samples_variant);
+  if (access_time_samples_variant != NULL)
+    g_variant_unref (access_time_samples_variant);
+  g_variant_unref (value);
+  return ret;
+}
+
+static gboolean
+load_results (GduBenchmark  *benchmark,
+              const gchar   *filename,
+              GError       **error)
+{
+  gboolean ret = FALSE;
+  GMappedFile *mapped_file;
+  const ResultsHeader *header;
+  gsize length;
+
+  mapped_file = g_mapped_file_new (filename, FALSE, error);
+  if (mapped_file == NULL)
+    goto out;
+
+  header = (const ResultsHeader *) g_mapped_file_get_contents (mapped_file);
+  length = g_mapped_file_get_length (mapped_file);
+  if (length < sizeof (ResultsHeader) ||
+      memcmp (header->magic, RESULTS_MAGIC, sizeof header->magic) != 0)
+    {
+      ret = load_legacy (benchmark, mapped_file, error);
+      goto out;
+    }
+
+  if (!check_results_header (header, length, filename, error))
+    goto out;
+
+  gdu_benchmark_lock (benchmark);
+  release_storage (benchmark);
+  benchmark->mapped_file = g_mapped_file_ref (mapped_file);
+  /* the mapping is read-only - nothing will write through this pointer */
+  use_results (benchmark, (ResultsHeader *) header);
+  gdu_benchmark_unlock (benchmark);
+
+  ret = TRUE;
+
+ out:
+  if (mapped_file != NULL)
+    g_mapped_file_unref (mapped_file);
+  return ret;
+}
+
+/* Loads the results saved by gdu_benchmark_run(). The samples are not
+ * copied - they point into a read-only mapping of @filename which is
+ * kept until the results are cleared or replaced. If a later run of
+ * the device didn't complete, its samples are loaded instead.
+ */
+gboolean
+gdu_benchmark_load (GduBenchmark  *benchmark,
+                    const gchar   *filename,
+                    GError       **error)
+{
+  gboolean ret = FALSE;
+  gchar *partial_filename;
+  GStatBuf partial_statbuf;
+  GStatBuf statbuf;
+  GError *local_error = NULL;
+
+  partial_filename = get_partial_filename (filename);
+  if (g_stat (partial_filename, &partial_statbuf) == 0 &&
+      (g_stat (filename, &statbuf) != 0 || partial_statbuf.st_mtime >= statbuf.st_mtime))
+    {
+      if (load_results (benchmark, partial_filename, &local_error))
+        {
+          ret = TRUE;
+          goto out;
+        }
+      g_warning ("Error loading %s: %s", partial_filename, local_error->message);
+      g_clear_error (&local_error);
+    }
+
+  ret = load_results (benchmark, filename, error);
+
+ out:
+  g_free (partial_filename);
+  return ret;
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+static GVariant *
+samples_to_gvariant (const GduBenchmarkSample *samples,
+                     guint                     num_samples)
+{
+  guint n;
+  GVariantBuilder builder;
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(td)"));
+  for (n = 0; n < num_samples; n++)
+    g_variant_builder_add (&builder, "(td)", samples[n].offset, samples[n].value);
+
+  return g_variant_builder_end (&builder);
+}
+
+/* Returns a floating a{sv} in the format the results were cached in
+ * before they were memory-mapped
+ */
+GVariant *
+gdu_benchmark_to_gvariant (GduBenchmark *benchmark)
+{
+  GVariantBuilder builder;
+
+  gdu_benchmark_lock (benchmark);
+  g_variant_builder_init (&builder, G_VARIANT_TYPE_VARDICT);
+  g_variant_builder_add (&builder, "{sv}", "version", g_variant_new_int32 (1));
+  g_variant_builder_add (&builder, "{sv}", "timestamp-usec", g_variant_new_int64 (benchmark->time_benchmarked_usec));
+  g_variant_builder_add (&builder, "{sv}", "device-size", g_variant_new_uint64 (benchmark->size));
+  g_variant_builder_add (&builder, "{sv}", "sample-size", g_variant_new_uint64 (benchmark->sample_size));
+  g_variant_builder_add (&builder, "{sv}", "read-samples",
+                         samples_to_gvariant (benchmark->read_samples, benchmark->num_read_samples));
+  g_variant_builder_add (&builder, "{sv}", "write-samples",
+                         samples_to_gvariant (benchmark->write_samples, benchmark->num_write_samples));
+  g_variant_builder_add (&builder, "{sv}", "access-time-samples",
+                         samples_to_gvariant (benchmark->access_time_samples, benchmark->num_access_time_samples));
+  gdu_benchmark_unlock (benchmark);
+
+  return g_variant_builder_end (&builder);
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+/* The history file contains every benchmark run ever made for a device,
+ * one HistoryRecord per run, each followed by the read, write and access
+ * time samples (in that order) in the in-memory GduBenchmarkSample
+ * layout. See gduhistoryfile.c for the file format.
+ */
+
+#define HISTORY_MAGIC      "GDUBMHST"
+#define HISTORY_VERSION    1
+
+typedef struct
+{
+  guint32 record_size; /* including this struct and all samples */
+  guint32 reserved;
+  gint64  timestamp_usec;
+  guint64 device_size;
+  guint64 sample_size;
+  guint32 num_read_samples;
+  guint32 num_write_samples;
+  guint32 num_access_time_samples;
+  guint32 reserved2;
+} HistoryRecord;
+
+G_STATIC_ASSERT (sizeof (HistoryRecord) == 48);
+
+static gsize
+get_history_record_size (gconstpointer data,
+                         gsize         length)
+{
+  const HistoryRecord *record = data;
+  guint64 num_samples;
+
+  if (length < sizeof (HistoryRecord))
+    return 0;
+
+  num_samples = ((guint64) record->num_read_samples) + record->num_write_samples + record->num_access_time_samples;
+  if (record->record_size != sizeof (HistoryRecord) + num_samples * sizeof (GduBenchmarkSample) ||
+      record->record_size > length)
+    return 0;
+
+  return record->record_size;
+}
+
+static const GduHistoryFormat history_format =
+{
+  HISTORY_MAGIC,
+  HISTORY_VERSION,
+  "benchmark",
+  0, /* record_size */
+  get_history_record_size
+};
+
+/* returns NULL if it doesn't make sense to keep history for this device */
+gchar *
+gdu_benchmark_get_history_filename_for_block (UDisksBlock *block)
+{
+  gchar *ret = NULL;
+  gchar *filename;
+
+  filename = gdu_benchmark_get_filename_for_block (block);
+  if (filename != NULL)
+    ret = g_strdup_printf ("%s-history", filename);
+  g_free (filename);
+  return ret;
+}
+
+static gboolean
+write_all (gint           fd,
+           gconstpointer  buf,
+           gsize          size,
+           GError       **error)
+{
+  const guchar *p = buf;
+
+  while (size > 0)
+    {
+      ssize_t num_written = write (fd, p, size);
+      if (num_written < 0)
+        {
+          if (errno == EINTR)
+            continue;
+          g_set_error (error,
+                       G_IO_ERROR,
+                       g_io_error_from_errno (errno),
+                       C_("benchmarking", "Error writing benchmark data: %m"));
+          return FALSE;
+        }
+      p += num_written;
+      size -= num_written;
+    }
+  return TRUE;
+}
+
+gboolean
+gdu_benchmark_append_to_history (GduBenchmark  *benchmark,
+                                 const gchar   *filename,
+                                 GError       **error)
+{
+  gboolean ret;
+  HistoryRecord *record;
+  guchar *buf;
+  gsize size;
+  gsize pos;
+
+  gdu_benchmark_lock (benchmark);
+  size = sizeof (HistoryRecord) + sizeof (GduBenchmarkSample) * (benchmark->num_read_samples +
+                                                                  benchmark->num_write_samples +
+                                                                  benchmark->num_access_time_samples);
+  buf = g_malloc0 (size);
+  record = (HistoryRecord *) buf;
+  record->record_size = size;
+  record->timestamp_usec = benchmark->time_benchmarked_usec;
+  record->device_size = benchmark->size;
+  record->sample_size = benchmark->sample_size;
+  record->num_read_samples = benchmark->num_read_samples;
+  record->num_write_samples = benchmark->num_write_samples;
+  record->num_access_time_samples = benchmark->num_access_time_samples;
+  pos = sizeof (HistoryRecord);
+  memcpy (buf + pos, benchmark->read_samples, sizeof (GduBenchmarkSample) * benchmark->num_read_samples);
+  pos += sizeof (GduBenchmarkSample) * benchmark->num_read_samples;
+  memcpy (buf + pos, benchmark->write_samples, sizeof (GduBenchmarkSample) * benchmark->num_write_samples);
+  pos += sizeof (GduBenchmarkSample) * benchmark->num_write_samples;
+  memcpy (buf + pos, benchmark->access_time_samples, sizeof (GduBenchmarkSample) * benchmark->num_access_time_samples);
+  gdu_benchmark_unlock (benchmark);
+
+  ret = gdu_history_file_append (filename, &history_format, buf, size, error);
+  g_free (buf);
+  return ret;
+}
+
+static gint
+compare_runs_by_timestamp (gconstpointer a,
+                           gconstpointer b)
+{
+  const GduBenchmark *run_a = *((const GduBenchmark **) a);
+  const GduBenchmark *run_b = *((const GduBenchmark **) b);
+
+  if (run_a->time_benchmarked_usec < run_b->time_benchmarked_usec)
+    return -1;
+  else if (run_a->time_benchmarked_usec > run_b->time_benchmarked_usec)
+    return 1;
+  return 0;
+}
+
+/* Returns all runs in @filename as GduBenchmark instances sorted by
+ * timestamp, oldest first. A missing file is not an error. The samples
+ * of each run point into a shared read-only mapping of @filename.
+ */
+GPtrArray *
+gdu_benchmark_load_history (const gchar  *filename,
+                            GError      **error)
+{
+  GPtrArray *ret = NULL;
+  GError *local_error = NULL;
+  GMappedFile *mapped_file = NULL;
+  const gchar *contents;
+  gsize length;
+  gsize pos;
+  guint32 version;
+
+  ret = g_ptr_array_new_with_free_func ((GDestroyNotify) gdu_benchmark_free);
+
+  mapped_file = g_mapped_file_new (filename, FALSE, &local_error);
+  if (mapped_file == NULL)
+    {
+      if (local_error->domain == G_FILE_ERROR && local_error->code == G_FILE_ERROR_NOENT)
+        {
+          g_clear_error (&local_error);
+          goto out;
+        }
+      g_propagate_error (error, local_error);
+      g_clear_pointer (&ret, g_ptr_array_unref);
+      goto out;
+    }
+
+  contents = g_mapped_file_get_contents (mapped_file);
+  length = g_mapped_file_get_length (mapped_file);
+  if (!gdu_history_file_check_header (filename, &history_format, contents, length, &version, error))
+    {
+      g_clear_pointer (&ret, g_ptr_array_unref);
+      goto out;
+    }
+  if (version != HISTORY_VERSION)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                   "Cannot decode version %d history", version);
+      g_clear_pointer (&ret, g_ptr_array_unref);
+      goto out;
+    }
+
+  pos = GDU_HISTORY_FILE_HEADER_SIZE;
+  while (pos < length)
+    {
+      const HistoryRecord *record;
+      const GduBenchmarkSample *samples;
+      GduBenchmark *run;
+      gsize record_size;
+
+      record_size = gdu_history_file_get_record_size (&history_format, contents, length, pos);
+      if (record_size == 0)
+        {
+          /* truncated by a crash while appending, just ignore the rest */
+          g_warning ("Ignoring truncated record at offset %" G_GSIZE_FORMAT " in %s", pos, filename);
+          break;
+        }
+
+      /* all records are 8-byte aligned in the page-aligned mapping */
+      record = (const HistoryRecord *) (contents + pos);
+      samples = (const GduBenchmarkSample *) (contents + pos + sizeof (HistoryRecord));
+      run = gdu_benchmark_new ();
+      run->mapped_file = g_mapped_file_ref (mapped_file);
+      run->time_benchmarked_usec = record->timestamp_usec;
+      run->size = record->device_size;
+      run->sample_size = record->sample_size;
+      run->read_samples = samples;
+      run->num_read_samples = record->num_read_samples;
+      samples += record->num_read_samples;
+      run->write_samples = samples;
+      run->num_write_samples = record->num_write_samples;
+      samples += record->num_write_samples;
+      run->access_time_samples = samples;
+      run->num_access_time_samples = record->num_access_time_samples;
+      g_ptr_array_add (ret, run);
+
+      pos += record_size;
+    }
+
+  /* appended in order unless the clock went backwards */
+  g_ptr_array_sort (ret, compare_runs_by_timestamp);
+
+ out:
+  if (mapped_file != NULL)
+    g_mapped_file_unref (mapped_file);
+  return ret;
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+/* Only changes larger than this are reported, no matter how significant */
+#define REGRESSION_MIN_CHANGE 0.10
+
+/* How many earlier runs to use as the baseline */
+#define REGRESSION_MAX_BASELINE_RUNS 5
+
+/* One-sided critical values of Student's t-distribution for p = 0.005 */
+static const gdouble t_critical[] = {
+  63.657, 9.925, 5.841, 4.604, 4.032, 3.707, 3.499, 3.355, 3.250, 3.169,
+   3.106, 3.055, 3.012, 2.977, 2.947, 2.921, 2.898, 2.878, 2.861, 2.845,
+   2.831, 2.819, 2.807, 2.797, 2.787, 2.779, 2.771, 2.763, 2.756, 2.750
+};
+
+static gdouble
+get_t_critical (gdouble df)
+{
+  if (df < 1.0)
+    return t_critical[0];
+  else if (df <= G_N_ELEMENTS (t_critical))
+    return t_critical[((guint) df) - 1];
+  else if (df <= 40)
+    return 2.704;
+  else if (df <= 60)
+    return 2.660;
+  else if (df <= 120)
+    return 2.617;
+  return 2.576;
+}
+
+typedef struct
+{
+  const GduBenchmarkSample *samples;
+  guint num_samples;
+} SampleSet;
+
+static void
+get_mean_var (const SampleSet *sets,
+              guint            num_sets,
+              gdouble         *out_mean,
+              gdouble         *out_var,
+              guint           *out_n)
+{
+  gdouble sum = 0.0;
+  gdouble sum_sq = 0.0;
+  gdouble mean = 0.0;
+  guint n = 0;
+  guint a, m;
+
+  for (a = 0; a < num_sets; a++)
+    {
+      for (m = 0; m < sets[a].num_samples; m++)
+        {
+          sum += sets[a].samples[m].value;
+          n++;
+        }
+    }
+  if (n > 0)
+    mean = sum / n;
+  for (a = 0; a < num_sets; a++)
+    {
+      for (m = 0; m < sets[a].num_samples; m++)
+        {
+          gdouble d = sets[a].samples[m].value - mean;
+          sum_sq += d * d;
+        }
+    }
+
+  *out_mean = mean;
+  *out_var = n > 1 ? sum_sq / (n - 1) : 0.0;
+  *out_n = n;
+}
+
+/* Welch's t-test - returns TRUE if @current is significantly lower
+ * (or higher if @higher_is_worse is TRUE) than @baseline
+ */
+static gboolean
+is_regression (const GduBenchmarkSample *current,
+               guint                     num_current,
+               const SampleSet          *baseline,
+               guint                     num_baseline,
+               gboolean                  higher_is_worse,
+               gdouble                  *out_change)
+{
+  gdouble mean_c, var_c, mean_b, var_b;
+  guint n_c, n_b;
+  gdouble se_c, se_b, se, t, df, change;
+  SampleSet current_set;
+
+  current_set.samples = current;
+  current_set.num_samples = num_current;
+  get_mean_var (&current_set, 1, &mean_c, &var_c, &n_c);
+  get_mean_var (baseline, num_baseline, &mean_b, &var_b, &n_b);
+  if (n_c < 2 || n_b < 2 || mean_b <= 0.0)
+    return FALSE;
+
+  change = (mean_c - mean_b) / mean_b;
+  if (out_change != NULL)
+    *out_change = change;
+  if (higher_is_worse ? change < REGRESSION_MIN_CHANGE : change > -REGRESSION_MIN_CHANGE)
+    return FALSE;
+
+  se_c = var_c / n_c;
+  se_b = var_b / n_b;
+  se = sqrt (se_c + se_b);
+  if (se == 0.0)
+    return TRUE;
+
+  t = fabs (mean_c - mean_b) / se;
+  df = (se_c + se_b) * (se_c + se_b) / (se_c * se_c / (n_c - 1) + se_b * se_b / (n_b - 1));
+  return t > get_t_critical (df);
+}
+
+/* Compares @benchmark against the most recent earlier runs of the same
+ * media in @history. The out parameters are set to the relative change
+ * of the mean, e.g. -0.25 if the read rate dropped by 25%.
+ */
+GduBenchmarkRegressionFlags
+gdu_benchmark_find_regressions (GduBenchmark *benchmark,
+                                GPtrArray    *history,
+                                gdouble      *out_read_change,
+                                gdouble      *out_write_change,
+                                gdouble      *out_access_time_change)
+{
+  GduBenchmarkRegressionFlags ret = GDU_BENCHMARK_REGRESSION_FLAGS_NONE;
+  SampleSet read[REGRESSION_MAX_BASELINE_RUNS];
+  SampleSet write[REGRESSION_MAX_BASELINE_RUNS];
+  SampleSet access_time[REGRESSION_MAX_BASELINE_RUNS];
+  guint num_runs = 0;
+  gint n;
+
+  if (out_read_change != NULL)
+    *out_read_change = 0.0;
+  if (out_write_change != NULL)
+    *out_write_change = 0.0;
+  if (out_access_time_change != NULL)
+    *out_access_time_change = 0.0;
+
+  if (history == NULL || benchmark->time_benchmarked_usec == 0 || benchmark->incomplete)
+    goto out;
+
+  for (n = (gint) history->len - 1; n >= 0 && num_runs < REGRESSION_MAX_BASELINE_RUNS; n--)
+    {
+      GduBenchmark *run = history->pdata[n];
+
+      /* different size means different media */
+      if (run->time_benchmarked_usec >= benchmark->time_benchmarked_usec ||
+          run->size != benchmark->size)
+        continue;
+
+      read[num_runs].samples = run->read_samples;
+      read[num_runs].num_samples = run->num_read_samples;
+      write[num_runs].samples = run->write_samples;
+      write[num_runs].num_samples = run->num_write_samples;
+      access_time[num_runs].samples = run->access_time_samples;
+      access_time[num_runs].num_samples = run->num_access_time_samples;
+      num_runs++;
+    }
+
+  if (num_runs == 0)
+    goto out;
+
+  gdu_benchmark_lock (benchmark);
+  if (is_regression (benchmark->read_samples, benchmark->num_read_samples,
+                     read, num_runs, FALSE, out_read_change))
+    ret |= GDU_BENCHMARK_REGRESSION_FLAGS_READ_RATE;
+  if (is_regression (benchmark->write_samples, benchmark->num_write_samples,
+                     write, num_runs, FALSE, out_write_change))
+    ret |= GDU_BENCHMARK_REGRESSION_FLAGS_WRITE_RATE;
+  if (is_regression (benchmark->access_time_samples, benchmark->num_access_time_samples,
+                     access_time, num_runs, TRUE, out_access_time_change))
+    ret |= GDU_BENCHMARK_REGRESSION_FLAGS_ACCESS_TIME;
+  gdu_benchmark_unlock (benchmark);
+
+ out:
+  return ret;
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+static void
+json_append_string (GString     *str,
+                    const gchar *s)
+{
+  const gchar *p;
+
+  g_string_append_c (str, '"');
+  for (p = s; *p != '\0'; p++)
+    {
+      switch (*p)
+        {
+        case '"':
+          g_string_append (str, "\\\"");
+          break;
+        case '\\':
+          g_string_append (str, "\\\\");
+          break;
+        case '\n':
+          g_string_append (str, "\\n");
+          break;
+        case '\t':
+          g_string_append (str, "\\t");
+          break;
+        default:
+          if ((guchar) *p < 0x20)
+            g_string_append_printf (str, "\\u%04x", (guint) *p);
+          else
+            g_string_append_c (str, *p);
+          break;
+        }
+    }
+  g_string_append_c (str, '"');
+}
+
+static void
+json_append_double (GString *str,
+                    gdouble  value)
+{
+  gchar buf[G_ASCII_DTOSTR_BUF_SIZE];
+  g_string_append (str, g_ascii_dtostr (buf, sizeof buf, value));
+}
+
+static void
+json_append_samples (GString                  *str,
+                     const gchar              *indent,
+                     const gchar              *name,
+                     const GduBenchmarkSample *samples,
+                     guint                     num_samples)
+{
+  gdouble max, min, avg;
+  guint n;
+
+  gdu_benchmark_get_max_min_avg (samples, num_samples, &max, &min, &avg);
+
+  g_string_append_printf (str, "%s  \"%s\": {\n", indent, name);
+  g_string_append_printf (str, "%s    \"num-samples\": %u,\n", indent, num_samples);
+  g_string_append_printf (str, "%s    \"min\": ", indent);
+  json_append_double (str, min);
+  g_string_append_printf (str, ",\n%s    \"max\": ", indent);
+  json_append_double (str, max);
+  g_string_append_printf (str, ",\n%s    \"avg\": ", indent);
+  json_append_double (str, avg);
+  g_string_append_printf (str, ",\n%s    \"samples\": [", indent);
+  for (n = 0; n < num_samples; n++)
+    {
+      const GduBenchmarkSample *s = &samples[n];
+      g_string_append_printf (str, "%s[%" G_GUINT64_FORMAT ", ", n > 0 ? ", " : "", s->offset);
+      json_append_double (str, s->value);
+      g_string_append_c (str, ']');
+    }
+  g_string_append_printf (str, "]\n%s  }", indent);
+}
+
+/* Appends @benchmark as a JSON object, every line but the first
+ * prefixed with @indent. The "device" member is left out if @device
+ * is %NULL.
+ */
+static void
+json_append_benchmark (GString      *str,
+                       const gchar  *indent,
+                       GduBenchmark *benchmark,
+                       const gchar  *device)
+{
+  g_string_append (str, "{\n");
+
+  gdu_benchmark_lock (benchmark);
+  if (device != NULL)
+    {
+      g_string_append_printf (str, "%s  \"device\": ", indent);
+      json_append_string (str, device);
+      g_string_append (str, ",\n");
+    }
+  g_string_append_printf (str, "%s  \"timestamp-usec\": %" G_GINT64_FORMAT ",\n", indent, benchmark->time_benchmarked_usec);
+  g_string_append_printf (str, "%s  \"device-size\": %" G_GUINT64_FORMAT ",\n", indent, benchmark->size);
+  g_string_append_printf (str, "%s  \"sample-size\": %" G_GUINT64_FORMAT ",\n", indent, benchmark->sample_size);
+  json_append_samples (str, indent, "read-rate", benchmark->read_samples, benchmark->num_read_samples);
+  g_string_append (str, ",\n");
+  json_append_samples (str, indent, "write-rate", benchmark->write_samples, benchmark->num_write_samples);
+  g_string_append (str, ",\n");
+  json_append_samples (str, indent, "access-time", benchmark->access_time_samples, benchmark->num_access_time_samples);
+  g_string_append (str, "\n");
+  gdu_benchmark_unlock (benchmark);
+
+  g_string_append_printf (str, "%s}", indent);
+}
+
+/* Transfer rates are in bytes per second, access times in seconds */
+gchar *
+gdu_benchmark_to_json (GduBenchmark *benchmark,
+                       const gchar  *device)
+{
+  GString *str;
+
+  str = g_string_new (NULL);
+  json_append_benchmark (str, "", benchmark, device);
+  g_string_append (str, "\n");
+
+  return g_string_free (str, FALSE);
+}
+
+static void
+csv_append_samples (GString                  *str,
+                    const gchar              *device,
+                    gint64                    timestamp_usec,
+                    const gchar              *kind_prefix,
+                    const gchar              *kind,
+                    const GduBenchmarkSample *samples,
+                    guint                     num_samples)
+{
+  gchar buf[G_ASCII_DTOSTR_BUF_SIZE];
+  guint n;
+
+  for (n = 0; n < num_samples; n++)
+    {
+      const GduBenchmarkSample *s = &samples[n];
+      g_string_append_printf (str, "%s,%" G_GINT64_FORMAT ",%s%s,%" G_GUINT64_FORMAT ",%s\n",
+                              device,
+                              timestamp_usec,
+                              kind_prefix,
+                              kind,
+                              s->offset,
+                              g_ascii_dtostr (buf, sizeof buf, s->value));
+    }
+}
+
+static void
+csv_append_benchmark (GString      *str,
+                      GduBenchmark *benchmark,
+                      const gchar  *device,
+                      const gchar  *kind_prefix)
+{
+  gdu_benchmark_lock (benchmark);
+  csv_append_samples (str, device, benchmark->time_benchmarked_usec, kind_prefix, "read-rate",
+                      benchmark->read_samples, benchmark->num_read_samples);
+  csv_append_samples (str, device, benchmark->time_benchmarked_usec, kind_prefix, "write-rate",
+                      benchmark->write_samples, benchmark->num_write_samples);
+  csv_append_samples (str, device, benchmark->time_benchmarked_usec, kind_prefix, "access-time",
+                      benchmark->access_time_samples, benchmark->num_access_time_samples);
+  gdu_benchmark_unlock (benchmark);
+}
+
+/* One row per sample - transfer rates are in bytes per second, access times in seconds */
+gchar *
+gdu_benchmark_to_csv (GduBenchmark *benchmark,
+                      const gchar  *device)
+{
+  GString *str;
+
+  str = g_string_new ("device,timestamp_usec,kind,offset,value\n");
+  csv_append_benchmark (str, benchmark, device, "");
+
+  return g_string_free (str, FALSE);
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+/* The filesystem benchmark measures a mounted filesystem instead of the
+ * device underneath it: sequential and random I/O on a test file, once
+ * with O_DIRECT and once through the page cache with every write
+ * fsync()ed, then small writes at random offsets of the test file each
+ * followed by fdatasync() - what databases and package managers do -
+ * and finally creating and deleting lots of small files.
+ *
+ * Everything happens in hidden temporary files in the given directory.
+ * The test file is unlinked as soon as it has been opened so not even
+ * a crash leaves it behind, the small files are removed on any error.
+ */
+
+#define FILESYSTEM_BENCHMARK_PREFIX     ".mate-disks-benchmark-XXXXXX"
+#define FILESYSTEM_BENCHMARK_FILE_SIZE  4096
+
+GduFilesystemBenchmark *
+gdu_filesystem_benchmark_new (void)
+{
+  GduFilesystemBenchmark *benchmark;
+
+  benchmark = g_new0 (GduFilesystemBenchmark, 1);
+  g_mutex_init (&benchmark->lock);
+  benchmark->direct = gdu_benchmark_new ();
+  benchmark->buffered = gdu_benchmark_new ();
+  return benchmark;
+}
+
+void
+gdu_filesystem_benchmark_free (GduFilesystemBenchmark *benchmark)
+{
+  gdu_benchmark_free (benchmark->direct);
+  gdu_benchmark_free (benchmark->buffered);
+  g_mutex_clear (&benchmark->lock);
+  g_free (benchmark);
+}
+
+void
+gdu_filesystem_benchmark_lock (GduFilesystemBenchmark *benchmark)
+{
+  g_mutex_lock (&benchmark->lock);
+}
+
+void
+gdu_filesystem_benchmark_unlock (GduFilesystemBenchmark *benchmark)
+{
+  g_mutex_unlock (&benchmark->lock);
+}
+
+typedef struct
+{
+  GduFilesystemBenchmark           *benchmark;
+  GduFilesystemBenchmarkUpdateFunc  update_func;
+  gpointer                          user_data;
+} FilesystemUpdateData;
+
+static void
+filesystem_update (FilesystemUpdateData *data)
+{
+  if (data->update_func != NULL)
+    data->update_func (data->benchmark, data->user_data);
+}
+
+static void
+on_filesystem_sample (GduBenchmark *benchmark,
+                      gpointer      user_data)
+{
+  filesystem_update (user_data);
+}
+
+static void
+filesystem_set_state (FilesystemUpdateData        *data,
+                      GduFilesystemBenchmarkState  state)
+{
+  gdu_filesystem_benchmark_lock (data->benchmark);
+  data->benchmark->state = state;
+  data->benchmark->num_files_done = 0;
+  gdu_filesystem_benchmark_unlock (data->benchmark);
+  filesystem_update (data);
+}
+
+static void
+filesystem_set_files_done (FilesystemUpdateData *data,
+                           gint                  num_files_done)
+{
+  gdu_filesystem_benchmark_lock (data->benchmark);
+  data->benchmark->num_files_done = num_files_done;
+  gdu_filesystem_benchmark_unlock (data->benchmark);
+  filesystem_update (data);
+}
+
+/* Writes @size bytes to @fd. Every 4096 bytes are stamped with their
+ * offset so filesystems with compression or deduplication can't cheat.
+ */
+static gboolean
+fill_file (gint           fd,
+           guint64        size,
+           GCancellable  *cancellable,
+           GError       **error)
+{
+  gboolean ret = FALSE;
+  const gsize chunk_size = 1024 * 1024;
+  guchar *buffer;
+  guint64 offset;
+  gsize n;
+
+  buffer = g_malloc (chunk_size);
+  memset (buffer, 0x5a, chunk_size);
+  for (offset = 0; offset < size; offset += chunk_size)
+    {
+      if (g_cancellable_set_error_if_cancelled (cancellable, error))
+        goto out;
+      for (n = 0; n < chunk_size; n += FILESYSTEM_BENCHMARK_FILE_SIZE)
+        *((guint64 *) (buffer + n)) = offset + n;
+      if (!write_all (fd, buffer, MIN (chunk_size, size - offset), error))
+        goto out;
+    }
+
+  if (fsync (fd) != 0)
+    {
+      g_set_error (error,
+                   G_IO_ERROR,
+                   g_io_error_from_errno (errno),
+                   C_("benchmarking", "Error syncing test file: %m"));
+      goto out;
+    }
+
+  ret = TRUE;
+
+ out:
+  g_free (buffer);
+  return ret;
+}
+
+/* Writes num_access_samples blocks of FILESYSTEM_BENCHMARK_FILE_SIZE
+ * bytes at random offsets of the test file, each followed by
+ * fdatasync(), and returns the average time per write in @out_time
+ */
+static gboolean
+run_random_writes (FilesystemUpdateData  *data,
+                   gint                   fd,
+                   guint64                file_size,
+                   GCancellable          *cancellable,
+                   gdouble               *out_time,
+                   GError               **error)
+{
+  GduFilesystemBenchmark *benchmark = data->benchmark;
+  gboolean ret = FALSE;
+  guchar *buffer_unaligned;
+  guchar *buffer;
+  GRand *rand;
+  gint64 total_usec = 0;
+  gint n;
+
+  /* aligned for O_DIRECT */
+  buffer_unaligned = g_malloc0 (2 * FILESYSTEM_BENCHMARK_FILE_SIZE);
+  buffer = (guchar*) (((gintptr) (buffer_unaligned + FILESYSTEM_BENCHMARK_FILE_SIZE)) & (~(FILESYSTEM_BENCHMARK_FILE_SIZE - 1)));
+  memset (buffer, 0x5a, FILESYSTEM_BENCHMARK_FILE_SIZE);
+
+  rand = g_rand_new_with_seed (42); /* same offsets for every run so it's repeatable */
+  for (n = 0; n < benchmark->num_access_samples; n++)
+    {
+      gint64 begin_usec;
+      guint64 offset;
+
+      if (g_cancellable_set_error_if_cancelled (cancellable, error))
+        goto out;
+
+      offset = (guint64) g_rand_double_range (rand, 0, (gdouble) file_size);
+      offset &= ~((guint64) FILESYSTEM_BENCHMARK_FILE_SIZE - 1);
+      *((guint64 *) buffer) = offset;
+
+      begin_usec = g_get_monotonic_time ();
+      if (pwrite (fd, buffer, FILESYSTEM_BENCHMARK_FILE_SIZE, offset) != FILESYSTEM_BENCHMARK_FILE_SIZE)
+        {
+          g_set_error (error,
+                       G_IO_ERROR,
+                       g_io_error_from_errno (errno),
+                       C_("benchmarking", "Error writing %lld bytes at offset %lld: %m"),
+                       (long long int) FILESYSTEM_BENCHMARK_FILE_SIZE,
+                       (long long int) offset);
+          goto out;
+        }
+      if (fdatasync (fd) != 0)
+        {
+          g_set_error (error,
+                       G_IO_ERROR,
+                       g_io_error_from_errno (errno),
+                       C_("benchmarking", "Error syncing (at offset %lld): %m"),
+                       (long long int) offset);
+          goto out;
+        }
+      total_usec += g_get_monotonic_time () - begin_usec;
+
+      if ((n + 1) % 50 == 0)
+        filesystem_set_files_done (data, n + 1);
+    }
+
+  *out_time = ((gdouble) total_usec) / G_USEC_PER_SEC / MAX (benchmark->num_access_samples, 1);
+
+  ret = TRUE;
+
+ out:
+  g_rand_free (rand);
+  g_free (buffer_unaligned);
+  return ret;
+}
+
+/* Creates num_files small files in a new directory below @directory,
+ * each written and fsync()ed, and deletes them again
+ */
+static gboolean
+run_metadata (FilesystemUpdateData  *data,
+              const gchar           *directory,
+              GCancellable          *cancellable,
+              GError               **error)
+{
+  GduFilesystemBenchmark *benchmark = data->benchmark;
+  gboolean ret = FALSE;
+  guchar buffer[FILESYSTEM_BENCHMARK_FILE_SIZE];
+  gchar name[16];
+  gchar *dir = NULL;
+  gint dir_fd = -1;
+  gint num_created = 0;
+  gint num_deleted = 0;
+  gint64 begin_usec;
+  gint64 end_usec;
+  gdouble rate;
+  gint n;
+
+  memset (buffer, 0x5a, sizeof buffer);
+
+  dir = g_build_filename (directory, FILESYSTEM_BENCHMARK_PREFIX, NULL);
+  if (g_mkdtemp_full (dir, 0700) == NULL)
+    {
+      g_set_error (error,
+                   G_IO_ERROR,
+                   g_io_error_from_errno (errno),
+                   C_("benchmarking", "Error creating temporary directory in %s: %m"),
+                   directory);
+      g_clear_pointer (&dir, g_free);
+      goto out;
+    }
+  dir_fd = open (dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (dir_fd == -1)
+    {
+      g_set_error (error,
+                   G_IO_ERROR,
+                   g_io_error_from_errno (errno),
+                   C_("benchmarking", "Error opening %s: %m"),
+                   dir);
+      goto out;
+    }
+
+  filesystem_set_state (data, GDU_FILESYSTEM_BENCHMARK_STATE_CREATING_FILES);
+  begin_usec = g_get_monotonic_time ();
+  for (n = 0; n < benchmark->num_files; n++)
+    {
+      gint fd;
+
+      if (g_cancellable_set_error_if_cancelled (cancellable, error))
+        goto out;
+
+      g_snprintf (name, sizeof name, "%d", n);
+      fd = openat (dir_fd, name, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+      if (fd == -1)
+        {
+          g_set_error (error,
+                       G_IO_ERROR,
+                       g_io_error_from_errno (errno),
+                       C_("benchmarking", "Error creating file in %s: %m"),
+                       dir);
+          goto out;
+        }
+      num_created++;
+      if (!write_all (fd, buffer, sizeof buffer, error))
+        {
+          close (fd);
+          goto out;
+        }
+      if (fsync (fd) != 0)
+        {
+          g_set_error (error,
+                       G_IO_ERROR,
+                       g_io_error_from_errno (errno),
+                       C_("benchmarking", "Error syncing file in %s: %m"),
+                       dir);
+          close (fd);
+          goto out;
+        }
+      close (fd);
+
+      if ((n + 1) % 50 == 0)
+        filesystem_set_files_done (data, n + 1);
+    }
+  if (fsync (dir_fd) != 0)
+    {
+      g_set_error (error,
+                   G_IO_ERROR,
+                   g_io_error_from_errno (errno),
+                   C_("benchmarking", "Error syncing %s: %m"),
+                   dir);
+      goto out;
+    }
+  end_usec = g_get_monotonic_time ();
+  rate = ((gdouble) G_USEC_PER_SEC) * benchmark->num_files / MAX (end_usec - begin_usec, 1);
+  gdu_filesystem_benchmark_lock (benchmark);
+  benchmark->create_rate = rate;
+  gdu_filesystem_benchmark_unlock (benchmark);
+
+  filesystem_set_state (data, GDU_FILESYSTEM_BENCHMARK_STATE_DELETING_FILES);
+  begin_usec = g_get_monotonic_time ();
+  for (n = 0; n < benchmark->num_files; n++)
+    {
+      if (g_cancellable_set_error_if_cancelled (cancellable, error))
+        goto out;
+
+      g_snprintf (name, sizeof name, "%d", n);
+      if (unlinkat (dir_fd, name, 0) != 0)
+        {
+          g_set_error (error,
+                       G_IO_ERROR,
+                       g_io_error_from_errno (errno),
+                       C_("benchmarking", "Error deleting file in %s: %m"),
+                       dir);
+          goto out;
+        }
+      num_deleted++;
+
+      if ((n + 1) % 50 == 0)
+        filesystem_set_files_done (data, n + 1);
+    }
+  if (fsync (dir_fd) != 0)
+    {
+      g_set_error (error,
+                   G_IO_ERROR,
+                   g_io_error_from_errno (errno),
+                   C_("benchmarking", "Error syncing %s: %m"),
+                   dir);
+      goto out;
+    }
+  end_usec = g_get_monotonic_time ();
+  rate = ((gdouble) G_USEC_PER_SEC) * benchmark->num_files / MAX (end_usec - begin_usec, 1);
+  gdu_filesystem_benchmark_lock (benchmark);
+  benchmark->delete_rate = rate;
+  gdu_filesystem_benchmark_unlock (benchmark);
+
+  ret = TRUE;
+
+ out:
+  /* don't leave anything behind, also on error */
+  if (dir_fd != -1)
+    {
+      for (n = num_deleted; n < num_created; n++)
+        {
+          g_snprintf (name, sizeof name, "%d", n);
+          unlinkat (dir_fd, name, 0);
+        }
+      close (dir_fd);
+    }
+  if (dir != NULL)
+    {
+      rmdir (dir);
+      g_free (dir);
+    }
+  return ret;
+}
+
+/**
+ * gdu_filesystem_benchmark_run:
+ * @benchmark: The parameters and results.
+ * @directory: A directory on the mounted filesystem to benchmark.
+ * @cancellable: A #GCancellable or %NULL.
+ * @update_func: Function to call when there is progress or %NULL.
+ * @user_data: User data for @update_func.
+ * @error: Return location for error or %NULL.
+ *
+ * Benchmarks the filesystem @directory is on, see above. Blocks so it
+ * must be called from a thread unless there is no UI. The direct
+ * benchmark is skipped if the filesystem doesn't support O_DIRECT.
+ *
+ * Returns: %TRUE if the benchmark completed, %FALSE if @error is set.
+ */
+gboolean
+gdu_filesystem_benchmark_run (GduFilesystemBenchmark            *benchmark,
+                              const gchar                       *directory,
+                              GCancellable                      *cancellable,
+                              GduFilesystemBenchmarkUpdateFunc   update_func,
+                              gpointer                           user_data,
+                              GError                           **error)
+{
+  gboolean ret = FALSE;
+  FilesystemUpdateData data;
+  struct statvfs vfsbuf;
+  gchar *filename = NULL;
+  guint64 file_size;
+  gint fd = -1;
+  gint direct_fd = -1;
+  gdouble random_write_time;
+
+  g_return_val_if_fail (benchmark->num_samples > 0, FALSE);
+  g_return_val_if_fail (benchmark->sample_size_mib > 0, FALSE);
+  g_return_val_if_fail (benchmark->num_access_samples > 0, FALSE);
+  g_return_val_if_fail (benchmark->num_files > 0, FALSE);
+
+  data.benchmark = benchmark;
+  data.update_func = update_func;
+  data.user_data = user_data;
+
+  gdu_benchmark_clear (benchmark->direct);
+  gdu_benchmark_clear (benchmark->buffered);
+  gdu_filesystem_benchmark_lock (benchmark);
+  benchmark->time_benchmarked_usec = 0;
+  benchmark->direct_supported = FALSE;
+  benchmark->direct_random_write_time = 0.0;
+  benchmark->buffered_random_write_time = 0.0;
+  benchmark->create_rate = 0.0;
+  benchmark->delete_rate = 0.0;
+  gdu_filesystem_benchmark_unlock (benchmark);
+  filesystem_set_state (&data, GDU_FILESYSTEM_BENCHMARK_STATE_PREPARING);
+
+  /* with samples back to back, each one reads data that isn't cached yet */
+  file_size = ((guint64) benchmark->num_samples) * benchmark->sample_size_mib * 1024 * 1024;
+
+  if (statvfs (directory, &vfsbuf) != 0)
+    {
+      g_set_error (error,
+                   G_IO_ERROR,
+                   g_io_error_from_errno (errno),
+                   C_("benchmarking", "Error getting free space of %s: %m"),
+                   directory);
+      goto out;
+    }
+  if (((guint64) vfsbuf.f_bavail) * vfsbuf.f_frsize < file_size + file_size / 10)
+    {
+      gchar *s = g_format_size (file_size);
+      g_set_error (error,
+                   G_IO_ERROR,
+                   G_IO_ERROR_NO_SPACE,
+                   C_("benchmarking", "Not enough free space in %s for a %s test file"),
+                   directory, s);
+      g_free (s);
+      goto out;
+    }
+
+  filename = g_build_filename (directory, FILESYSTEM_BENCHMARK_PREFIX, NULL);
+  fd = g_mkstemp_full (filename, O_RDWR | O_CLOEXEC, 0600);
+  if (fd == -1)
+    {
+      g_set_error (error,
+                   G_IO_ERROR,
+                   g_io_error_from_errno (errno),
+                   C_("benchmarking", "Error creating temporary file in %s: %m"),
+                   directory);
+      g_clear_pointer (&filename, g_free);
+      goto out;
+    }
+  direct_fd = open (filename, O_RDWR | O_CLOEXEC | O_DIRECT);
+  if (direct_fd == -1 && errno != EINVAL)
+    {
+      g_set_error (error,
+                   G_IO_ERROR,
+                   g_io_error_from_errno (errno),
+                   C_("benchmarking", "Error opening %s: %m"),
+                   filename);
+      goto out;
+    }
+  unlink (filename);
+  g_clear_pointer (&filename, g_free);
+
+  if (!fill_file (fd, file_size, cancellable, error))
+    goto out;
+
+  benchmark->direct->num_samples = benchmark->num_samples;
+  benchmark->direct->sample_size_mib = benchmark->sample_size_mib;
+  benchmark->direct->do_write = TRUE;
+  benchmark->direct->num_access_samples = benchmark->num_access_samples;
+  benchmark->buffered->num_samples = benchmark->num_samples;
+  benchmark->buffered->sample_size_mib = benchmark->sample_size_mib;
+  benchmark->buffered->do_write = TRUE;
+  benchmark->buffered->num_access_samples = benchmark->num_access_samples;
+
+  if (direct_fd != -1)
+    {
+      gdu_filesystem_benchmark_lock (benchmark);
+      benchmark->direct_supported = TRUE;
+      gdu_filesystem_benchmark_unlock (benchmark);
+      filesystem_set_state (&data, GDU_FILESYSTEM_BENCHMARK_STATE_DIRECT);
+      if (!gdu_benchmark_run (benchmark->direct, direct_fd, NULL, cancellable,
+                              on_filesystem_sample, &data, error))
+        goto out;
+    }
+
+  filesystem_set_state (&data, GDU_FILESYSTEM_BENCHMARK_STATE_BUFFERED);
+  if (!gdu_benchmark_run (benchmark->buffered, fd, NULL, cancellable,
+                          on_filesystem_sample, &data, error))
+    goto out;
+
+  filesystem_set_state (&data, GDU_FILESYSTEM_BENCHMARK_STATE_RANDOM_WRITES);
+  if (direct_fd != -1)
+    {
+      if (!run_random_writes (&data, direct_fd, file_size, cancellable, &random_write_time, error))
+        goto out;
+      gdu_filesystem_benchmark_lock (benchmark);
+      benchmark->direct_random_write_time = random_write_time;
+      gdu_filesystem_benchmark_unlock (benchmark);
+      filesystem_set_files_done (&data, 0);
+    }
+  if (!run_random_writes (&data, fd, file_size, cancellable, &random_write_time, error))
+    goto out;
+  gdu_filesystem_benchmark_lock (benchmark);
+  benchmark->buffered_random_write_time = random_write_time;
+  gdu_filesystem_benchmark_unlock (benchmark);
+
+  /* give the space back before creating the small files */
+  if (direct_fd != -1)
+    {
+      close (direct_fd);
+      direct_fd = -1;
+    }
+  close (fd);
+  fd = -1;
+
+  if (!run_metadata (&data, directory, cancellable, error))
+    goto out;
+
+  gdu_filesystem_benchmark_lock (benchmark);
+  benchmark->time_benchmarked_usec = g_get_real_time ();
+  gdu_filesystem_benchmark_unlock (benchmark);
+
+  ret = TRUE;
+
+ out:
+  if (filename != NULL)
+    {
+      unlink (filename);
+      g_free (filename);
+    }
+  if (direct_fd != -1)
+    close (direct_fd);
+  if (fd != -1)
+    close (fd);
+  filesystem_set_state (&data, GDU_FILESYSTEM_BENCHMARK_STATE_NONE);
+  return ret;
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+/* Returns a floating a{sv} - the direct results are left out if the
+ * filesystem doesn't support O_DIRECT
+ */
+GVariant *
+gdu_filesystem_benchmark_to_gvariant (GduFilesystemBenchmark *benchmark)
+{
+  GVariantBuilder builder;
+
+  gdu_filesystem_benchmark_lock (benchmark);
+  g_variant_builder_init (&builder, G_VARIANT_TYPE_VARDICT);
+  g_variant_builder_add (&builder, "{sv}", "version", g_variant_new_int32 (1));
+  g_variant_builder_add (&builder, "{sv}", "timestamp-usec", g_variant_new_int64 (benchmark->time_benchmarked_usec));
+  if (benchmark->direct_supported)
+    g_variant_builder_add (&builder, "{sv}", "direct", gdu_benchmark_to_gvariant (benchmark->direct));
+  g_variant_builder_add (&builder, "{sv}", "buffered", gdu_benchmark_to_gvariant (benchmark->buffered));
+  g_variant_builder_add (&builder, "{sv}", "num-random-writes", g_variant_new_int32 (benchmark->num_access_samples));
+  if (benchmark->direct_supported)
+    g_variant_builder_add (&builder, "{sv}", "direct-random-write-time", g_variant_new_double (benchmark->direct_random_write_time));
+  g_variant_builder_add (&builder, "{sv}", "buffered-random-write-time", g_variant_new_double (benchmark->buffered_random_write_time));
+  g_variant_builder_add (&builder, "{sv}", "num-files", g_variant_new_int32 (benchmark->num_files));
+  g_variant_builder_add (&builder, "{sv}", "file-size", g_variant_new_uint64 (FILESYSTEM_BENCHMARK_FILE_SIZE));
+  g_variant_builder_add (&builder, "{sv}", "create-rate", g_variant_new_double (benchmark->create_rate));
+  g_variant_builder_add (&builder, "{sv}", "delete-rate", g_variant_new_double (benchmark->delete_rate));
+  gdu_filesystem_benchmark_unlock (benchmark);
+
+  return g_variant_builder_end (&builder);
+}
+
+/* Transfer rates are in bytes per second, access and random write
+ * times in seconds and create and delete rates in files per second
+ */
+gchar *
+gdu_filesystem_benchmark_to_json (GduFilesystemBenchmark *benchmark,
+                                  const gchar            *directory)
+{
+  GString *str;
+
+  str = g_string_new ("{\n");
+
+  gdu_filesystem_benchmark_lock (benchmark);
+  g_string_append (str, "  \"directory\": ");
+  json_append_string (str, directory);
+  g_string_append (str, ",\n");
+  g_string_append_printf (str, "  \"timestamp-usec\": %" G_GINT64_FORMAT ",\n", benchmark->time_benchmarked_usec);
+  g_string_append (str, "  \"direct\": ");
+  if (benchmark->direct_supported)
+    json_append_benchmark (str, "  ", benchmark->direct, NULL);
+  else
+    g_string_append (str, "null");
+  g_string_append (str, ",\n  \"buffered\": ");
+  json_append_benchmark (str, "  ", benchmark->buffered, NULL);
+  g_string_append (str, ",\n  \"random-writes\": {\n");
+  g_string_append_printf (str, "    \"num-writes\": %d,\n", benchmark->num_access_samples);
+  g_string_append_printf (str, "    \"block-size\": %d,\n", FILESYSTEM_BENCHMARK_FILE_SIZE);
+  g_string_append (str, "    \"direct-time\": ");
+  if (benchmark->direct_supported)
+    json_append_double (str, benchmark->direct_random_write_time);
+  else
+    g_string_append (str, "null");
+  g_string_append (str, ",\n    \"buffered-time\": ");
+  json_append_double (str, benchmark->buffered_random_write_time);
+  g_string_append (str, "\n  },\n  \"metadata\": {\n");
+  g_string_append_printf (str, "    \"num-files\": %d,\n", benchmark->num_files);
+  g_string_append_printf (str, "    \"file-size\": %d,\n", FILESYSTEM_BENCHMARK_FILE_SIZE);
+  g_string_append (str, "    \"create-rate\": ");
+  json_append_double (str, benchmark->create_rate);
+  g_string_append (str, ",\n    \"delete-rate\": ");
+  json_append_double (str, benchmark->delete_rate);
+  g_string_append (str, "\n  }\n");
+  gdu_filesystem_benchmark_unlock (benchmark);
+
+  g_string_append (str, "}\n");
+
+  return g_string_free (str, FALSE);
+}
+
+/* Same columns as gdu_benchmark_to_csv() with @directory as the device.
+ * Kinds are prefixed with "direct-" or "buffered-" and the random write
+ * times and the create and delete rates are single rows with offset 0.
+ */
+gchar *
+gdu_filesystem_benchmark_to_csv (GduFilesystemBenchmark *benchmark,
+                                 const gchar            *directory)
+{
+  gchar buf[G_ASCII_DTOSTR_BUF_SIZE];
+  GString *str;
+
+  str = g_string_new ("device,timestamp_usec,kind,offset,value\n");
+
+  gdu_filesystem_benchmark_lock (benchmark);
+  if (benchmark->direct_supported)
+    csv_append_benchmark (str, benchmark->direct, directory, "direct-");
+  csv_append_benchmark (str, benchmark->buffered, directory, "buffered-");
+  if (benchmark->direct_supported)
+    g_string_append_printf (str, "%s,%" G_GINT64_FORMAT ",direct-random-write-time,0,%s\n",
+                            directory,
+                            benchmark->time_benchmarked_usec,
+                            g_ascii_dtostr (buf, sizeof buf, benchmark->direct_random_write_time));
+  g_string_append_printf (str, "%s,%" G_GINT64_FORMAT ",buffered-random-write-time,0,%s\n",
+                          directory,
+                          benchmark->time_benchmarked_usec,
+                          g_ascii_dtostr (buf, sizeof buf, benchmark->buffered_random_write_time));
+  g_string_append_printf (str, "%s,%" G_GINT64_FORMAT ",create-rate,0,%s\n",
+                          directory,
+                          benchmark->time_benchmarked_usec,
+                          g_ascii_dtostr (buf, sizeof buf, benchmark->create_rate));
+  g_string_append_printf (str, "%s,%" G_GINT64_FORMAT ",delete-rate,0,%s\n",
+                          directory,
+                          benchmark->time_benchmarked_usec,
+                          g_ascii_dtostr (buf, sizeof buf, benchmark->delete_rate));
+  gdu_filesystem_benchmark_unlock (benchmark);
+
+  return g_string_free (str, FALSE);
+}
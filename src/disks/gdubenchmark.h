@@ -0,0 +1,163 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*-
+ *
+ * Copyright (C) 2008-2013 Red Hat, Inc.
+ *
+ * Licensed under GPL version 2 or later.
+ *
+ * Author: David Zeuthen <zeuthen@gmail.com>
+ */
+
+#ifndef __GDU_BENCHMARK_H__
+#define __GDU_BENCHMARK_H__
+
+#include <gtk/gtk.h>
+#include "gdutypes.h"
+
+G_BEGIN_DECLS
+
+typedef struct
+{
+  guint64 offset;
+  gdouble value;
+} GduBenchmarkSample;
+
+struct GduBenchmark
+{
+  GMutex lock;
+
+  /* parameters - must be set before calling gdu_benchmark_run() */
+  gint num_samples;
+  gint sample_size_mib;
+  gboolean do_write;
+  gint num_access_samples;
+
+  /* must hold lock when reading these - the samples point into storage
+   * owned by the benchmark (possibly a mapped file) and are read-only
+   */
+  GduBenchmarkState state;
+  gint64 time_benchmarked_usec; /* 0 if never benchmarked, otherwise micro-seconds since Epoch */
+  gboolean incomplete;          /* TRUE if from a run that never finished */
+  guint64 size;
+  guint64 sample_size;
+  const GduBenchmarkSample *read_samples;        /* value is bytes per second */
+  guint num_read_samples;
+  const GduBenchmarkSample *write_samples;       /* value is bytes per second */
+  guint num_write_samples;
+  const GduBenchmarkSample *access_time_samples; /* value is seconds */
+  guint num_access_time_samples;
+
+  /*< private >*/
+  gpointer storage;          /* results file layout in heap or mmap()ed memory, if any */
+  gsize storage_size;
+  gboolean storage_is_mmap;
+  GMappedFile *mapped_file;  /* read-only results or history file, if any */
+};
+
+/* Called from the benchmarking thread whenever a sample has been added */
+typedef void (*GduBenchmarkUpdateFunc) (GduBenchmark *benchmark,
+                                        gpointer      user_data);
+
+GduBenchmark *gdu_benchmark_new                   (void);
+void          gdu_benchmark_free                  (GduBenchmark  *benchmark);
+void          gdu_benchmark_lock                  (GduBenchmark  *benchmark);
+void          gdu_benchmark_unlock                (GduBenchmark  *benchmark);
+void          gdu_benchmark_clear                 (GduBenchmark  *benchmark);
+
+void          gdu_benchmark_get_max_min_avg       (const GduBenchmarkSample *samples,
+                                                   guint                     num_samples,
+                                                   gdouble                  *out_max,
+                                                   gdouble                  *out_min,
+                                                   gdouble                  *out_avg);
+
+gint          gdu_benchmark_open_block            (UDisksBlock   *block,
+                                                   gboolean       writable,
+                                                   GCancellable  *cancellable,
+                                                   GError       **error);
+gint          gdu_benchmark_open_file             (const gchar   *filename,
+                                                   gboolean       writable,
+                                                   GError       **error);
+
+gboolean      gdu_benchmark_run                   (GduBenchmark            *benchmark,
+                                                   gint                     fd,
+                                                   const gchar             *results_filename,
+                                                   GCancellable            *cancellable,
+                                                   GduBenchmarkUpdateFunc   update_func,
+                                                   gpointer                 user_data,
+                                                   GError                 **error);
+
+gchar        *gdu_benchmark_get_filename_for_block (UDisksBlock  *block);
+gboolean      gdu_benchmark_load                  (GduBenchmark  *benchmark,
+                                                   const gchar   *filename,
+                                                   GError       **error);
+
+gchar        *gdu_benchmark_get_history_filename_for_block (UDisksBlock *block);
+gboolean      gdu_benchmark_append_to_history     (GduBenchmark  *benchmark,
+                                                   const gchar   *filename,
+                                                   GError       **error);
+GPtrArray    *gdu_benchmark_load_history          (const gchar   *filename,
+                                                   GError       **error);
+
+GduBenchmarkRegressionFlags gdu_benchmark_find_regressions (GduBenchmark *benchmark,
+                                                            GPtrArray    *history,
+                                                            gdouble      *out_read_change,
+                                                            gdouble      *out_write_change,
+                                                            gdouble      *out_access_time_change);
+
+GVariant     *gdu_benchmark_to_gvariant           (GduBenchmark  *benchmark);
+gchar        *gdu_benchmark_to_json               (GduBenchmark  *benchmark,
+                                                   const gchar   *device);
+gchar        *gdu_benchmark_to_csv                (GduBenchmark  *benchmark,
+                                                   const gchar   *device);
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+struct GduFilesystemBenchmark
+{
+  GMutex lock;
+
+  /* parameters - must be set before calling gdu_filesystem_benchmark_run(),
+   * the test file is num_samples * sample_size_mib MiB big
+   */
+  gint num_samples;
+  gint sample_size_mib;
+  gint num_access_samples;
+  gint num_files;
+
+  /* direct and buffered have their own locks - must hold lock when
+   * reading the rest of these
+   */
+  GduFilesystemBenchmarkState state;
+  gint64 time_benchmarked_usec;  /* 0 if not completed, otherwise micro-seconds since Epoch */
+  gboolean direct_supported;     /* FALSE if the filesystem doesn't support O_DIRECT */
+  GduBenchmark *direct;          /* through O_DIRECT, bypassing the page cache */
+  GduBenchmark *buffered;        /* through the page cache, every write is fsync()ed */
+  gint num_files_done;           /* while writing at random offsets, creating or deleting files */
+  gdouble direct_random_write_time;   /* seconds per block written at a random offset and fdatasync()ed */
+  gdouble buffered_random_write_time;
+  gdouble create_rate;           /* files per second, each written and fsync()ed */
+  gdouble delete_rate;           /* files per second */
+};
+
+/* Called from the benchmarking thread whenever there is progress */
+typedef void (*GduFilesystemBenchmarkUpdateFunc) (GduFilesystemBenchmark *benchmark,
+                                                  gpointer                user_data);
+
+GduFilesystemBenchmark *gdu_filesystem_benchmark_new          (void);
+void                    gdu_filesystem_benchmark_free         (GduFilesystemBenchmark            *benchmark);
+void                    gdu_filesystem_benchmark_lock         (GduFilesystemBenchmark            *benchmark);
+void                    gdu_filesystem_benchmark_unlock       (GduFilesystemBenchmark            *benchmark);
+gboolean                gdu_filesystem_benchmark_run          (GduFilesystemBenchmark            *benchmark,
+                                                               const gchar                       *directory,
+                                                               GCancellable                      *cancellable,
+                                                               GduFilesystemBenchmarkUpdateFunc   update_func,
+                                                               gpointer                           user_data,
+                                                               GError                           **error);
+GVariant               *gdu_filesystem_benchmark_to_gvariant  (GduFilesystemBenchmark            *benchmark);
+gchar                  *gdu_filesystem_benchmark_to_json      (GduFilesystemBenchmark            *benchmark,
+                                                               const gchar                       *directory);
+gchar                  *gdu_filesystem_benchmark_to_csv       (GduFilesystemBenchmark            *benchmark,
+                                                               const gchar                       *directory);
+
+G_END_DECLS
+
+#endif /* __GDU_BENCHMARK_H__ */
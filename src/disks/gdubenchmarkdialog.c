@@ -23,23 +23,10 @@
 #include "gduapplication.h"
 #include "gduwindow.h"
 #include "gdubenchmarkdialog.h"
+#include "gdubenchmark.h"
 
 /* ---------------------------------------------------------------------------------------------------- */
 
-typedef struct {
-  guint64 offset;
-  gdouble value;
-} BMSample;
-
-/* ---------------------------------------------------------------------------------------------------- */
-
-typedef enum {
-  BM_STATE_NONE,
-  BM_STATE_OPENING_DEVICE,
-  BM_STATE_TRANSFER_RATE,
-  BM_STATE_ACCESS_TIME,
-} BMState;
-
 typedef struct
 {
   volatile gint ref_count;
@@ -54,6 +41,7 @@ typedef struct
 
   GtkWidget *dialog;
 
+  GtkWidget *main_box;
   GtkWidget *graph_drawing_area;
 
   GtkWidget *device_label;
@@ -63,6 +51,9 @@ typedef struct
   GtkWidget *write_rate_label;
   GtkWidget *access_time_label;
 
+  GtkWidget *regression_infobar;
+  GtkWidget *regression_label;
+
   GtkWidget *start_benchmark_button;
   GtkWidget *stop_benchmark_button;
 
@@ -70,35 +61,32 @@ typedef struct
 
   /* ---- */
 
-  /* retrieved from preferences dialog */
-  gint bm_num_samples;
-  gint bm_sample_size_mib;
-  gboolean bm_do_write;
-  gint bm_num_access_samples;
+  /* parameters are retrieved from preferences dialog, results are
+   * protected by the lock of the benchmark
+   */
+  GduBenchmark *bm;
 
-  /* must hold bm_lock when reading/writing these */
+  /* must hold the lock of bm when reading/writing these */
   GThread *bm_thread;
   GCancellable *bm_cancellable;
   gboolean bm_in_progress;
-  BMState bm_state;
   GError *bm_error; /* set by benchmark thread on termination */
   gboolean bm_update_timeout_pending;
+  gboolean bm_history_changed; /* set by benchmark thread when a run was added */
 
-  gint64 bm_time_benchmarked_usec; /* 0 if never benchmarked, otherwise micro-seconds since Epoch */
-  guint64 bm_size;
-  guint64 bm_sample_size;
-  GArray *bm_read_samples;
-  GArray *bm_write_samples;
-  GArray *bm_access_time_samples;
+  /* earlier runs, oldest first - only used from the main / UI thread */
+  GPtrArray *history;
 
 } DialogData;
 
-G_LOCK_DEFINE (bm_lock);
+/* Max number of earlier runs drawn behind the current one */
+#define MAX_OVERLAY_RUNS 5
 
 static const struct {
   goffset offset;
   const gchar *name;
 } widget_mapping[] = {
+  {G_STRUCT_OFFSET (DialogData, main_box), "box1"},
   {G_STRUCT_OFFSET (DialogData, graph_drawing_area), "graph-drawing-area"},
   {G_STRUCT_OFFSET (DialogData, device_label), "device-label"},
   {G_STRUCT_OFFSET (DialogData, updated_label), "updated-label"},
@@ -114,6 +102,8 @@ static void update_dialog (DialogData *data);
 static gboolean maybe_load_data (DialogData  *data,
                                  GError     **error);
 
+static void maybe_load_history (DialogData *data);
+
 /* ---------------------------------------------------------------------------------------------------- */
 
 static DialogData *
@@ -139,9 +129,8 @@ dialog_data_unref (DialogData *data)
       g_clear_object (&data->window);
       g_clear_object (&data->builder);
 
-      g_array_unref (data->bm_read_samples);
-      g_array_unref (data->bm_write_samples);
-      g_array_unref (data->bm_access_time_samples);
+      gdu_benchmark_free (data->bm);
+      g_clear_pointer (&data->history, g_ptr_array_unref);
       g_clear_object (&data->bm_cancellable);
       g_clear_error (&data->bm_error);
 
@@ -160,45 +149,6 @@ dialog_data_close (DialogData *data)
 
 /* ---------------------------------------------------------------------------------------------------- */
 
-static void
-get_max_min_avg (GArray  *array,
-                 gdouble *out_max,
-                 gdouble *out_min,
-                 gdouble *out_avg)
-{
-  guint n;
-  gdouble max = 0;
-  gdouble min = 0;
-  gdouble avg = 0;
-  gdouble sum = 0;
-
-  if (array->len == 0)
-    goto out;
-
-  max = -G_MAXDOUBLE;
-  min = G_MAXDOUBLE;
-  sum = 0;
-
-  for (n = 0; n < array->len; n++)
-    {
-      BMSample *s = &g_array_index (array, BMSample, n);
-      if (s->value > max)
-        max = s->value;
-      if (s->value < min)
-        min = s->value;
-      sum += s->value;
-    }
-  avg = sum / array->len;
-
- out:
-  if (out_max != NULL)
-    *out_max = max;
-  if (out_min != NULL)
-    *out_min = min;
-  if (out_avg != NULL)
-    *out_avg = avg;
-}
-
 static gdouble
 measure_width (cairo_t     *cr,
                const gchar *s)
@@ -217,6 +167,58 @@ measure_height (cairo_t     *cr,
   return te.height;
 }
 
+/* returns the earlier runs to draw behind the current one, most recent first */
+static GPtrArray *
+get_overlay_runs (DialogData *data)
+{
+  GPtrArray *ret;
+  gint n;
+
+  ret = g_ptr_array_new ();
+  if (data->history == NULL)
+    goto out;
+
+  for (n = (gint) data->history->len - 1; n >= 0 && ret->len < MAX_OVERLAY_RUNS; n--)
+    {
+      GduBenchmark *run = data->history->pdata[n];
+      if (run->size == 0 || run->time_benchmarked_usec == data->bm->time_benchmarked_usec)
+        continue;
+      g_ptr_array_add (ret, run);
+    }
+
+ out:
+  return ret;
+}
+
+static void
+draw_samples (cairo_t                  *cr,
+              const GduBenchmarkSample *samples,
+              guint                     num_samples,
+              guint64                   size,
+              gdouble                   gx,
+              gdouble                   gy,
+              gdouble                   gw,
+              gdouble                   gh,
+              gdouble                   max_visible_value)
+{
+  guint n;
+
+  for (n = 0; n < num_samples; n++)
+    {
+      const GduBenchmarkSample *sample = &samples[n];
+      gdouble x, y;
+
+      x = gx + gw * sample->offset / size;
+      y = gy + gh - gh * sample->value / max_visible_value;
+
+      if (n == 0)
+        cairo_move_to (cr, x, y);
+      else
+        cairo_line_to (cr, x, y);
+    }
+  cairo_stroke (cr);
+}
+
 static gboolean
 on_drawing_area_draw (GtkWidget      *widget,
                       cairo_t        *cr,
@@ -252,30 +254,53 @@ on_drawing_area_draw (GtkWidget      *widget,
   gint size;
   GdkRGBA fg;
   PangoLayout *layout;
+  GPtrArray *overlay_runs;
 
-  G_LOCK (bm_lock);
+  gdu_benchmark_lock (data->bm);
+
+  overlay_runs = get_overlay_runs (data);
 
   //g_print ("drawing: %d %d %d\n",
-  //         data->bm_read_samples->len,
-  //         data->bm_write_samples->len,
-  //         data->bm_access_time_samples->len);
-
-  get_max_min_avg (data->bm_read_samples,
-                   &read_transfer_rate_max,
-                   NULL,
-                   NULL);
-  get_max_min_avg (data->bm_write_samples,
-                   &write_transfer_rate_max,
-                   NULL,
-                   NULL);
-  get_max_min_avg (data->bm_access_time_samples,
-                   &access_time_max,
-                   NULL,
-                   NULL);
+  //         data->bm->num_read_samples,
+  //         data->bm->num_write_samples,
+  //         data->bm->num_access_time_samples);
+
+  gdu_benchmark_get_max_min_avg (data->bm->read_samples,
+                                 data->bm->num_read_samples,
+                                 &read_transfer_rate_max,
+                                 NULL,
+                                 NULL);
+  gdu_benchmark_get_max_min_avg (data->bm->write_samples,
+                                 data->bm->num_write_samples,
+                                 &write_transfer_rate_max,
+                                 NULL,
+                                 NULL);
+  gdu_benchmark_get_max_min_avg (data->bm->access_time_samples,
+                                 data->bm->num_access_time_samples,
+                                 &access_time_max,
+                                 NULL,
+                                 NULL);
 
   max_speed = MAX (read_transfer_rate_max, write_transfer_rate_max);
   max_time = access_time_max;
 
+  for (n = 0; n < overlay_runs->len; n++)
+    {
+      GduBenchmark *run = overlay_runs->pdata[n];
+
+      gdu_benchmark_get_max_min_avg (run->read_samples,
+                                     run->num_read_samples,
+                                     &read_transfer_rate_max,
+                                     NULL,
+                                     NULL);
+      gdu_benchmark_get_max_min_avg (run->write_samples,
+                                     run->num_write_samples,
+                                     &write_transfer_rate_max,
+                                     NULL,
+                                     NULL);
+      max_speed = MAX (max_speed, MAX (read_transfer_rate_max, write_transfer_rate_max));
+    }
+
   if (max_speed == 0)
     max_speed = 100 * 1000 * 1000;
 
@@ -511,46 +536,36 @@ on_drawing_area_draw (GtkWidget      *widget,
       cairo_stroke (cr);
     }
 
-  /* draw read graph */
-  cairo_set_source_rgb (cr, 0.5, 0.5, 1.0);
-  cairo_set_line_width (cr, 1.5);
-  for (n = 0; n < data->bm_read_samples->len; n++)
+  /* draw earlier runs, fading out with age */
+  cairo_set_line_width (cr, 1.0);
+  for (n = 0; n < overlay_runs->len; n++)
     {
-      BMSample *sample = &g_array_index (data->bm_read_samples, BMSample, n);
-
-      x = gx + gw * sample->offset / data->bm_size;
-      y = gy + gh - gh * sample->value / max_visible_speed;
+      GduBenchmark *run = overlay_runs->pdata[n];
+      gdouble alpha = 0.35 - 0.05 * n;
 
-      if (n == 0)
-        cairo_move_to (cr, x, y);
-      else
-        cairo_line_to (cr, x, y);
+      cairo_set_source_rgba (cr, 0.5, 0.5, 1.0, alpha);
+      draw_samples (cr, run->read_samples, run->num_read_samples, run->size, gx, gy, gw, gh, max_visible_speed);
+      cairo_set_source_rgba (cr, 1.0, 0.5, 0.5, alpha);
+      draw_samples (cr, run->write_samples, run->num_write_samples, run->size, gx, gy, gw, gh, max_visible_speed);
     }
-  cairo_stroke (cr);
+
+  /* draw read graph */
+  cairo_set_source_rgb (cr, 0.5, 0.5, 1.0);
+  cairo_set_line_width (cr, 1.5);
+  draw_samples (cr, data->bm->read_samples, data->bm->num_read_samples, data->bm->size, gx, gy, gw, gh, max_visible_speed);
 
   /* draw write graph */
   cairo_set_source_rgb (cr, 1.0, 0.5, 0.5);
   cairo_set_line_width (cr, 1.5);
-  for (n = 0; n < data->bm_write_samples->len; n++)
-    {
-      BMSample *sample = &g_array_index (data->bm_write_samples, BMSample, n);
-      x = gx + gw * sample->offset / data->bm_size;
-      y = gy + gh - gh * sample->value / max_visible_speed;
-
-      if (n == 0)
-        cairo_move_to (cr, x, y);
-      else
-        cairo_line_to (cr, x, y);
-    }
-  cairo_stroke (cr);
+  draw_samples (cr, data->bm->write_samples, data->bm->num_write_samples, data->bm->size, gx, gy, gw, gh, max_visible_speed);
 
   /* draw access time dots + lines */
   cairo_set_line_width (cr, 0.5);
-  for (n = 0; n < data->bm_access_time_samples->len; n++)
+  for (n = 0; n < data->bm->num_access_time_samples; n++)
     {
-      BMSample *sample = &g_array_index (data->bm_access_time_samples, BMSample, n);
+      const GduBenchmarkSample *sample = &data->bm->access_time_samples[n];
 
-      x = gx + gw * sample->offset / data->bm_size;
+      x = gx + gw * sample->offset / data->bm->size;
       y = gy + gh - gh * sample->value / max_visible_time;
 
       /*g_debug ("time = %f @ %f", point->value, x);*/
@@ -641,8 +656,9 @@ on_drawing_area_draw (GtkWidget      *widget,
 
         g_strfreev (y_left_markers);
         g_strfreev (y_right_markers);
+        g_ptr_array_unref (overlay_runs);
 
-  G_UNLOCK (bm_lock);
+  gdu_benchmark_unlock (data->bm);
 
   /* propagate event further */
   return FALSE;
@@ -689,11 +705,11 @@ update_updated_label (DialogData *data)
 {
   gchar *s = NULL;
 
-  G_LOCK (bm_lock);
-  switch (data->bm_state)
+  gdu_benchmark_lock (data->bm);
+  switch (data->bm->state)
     {
-    case BM_STATE_NONE:
-      if (data->bm_time_benchmarked_usec > 0)
+    case GDU_BENCHMARK_STATE_NONE:
+      if (data->bm->time_benchmarked_usec > 0)
         {
           gint64 now_usec;
           gchar *s2;
@@ -703,20 +719,32 @@ update_updated_label (DialogData *data)
 
           now_usec = g_get_real_time ();
 
-          time_benchmarked_dt = g_date_time_new_from_unix_utc (data->bm_time_benchmarked_usec / G_USEC_PER_SEC);
+          time_benchmarked_dt = g_date_time_new_from_unix_utc (data->bm->time_benchmarked_usec / G_USEC_PER_SEC);
           time_benchmarked_dt_local = g_date_time_to_local (time_benchmarked_dt);
           time_benchmarked_str = g_date_time_format (time_benchmarked_dt_local, "%c");
 
-          s = gdu_utils_format_duration_usec ((now_usec - data->bm_time_benchmarked_usec),
+          s = gdu_utils_format_duration_usec ((now_usec - data->bm->time_benchmarked_usec),
                                               GDU_FORMAT_DURATION_FLAGS_NO_SECONDS);
           /* Translators: The first %s is the date and time the benchmark took place in the preferred
            * format for the locale (e.g. "%c" for strftime()/g_date_time_format()), for example
            * "Tue 12 Jun 2012 03:57:08 PM EDT". The second %s is how long ago that is from right
            * now, for example "3 days" or "2 hours" or "12 minutes".
            */
-          s2 = g_strdup_printf (C_("benchmark-updated", "%s (%s ago)"),
-                                time_benchmarked_str,
-                                s);
+          if (data->bm->incomplete)
+            {
+              /* Translators: Like "%s (%s ago)" but for a benchmark that was interrupted
+               * (cancelled, or by a crash) before it finished.
+               */
+              s2 = g_strdup_printf (C_("benchmark-updated", "%s (%s ago, incomplete)"),
+                                    time_benchmarked_str,
+                                    s);
+            }
+          else
+            {
+              s2 = g_strdup_printf (C_("benchmark-updated", "%s (%s ago)"),
+                                    time_benchmarked_str,
+                                    s);
+            }
           gtk_label_set_text (GTK_LABEL (data->updated_label), s2);
           g_free (s2);
           g_free (s);
@@ -730,20 +758,20 @@ update_updated_label (DialogData *data)
         }
       break;
 
-    case BM_STATE_OPENING_DEVICE:
+    case GDU_BENCHMARK_STATE_OPENING_DEVICE:
       gtk_label_set_markup (GTK_LABEL (data->updated_label), C_("benchmark-updated", "Opening Device…"));
       break;
 
-    case BM_STATE_TRANSFER_RATE:
+    case GDU_BENCHMARK_STATE_TRANSFER_RATE:
       s = g_strdup_printf (C_("benchmark-updated", "Measuring transfer rate (%2.1f%% complete)…"),
-                           data->bm_read_samples->len * 100.0 / data->bm_num_samples);
+                           data->bm->num_read_samples * 100.0 / data->bm->num_samples);
       gtk_label_set_markup (GTK_LABEL (data->updated_label), s);
       g_free (s);
       break;
 
-    case BM_STATE_ACCESS_TIME:
+    case GDU_BENCHMARK_STATE_ACCESS_TIME:
       s = g_strdup_printf (C_("benchmark-updated", "Measuring access time (%2.1f%% complete)…"),
-                           data->bm_access_time_samples->len * 100.0 / data->bm_num_access_samples);
+                           data->bm->num_access_time_samples * 100.0 / data->bm->num_access_samples);
       gtk_label_set_markup (GTK_LABEL (data->updated_label), s);
       g_free (s);
       break;
@@ -751,35 +779,61 @@ update_updated_label (DialogData *data)
     default:
       g_assert_not_reached ();
     }
-  G_UNLOCK (bm_lock);
+  gdu_benchmark_unlock (data->bm);
 }
 
-/* returns NULL if it doesn't make sense to load/save benchmark data (removable media,
- * non-drive devices etc.)
- */
-static gchar *
-get_bm_filename (DialogData *data)
+static void
+update_regression_infobar (DialogData *data)
 {
-  gchar *ret = NULL;
-  gchar *bench_dir = NULL;
-  const gchar *id = NULL;
-
-  id = udisks_block_get_id (data->block);
-  if (id == NULL || strlen (id) == 0)
-    goto out;
-
-  bench_dir = g_strdup_printf ("%s/mate-disks/benchmarks", g_get_user_cache_dir ());
-  if (g_mkdir_with_parents (bench_dir, 0777) != 0)
+  GduBenchmarkRegressionFlags flags = GDU_BENCHMARK_REGRESSION_FLAGS_NONE;
+  gdouble read_change = 0.0;
+  gdouble write_change = 0.0;
+  gdouble access_time_change = 0.0;
+  GString *str;
+
+  if (!data->bm_in_progress)
+    flags = gdu_benchmark_find_regressions (data->bm,
+                                            data->history,
+                                            &read_change,
+                                            &write_change,
+                                            &access_time_change);
+
+  if (flags == GDU_BENCHMARK_REGRESSION_FLAGS_NONE)
     {
-      g_warning ("Error creating directory %s: %m", bench_dir);
+      gtk_widget_hide (data->regression_infobar);
       goto out;
     }
 
-  ret = g_strdup_printf ("%s/%s.mate-disks-benchmark", bench_dir, id);
+  str = g_string_new (NULL);
+  g_string_append_printf (str, "<b>%s</b>",
+                          C_("benchmark-regression", "Performance is significantly worse than in earlier benchmarks"));
+  if (flags & GDU_BENCHMARK_REGRESSION_FLAGS_READ_RATE)
+    {
+      g_string_append_c (str, '\n');
+      /* Translators: %.0f is the percentage the average read rate dropped compared to earlier benchmarks */
+      g_string_append_printf (str, C_("benchmark-regression", "Average read rate is %.0f%% lower"),
+                              -read_change * 100.0);
+    }
+  if (flags & GDU_BENCHMARK_REGRESSION_FLAGS_WRITE_RATE)
+    {
+      g_string_append_c (str, '\n');
+      /* Translators: %.0f is the percentage the average write rate dropped compared to earlier benchmarks */
+      g_string_append_printf (str, C_("benchmark-regression", "Average write rate is %.0f%% lower"),
+                              -write_change * 100.0);
+    }
+  if (flags & GDU_BENCHMARK_REGRESSION_FLAGS_ACCESS_TIME)
+    {
+      g_string_append_c (str, '\n');
+      /* Translators: %.0f is the percentage the average access time grew compared to earlier benchmarks */
+      g_string_append_printf (str, C_("benchmark-regression", "Average access time is %.0f%% higher"),
+                              access_time_change * 100.0);
+    }
+  gtk_label_set_markup (GTK_LABEL (data->regression_label), str->str);
+  gtk_widget_show (data->regression_infobar);
+  g_string_free (str, TRUE);
 
  out:
-  g_free (bench_dir);
-  return ret;
+  ;
 }
 
 static void
@@ -793,14 +847,20 @@ update_dialog (DialogData *data)
   gchar *s = NULL;
   UDisksDrive *drive = NULL;
   UDisksObjectInfo *info = NULL;
+  gboolean history_changed;
 
-  G_LOCK (bm_lock);
+  gdu_benchmark_lock (data->bm);
   if (data->bm_error != NULL)
     {
       error = data->bm_error;
       data->bm_error = NULL;
     }
-  G_UNLOCK (bm_lock);
+  history_changed = data->bm_history_changed;
+  data->bm_history_changed = FALSE;
+  gdu_benchmark_unlock (data->bm);
+
+  if (history_changed)
+    maybe_load_history (data);
 
   /* first of all, present an error if something went wrong */
   if (error != NULL)
@@ -812,7 +872,7 @@ update_dialog (DialogData *data)
         }
       g_clear_error (&error);
 
-      /* and reload old data */
+      /* and reload the data - the partial run, if it got anywhere, or the old results */
       if (!maybe_load_data (data, &error))
         {
           /* not worth complaining in dialog about */
@@ -826,11 +886,11 @@ update_dialog (DialogData *data)
 
   /* disk / device label */
   drive = udisks_client_get_drive_for_block (gdu_window_get_client (data->window), data->block);
-  info = udisks_client_get_object_info (gdu_window_get_client (data->window), data->object);
+  info = gdu_application_get_object_info (gdu_window_get_application (data->window), data->object);
   gtk_label_set_text (GTK_LABEL (data->device_label), udisks_object_info_get_one_liner (info));
   g_free (s);
 
-  G_LOCK (bm_lock);
+  gdu_benchmark_lock (data->bm);
 
   if (data->bm_in_progress)
     {
@@ -844,33 +904,36 @@ update_dialog (DialogData *data)
       gtk_widget_hide (data->stop_benchmark_button);
     }
 
-  get_max_min_avg (data->bm_read_samples,
-                   NULL, NULL, &read_avg);
-  get_max_min_avg (data->bm_write_samples,
-                   NULL, NULL, &write_avg);
-  get_max_min_avg (data->bm_access_time_samples,
-                   NULL, NULL, &access_time_avg);
+  gdu_benchmark_get_max_min_avg (data->bm->read_samples,
+                                 data->bm->num_read_samples,
+                                 NULL, NULL, &read_avg);
+  gdu_benchmark_get_max_min_avg (data->bm->write_samples,
+                                 data->bm->num_write_samples,
+                                 NULL, NULL, &write_avg);
+  gdu_benchmark_get_max_min_avg (data->bm->access_time_samples,
+                                 data->bm->num_access_time_samples,
+                                 NULL, NULL, &access_time_avg);
 
-  G_UNLOCK (bm_lock);
+  gdu_benchmark_unlock (data->bm);
 
-  if (data->bm_sample_size == 0)
+  if (data->bm->sample_size == 0)
     s = g_strdup ("–");
   else
-    s = g_format_size_full (data->bm_sample_size, G_FORMAT_SIZE_IEC_UNITS | G_FORMAT_SIZE_LONG_FORMAT);
+    s = g_format_size_full (data->bm->sample_size, G_FORMAT_SIZE_IEC_UNITS | G_FORMAT_SIZE_LONG_FORMAT);
   gtk_label_set_markup (GTK_LABEL (data->sample_size_label), s);
   g_free (s);
 
   if (read_avg == 0.0)
     s = g_strdup ("–");
   else
-    s = format_transfer_rate_and_num_samples (read_avg, data->bm_read_samples->len);
+    s = format_transfer_rate_and_num_samples (read_avg, data->bm->num_read_samples);
   gtk_label_set_markup (GTK_LABEL (data->read_rate_label), s);
   g_free (s);
 
   if (write_avg == 0.0)
     s = g_strdup ("–");
   else
-    s = format_transfer_rate_and_num_samples (write_avg, data->bm_write_samples->len);
+    s = format_transfer_rate_and_num_samples (write_avg, data->bm->num_write_samples);
   gtk_label_set_markup (GTK_LABEL (data->write_rate_label), s);
   g_free (s);
 
@@ -887,8 +950,8 @@ update_dialog (DialogData *data)
       s3 = g_strdup_printf (g_dngettext (GETTEXT_PACKAGE,
                                          "%u sample",
                                          "%u samples",
-                                         data->bm_access_time_samples->len),
-                            data->bm_access_time_samples->len);
+                                         data->bm->num_access_time_samples),
+                            data->bm->num_access_time_samples);
       s = g_strdup_printf ("%s <small>(%s)</small>", s2, s3);
       g_free (s3);
       g_free (s2);
@@ -897,6 +960,8 @@ update_dialog (DialogData *data)
   g_free (s);
 
 
+  update_regression_infobar (data);
+
   window = gtk_widget_get_window (data->graph_drawing_area);
   if (window != NULL)
     gdk_window_invalidate_rect (window, NULL, TRUE);
@@ -917,41 +982,15 @@ on_timeout (gpointer user_data)
 
 /* ---------------------------------------------------------------------------------------------------- */
 
-static void
-samples_from_gvariant (GArray   *array,
-                       GVariant *variant)
-{
-  GVariantIter iter;
-  BMSample sample;
-
-  g_array_set_size (array, 0);
-
-  g_variant_iter_init (&iter, variant);
-  while (g_variant_iter_next (&iter, "(td)", &sample.offset, &sample.value))
-    {
-      g_array_append_val (array, sample);
-    }
-}
-
 static gboolean
 maybe_load_data (DialogData  *data,
                  GError     **error)
 {
   gboolean ret = FALSE;
   gchar *filename = NULL;
-  GVariant *value = NULL;
-  gchar *variant_data = NULL;
-  gsize variant_size;
   GError *local_error = NULL;
-  GVariant *read_samples_variant = NULL;
-  GVariant *write_samples_variant = NULL;
-  GVariant *access_time_samples_variant = NULL;
-  gint32 version;
-  gint64 timestamp_usec;
-  guint64 device_size;
-  guint64 sample_size;
-
-  filename = get_bm_filename (data);
+
+  filename = gdu_benchmark_get_filename_for_block (data->block);
   if (filename == NULL)
     {
       /* all good since we don't want to load data for this device */
@@ -959,10 +998,7 @@ maybe_load_data (DialogData  *data,
       goto out;
     }
 
-  if (!g_file_get_contents (filename,
-                            &variant_data,
-                            &variant_size,
-                            &local_error))
+  if (!gdu_benchmark_load (data->bm, filename, &local_error))
     {
       if (local_error->domain == G_FILE_ERROR && local_error->code == G_FILE_ERROR_NOENT)
         {
@@ -975,151 +1011,67 @@ maybe_load_data (DialogData  *data,
       goto out;
     }
 
-  value = g_variant_new_from_data (G_VARIANT_TYPE_VARDICT,
-                                   variant_data,
-                                   variant_size,
-                                   FALSE,
-                                   NULL, NULL);
-
-  if (!g_variant_lookup (value, "version", "i", &version))
-    {
-      g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
-                   "No version key");
-      goto out;
-    }
-  if (version != 1)
-    {
-      g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
-                   "Cannot decode version %d data", version);
-      goto out;
-    }
-
-  if (!g_variant_lookup (value, "timestamp-usec", "x", &timestamp_usec))
-    {
-      g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
-                   "No timestamp-usec");
-      goto out;
-    }
-
-  if (!g_variant_lookup (value, "device-size", "t", &device_size))
-    {
-      g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
-                   "No device-size");
-      goto out;
-    }
-
-  if (!g_variant_lookup (value, "read-samples", "@a(td)", &read_samples_variant))
-    {
-      g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
-                   "No read-samples");
-      goto out;
-    }
-
-  if (!g_variant_lookup (value, "write-samples", "@a(td)", &write_samples_variant))
-    {
-      g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
-                   "No write-samples");
-      goto out;
-    }
-
-  if (!g_variant_lookup (value, "access-time-samples", "@a(td)", &access_time_samples_variant))
-    {
-      g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
-                   "No access-time-samples");
-      goto out;
-    }
-
-  if (!g_variant_lookup (value, "sample-size", "t", &sample_size))
-    {
-      g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
-                   "No sample-size");
-      goto out;
-    }
-
-  data->bm_time_benchmarked_usec = timestamp_usec;
-  data->bm_size = device_size;
-  data->bm_sample_size = sample_size;
-  samples_from_gvariant (data->bm_read_samples, read_samples_variant);
-  samples_from_gvariant (data->bm_write_samples, write_samples_variant);
-  samples_from_gvariant (data->bm_access_time_samples, access_time_samples_variant);
-
   ret = TRUE;
 
  out:
-  if (read_samples_variant != NULL)
-    g_variant_unref (read_samples_variant);
-  if (write_samples_variant != NULL)
-    g_variant_unref (write_samples_variant);
-  if (access_time_samples_variant != NULL)
-    g_variant_unref (access_time_samples_variant);
-  if (value != NULL)
-    g_variant_unref (value);
-  g_free (variant_data);
   g_free (filename);
   return ret;
 }
 
-/* ---------------------------------------------------------------------------------------------------- */
-
-static GVariant *
-samples_to_gvariant (GArray *array)
+static void
+maybe_load_history (DialogData *data)
 {
-  guint n;
-  GVariantBuilder builder;
+  GPtrArray *history = NULL;
+  gchar *filename = NULL;
+  GError *error = NULL;
 
-  g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(td)"));
-  for (n = 0; n < array->len; n++)
+  filename = gdu_benchmark_get_history_filename_for_block (data->block);
+  if (filename != NULL)
     {
-      BMSample *s = &g_array_index (array, BMSample, n);
-      g_variant_builder_add (&builder, "(td)", s->offset, s->value);
+      history = gdu_benchmark_load_history (filename, &error);
+      if (history == NULL)
+        {
+          /* not worth complaining in dialog about */
+          g_warning ("Error loading benchmark history: %s (%s, %d)",
+                     error->message, g_quark_to_string (error->domain), error->code);
+          g_clear_error (&error);
+        }
     }
 
-  return g_variant_builder_end (&builder);
+  g_clear_pointer (&data->history, g_ptr_array_unref);
+  data->history = history;
+  g_free (filename);
 }
 
+/* ---------------------------------------------------------------------------------------------------- */
 
+/* the results file itself is written by gdu_benchmark_run() while benchmarking */
 static gboolean
 maybe_save_data (DialogData  *data,
                  GError     **error)
 {
   gboolean ret = FALSE;
-  gchar *filename = NULL;
-  GVariantBuilder builder;
-  GVariant *value = NULL;
-  gconstpointer variant_data;
-  gsize variant_size;
+  gchar *history_filename = NULL;
 
-  filename = get_bm_filename (data);
-  if (filename == NULL)
+  history_filename = gdu_benchmark_get_history_filename_for_block (data->block);
+  if (history_filename == NULL)
     {
       /* all good since we don't want to save data for this device */
       ret = TRUE;
       goto out;
     }
 
-  g_variant_builder_init (&builder, G_VARIANT_TYPE_VARDICT);
-  g_variant_builder_add (&builder, "{sv}", "version", g_variant_new_int32 (1));
-  g_variant_builder_add (&builder, "{sv}", "timestamp-usec", g_variant_new_int64 (data->bm_time_benchmarked_usec));
-  g_variant_builder_add (&builder, "{sv}", "device-size", g_variant_new_uint64 (data->bm_size));
-  g_variant_builder_add (&builder, "{sv}", "sample-size", g_variant_new_uint64 (data->bm_sample_size));
-  g_variant_builder_add (&builder, "{sv}", "read-samples", samples_to_gvariant (data->bm_read_samples));
-  g_variant_builder_add (&builder, "{sv}", "write-samples", samples_to_gvariant (data->bm_write_samples));
-  g_variant_builder_add (&builder, "{sv}", "access-time-samples", samples_to_gvariant (data->bm_access_time_samples));
-  value = g_variant_builder_end (&builder);
-
-  variant_data = g_variant_get_data (value);
-  variant_size = g_variant_get_size (value);
-
-  if (!g_file_set_contents (filename,
-                            variant_data,
-                            variant_size,
-                            error))
+  if (!gdu_benchmark_append_to_history (data->bm, history_filename, error))
     goto out;
 
+  gdu_benchmark_lock (data->bm);
+  data->bm_history_changed = TRUE;
+  gdu_benchmark_unlock (data->bm);
+
+  ret = TRUE;
+
  out:
-  if (value != NULL)
-    g_variant_unref (value);
-  g_free (filename);
+  g_free (history_filename);
   return ret;
 }
 
@@ -1131,9 +1083,9 @@ bmt_on_timeout (gpointer user_data)
 {
   DialogData *data = user_data;
   update_dialog (data);
-  G_LOCK (bm_lock);
+  gdu_benchmark_lock (data->bm);
   data->bm_update_timeout_pending = FALSE;
-  G_UNLOCK (bm_lock);
+  gdu_benchmark_unlock (data->bm);
   dialog_data_unref (data);
   return FALSE; /* don't run again */
 }
@@ -1142,7 +1094,7 @@ static void
 bmt_schedule_update (DialogData *data)
 {
   /* rate-limit updates */
-  G_LOCK (bm_lock);
+  gdu_benchmark_lock (data->bm);
   if (!data->bm_update_timeout_pending)
     {
       g_timeout_add (200, /* ms */
@@ -1150,24 +1102,24 @@ bmt_schedule_update (DialogData *data)
                      dialog_data_ref (data));
       data->bm_update_timeout_pending = TRUE;
     }
-  G_UNLOCK (bm_lock);
+  gdu_benchmark_unlock (data->bm);
+}
+
+static void
+bmt_on_sample (GduBenchmark *benchmark,
+               gpointer      user_data)
+{
+  DialogData *data = user_data;
+  bmt_schedule_update (data);
 }
 
 static gpointer
 benchmark_thread (gpointer user_data)
 {
   DialogData *data = user_data;
-  GVariant *fd_index = NULL;
-  GUnixFDList *fd_list = NULL;
   GError *error = NULL;
-  guchar *buffer_unaligned = NULL;
-  guchar *buffer = NULL;
-  GRand *rand = NULL;
+  gchar *filename = NULL;
   int fd = -1;
-  gint n;
-  long page_size;
-  guint64 disk_size;
-  GVariantBuilder options_builder;
   guint inhibit_cookie;
 
   //g_print ("bm thread start\n");
@@ -1179,289 +1131,43 @@ benchmark_thread (gpointer user_data)
                                             /* Translators: Reason why suspend/logout is being inhibited */
                                             C_("create-inhibit-message", "Benchmarking device"));
 
-  g_variant_builder_init (&options_builder, G_VARIANT_TYPE_VARDICT);
-  g_variant_builder_add (&options_builder, "{sv}", "writable", g_variant_new_boolean (data->bm_do_write));
-
-  if (!udisks_block_call_open_for_benchmark_sync (data->block,
-                                                  g_variant_builder_end (&options_builder),
-                                                  NULL, /* fd_list */
-                                                  &fd_index,
-                                                  &fd_list,
-                                                  data->bm_cancellable,
-                                                  &error))
+  fd = gdu_benchmark_open_block (data->block,
+                                 data->bm->do_write,
+                                 data->bm_cancellable,
+                                 &error);
+  if (fd == -1)
     goto out;
 
-  fd = g_unix_fd_list_get (fd_list, g_variant_get_handle (fd_index), NULL);
-  g_clear_object (&fd_list);
-
-  /* We can't use udisks_block_get_size() because the media may have
-   * changed and udisks may not have noticed. TODO: maybe have a
-   * Block.GetSize() method instead...
-   */
-  if (ioctl (fd, BLKGETSIZE64, &disk_size) != 0)
-    {
-      g_set_error (&error,
-                   G_IO_ERROR,
-                   g_io_error_from_errno (errno),
-                   C_("benchmarking", "Error getting size of device: %m"));
-      goto out;
-    }
-
-  page_size = sysconf (_SC_PAGESIZE);
-  if (page_size < 1)
-    {
-      g_set_error (&error,
-                   G_IO_ERROR,
-                   g_io_error_from_errno (errno),
-                   C_("benchmarking", "Error getting page size: %m\n"));
-      goto out;
-    }
-
-  buffer_unaligned = g_new0 (guchar, data->bm_sample_size_mib*1024*1024 + page_size);
-  buffer = (guchar*) (((gintptr) (buffer_unaligned + page_size)) & (~(page_size - 1)));
-
-  /* transfer rate... */
-  G_LOCK (bm_lock);
-  data->bm_size = disk_size;
-  data->bm_sample_size = data->bm_sample_size_mib*1024*1024;
-  data->bm_state = BM_STATE_TRANSFER_RATE;
-  G_UNLOCK (bm_lock);
-  for (n = 0; n < data->bm_num_samples; n++)
-    {
-      gchar *s, *s2;
-      gint64 begin_usec;
-      gint64 end_usec;
-      gint64 offset;
-      ssize_t num_read;
-      BMSample sample = {0};
-
-      if (g_cancellable_set_error_if_cancelled (data->bm_cancellable, &error))
-        goto out;
-
-      /* figure out offset and align to page-size */
-      offset = n * disk_size / data->bm_num_samples;
-      offset &= ~(page_size - 1);
-
-      if (lseek (fd, offset, SEEK_SET) != offset)
-        {
-          g_set_error (&error,
-                       G_IO_ERROR,
-                       g_io_error_from_errno (errno),
-                       C_("benchmarking", "Error seeking to offset %lld"),
-                       (long long int) offset);
-          goto out;
-        }
-      if (read (fd, buffer, page_size) != page_size)
-        {
-          s = g_format_size_full (page_size, G_FORMAT_SIZE_LONG_FORMAT);
-          s2 = g_format_size_full (offset, G_FORMAT_SIZE_LONG_FORMAT);
-          g_set_error (&error,
-                       G_IO_ERROR,
-                       g_io_error_from_errno (errno),
-                       C_("benchmarking", "Error pre-reading %s from offset %s"),
-                       s, s2);
-          g_free (s2);
-          g_free (s);
-          goto out;
-        }
-      if (lseek (fd, offset, SEEK_SET) != offset)
-        {
-          s = g_format_size_full (offset, G_FORMAT_SIZE_LONG_FORMAT);
-          g_set_error (&error,
-                       G_IO_ERROR,
-                       g_io_error_from_errno (errno),
-                       C_("benchmarking", "Error seeking to offset %s"),
-                       s);
-          g_free (s);
-          goto out;
-        }
-      begin_usec = g_get_monotonic_time ();
-      num_read = read (fd, buffer, data->bm_sample_size_mib*1024*1024);
-      if (G_UNLIKELY (num_read < 0))
-        {
-          s = g_format_size_full (data->bm_sample_size_mib * 1024 * 1024, G_FORMAT_SIZE_LONG_FORMAT);
-          s2 = g_format_size_full (offset, G_FORMAT_SIZE_LONG_FORMAT);
-          g_set_error (&error,
-                       G_IO_ERROR,
-                       g_io_error_from_errno (errno),
-                       C_("benchmarking", "Error reading %s from offset %s"),
-                       s, s2);
-          g_free (s2);
-          g_free (s);
-          goto out;
-        }
-      end_usec = g_get_monotonic_time ();
-
-      sample.offset = offset;
-      sample.value = ((gdouble) G_USEC_PER_SEC) * num_read / (end_usec - begin_usec);
-      G_LOCK (bm_lock);
-      g_array_append_val (data->bm_read_samples, sample);
-      G_UNLOCK (bm_lock);
-
-      bmt_schedule_update (data);
-
-      if (data->bm_do_write)
-        {
-          ssize_t num_written;
-
-          /* and now write the same block again... */
-          if (lseek (fd, offset, SEEK_SET) != offset)
-            {
-              g_set_error (&error,
-                           G_IO_ERROR,
-                           g_io_error_from_errno (errno),
-                           C_("benchmarking", "Error seeking to offset %lld"),
-                           (long long int) offset);
-              goto out;
-            }
-          if (read (fd, buffer, page_size) != page_size)
-            {
-              g_set_error (&error,
-                           G_IO_ERROR,
-                           g_io_error_from_errno (errno),
-                           C_("benchmarking", "Error pre-reading %lld bytes from offset %lld"),
-                           (long long int) page_size,
-                           (long long int) offset);
-              goto out;
-            }
-          if (lseek (fd, offset, SEEK_SET) != offset)
-            {
-              g_set_error (&error,
-                           G_IO_ERROR,
-                           g_io_error_from_errno (errno),
-                           C_("benchmarking", "Error seeking to offset %lld"),
-                           (long long int) offset);
-              goto out;
-            }
-          begin_usec = g_get_monotonic_time ();
-          num_written = write (fd, buffer, num_read);
-          if (G_UNLIKELY (num_written < 0))
-            {
-              g_set_error (&error,
-                           G_IO_ERROR,
-                           g_io_error_from_errno (errno),
-                           C_("benchmarking", "Error writing %lld bytes at offset %lld: %m"),
-                           (long long int) num_read,
-                           (long long int) offset);
-              goto out;
-            }
-          if (num_written != num_read)
-            {
-              g_set_error (&error,
-                           G_IO_ERROR,
-                           g_io_error_from_errno (errno),
-                           C_("benchmarking", "Expected to write %lld bytes, only wrote %lld: %m"),
-                           (long long int) num_read,
-                           (long long int) num_written);
-              goto out;
-            }
-          if (fsync (fd) != 0)
-            {
-              g_set_error (&error,
-                           G_IO_ERROR,
-                           g_io_error_from_errno (errno),
-                           C_("benchmarking", "Error syncing (at offset %lld): %m"),
-                           (long long int) offset);
-              goto out;
-            }
-          end_usec = g_get_monotonic_time ();
-
-          sample.offset = offset;
-          sample.value = ((gdouble) G_USEC_PER_SEC) * num_written / (end_usec - begin_usec);
-          G_LOCK (bm_lock);
-          g_array_append_val (data->bm_write_samples, sample);
-          G_UNLOCK (bm_lock);
-
-          bmt_schedule_update (data);
-        }
-    }
-
-  /* access time... */
-  G_LOCK (bm_lock);
-  data->bm_state = BM_STATE_ACCESS_TIME;
-  G_UNLOCK (bm_lock);
-  rand = g_rand_new_with_seed (42); /* want this to be deterministic (per size) so it's repeatable */
-  for (n = 0; n < data->bm_num_access_samples; n++)
-    {
-      gint64 begin_usec;
-      gint64 end_usec;
-      gint64 offset;
-      ssize_t num_read;
-      BMSample sample = {0};
-
-      if (g_cancellable_set_error_if_cancelled (data->bm_cancellable, &error))
-        goto out;
-
-      offset = (guint64) g_rand_double_range (rand, 0, (gdouble) disk_size);
-      offset &= ~(page_size - 1);
-
-      if (lseek (fd, offset, SEEK_SET) != offset)
-        {
-          g_set_error (&error,
-                       G_IO_ERROR,
-                       g_io_error_from_errno (errno),
-                       C_("benchmarking", "Error seeking to offset %lld: %m"),
-                       (long long int) offset);
-          goto out;
-        }
-
-      begin_usec = g_get_monotonic_time ();
-      num_read = read (fd, buffer, page_size);
-      if (G_UNLIKELY (num_read < 0))
-        {
-          g_set_error (&error,
-                       G_IO_ERROR,
-                       g_io_error_from_errno (errno),
-                       C_("benchmarking", "Error reading %lld bytes from offset %lld"),
-                       (long long int) page_size,
-                       (long long int) offset);
-          goto out;
-        }
-      end_usec = g_get_monotonic_time ();
-
-      sample.offset = offset;
-      sample.value = (end_usec - begin_usec) / ((gdouble) G_USEC_PER_SEC);
-      G_LOCK (bm_lock);
-      g_array_append_val (data->bm_access_time_samples, sample);
-      G_UNLOCK (bm_lock);
-
-      bmt_schedule_update (data);
-    }
+  /* NULL if we don't want to save data for this device */
+  filename = gdu_benchmark_get_filename_for_block (data->block);
+  if (!gdu_benchmark_run (data->bm,
+                          fd,
+                          filename,
+                          data->bm_cancellable,
+                          bmt_on_sample,
+                          data,
+                          &error))
+    goto out;
 
-  G_LOCK (bm_lock);
-  data->bm_time_benchmarked_usec = g_get_real_time ();
-  G_UNLOCK (bm_lock);
   if (!maybe_save_data (data, &error))
     goto out;
 
  out:
-  if (rand != NULL)
-    g_rand_free (rand);
-  g_clear_object (&fd_list);
-
-  if (fd_index != NULL)
-    g_variant_unref (fd_index);
   if (fd != -1)
     close (fd);
-  g_free (buffer_unaligned);
+  g_free (filename);
   data->bm_in_progress = FALSE;
   data->bm_thread = NULL;
-  data->bm_state = BM_STATE_NONE;
+  data->bm->state = GDU_BENCHMARK_STATE_NONE;
 
   if (inhibit_cookie > 0)
     gtk_application_uninhibit (GTK_APPLICATION (gdu_window_get_application (data->window)), inhibit_cookie);
 
   if (error != NULL)
     {
-      G_LOCK (bm_lock);
+      gdu_benchmark_lock (data->bm);
       data->bm_error = error;
-      g_array_set_size (data->bm_read_samples, 0);
-      g_array_set_size (data->bm_write_samples, 0);
-      g_array_set_size (data->bm_access_time_samples, 0);
-      data->bm_time_benchmarked_usec = 0;
-      data->bm_sample_size = 0;
-      data->bm_size = 0;
-      G_UNLOCK (bm_lock);
+      gdu_benchmark_unlock (data->bm);
     }
 
   bmt_schedule_update (data);
@@ -1482,12 +1188,9 @@ static void
 start_benchmark2 (DialogData *data)
 {
   data->bm_in_progress = TRUE;
-  data->bm_state = BM_STATE_OPENING_DEVICE;
   g_clear_error (&data->bm_error);
-  g_array_set_size (data->bm_read_samples, 0);
-  g_array_set_size (data->bm_write_samples, 0);
-  g_array_set_size (data->bm_access_time_samples, 0);
-  data->bm_time_benchmarked_usec = 0;
+  /* the previous results are shown until the first sample is in */
+  data->bm->state = GDU_BENCHMARK_STATE_OPENING_DEVICE;
   g_cancellable_reset (data->bm_cancellable);
 
   data->bm_thread = g_thread_new ("benchmark-thread",
@@ -1521,7 +1224,7 @@ start_benchmark (DialogData *data)
 
   g_assert (!data->bm_in_progress);
   g_assert (data->bm_thread == NULL);
-  g_assert_cmpint (data->bm_state, ==, BM_STATE_NONE);
+  g_assert_cmpint (data->bm->state, ==, GDU_BENCHMARK_STATE_NONE);
 
   dialog = GTK_WIDGET (gdu_application_new_widget (gdu_window_get_application (data->window),
                                                    "benchmark-dialog.ui",
@@ -1558,17 +1261,17 @@ start_benchmark (DialogData *data)
   if (response != GTK_RESPONSE_OK)
     goto out;
 
-  data->bm_num_samples = gtk_spin_button_get_value (GTK_SPIN_BUTTON (num_samples_spinbutton));
-  data->bm_sample_size_mib = gtk_spin_button_get_value (GTK_SPIN_BUTTON (sample_size_spinbutton));
-  data->bm_do_write = gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (write_checkbutton));
-  data->bm_num_access_samples = gtk_spin_button_get_value (GTK_SPIN_BUTTON (num_access_samples_spinbutton));
+  data->bm->num_samples = gtk_spin_button_get_value (GTK_SPIN_BUTTON (num_samples_spinbutton));
+  data->bm->sample_size_mib = gtk_spin_button_get_value (GTK_SPIN_BUTTON (sample_size_spinbutton));
+  data->bm->do_write = gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (write_checkbutton));
+  data->bm->num_access_samples = gtk_spin_button_get_value (GTK_SPIN_BUTTON (num_access_samples_spinbutton));
 
-  //g_print ("num_samples=%d\n", data->bm_num_samples);
-  //g_print ("sample_size=%d MB\n", data->bm_sample_size_mib);
-  //g_print ("do_write=%d\n", data->bm_do_write);
-  //g_print ("num_access_samples=%d\n", data->bm_num_access_samples);
+  //g_print ("num_samples=%d\n", data->bm->num_samples);
+  //g_print ("sample_size=%d MB\n", data->bm->sample_size_mib);
+  //g_print ("do_write=%d\n", data->bm->do_write);
+  //g_print ("num_access_samples=%d\n", data->bm->num_access_samples);
 
-  if (data->bm_do_write)
+  if (data->bm->do_write)
     {
       /* ensure the device is unused (e.g. unmounted) before formatting it... */
       gdu_window_ensure_unused (data->window,
@@ -1606,15 +1309,7 @@ gdu_benchmark_dialog_show (GduWindow    *window,
   data->window = g_object_ref (window);
   data->bm_cancellable = g_cancellable_new ();
 
-  data->bm_read_samples = g_array_new (FALSE, /* zero-terminated */
-                                       FALSE, /* clear */
-                                       sizeof (BMSample));
-  data->bm_write_samples = g_array_new (FALSE, /* zero-terminated */
-                                        FALSE, /* clear */
-                                        sizeof (BMSample));
-  data->bm_access_time_samples = g_array_new (FALSE, /* zero-terminated */
-                                              FALSE, /* clear */
-                                              sizeof (BMSample));
+  data->bm = gdu_benchmark_new ();
 
   data->dialog = GTK_WIDGET (gdu_application_new_widget (gdu_window_get_application (window),
                                                          "benchmark-dialog.ui",
@@ -1629,6 +1324,11 @@ gdu_benchmark_dialog_show (GduWindow    *window,
 
   gtk_window_set_transient_for (GTK_WINDOW (data->dialog), GTK_WINDOW (window));
 
+  data->regression_infobar = gdu_utils_create_info_bar (GTK_MESSAGE_WARNING, "", &data->regression_label);
+  gtk_box_pack_start (GTK_BOX (data->main_box), data->regression_infobar, FALSE, TRUE, 0);
+  gtk_box_reorder_child (GTK_BOX (data->main_box), data->regression_infobar, 0);
+  gtk_widget_set_no_show_all (data->regression_infobar, TRUE);
+
   data->start_benchmark_button = gtk_dialog_get_widget_for_response (GTK_DIALOG (data->dialog), 0);
   data->stop_benchmark_button = gtk_dialog_get_widget_for_response (GTK_DIALOG (data->dialog), 1);
 
@@ -1653,6 +1353,7 @@ gdu_benchmark_dialog_show (GduWindow    *window,
                  error->message, g_quark_to_string (error->domain), error->code);
       g_clear_error (&error);
     }
+  maybe_load_history (data);
 
   update_dialog (data);
 
@@ -11,6 +11,7 @@
 
 #define _GNU_SOURCE
 #include <fcntl.h>
+#include <unistd.h>
 
 #include <glib/gi18n.h>
 #include <gio/gunixfdlist.h>
@@ -20,6 +21,8 @@
 #include <glib-unix.h>
 #include <sys/ioctl.h>
 #include <linux/fs.h>
+#include <linux/cdrom.h>
+#include <scsi/sg.h>
 
 #include <canberra-gtk.h>
 
@@ -69,6 +72,7 @@ typedef struct
   GCancellable *cancellable;
   GFile *output_file;
   GFileOutputStream *output_file_stream;
+  GFile *map_file;
 
   /* must hold copy_lock when reading/writing these */
   GMutex copy_lock;
@@ -76,6 +80,7 @@ typedef struct
 
   gboolean allocating_file;
   gboolean retrieving_dvd_keys;
+  gboolean retrying_unreadable;
   guint64 num_error_bytes;
   gint64 start_time_usec;
   gint64 end_time_usec;
@@ -164,6 +169,7 @@ dialog_data_unref (DialogData *data)
 
       g_clear_object (&data->cancellable);
       g_clear_object (&data->output_file_stream);
+      g_clear_object (&data->map_file);
       g_object_unref (data->window);
       g_object_unref (data->object);
       g_object_unref (data->block);
@@ -288,7 +294,7 @@ create_disk_image_populate (DialogData *data)
                                                     FALSE);  /* allow_compressed */
 
   /* Source label */
-  info = udisks_client_get_object_info (gdu_window_get_client (data->window), data->object);
+  info = gdu_application_get_object_info (gdu_window_get_application (data->window), data->object);
   gtk_label_set_text (GTK_LABEL (data->source_label), udisks_object_info_get_one_liner (info));
   g_clear_object (&info);
 }
@@ -323,6 +329,7 @@ update_job (DialogData *data,
   guint64 bytes_per_sec = 0;
   guint64 usec_remaining = 0;
   guint64 num_error_bytes = 0;
+  gboolean retrying_unreadable = FALSE;
   gdouble progress = 0.0;
   gchar *s2, *s3;
 
@@ -334,6 +341,7 @@ update_job (DialogData *data,
       bytes_completed = gdu_estimator_get_completed_bytes (data->estimator);
       bytes_target = gdu_estimator_get_target_bytes (data->estimator);
       num_error_bytes = data->num_error_bytes;
+      retrying_unreadable = data->retrying_unreadable;
     }
   data->update_id = 0;
   g_mutex_unlock (&data->copy_lock);
@@ -350,10 +358,20 @@ update_job (DialogData *data,
   if (num_error_bytes > 0)
     {
       s2 = g_format_size (num_error_bytes);
-      /* Translators: Shown when there are read errors and we skip some data.
-       *              The first %s is the amount of unreadable data (ex. "512 kB").
-       */
-      s3 = g_strdup_printf (_("%s unreadable (replaced with zeroes)"), s2);
+      if (retrying_unreadable)
+        {
+          /* Translators: Shown while data that couldn't be read is read again.
+           *              The first %s is the amount of unreadable data (ex. "512 kB").
+           */
+          s3 = g_strdup_printf (_("Retrying %s of unreadable data"), s2);
+        }
+      else
+        {
+          /* Translators: Shown when there are read errors and we skip some data.
+           *              The first %s is the amount of unreadable data (ex. "512 kB").
+           */
+          s3 = g_strdup_printf (_("%s unreadable (replaced with zeroes)"), s2);
+        }
       /* TODO: once https://bugzilla.gnome.org/show_bug.cgi?id=657194 is resolved, use that instead
        * of hard-coding the color
        */
@@ -468,6 +486,7 @@ on_success (gpointer user_data)
       GtkWidget *dialog;
       GError *error = NULL;
       gchar *s = NULL;
+      gchar *message = NULL;
       gint response;
       gdouble percentage;
 
@@ -480,16 +499,36 @@ on_success (gpointer user_data)
                                                    _("Unrecoverable read errors while creating disk image"));
       s = g_format_size (data->num_error_bytes);
       percentage = 100.0 * ((gdouble) data->num_error_bytes) / ((gdouble) gdu_estimator_get_target_bytes (data->estimator));
-      gtk_message_dialog_format_secondary_markup (GTK_MESSAGE_DIALOG (dialog),
-                                                  /* Translators: Secondary message in dialog shown if some data was unreadable while creating a disk image.
-                                                   * The %f is the percentage of unreadable data (ex. 13.0).
-                                                   * The first %s is the amount of unreadable data (ex. "4.2 MB").
-                                                   * The second %s is the name of the device (ex "/dev/").
-                                                   */
-                                                  _("%2.1f%% (%s) of the data on the device “%s” was unreadable and replaced with zeroes in the created disk image file. This typically happens if the medium is scratched or if there is physical damage to the drive"),
-                                                  percentage,
-                                                  s,
-                                                  gtk_label_get_text (GTK_LABEL (data->source_label)));
+      message = g_strdup_printf (/* Translators: Secondary message in dialog shown if some data was unreadable while creating a disk image.
+                                  * The %f is the percentage of unreadable data (ex. 13.0).
+                                  * The first %s is the amount of unreadable data (ex. "4.2 MB").
+                                  * The second %s is the name of the device (ex "/dev/").
+                                  */
+                                 _("%2.1f%% (%s) of the data on the device “%s” was unreadable and replaced with zeroes in the created disk image file. This typically happens if the medium is scratched or if there is physical damage to the drive"),
+                                 percentage,
+                                 s,
+                                 gtk_label_get_text (GTK_LABEL (data->source_label)));
+      if (data->map_file != NULL)
+        {
+          gchar *map_name = g_file_get_basename (data->map_file);
+          gchar *escaped_map_name = g_markup_escape_text (map_name, -1);
+          gchar *map_message;
+          gchar *tmp;
+
+          map_message = g_strdup_printf (/* Translators: Appended to the secondary message in dialog shown if some data on an optical disc was unreadable while creating a disk image.
+                                          * The %s is the name of the file listing the unreadable sectors (ex. "Disc Image.iso.map").
+                                          */
+                                         _("The unreadable sectors are listed in the file “%s”."),
+                                         escaped_map_name);
+          g_free (escaped_map_name);
+          g_free (map_name);
+          tmp = message;
+          message = g_strdup_printf ("%s\n\n%s", tmp, map_message);
+          g_free (tmp);
+          g_free (map_message);
+        }
+      gtk_message_dialog_format_secondary_markup (GTK_MESSAGE_DIALOG (dialog), "%s", message);
+      g_free (message);
       gtk_dialog_add_button (GTK_DIALOG (dialog),
                              /* Translators: Label of secondary button in dialog if some data was unreadable while creating a disk image */
                              _("_Delete Disk Image File"),
@@ -508,6 +547,12 @@ on_success (gpointer user_data)
                          error->message, g_quark_to_string (error->domain), error->code);
               g_clear_error (&error);
             }
+          if (data->map_file != NULL && !g_file_delete (data->map_file, NULL, &error))
+            {
+              g_warning ("Error deleting file: %s (%s, %d)",
+                         error->message, g_quark_to_string (error->domain), error->code);
+              g_clear_error (&error);
+            }
         }
     }
 
@@ -517,11 +562,380 @@ on_success (gpointer user_data)
 
 /* ---------------------------------------------------------------------------------------------------- */
 
+/* Optical discs are imaged at the maximum read speed the drive
+ * supports. When a chunk cannot be read completely, the remainder of
+ * the chunk is read one sector at a time, bypassing the page cache with
+ * O_DIRECT - otherwise each read covers a whole page plus readahead, so
+ * a bad sector fails its neighbours too.
+ *
+ * Like ddrescue(1), this first pass tries each sector once and skips
+ * the rest of the chunk after a few unreadable sectors in a row, since
+ * a scratch rarely covers just a single sector. Once the rest of the
+ * disc is copied, the drive is slowed down and the sectors that failed
+ * or were skipped are retried with exponential backoff, again only
+ * trying the rest of a range once after a run of failures. This way a
+ * badly scratched disc doesn't take hours to image and a single scratch
+ * only costs the sectors it actually covers. Sectors that stay unreadable
+ * are recorded so a map of them can be saved next to the disk image.
+ * Afterwards the drive is set back to the read speed it had before.
+ */
+
+#define OPTICAL_SECTOR_SIZE          2048
+#define OPTICAL_NUM_RETRIES          3
+#define OPTICAL_RETRY_DELAY_USEC     (100 * G_USEC_PER_SEC / 1000)
+#define OPTICAL_MAX_BAD_IN_A_ROW     4
+#define OPTICAL_SPEED_MAX            0xffff
+#define OPTICAL_SPEED_RETRY          176    /* kB/s, i.e. 1x CD - the drive rounds to its slowest speed */
+
+typedef struct
+{
+  guint64 offset;
+  guint64 size;
+} BadRange;
+
+typedef struct
+{
+  gint direct_fd;          /* opened with O_DIRECT, -1 if that isn't supported */
+  guint saved_speed;       /* read speed in kB/s before imaging, 0 if not known */
+  GArray *pending_ranges;  /* unreadable or skipped in the first pass */
+  GArray *bad_ranges;      /* still unreadable after retrying */
+} OpticalState;
+
+/* Returns the current read speed in kB/s or 0 if the drive doesn't tell */
+static guint
+optical_get_read_speed (gint fd)
+{
+  guchar cdb[10] = {0};
+  guchar sense[32];
+  guchar buf[256];
+  sg_io_hdr_t io_hdr;
+  gsize page;
+
+  cdb[0] = 0x5a; /* MODE SENSE (10) */
+  cdb[2] = 0x2a; /* CD/DVD Capabilities and Mechanical Status page, current values */
+  cdb[7] = (sizeof (buf) >> 8) & 0xff;
+  cdb[8] = sizeof (buf) & 0xff;
+
+  memset (buf, 0, sizeof (buf));
+  memset (&io_hdr, 0, sizeof (io_hdr));
+  io_hdr.interface_id = 'S';
+  io_hdr.cmd_len = sizeof (cdb);
+  io_hdr.cmdp = cdb;
+  io_hdr.dxfer_direction = SG_DXFER_FROM_DEV;
+  io_hdr.dxferp = buf;
+  io_hdr.dxfer_len = sizeof (buf);
+  io_hdr.sbp = sense;
+  io_hdr.mx_sb_len = sizeof (sense);
+  io_hdr.timeout = 5000;
+
+  if (ioctl (fd, SG_IO, &io_hdr) != 0 ||
+      io_hdr.status != 0 || io_hdr.host_status != 0 || io_hdr.driver_status != 0)
+    return 0;
+
+  /* the page follows the mode parameter header and block descriptors, if any */
+  page = 8 + ((buf[6] << 8) | buf[7]);
+  if (page + 16 > sizeof (buf) - MAX (io_hdr.resid, 0) ||
+      (buf[page] & 0x3f) != 0x2a || buf[page + 1] < 14)
+    return 0;
+
+  /* Current Read Speed - obsolete since MMC-3 but still filled in by most drives */
+  return (buf[page + 14] << 8) | buf[page + 15];
+}
+
+/* Sets the read speed in kB/s, OPTICAL_SPEED_MAX meaning the fastest
+ * speed the drive supports.
+ */
+static gboolean
+optical_set_read_speed (gint  fd,
+                        guint speed)
+{
+  guchar cdb[12] = {0};
+  guchar sense[32];
+  sg_io_hdr_t io_hdr;
+
+  cdb[0] = 0xbb; /* SET CD SPEED */
+  cdb[2] = (speed >> 8) & 0xff;
+  cdb[3] = speed & 0xff;
+  cdb[4] = 0xff; /* leave the write speed alone */
+  cdb[5] = 0xff;
+
+  memset (&io_hdr, 0, sizeof (io_hdr));
+  io_hdr.interface_id = 'S';
+  io_hdr.cmd_len = sizeof (cdb);
+  io_hdr.cmdp = cdb;
+  io_hdr.dxfer_direction = SG_DXFER_NONE;
+  io_hdr.sbp = sense;
+  io_hdr.mx_sb_len = sizeof (sense);
+  io_hdr.timeout = 5000;
+
+  if (ioctl (fd, SG_IO, &io_hdr) == 0 &&
+      io_hdr.status == 0 && io_hdr.host_status == 0 && io_hdr.driver_status == 0)
+    return TRUE;
+
+  /* Newer kernels only let SET CD SPEED through SG_IO on file
+   * descriptors opened for writing - fall back to the cdrom driver
+   * which takes multiples of 1x CD speed with 0 meaning the maximum
+   */
+  if (ioctl (fd, CDROM_SELECT_SPEED, speed == OPTICAL_SPEED_MAX ? 0 : MAX (speed / 176, 1)) == 0)
+    return TRUE;
+
+  return FALSE;
+}
+
+static void
+optical_add_range (GArray  *ranges,
+                   guint64  offset,
+                   guint64  size)
+{
+  BadRange range;
+
+  if (ranges->len > 0)
+    {
+      BadRange *last = &g_array_index (ranges, BadRange, ranges->len - 1);
+      if (last->offset + last->size == offset)
+        {
+          last->size += size;
+          return;
+        }
+    }
+  range.offset = offset;
+  range.size = size;
+  g_array_append_val (ranges, range);
+}
+
+static gssize
+read_span (int              fd,
+           guchar          *buffer,
+           guint64          offset,
+           guint64          size,
+           GduDVDSupport   *dvd_support)
+{
+  gssize num_bytes_read;
+
+  if (dvd_support != NULL)
+    return gdu_dvd_support_read (dvd_support, fd, buffer, offset, size);
+
+  do
+    num_bytes_read = pread (fd, buffer, size, offset);
+  while (num_bytes_read < 0 && (errno == EAGAIN || errno == EINTR));
+
+  return num_bytes_read;
+}
+
+/* Reads a single sector into @buffer, which must be aligned to
+ * OPTICAL_SECTOR_SIZE, trying @num_retries more times if it fails.
+ */
+static gboolean
+optical_read_sector (OpticalState    *optical,
+                     int              fd,
+                     guchar          *buffer,
+                     guint64          offset,
+                     guint64          size,
+                     guint            num_retries,
+                     GduDVDSupport   *dvd_support,
+                     GCancellable    *cancellable,
+                     GError         **error)
+{
+  guint attempt;
+
+  for (attempt = 0; attempt <= num_retries; attempt++)
+    {
+      if (g_cancellable_set_error_if_cancelled (cancellable, error))
+        return FALSE;
+
+      if (attempt > 0)
+        g_usleep (OPTICAL_RETRY_DELAY_USEC << (attempt - 1));
+
+      if (optical->direct_fd != -1)
+        {
+          if (read_span (optical->direct_fd, buffer, offset, size, dvd_support) == (gssize) size)
+            return TRUE;
+        }
+      else
+        {
+          /* at least don't get the pages that failed before from the cache */
+          posix_fadvise (fd, offset, size, POSIX_FADV_DONTNEED);
+          if (read_span (fd, buffer, offset, size, dvd_support) == (gssize) size)
+            return TRUE;
+        }
+    }
+
+  return FALSE;
+}
+
+/* First pass over what's left of a partially read span: reads it sector
+ * by sector and skips the rest of the span after a run of unreadable
+ * sectors. Sectors that couldn't be read are replaced with zeroes and
+ * retried later, see optical_retry_pending().
+ *
+ * Returns: Number of bytes in @buffer that were actually read, -1 if cancelled.
+ */
+static gssize
+optical_rescue_span (OpticalState    *optical,
+                     int              fd,
+                     guchar          *buffer,
+                     guint64          offset,
+                     guint64          size,
+                     guint64          num_bytes_read,
+                     GduDVDSupport   *dvd_support,
+                     GCancellable    *cancellable,
+                     GError         **error)
+{
+  guint64 pos;
+  guint64 num_good = 0;
+  guint num_bad_in_a_row = 0;
+
+  /* start at the sector where the read stopped */
+  pos = num_bytes_read - num_bytes_read % OPTICAL_SECTOR_SIZE;
+  num_good = pos;
+  while (pos < size)
+    {
+      guint64 sector_size = MIN (OPTICAL_SECTOR_SIZE, size - pos);
+
+      if (optical_read_sector (optical, fd, buffer + pos, offset + pos, sector_size, 0,
+                               dvd_support, cancellable, error))
+        {
+          num_good += sector_size;
+          num_bad_in_a_row = 0;
+          pos += sector_size;
+          continue;
+        }
+      if (g_cancellable_is_cancelled (cancellable))
+        return -1;
+
+      num_bad_in_a_row++;
+      if (num_bad_in_a_row == OPTICAL_MAX_BAD_IN_A_ROW)
+        {
+          /* probably a scratch - skip ahead and come back later */
+          sector_size = size - pos;
+        }
+      memset (buffer + pos, 0, sector_size);
+      optical_add_range (optical->pending_ranges, offset + pos, sector_size);
+      pos += sector_size;
+    }
+
+  return num_good;
+}
+
+/* Retries the sectors the first pass couldn't read and writes those
+ * that can be read now to @output_stream. @buffer must be aligned to
+ * OPTICAL_SECTOR_SIZE.
+ *
+ * Returns: %FALSE if @error is set.
+ */
+static gboolean
+optical_retry_pending (OpticalState    *optical,
+                       int              fd,
+                       GOutputStream   *output_stream,
+                       guchar          *buffer,
+                       GduDVDSupport   *dvd_support,
+                       guint64         *out_num_recovered,
+                       GCancellable    *cancellable,
+                       GError         **error)
+{
+  guint n;
+
+  *out_num_recovered = 0;
+
+  optical_set_read_speed (fd, OPTICAL_SPEED_RETRY);
+
+  for (n = 0; n < optical->pending_ranges->len; n++)
+    {
+      BadRange *range = &g_array_index (optical->pending_ranges, BadRange, n);
+      guint num_bad_in_a_row = 0;
+      guint64 pos;
+
+      for (pos = 0; pos < range->size; pos += OPTICAL_SECTOR_SIZE)
+        {
+          guint64 sector_offset = range->offset + pos;
+          guint64 sector_size = MIN (OPTICAL_SECTOR_SIZE, range->size - pos);
+
+          /* after a run of failures, try the rest of the range just once */
+          if (!optical_read_sector (optical, fd, buffer, sector_offset, sector_size,
+                                    num_bad_in_a_row < OPTICAL_MAX_BAD_IN_A_ROW ? OPTICAL_NUM_RETRIES : 0,
+                                    dvd_support, cancellable, error))
+            {
+              if (g_cancellable_is_cancelled (cancellable))
+                return FALSE;
+              optical_add_range (optical->bad_ranges, sector_offset, sector_size);
+              num_bad_in_a_row++;
+              continue;
+            }
+          num_bad_in_a_row = 0;
+
+          if (!g_seekable_seek (G_SEEKABLE (output_stream), sector_offset, G_SEEK_SET, cancellable, error))
+            {
+              g_prefix_error (error,
+                              "Error seeking to offset %" G_GUINT64_FORMAT ": ",
+                              sector_offset);
+              return FALSE;
+            }
+          if (!g_output_stream_write_all (output_stream, buffer, sector_size, NULL, cancellable, error))
+            {
+              g_prefix_error (error,
+                              "Error writing %" G_GUINT64_FORMAT " bytes to offset %" G_GUINT64_FORMAT ": ",
+                              sector_size,
+                              sector_offset);
+              return FALSE;
+            }
+          *out_num_recovered += sector_size;
+        }
+    }
+
+  return TRUE;
+}
+
+/* Writes a ddrescue(1) compatible map of unreadable sectors */
+static gboolean
+optical_write_map_file (OpticalState  *optical,
+                        GFile         *map_file,
+                        guint64        device_size,
+                        GError       **error)
+{
+  GString *str;
+  guint64 pos = 0;
+  guint n;
+  gboolean ret;
+
+  str = g_string_new ("# Mapfile. Created by MATE Disks\n"
+                      "# current_pos  current_status  current_pass\n"
+                      "0x00000000     +               1\n"
+                      "#      pos        size  status\n");
+  for (n = 0; n < optical->bad_ranges->len; n++)
+    {
+      BadRange *range = &g_array_index (optical->bad_ranges, BadRange, n);
+      if (range->offset > pos)
+        g_string_append_printf (str, "0x%08" G_GINT64_MODIFIER "x  0x%08" G_GINT64_MODIFIER "x  +\n",
+                                pos, range->offset - pos);
+      g_string_append_printf (str, "0x%08" G_GINT64_MODIFIER "x  0x%08" G_GINT64_MODIFIER "x  -\n",
+                              range->offset, range->size);
+      pos = range->offset + range->size;
+    }
+  if (pos < device_size)
+    g_string_append_printf (str, "0x%08" G_GINT64_MODIFIER "x  0x%08" G_GINT64_MODIFIER "x  +\n",
+                            pos, device_size - pos);
+
+  ret = g_file_replace_contents (map_file, str->str, str->len,
+                                 NULL,  /* etag */
+                                 FALSE, /* make_backup */
+                                 G_FILE_CREATE_REPLACE_DESTINATION,
+                                 NULL,  /* new_etag */
+                                 NULL,  /* cancellable */
+                                 error);
+  g_string_free (str, TRUE);
+  return ret;
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
 /* Note that error on reading is *not* considered an error - instead 0
  * is returned.
  *
  * Error conditions include failure to seek or write to output.
  *
+ * If @optical is not %NULL, partially read spans are re-read sector by
+ * sector, see optical_rescue_span().
+ *
  * Returns: Number of bytes actually read (e.g. not include padding) -1 if @error is set.
  */
 static gssize
@@ -532,12 +946,14 @@ copy_span (int              fd,
            guchar          *buffer,
            gboolean         pad_with_zeroes,
            GduDVDSupport   *dvd_support,
+           OpticalState    *optical,
            GCancellable    *cancellable,
            GError         **error)
 {
   gint64 ret = -1;
   ssize_t num_bytes_read;
   gsize num_bytes_to_write;
+  gboolean buffer_filled = FALSE;
 
   g_return_val_if_fail (-1, buffer != NULL);
   g_return_val_if_fail (-1, G_IS_OUTPUT_STREAM (output_stream));
@@ -545,39 +961,16 @@ copy_span (int              fd,
   g_return_val_if_fail (-1, cancellable == NULL || G_IS_CANCELLABLE (cancellable));
   g_return_val_if_fail (-1, error == NULL || *error == NULL);
 
-  if (dvd_support != NULL)
-    {
-      num_bytes_read = gdu_dvd_support_read (dvd_support, fd, buffer, offset, size);
-    }
-  else
+  num_bytes_read = read_span (fd, buffer, offset, size, dvd_support);
+
+  /* EOF */
+  if (num_bytes_read == 0 && dvd_support == NULL)
     {
-      if (lseek (fd, offset, SEEK_SET) == (off_t) -1)
-        {
-          g_set_error (error,
-                       G_IO_ERROR, g_io_error_from_errno (errno),
-                       "Error seeking to offset %" G_GUINT64_FORMAT ": %s",
-                       offset, strerror (errno));
-          goto out;
-        }
-    read_again:
-      num_bytes_read = read (fd, buffer, size);
-      if (num_bytes_read < 0)
-        {
-          if (errno == EAGAIN || errno == EINTR)
-            goto read_again;
-        }
-      else
-        {
-          /* EOF */
-          if (num_bytes_read == 0)
-            {
-              g_set_error (error,
-                           G_IO_ERROR, G_IO_ERROR_FAILED,
-                           "Reading from offset %" G_GUINT64_FORMAT " returned zero bytes",
-                           offset);
-              goto out;
-            }
-        }
+      g_set_error (error,
+                   G_IO_ERROR, G_IO_ERROR_FAILED,
+                   "Reading from offset %" G_GUINT64_FORMAT " returned zero bytes",
+                   offset);
+      goto out;
     }
 
   if (num_bytes_read < 0)
@@ -586,8 +979,21 @@ copy_span (int              fd,
       num_bytes_read = 0;
     }
 
+  if (optical != NULL && (guint64) num_bytes_read < size)
+    {
+      num_bytes_read = optical_rescue_span (optical, fd, buffer, offset, size, num_bytes_read,
+                                            dvd_support, cancellable, error);
+      if (num_bytes_read < 0)
+        goto out;
+      buffer_filled = TRUE;
+    }
+
   num_bytes_to_write = num_bytes_read;
-  if (pad_with_zeroes && (guint64) num_bytes_read < size)
+  if (buffer_filled)
+    {
+      num_bytes_to_write = size;
+    }
+  else if (pad_with_zeroes && (guint64) num_bytes_read < size)
     {
       memset (buffer + num_bytes_read, 0, size - num_bytes_read);
       num_bytes_to_write = size;
@@ -633,6 +1039,7 @@ copy_thread_func (gpointer user_data)
 {
   DialogData *data = user_data;
   GduDVDSupport *dvd_support = NULL;
+  OpticalState *optical = NULL;
   guchar *buffer_unaligned = NULL;
   guchar *buffer = NULL;
   guint64 block_device_size = 0;
@@ -660,6 +1067,16 @@ copy_thread_func (gpointer user_data)
       const gchar *device_file = udisks_block_get_device (data->block);
       fd = open (device_file, O_RDONLY);
 
+      if (fd != -1)
+        {
+          optical = g_new0 (OpticalState, 1);
+          optical->direct_fd = open (device_file, O_RDONLY | O_DIRECT);
+          optical->saved_speed = optical_get_read_speed (fd);
+          optical->pending_ranges = g_array_new (FALSE, FALSE, sizeof (BadRange));
+          optical->bad_ranges = g_array_new (FALSE, FALSE, sizeof (BadRange));
+          optical_set_read_speed (fd, OPTICAL_SPEED_MAX);
+        }
+
       /* Use libdvdcss (if available on the system) on DVDs with UDF
        * filesystems - otherwise the backup process may fail because
        * of unreadable/scrambled sectors
@@ -815,6 +1232,7 @@ copy_thread_func (gpointer user_data)
                                   buffer,
                                   TRUE, /* pad_with_zeroes */
                                   dvd_support,
+                                  optical,
                                   data->cancellable,
                                   &error);
       if (num_bytes_read < 0)
@@ -835,10 +1253,73 @@ copy_thread_func (gpointer user_data)
       num_bytes_completed += num_bytes_to_read;
     }
 
+  if (optical != NULL && optical->pending_ranges->len > 0)
+    {
+      guint64 num_recovered = 0;
+
+      g_mutex_lock (&data->copy_lock);
+      data->retrying_unreadable = TRUE;
+      if (data->update_id == 0)
+        data->update_id = g_idle_add (on_update_job, dialog_data_ref (data));
+      g_mutex_unlock (&data->copy_lock);
+
+      if (!optical_retry_pending (optical,
+                                  fd,
+                                  G_OUTPUT_STREAM (data->output_file_stream),
+                                  buffer,
+                                  dvd_support,
+                                  &num_recovered,
+                                  data->cancellable,
+                                  &error))
+        goto out;
+
+      g_mutex_lock (&data->copy_lock);
+      data->retrying_unreadable = FALSE;
+      data->num_error_bytes -= num_recovered;
+      if (data->update_id == 0)
+        data->update_id = g_idle_add (on_update_job, dialog_data_ref (data));
+      g_mutex_unlock (&data->copy_lock);
+    }
+
  out:
   if (dvd_support != NULL)
     gdu_dvd_support_free (dvd_support);
 
+  if (optical != NULL)
+    {
+      if (error == NULL && optical->bad_ranges->len > 0)
+        {
+          GFile *parent = g_file_get_parent (data->output_file);
+          gchar *basename = g_file_get_basename (data->output_file);
+          gchar *map_name = g_strdup_printf ("%s.map", basename);
+          GFile *map_file = g_file_get_child (parent, map_name);
+
+          if (optical_write_map_file (optical, map_file, block_device_size, &error2))
+            {
+              g_mutex_lock (&data->copy_lock);
+              data->map_file = g_object_ref (map_file);
+              g_mutex_unlock (&data->copy_lock);
+            }
+          else
+            {
+              g_warning ("Error writing map of unreadable sectors: %s (%s, %d)",
+                         error2->message, g_quark_to_string (error2->domain), error2->code);
+              g_clear_error (&error2);
+            }
+          g_object_unref (map_file);
+          g_free (map_name);
+          g_free (basename);
+          g_object_unref (parent);
+        }
+      /* 0xffff lets the drive pick its speed, as it does before anyone sets one */
+      optical_set_read_speed (fd, optical->saved_speed > 0 ? optical->saved_speed : OPTICAL_SPEED_MAX);
+      if (optical->direct_fd != -1)
+        close (optical->direct_fd);
+      g_array_unref (optical->pending_ranges);
+      g_array_unref (optical->bad_ranges);
+      g_free (optical);
+    }
+
   data->end_time_usec = g_get_real_time ();
 
   /* in either case, close the stream */
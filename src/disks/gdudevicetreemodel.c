@@ -11,6 +11,7 @@
 
 #include "config.h"
 #include <glib/gi18n.h>
+#include <string.h>
 
 #include "gdudevicetreemodel.h"
 #include "gduapplication.h"
@@ -26,20 +27,42 @@ struct _GduDeviceTreeModel
 
   GduDeviceTreeModelFlags flags;
 
-  GList *current_drives;
+  /* object path -> GtkTreeIter* of its row - iters persist in a GtkTreeStore */
+  GHashTable *iters;
+
+  /* object path -> UDisksObject for the rows currently in the model */
+  GHashTable *current_drives;
   GtkTreeIter drive_iter;
   gboolean drive_iter_valid;
 
-  GList *current_blocks;
+  GHashTable *current_blocks;
   GtkTreeIter block_iter;
   gboolean block_iter_valid;
 
+  /* object paths of rows to add, remove or update in the next idle pass */
+  GHashTable *pending_paths;
+  guint pending_idle_id;
+
+  /* object paths of rows whose columns are computed once they are shown, see materialize_row() */
+  GHashTable *stale_paths;
+  /* object paths of computed rows with jobs running, for the spinner */
+  GHashTable *busy_paths;
+  /* object path -> casefolded text to search in, built on demand */
+  GHashTable *search_texts;
+
   guint spinner_timeout;
 
   /* "Polling Every Few Seconds" ... e.g. power state */
   guint pefs_timeout_id;
-
-  GHashTable *sort_mz;
+  gint64 pefs_next_check;  /* when pefs_timeout_id fires, g_get_monotonic_time() */
+  gboolean pefs_paused;
+  /* object path -> PowerStatePoll for drives that have been checked */
+  GHashTable *power_states;
+  /* the rows shown in the view, see GDU_DEVICE_TREE_MODEL_FLAGS_VISIBLE_RANGE */
+  GtkTreePath *visible_start;
+  GtkTreePath *visible_end;
+  /* object paths of the rows in that range, see update_visible_paths() */
+  GHashTable *visible_paths;
 };
 
 typedef struct
@@ -57,17 +80,37 @@ enum
 G_DEFINE_TYPE (GduDeviceTreeModel, gdu_device_tree_model, GTK_TYPE_TREE_STORE);
 
 static void coldplug (GduDeviceTreeModel *model);
-
-static void on_client_changed (UDisksClient  *client,
-                               gpointer       user_data);
+static void materialize_visible_rows (GduDeviceTreeModel *model);
+
+static void on_object_added (GDBusObjectManager *manager,
+                             GDBusObject        *object,
+                             gpointer            user_data);
+static void on_object_removed (GDBusObjectManager *manager,
+                               GDBusObject        *object,
+                               gpointer            user_data);
+static void on_interface_added (GDBusObjectManager *manager,
+                                GDBusObject        *object,
+                                GDBusInterface     *interface,
+                                gpointer            user_data);
+static void on_interface_removed (GDBusObjectManager *manager,
+                                  GDBusObject        *object,
+                                  GDBusInterface     *interface,
+                                  gpointer            user_data);
+static void on_interface_proxy_properties_changed (GDBusObjectManagerClient *manager,
+                                                   GDBusObjectProxy         *object_proxy,
+                                                   GDBusProxy               *interface_proxy,
+                                                   GVariant                 *changed_properties,
+                                                   const gchar *const       *invalidated_properties,
+                                                   gpointer                  user_data);
+static void on_local_jobs_changed (GduApplication *application,
+                                   UDisksObject   *object,
+                                   gpointer        user_data);
 
 static gboolean update_drive (GduDeviceTreeModel *model,
-                              UDisksObject       *object,
-                              gboolean            from_timer);
+                              UDisksObject       *object);
 
 static gboolean update_block (GduDeviceTreeModel  *model,
-                              UDisksObject        *object,
-                              gboolean             from_timer);
+                              UDisksObject        *object);
 
 
 static void
@@ -81,12 +124,27 @@ gdu_device_tree_model_finalize (GObject *object)
   if (model->spinner_timeout != 0)
     g_source_remove (model->spinner_timeout);
 
-  g_signal_handlers_disconnect_by_func (model->client,
-                                        G_CALLBACK (on_client_changed),
+  if (model->pending_idle_id != 0)
+    g_source_remove (model->pending_idle_id);
+
+  g_signal_handlers_disconnect_by_data (udisks_client_get_object_manager (model->client), model);
+  g_signal_handlers_disconnect_by_func (model->application,
+                                        G_CALLBACK (on_local_jobs_changed),
                                         model);
 
-  g_list_foreach (model->current_drives, (GFunc) g_object_unref, NULL);
-  g_list_free (model->current_drives);
+  g_hash_table_unref (model->iters);
+  g_hash_table_unref (model->current_drives);
+  g_hash_table_unref (model->current_blocks);
+  g_hash_table_unref (model->pending_paths);
+  g_hash_table_unref (model->stale_paths);
+  g_hash_table_unref (model->busy_paths);
+  g_hash_table_unref (model->search_texts);
+  g_hash_table_unref (model->power_states);
+  g_hash_table_unref (model->visible_paths);
+  if (model->visible_start != NULL)
+    gtk_tree_path_free (model->visible_start);
+  if (model->visible_end != NULL)
+    gtk_tree_path_free (model->visible_end);
 
   g_object_unref (model->application);
 
@@ -96,6 +154,15 @@ gdu_device_tree_model_finalize (GObject *object)
 static void
 gdu_device_tree_model_init (GduDeviceTreeModel *model)
 {
+  model->iters = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) gtk_tree_iter_free);
+  model->current_drives = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_object_unref);
+  model->current_blocks = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_object_unref);
+  model->pending_paths = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  model->stale_paths = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  model->busy_paths = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  model->search_texts = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+  model->visible_paths = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  model->power_states = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
 }
 
 static void
@@ -149,51 +216,24 @@ gdu_device_tree_model_set_property (GObject      *object,
 
 /* ---------------------------------------------------------------------------------------------------- */
 
-typedef struct
-{
-  UDisksObject *object;
-  const gchar *object_path;
-  GtkTreeIter iter;
-  gboolean found;
-} FindIterData;
+/* Row lookups are on the path of every update so they go through
+ * model->iters instead of walking the store
+ */
 
 static gboolean
-find_iter_for_object_cb (GtkTreeModel  *model,
-                         GtkTreePath   *path,
-                         GtkTreeIter   *iter,
-                         gpointer       user_data)
+find_iter_for_object_path (GduDeviceTreeModel *model,
+                           const gchar        *object_path,
+                           GtkTreeIter        *out_iter)
 {
-  FindIterData *data = user_data;
-  UDisksObject *iter_object;
-
-  iter_object = NULL;
-
-  gtk_tree_model_get (model,
-                      iter,
-                      GDU_DEVICE_TREE_MODEL_COLUMN_OBJECT, &iter_object,
-                      -1);
-  if (iter_object == NULL)
-    goto out;
-
-  if (iter_object == data->object)
-    {
-      data->iter = *iter;
-      data->found = TRUE;
-      goto out;
-    }
-
-  if (g_strcmp0 (g_dbus_object_get_object_path (G_DBUS_OBJECT (iter_object)), data->object_path) == 0)
-    {
-      data->iter = *iter;
-      data->found = TRUE;
-      goto out;
-    }
+  GtkTreeIter *iter;
 
+  iter = g_hash_table_lookup (model->iters, object_path);
+  if (iter == NULL)
+    return FALSE;
 
- out:
-  if (iter_object != NULL)
-    g_object_unref (iter_object);
-  return data->found;
+  if (out_iter != NULL)
+    *out_iter = *iter;
+  return TRUE;
 }
 
 static gboolean
@@ -201,21 +241,9 @@ find_iter_for_object (GduDeviceTreeModel *model,
                       UDisksObject       *object,
                       GtkTreeIter        *out_iter)
 {
-  FindIterData data;
-
-  memset (&data, 0, sizeof (data));
-  data.object = object;
-  data.found = FALSE;
-  gtk_tree_model_foreach (GTK_TREE_MODEL (model),
-                          find_iter_for_object_cb,
-                          &data);
-  if (data.found)
-    {
-      if (out_iter != NULL)
-        *out_iter = data.iter;
-    }
-
-  return data.found;
+  return find_iter_for_object_path (model,
+                                    g_dbus_object_get_object_path (G_DBUS_OBJECT (object)),
+                                    out_iter);
 }
 
 gboolean
@@ -226,88 +254,210 @@ gdu_device_tree_model_get_iter_for_object (GduDeviceTreeModel *model,
   return find_iter_for_object (model, object, iter);
 }
 
+/* Inserts a row for @object and remembers its iter */
+static void
+insert_object_row (GduDeviceTreeModel *model,
+                   UDisksObject       *object,
+                   GtkTreeIter        *parent)
+{
+  GtkTreeIter iter;
 
-#if 0
-static gboolean
-find_iter_for_object_path (GduDeviceTreeModel *model,
-                           const gchar        *object_path,
-                           GtkTreeIter        *out_iter)
+  gtk_tree_store_insert_with_values (GTK_TREE_STORE (model),
+                                     &iter,
+                                     parent,
+                                     0,
+                                     GDU_DEVICE_TREE_MODEL_COLUMN_OBJECT, object,
+                                     -1);
+  g_hash_table_insert (model->iters,
+                       g_strdup (g_dbus_object_get_object_path (G_DBUS_OBJECT (object))),
+                       gtk_tree_iter_copy (&iter));
+}
+
+static void
+remove_object_row (GduDeviceTreeModel *model,
+                   UDisksObject       *object)
 {
-  FindIterData data;
+  const gchar *object_path;
+  GtkTreeIter iter;
 
-  memset (&data, 0, sizeof (data));
-  data.object_path = object_path;
-  data.found = FALSE;
-  gtk_tree_model_foreach (GTK_TREE_MODEL (model),
-                          find_iter_for_object_cb,
-                          &data);
-  if (data.found)
+  object_path = g_dbus_object_get_object_path (G_DBUS_OBJECT (object));
+  if (!find_iter_for_object_path (model, object_path, &iter))
     {
-      if (out_iter != NULL)
-        *out_iter = data.iter;
+      g_warning ("Error finding iter for object at %s", object_path);
+      return;
     }
 
-  return data.found;
+  gtk_tree_store_remove (GTK_TREE_STORE (model), &iter);
+  g_hash_table_remove (model->iters, object_path);
+  g_hash_table_remove (model->stale_paths, object_path);
+  g_hash_table_remove (model->busy_paths, object_path);
+  g_hash_table_remove (model->search_texts, object_path);
 }
-#endif
 
 /* ---------------------------------------------------------------------------------------------------- */
 
-static void
-diff_sorted_lists (GList         *list1,
-                   GList         *list2,
-                   GCompareFunc   compare,
-                   GList        **added,
-                   GList        **removed)
+/* Drives are checked less often the longer they stay in the same power
+ * state and not at all while their rows are scrolled out of view or
+ * while polling is paused. Checks that are due at about the same time
+ * are sent together so udisksd and the drives are woken up once per
+ * round instead of once per drive.
+ *
+ * There is a single timeout for the earliest check that is due. When a
+ * single drive changes only that drive is looked at and the timeout is
+ * moved up if needed - all drives are only walked when the timeout
+ * fires or when something affecting all of them changes.
+ */
+
+#define POWER_STATE_MIN_INTERVAL   5 /* seconds */
+#define POWER_STATE_MAX_INTERVAL 120 /* seconds */
+#define POWER_STATE_BATCH_SLACK    2 /* seconds */
+
+typedef struct
 {
-  gint order;
+  guint interval;    /* seconds */
+  gint64 next_check; /* g_get_monotonic_time() */
+} PowerStatePoll;
 
-  *added = *removed = NULL;
+static void schedule_power_state_check  (GduDeviceTreeModel *model,
+                                         UDisksObject       *object);
+static void schedule_power_state_checks (GduDeviceTreeModel *model);
 
-  while (list1 != NULL &&
-         list2 != NULL)
+static PowerStatePoll *
+get_power_state_poll (GduDeviceTreeModel *model,
+                      const gchar        *object_path)
+{
+  PowerStatePoll *poll;
+
+  poll = g_hash_table_lookup (model->power_states, object_path);
+  if (poll == NULL)
     {
-      order = (*compare) (list1->data, list2->data);
-      if (order < 0)
-        {
-          *removed = g_list_prepend (*removed, list1->data);
-          list1 = list1->next;
-        }
-      else if (order > 0)
-        {
-          *added = g_list_prepend (*added, list2->data);
-          list2 = list2->next;
-        }
-      else
-        { /* same item */
-          list1 = list1->next;
-          list2 = list2->next;
-        }
+      poll = g_new0 (PowerStatePoll, 1);
+      poll->interval = POWER_STATE_MIN_INTERVAL;
+      poll->next_check = 0; /* right away */
+      g_hash_table_insert (model->power_states, g_strdup (object_path), poll);
     }
+  return poll;
+}
+
+static gboolean
+drive_has_power_state (UDisksObject *object)
+{
+  UDisksDriveAta *ata;
+
+  /* TODO: add support for other PM interfaces */
+  ata = udisks_object_peek_drive_ata (object);
+  return ata != NULL && udisks_drive_ata_get_pm_supported (ata) && udisks_drive_ata_get_pm_enabled (ata);
+}
+
+/* Without GDU_DEVICE_TREE_MODEL_FLAGS_VISIBLE_RANGE all rows are visible,
+ * otherwise only those in the range last passed to
+ * gdu_device_tree_model_set_visible_range() - none before that
+ */
+static gboolean
+row_is_visible (GduDeviceTreeModel *model,
+                const gchar        *object_path)
+{
+  if (!(model->flags & GDU_DEVICE_TREE_MODEL_FLAGS_VISIBLE_RANGE))
+    return TRUE;
+  return g_hash_table_contains (model->visible_paths, object_path);
+}
+
+/* Moves @iter and @path to the next row, depth-first */
+static gboolean
+next_row (GtkTreeModel *tree_model,
+          GtkTreeIter  *iter,
+          GtkTreePath  *path)
+{
+  GtkTreeIter tmp;
 
-  while (list1 != NULL)
+  if (gtk_tree_model_iter_children (tree_model, &tmp, iter))
     {
-      *removed = g_list_prepend (*removed, list1->data);
-      list1 = list1->next;
+      *iter = tmp;
+      gtk_tree_path_down (path);
+      return TRUE;
     }
-  while (list2 != NULL)
+
+  for (;;)
     {
-      *added = g_list_prepend (*added, list2->data);
-      list2 = list2->next;
+      tmp = *iter;
+      if (gtk_tree_model_iter_next (tree_model, &tmp))
+        {
+          *iter = tmp;
+          gtk_tree_path_next (path);
+          return TRUE;
+        }
+      if (!gtk_tree_model_iter_parent (tree_model, &tmp, iter))
+        return FALSE;
+      *iter = tmp;
+      gtk_tree_path_up (path);
     }
 }
 
-/* ---------------------------------------------------------------------------------------------------- */
-
-static gint
-_g_dbus_object_compare (GDBusObject *a,
-                        GDBusObject *b)
+/* Collects the object paths of the rows in the visible range. Walking
+ * the range keeps track of the position as it goes - asking a
+ * GtkTreeStore for the path of each row would cost O(position) per row.
+ */
+static void
+update_visible_paths (GduDeviceTreeModel *model)
 {
-  return g_strcmp0 (g_dbus_object_get_object_path (a),
-                    g_dbus_object_get_object_path (b));
+  GtkTreeModel *tree_model = GTK_TREE_MODEL (model);
+  GtkTreePath *path;
+  GtkTreeIter iter;
+  gboolean valid;
+
+  g_hash_table_remove_all (model->visible_paths);
+  if (model->visible_start == NULL || model->visible_end == NULL)
+    return;
+
+  path = gtk_tree_path_copy (model->visible_start);
+  valid = gtk_tree_model_get_iter (tree_model, &iter, path);
+  while (valid && gtk_tree_path_compare (path, model->visible_end) <= 0)
+    {
+      GDBusObject *object = NULL;
+
+      gtk_tree_model_get (tree_model,
+                          &iter,
+                          GDU_DEVICE_TREE_MODEL_COLUMN_OBJECT, &object,
+                          -1);
+      /* headers don't have an object */
+      if (object != NULL)
+        {
+          g_hash_table_add (model->visible_paths, g_strdup (g_dbus_object_get_object_path (object)));
+          g_object_unref (object);
+        }
+      valid = next_row (tree_model, &iter, path);
+    }
+  gtk_tree_path_free (path);
 }
 
-/* ---------------------------------------------------------------------------------------------------- */
+/* Returns TRUE if @object should be considered for the next round of checks */
+static gboolean
+should_check_power_state (GduDeviceTreeModel *model,
+                          UDisksObject       *object,
+                          GtkTreeIter        *iter)
+{
+  GduPowerStateFlags cur_flags = GDU_POWER_STATE_FLAGS_NONE;
+
+  if (!drive_has_power_state (object))
+    return FALSE;
+
+  if (!gdu_device_tree_model_get_iter_for_object (model, object, iter))
+    return FALSE;
+
+  /* Don't check power state if
+   *
+   *  - a check is already pending; or
+   *  - a check failed in the past
+   */
+  gtk_tree_model_get (GTK_TREE_MODEL (model),
+                      iter,
+                      GDU_DEVICE_TREE_MODEL_COLUMN_POWER_STATE_FLAGS, &cur_flags,
+                      -1);
+  if (cur_flags & GDU_POWER_STATE_FLAGS_CHECKING || cur_flags & GDU_POWER_STATE_FLAGS_FAILED)
+    return FALSE;
+
+  return row_is_visible (model, g_dbus_object_get_object_path (G_DBUS_OBJECT (object)));
+}
 
 static void
 pm_get_state_cb (GObject       *source_object,
@@ -370,80 +520,232 @@ pm_get_state_cb (GObject       *source_object,
       GtkTreeIter iter;
       if (gdu_device_tree_model_get_iter_for_object (model, UDISKS_OBJECT (object), &iter))
         {
+          GduPowerStateFlags old_flags = GDU_POWER_STATE_FLAGS_NONE;
+          PowerStatePoll *poll;
+
+          gtk_tree_model_get (GTK_TREE_MODEL (model),
+                              &iter,
+                              GDU_DEVICE_TREE_MODEL_COLUMN_POWER_STATE_FLAGS, &old_flags,
+                              -1);
+
+          /* back off while the drive stays in the same state */
+          poll = get_power_state_poll (model, g_dbus_object_get_object_path (object));
+          if ((old_flags & GDU_POWER_STATE_FLAGS_STANDBY) == (flags & GDU_POWER_STATE_FLAGS_STANDBY))
+            poll->interval = MIN (poll->interval * 2, POWER_STATE_MAX_INTERVAL);
+          else
+            poll->interval = POWER_STATE_MIN_INTERVAL;
+          poll->next_check = g_get_monotonic_time () + poll->interval * G_USEC_PER_SEC;
+
           gtk_tree_store_set (GTK_TREE_STORE (model),
                               &iter,
                               GDU_DEVICE_TREE_MODEL_COLUMN_POWER_STATE_FLAGS, flags,
                               -1);
         }
+      schedule_power_state_check (model, UDISKS_OBJECT (object));
     }
 
   g_object_unref (model);
 }
 
-
-static gboolean
-pefs_timeout_foreach_cb (GtkTreeModel  *_model,
-                         GtkTreePath   *path,
-                         GtkTreeIter   *iter,
-                         gpointer       user_data)
+static void
+check_power_state (GduDeviceTreeModel *model,
+                   UDisksObject       *object,
+                   GtkTreeIter        *iter)
 {
-  GduDeviceTreeModel *model = GDU_DEVICE_TREE_MODEL (_model);
-  UDisksObject *object = NULL;
-  UDisksDriveAta *ata = NULL;
   GduPowerStateFlags cur_flags = GDU_POWER_STATE_FLAGS_NONE;
+  GVariantBuilder options_builder;
+
+  g_variant_builder_init (&options_builder, G_VARIANT_TYPE_VARDICT);
+  g_variant_builder_add (&options_builder,
+                         "{sv}", "auth.no_user_interaction", g_variant_new_boolean (TRUE));
+  udisks_drive_ata_call_pm_get_state (udisks_object_peek_drive_ata (object),
+                                      g_variant_builder_end (&options_builder),
+                                      NULL, /* GCancellable */
+                                      pm_get_state_cb,
+                                      g_object_ref (model));
 
   gtk_tree_model_get (GTK_TREE_MODEL (model),
                       iter,
-                      GDU_DEVICE_TREE_MODEL_COLUMN_OBJECT, &object,
                       GDU_DEVICE_TREE_MODEL_COLUMN_POWER_STATE_FLAGS, &cur_flags,
                       -1);
+  cur_flags |= GDU_POWER_STATE_FLAGS_CHECKING;
+  gtk_tree_store_set (GTK_TREE_STORE (model),
+                      iter,
+                      GDU_DEVICE_TREE_MODEL_COLUMN_POWER_STATE_FLAGS, cur_flags,
+                      -1);
+}
 
-  if (object == NULL)
-    goto out;
+static gboolean
+on_pefs_timeout (gpointer user_data)
+{
+  GduDeviceTreeModel *model = GDU_DEVICE_TREE_MODEL (user_data);
+  GHashTableIter hash_iter;
+  const gchar *object_path;
+  UDisksObject *object;
+  gint64 due;
 
-  /* Don't check power state if
-   *
-   *  - a check is already pending; or
-   *  - a check failed in the past
-   */
-  if (cur_flags & GDU_POWER_STATE_FLAGS_CHECKING || cur_flags & GDU_POWER_STATE_FLAGS_FAILED)
+  model->pefs_timeout_id = 0;
+
+  /* also take the drives that are due in a moment so they share this wakeup */
+  due = g_get_monotonic_time () + POWER_STATE_BATCH_SLACK * G_USEC_PER_SEC;
+
+  g_hash_table_iter_init (&hash_iter, model->current_drives);
+  while (g_hash_table_iter_next (&hash_iter, (gpointer *) &object_path, (gpointer *) &object))
+    {
+      GtkTreeIter iter;
+      if (should_check_power_state (model, object, &iter) &&
+          get_power_state_poll (model, object_path)->next_check <= due)
+        check_power_state (model, object, &iter);
+    }
+
+  schedule_power_state_checks (model);
+
+  return FALSE; /* remove source */
+}
+
+/* Arms the timeout for @next_check unless it already fires earlier */
+static void
+arm_power_state_timeout (GduDeviceTreeModel *model,
+                         gint64              next_check)
+{
+  gint64 now;
+
+  if (model->pefs_timeout_id != 0)
+    {
+      if (model->pefs_next_check <= next_check)
+        return;
+      g_source_remove (model->pefs_timeout_id);
+    }
+
+  /* g_timeout_add_seconds() lines up with the other second timeouts in the process */
+  now = g_get_monotonic_time ();
+  model->pefs_next_check = next_check;
+  model->pefs_timeout_id = g_timeout_add_seconds (next_check > now ? (next_check - now) / G_USEC_PER_SEC : 0,
+                                                  on_pefs_timeout,
+                                                  model);
+}
+
+/* Moves the timeout up if @object is due before it */
+static void
+schedule_power_state_check (GduDeviceTreeModel *model,
+                            UDisksObject       *object)
+{
+  GtkTreeIter iter;
+
+  if (!(model->flags & GDU_DEVICE_TREE_MODEL_FLAGS_UPDATE_POWER_STATE) || model->pefs_paused)
+    return;
+
+  if (should_check_power_state (model, object, &iter))
+    arm_power_state_timeout (model,
+                             get_power_state_poll (model, g_dbus_object_get_object_path (G_DBUS_OBJECT (object)))->next_check);
+}
+
+/* Arms the timeout for when the next of all drives is due, if any */
+static void
+schedule_power_state_checks (GduDeviceTreeModel *model)
+{
+  GHashTableIter hash_iter;
+  const gchar *object_path;
+  UDisksObject *object;
+  gint64 next_check = G_MAXINT64;
+
+  if (model->pefs_timeout_id != 0)
+    {
+      g_source_remove (model->pefs_timeout_id);
+      model->pefs_timeout_id = 0;
+    }
+
+  if (!(model->flags & GDU_DEVICE_TREE_MODEL_FLAGS_UPDATE_POWER_STATE) || model->pefs_paused)
     goto out;
 
-  ata = udisks_object_peek_drive_ata (object);
-  if (ata != NULL && udisks_drive_ata_get_pm_supported (ata) && udisks_drive_ata_get_pm_enabled (ata))
+  g_hash_table_iter_init (&hash_iter, model->current_drives);
+  while (g_hash_table_iter_next (&hash_iter, (gpointer *) &object_path, (gpointer *) &object))
     {
-      GVariantBuilder options_builder;
-      g_variant_builder_init (&options_builder, G_VARIANT_TYPE_VARDICT);
-      g_variant_builder_add (&options_builder,
-                             "{sv}", "auth.no_user_interaction", g_variant_new_boolean (TRUE));
-      udisks_drive_ata_call_pm_get_state (ata,
-                                          g_variant_builder_end (&options_builder),
-                                          NULL, /* GCancellable */
-                                          pm_get_state_cb,
-                                          g_object_ref (model));
-
-      cur_flags |= GDU_POWER_STATE_FLAGS_CHECKING;
-      gtk_tree_store_set (GTK_TREE_STORE (model),
-                          iter,
-                          GDU_DEVICE_TREE_MODEL_COLUMN_POWER_STATE_FLAGS, cur_flags,
-                          -1);
+      GtkTreeIter iter;
+      if (should_check_power_state (model, object, &iter))
+        next_check = MIN (next_check, get_power_state_poll (model, object_path)->next_check);
     }
 
-  /* TODO: add support for other PM interfaces */
+  if (next_check != G_MAXINT64)
+    arm_power_state_timeout (model, next_check);
 
  out:
-  g_clear_object (&object);
-  return FALSE; /* continue iterating */
+  ;
 }
 
-static gboolean
-on_pefs_timeout (gpointer user_data)
+/**
+ * gdu_device_tree_model_set_power_state_paused:
+ * @model: A #GduDeviceTreeModel.
+ * @paused: Whether to stop checking the power state of drives.
+ *
+ * Pauses or resumes power state checks, e.g. while the view showing
+ * @model is not on screen.
+ */
+void
+gdu_device_tree_model_set_power_state_paused (GduDeviceTreeModel *model,
+                                              gboolean            paused)
 {
-  GduDeviceTreeModel *model = GDU_DEVICE_TREE_MODEL (user_data);
-  gtk_tree_model_foreach (GTK_TREE_MODEL (model),
-                          pefs_timeout_foreach_cb,
-                          NULL);
-  return TRUE; /* keep timeout around */
+  g_return_if_fail (GDU_IS_DEVICE_TREE_MODEL (model));
+
+  paused = !!paused;
+  if (model->pefs_paused == paused)
+    return;
+
+  model->pefs_paused = paused;
+  schedule_power_state_checks (model);
+}
+
+/**
+ * gdu_device_tree_model_set_visible_range:
+ * @model: A #GduDeviceTreeModel.
+ * @start_path: (allow-none): The first visible row or %NULL.
+ * @end_path: (allow-none): The last visible row or %NULL.
+ *
+ * Tells @model which rows are shown so only those rows are computed
+ * and only those drives have their power state checked. Only used if
+ * @model was created with %GDU_DEVICE_TREE_MODEL_FLAGS_VISIBLE_RANGE.
+ * Pass %NULL for both paths if no rows are shown, e.g. because the view
+ * isn't realized yet.
+ */
+void
+gdu_device_tree_model_set_visible_range (GduDeviceTreeModel *model,
+                                         GtkTreePath        *start_path,
+                                         GtkTreePath        *end_path)
+{
+  g_return_if_fail (GDU_IS_DEVICE_TREE_MODEL (model));
+
+  if (model->visible_start != NULL)
+    gtk_tree_path_free (model->visible_start);
+  if (model->visible_end != NULL)
+    gtk_tree_path_free (model->visible_end);
+  model->visible_start = start_path != NULL ? gtk_tree_path_copy (start_path) : NULL;
+  model->visible_end = end_path != NULL ? gtk_tree_path_copy (end_path) : NULL;
+
+  materialize_visible_rows (model);
+  schedule_power_state_checks (model);
+}
+
+/**
+ * gdu_device_tree_model_update_power_state:
+ * @model: A #GduDeviceTreeModel.
+ * @object: A #UDisksObject for a drive.
+ *
+ * Checks the power state of @object soon, e.g. because it was just
+ * put into standby or woken up.
+ */
+void
+gdu_device_tree_model_update_power_state (GduDeviceTreeModel *model,
+                                          UDisksObject       *object)
+{
+  PowerStatePoll *poll;
+
+  g_return_if_fail (GDU_IS_DEVICE_TREE_MODEL (model));
+  g_return_if_fail (UDISKS_IS_OBJECT (object));
+
+  poll = get_power_state_poll (model, g_dbus_object_get_object_path (G_DBUS_OBJECT (object)));
+  poll->interval = POWER_STATE_MIN_INTERVAL;
+  poll->next_check = 0;
+  schedule_power_state_check (model, object);
 }
 
 /* ---------------------------------------------------------------------------------------------------- */
@@ -452,6 +754,7 @@ static void
 gdu_device_tree_model_constructed (GObject *object)
 {
   GduDeviceTreeModel *model = GDU_DEVICE_TREE_MODEL (object);
+  GDBusObjectManager *object_manager;
   GType types[GDU_DEVICE_TREE_MODEL_N_COLUMNS];
 
   G_STATIC_ASSERT (13 == GDU_DEVICE_TREE_MODEL_N_COLUMNS);
@@ -475,17 +778,23 @@ gdu_device_tree_model_constructed (GObject *object)
 
   g_assert (gtk_tree_model_get_flags (GTK_TREE_MODEL (model)) & GTK_TREE_MODEL_ITERS_PERSIST);
 
-  g_signal_connect (model->client,
-                    "changed",
-                    G_CALLBACK (on_client_changed),
+  object_manager = udisks_client_get_object_manager (model->client);
+  g_signal_connect (object_manager, "object-added", G_CALLBACK (on_object_added), model);
+  g_signal_connect (object_manager, "object-removed", G_CALLBACK (on_object_removed), model);
+  g_signal_connect (object_manager, "interface-added", G_CALLBACK (on_interface_added), model);
+  g_signal_connect (object_manager, "interface-removed", G_CALLBACK (on_interface_removed), model);
+  g_signal_connect (object_manager,
+                    "interface-proxy-properties-changed",
+                    G_CALLBACK (on_interface_proxy_properties_changed),
+                    model);
+  g_signal_connect (model->application,
+                    "local-jobs-changed",
+                    G_CALLBACK (on_local_jobs_changed),
                     model);
   coldplug (model);
+  materialize_visible_rows (model);
 
-  if (model->flags & GDU_DEVICE_TREE_MODEL_FLAGS_UPDATE_POWER_STATE)
-    {
-      model->pefs_timeout_id = g_timeout_add_seconds (5, on_pefs_timeout, model);
-      on_pefs_timeout (model);
-    }
+  schedule_power_state_checks (model);
 
   if (model->flags & GDU_DEVICE_TREE_MODEL_FLAGS_INCLUDE_NONE_ITEM)
     {
@@ -640,34 +949,15 @@ add_drive (GduDeviceTreeModel *model,
            UDisksObject       *object,
            GtkTreeIter        *parent)
 {
-  GtkTreeIter iter;
-  gtk_tree_store_insert_with_values (GTK_TREE_STORE (model),
-                                     &iter,
-                                     parent,
-                                     0,
-                                     GDU_DEVICE_TREE_MODEL_COLUMN_OBJECT, object,
-                                     -1);
+  insert_object_row (model, object, parent);
 }
 
 static void
 remove_drive (GduDeviceTreeModel *model,
               UDisksObject       *object)
 {
-  GtkTreeIter iter;
-
-  if (!find_iter_for_object (model,
-                             object,
-                             &iter))
-    {
-      g_warning ("Error finding iter for object at %s",
-                 g_dbus_object_get_object_path (G_DBUS_OBJECT (object)));
-      goto out;
-    }
-
-  gtk_tree_store_remove (GTK_TREE_STORE (model), &iter);
-
- out:
-  ;
+  remove_object_row (model, object);
+  g_hash_table_remove (model->power_states, g_dbus_object_get_object_path (G_DBUS_OBJECT (object)));
 }
 
 /* ---------------------------------------------------------------------------------------------------- */
@@ -706,51 +996,28 @@ block_has_jobs (GduDeviceTreeModel *model,
 {
   gboolean ret = FALSE;
   GDBusObject *block_object;
-  UDisksPartitionTable *part_table = NULL;
-  UDisksEncrypted *encrypted = NULL;
-  GList *partitions = NULL, *l;
-  UDisksBlock *cleartext_block = NULL;
-
-  if (iface_has_jobs (model, G_DBUS_INTERFACE (block)))
-    {
-      ret = TRUE;
-      goto out;
-    }
+  GList *objects = NULL, *l;
 
   block_object = g_dbus_interface_get_object (G_DBUS_INTERFACE (block));
   if (block_object == NULL)
     goto out;
 
-  part_table = udisks_object_get_partition_table (UDISKS_OBJECT (block_object));
-  if (part_table != NULL)
+  /* the block device itself, its partitions and unlocked cleartext devices */
+  objects = gdu_utils_get_all_contained_objects (model->client, UDISKS_OBJECT (block_object));
+  for (l = objects; l != NULL; l = l->next)
     {
-      partitions = udisks_client_get_partitions (model->client, part_table);
-      for (l = partitions; l != NULL; l = l->next)
-        {
-          UDisksPartition *partition = UDISKS_PARTITION (l->data);
-          GDBusObject *partition_object;
-          UDisksBlock *partition_block;
+      UDisksObject *object = UDISKS_OBJECT (l->data);
 
-          partition_object = g_dbus_interface_get_object (G_DBUS_INTERFACE (partition));
-          if (partition_object != NULL)
-            {
-              partition_block = udisks_object_get_block (UDISKS_OBJECT (partition_object));
-              if (block_has_jobs (model, partition_block))
-                {
-                  ret = TRUE;
-                  goto out;
-                }
-            }
+      if (object_has_jobs (model, object))
+        {
+          ret = TRUE;
+          goto out;
         }
-    }
 
-  encrypted = udisks_object_get_encrypted (UDISKS_OBJECT (block_object));
-  if (encrypted != NULL)
-    {
-      cleartext_block = udisks_client_get_cleartext_block (model->client, block);
-      if (cleartext_block != NULL)
+      /* e.g. a partitioned cleartext device */
+      if (l != objects && udisks_object_peek_partition_table (object) != NULL)
         {
-          if (block_has_jobs (model, cleartext_block))
+          if (block_has_jobs (model, udisks_object_peek_block (object)))
             {
               ret = TRUE;
               goto out;
@@ -759,11 +1026,7 @@ block_has_jobs (GduDeviceTreeModel *model,
     }
 
  out:
-  g_clear_object (&part_table);
-  g_clear_object (&encrypted);
-  g_clear_object (&cleartext_block);
-  g_list_foreach (partitions, (GFunc) g_object_unref, NULL);
-  g_list_free (partitions);
+  g_list_free_full (objects, g_object_unref);
   return ret;
 }
 
@@ -783,7 +1046,7 @@ drive_has_jobs (GduDeviceTreeModel *model,
     }
 
   block = udisks_client_get_block_for_drive (model->client, drive, FALSE); /* get_physical */
-  if (block_has_jobs (model, block))
+  if (block != NULL && block_has_jobs (model, block))
     {
       ret = TRUE;
       goto out;
@@ -800,25 +1063,29 @@ static gboolean
 on_spinner_timeout (gpointer user_data)
 {
   GduDeviceTreeModel *model = GDU_DEVICE_TREE_MODEL (user_data);
-  GList *l;
-  gboolean keep_animating = FALSE;
+  GHashTableIter hash_iter;
+  const gchar *object_path;
 
-  for (l = model->current_drives; l != NULL; l = l->next)
+  /* whether jobs are running is picked up from events, only the spinners need to move */
+  g_hash_table_iter_init (&hash_iter, model->busy_paths);
+  while (g_hash_table_iter_next (&hash_iter, (gpointer *) &object_path, NULL))
     {
-      UDisksObject *object = UDISKS_OBJECT (l->data);
-      if (update_drive (model, object, TRUE))
-        keep_animating = TRUE;
-    }
+      GtkTreeIter iter;
+      guint pulse;
 
-  for (l = model->current_blocks; l != NULL; l = l->next)
-    {
-      UDisksObject *object = UDISKS_OBJECT (l->data);
-      if (update_block (model, object, TRUE))
-        keep_animating = TRUE;
+      if (!find_iter_for_object_path (model, object_path, &iter))
+        continue;
+      gtk_tree_model_get (GTK_TREE_MODEL (model),
+                          &iter,
+                          GDU_DEVICE_TREE_MODEL_COLUMN_PULSE, &pulse,
+                          -1);
+      gtk_tree_store_set (GTK_TREE_STORE (model),
+                          &iter,
+                          GDU_DEVICE_TREE_MODEL_COLUMN_PULSE, pulse + 1,
+                          -1);
     }
 
-
-  if (keep_animating)
+  if (g_hash_table_size (model->busy_paths) > 0)
     {
       return TRUE; /* keep source */
     }
@@ -833,8 +1100,7 @@ on_spinner_timeout (gpointer user_data)
 
 static gboolean
 update_drive (GduDeviceTreeModel *model,
-              UDisksObject       *object,
-              gboolean            from_timer)
+              UDisksObject       *object)
 {
   UDisksDrive *drive = NULL;
   UDisksDriveAta *ata = NULL;
@@ -845,7 +1111,6 @@ update_drive (GduDeviceTreeModel *model,
   gboolean warning = FALSE;
   gboolean jobs_running = FALSE;
   GtkTreeIter iter;
-  guint pulse;
   guint64 size = 0;
   GIcon *icon = NULL;
 
@@ -872,7 +1137,7 @@ update_drive (GduDeviceTreeModel *model,
   if (model->flags & GDU_DEVICE_TREE_MODEL_FLAGS_INCLUDE_DEVICE_NAME)
     included_device_name = g_strdup_printf (" (%s)", udisks_block_get_preferred_device (block));
 
-  info = udisks_client_get_object_info (model->client, object);
+  info = gdu_application_get_object_info (model->application, object);
   if (warning)
     {
       /* TODO: once https://bugzilla.gnome.org/show_bug.cgi?id=657194 is resolved, use that instead
@@ -901,13 +1166,6 @@ update_drive (GduDeviceTreeModel *model,
 
   size = udisks_drive_get_size (drive);
 
-  gtk_tree_model_get (GTK_TREE_MODEL (model),
-                      &iter,
-                      GDU_DEVICE_TREE_MODEL_COLUMN_PULSE, &pulse,
-                      -1);
-  if (from_timer)
-    pulse += 1;
-
   icon = udisks_object_info_get_media_icon (info);
   if (icon == NULL)
     icon = udisks_object_info_get_icon (info);
@@ -916,23 +1174,12 @@ update_drive (GduDeviceTreeModel *model,
                       &iter,
                       GDU_DEVICE_TREE_MODEL_COLUMN_ICON, icon,
                       GDU_DEVICE_TREE_MODEL_COLUMN_NAME, s,
-                      GDU_DEVICE_TREE_MODEL_COLUMN_SORT_KEY, udisks_object_info_get_sort_key (info),
                       GDU_DEVICE_TREE_MODEL_COLUMN_WARNING, warning,
                       GDU_DEVICE_TREE_MODEL_COLUMN_JOBS_RUNNING, jobs_running,
-                      GDU_DEVICE_TREE_MODEL_COLUMN_PULSE, pulse,
                       GDU_DEVICE_TREE_MODEL_COLUMN_SIZE, size,
                       GDU_DEVICE_TREE_MODEL_COLUMN_BLOCK, block,
                       -1);
 
-  /* update spinner, if jobs are running */
-  if (jobs_running && (model->flags & GDU_DEVICE_TREE_MODEL_FLAGS_UPDATE_PULSE))
-    {
-      if (model->spinner_timeout == 0)
-        {
-          model->spinner_timeout = g_timeout_add (SPINNER_TIMEOUT_MSEC, on_spinner_timeout, model);
-        }
-    }
-
  out:
   g_clear_object (&block);
   g_clear_object (&info);
@@ -941,73 +1188,6 @@ update_drive (GduDeviceTreeModel *model,
   return jobs_running;
 }
 
-static void
-update_drives (GduDeviceTreeModel *model)
-{
-  GDBusObjectManager *object_manager;
-  GList *objects;
-  GList *drives;
-  GList *added_drives;
-  GList *removed_drives;
-  GList *l;
-
-  object_manager = udisks_client_get_object_manager (model->client);
-  objects = g_dbus_object_manager_get_objects (object_manager);
-
-  drives = NULL;
-  for (l = objects; l != NULL; l = l->next)
-    {
-      UDisksObject *object = UDISKS_OBJECT (l->data);
-      UDisksDrive *drive;
-
-      drive = udisks_object_peek_drive (object);
-      if (drive == NULL)
-        continue;
-
-      drives = g_list_prepend (drives, g_object_ref (object));
-    }
-
-  drives = g_list_sort (drives, (GCompareFunc) _g_dbus_object_compare);
-  model->current_drives = g_list_sort (model->current_drives, (GCompareFunc) _g_dbus_object_compare);
-  diff_sorted_lists (model->current_drives,
-                     drives,
-                     (GCompareFunc) _g_dbus_object_compare,
-                     &added_drives,
-                     &removed_drives);
-
-  for (l = removed_drives; l != NULL; l = l->next)
-    {
-      UDisksObject *object = UDISKS_OBJECT (l->data);
-      g_assert (g_list_find (model->current_drives, object) != NULL);
-      model->current_drives = g_list_remove (model->current_drives, object);
-      remove_drive (model, object);
-      g_object_unref (object);
-    }
-  for (l = added_drives; l != NULL; l = l->next)
-    {
-      UDisksObject *object = UDISKS_OBJECT (l->data);
-      model->current_drives = g_list_prepend (model->current_drives, g_object_ref (object));
-      add_drive (model, object, get_drive_header_iter (model));
-    }
-
-  for (l = model->current_drives; l != NULL; l = l->next)
-    {
-      UDisksObject *object = UDISKS_OBJECT (l->data);
-      update_drive (model, object, FALSE);
-    }
-
-  if (g_list_length (model->current_drives) == 0)
-    nuke_drive_header (model);
-
-  g_list_free (added_drives);
-  g_list_free (removed_drives);
-  g_list_foreach (drives, (GFunc) g_object_unref, NULL);
-  g_list_free (drives);
-
-  g_list_foreach (objects, (GFunc) g_object_unref, NULL);
-  g_list_free (objects);
-}
-
 /* ---------------------------------------------------------------------------------------------------- */
 
 static GtkTreeIter *
@@ -1054,40 +1234,19 @@ add_block (GduDeviceTreeModel  *model,
            UDisksObject        *object,
            GtkTreeIter         *parent)
 {
-  GtkTreeIter iter;
-  gtk_tree_store_insert_with_values (GTK_TREE_STORE (model),
-                                     &iter,
-                                     parent,
-                                     0,
-                                     GDU_DEVICE_TREE_MODEL_COLUMN_OBJECT, object,
-                                     -1);
+  insert_object_row (model, object, parent);
 }
 
 static void
 remove_block (GduDeviceTreeModel  *model,
               UDisksObject        *object)
 {
-  GtkTreeIter iter;
-
-  if (!find_iter_for_object (model,
-                             object,
-                             &iter))
-    {
-      g_warning ("Error finding iter for object at %s",
-                 g_dbus_object_get_object_path (G_DBUS_OBJECT (object)));
-      goto out;
-    }
-
-  gtk_tree_store_remove (GTK_TREE_STORE (model), &iter);
-
- out:
-  ;
+  remove_object_row (model, object);
 }
 
 static gboolean
 update_block (GduDeviceTreeModel  *model,
-              UDisksObject        *object,
-              gboolean             from_timer)
+              UDisksObject        *object)
 {
   GtkTreeIter iter;
   UDisksBlock *block;
@@ -1099,7 +1258,6 @@ update_block (GduDeviceTreeModel  *model,
   guint64 size;
   gchar *size_str = NULL;
   gboolean jobs_running = FALSE;
-  guint pulse;
 
   if (!find_iter_for_object (model,
                              object,
@@ -1116,7 +1274,7 @@ update_block (GduDeviceTreeModel  *model,
   size = udisks_block_get_size (block);
   size_str = udisks_client_get_size_for_display (model->client, size, FALSE, FALSE);
 
-  info = udisks_client_get_object_info (model->client, object);
+  info = gdu_application_get_object_info (model->application, object);
 
   preferred_device = udisks_block_get_preferred_device (block);
   loop_backing_file = loop != NULL ? udisks_loop_get_backing_file (loop) : NULL;
@@ -1144,33 +1302,15 @@ update_block (GduDeviceTreeModel  *model,
 
   jobs_running = block_has_jobs (model, block);
 
-  gtk_tree_model_get (GTK_TREE_MODEL (model),
-                      &iter,
-                      GDU_DEVICE_TREE_MODEL_COLUMN_PULSE, &pulse,
-                      -1);
-  if (from_timer)
-    pulse += 1;
-
   gtk_tree_store_set (GTK_TREE_STORE (model),
                       &iter,
                       GDU_DEVICE_TREE_MODEL_COLUMN_ICON, udisks_object_info_get_icon (info),
                       GDU_DEVICE_TREE_MODEL_COLUMN_NAME, s,
-                      GDU_DEVICE_TREE_MODEL_COLUMN_SORT_KEY, udisks_object_info_get_sort_key (info),
                       GDU_DEVICE_TREE_MODEL_COLUMN_JOBS_RUNNING, jobs_running,
-                      GDU_DEVICE_TREE_MODEL_COLUMN_PULSE, pulse,
                       GDU_DEVICE_TREE_MODEL_COLUMN_SIZE, size,
                       GDU_DEVICE_TREE_MODEL_COLUMN_BLOCK, block,
                       -1);
 
-  /* update spinner, if jobs are running */
-  if (jobs_running && (model->flags & GDU_DEVICE_TREE_MODEL_FLAGS_UPDATE_PULSE))
-    {
-      if (model->spinner_timeout == 0)
-        {
-          model->spinner_timeout = g_timeout_add (SPINNER_TIMEOUT_MSEC, on_spinner_timeout, model);
-        }
-    }
-
  out:
   g_clear_object (&info);
   g_free (s);
@@ -1236,98 +1376,392 @@ should_include_block (UDisksObject *object)
   return ret;
 }
 
+/* ---------------------------------------------------------------------------------------------------- */
+
+/* Rows are cheap to add - only the sort key is computed up front. The
+ * other columns, which involve looking at jobs, partitions and SMART
+ * data, are computed once the row is in the visible range, see
+ * gdu_device_tree_model_set_visible_range(). Rows that are scrolled out
+ * of view therefore cost next to nothing when they are added or change.
+ *
+ * This happens at the end of each idle pass and when the visible range
+ * changes - never while a view is reading the model, since setting the
+ * columns emits ::row-changed.
+ */
+
+/* Marks the row for @object as out of date and updates its sort key */
 static void
-update_blocks (GduDeviceTreeModel *model)
+invalidate_row (GduDeviceTreeModel *model,
+                UDisksObject       *object)
 {
-  GDBusObjectManager *object_manager;
-  GList *objects;
-  GList *blocks;
-  GList *added_blocks;
-  GList *removed_blocks;
-  GList *l;
-
-  object_manager = udisks_client_get_object_manager (model->client);
-  objects = g_dbus_object_manager_get_objects (object_manager);
+  const gchar *object_path;
+  UDisksObjectInfo *info;
+  GtkTreeIter iter;
 
-  blocks = NULL;
-  for (l = objects; l != NULL; l = l->next)
+  object_path = g_dbus_object_get_object_path (G_DBUS_OBJECT (object));
+  if (!find_iter_for_object_path (model, object_path, &iter))
     {
-      UDisksObject *object = UDISKS_OBJECT (l->data);
-      UDisksBlock *block;
+      g_warning ("Error finding iter for object at %s", object_path);
+      return;
+    }
 
-      block = udisks_object_peek_block (object);
-      if (block == NULL)
-        continue;
+  g_hash_table_add (model->stale_paths, g_strdup (object_path));
+  g_hash_table_remove (model->busy_paths, object_path);
+  g_hash_table_remove (model->search_texts, object_path);
+
+  /* also emits ::row-changed so views showing the row ask for it again */
+  info = gdu_application_get_object_info (model->application, object);
+  gtk_tree_store_set (GTK_TREE_STORE (model),
+                      &iter,
+                      GDU_DEVICE_TREE_MODEL_COLUMN_SORT_KEY, udisks_object_info_get_sort_key (info),
+                      -1);
+  g_object_unref (info);
+}
+
+/* Computes the columns of the stale row for @object_path */
+static void
+materialize_row (GduDeviceTreeModel *model,
+                 const gchar        *object_path)
+{
+  UDisksObject *object;
+  gboolean jobs_running;
 
-      if (should_include_block (object))
-        blocks = g_list_prepend (blocks, g_object_ref (object));
+  object = g_hash_table_lookup (model->current_drives, object_path);
+  if (object != NULL)
+    {
+      jobs_running = update_drive (model, object);
+    }
+  else
+    {
+      object = g_hash_table_lookup (model->current_blocks, object_path);
+      if (object == NULL)
+        return;
+      jobs_running = update_block (model, object);
     }
 
-  blocks = g_list_sort (blocks, (GCompareFunc) _g_dbus_object_compare);
-  model->current_blocks = g_list_sort (model->current_blocks, (GCompareFunc) _g_dbus_object_compare);
-  diff_sorted_lists (model->current_blocks,
-                     blocks,
-                     (GCompareFunc) _g_dbus_object_compare,
-                     &added_blocks,
-                     &removed_blocks);
+  /* update spinner, if jobs are running */
+  if (jobs_running && (model->flags & GDU_DEVICE_TREE_MODEL_FLAGS_UPDATE_PULSE))
+    {
+      g_hash_table_add (model->busy_paths, g_strdup (object_path));
+      if (model->spinner_timeout == 0)
+        {
+          model->spinner_timeout = g_timeout_add (SPINNER_TIMEOUT_MSEC, on_spinner_timeout, model);
+        }
+    }
+}
+
+/* Computes the columns of the stale rows that are in the visible range */
+static void
+materialize_visible_rows (GduDeviceTreeModel *model)
+{
+  GHashTableIter hash_iter;
+  const gchar *object_path;
+  GPtrArray *paths;
+  guint n;
 
-  for (l = removed_blocks; l != NULL; l = l->next)
+  if (model->flags & GDU_DEVICE_TREE_MODEL_FLAGS_VISIBLE_RANGE)
+    update_visible_paths (model);
+
+  if (g_hash_table_size (model->stale_paths) == 0)
+    return;
+
+  /* updating rows must not happen while iterating over stale_paths */
+  paths = g_ptr_array_new_with_free_func (g_free);
+  if (model->flags & GDU_DEVICE_TREE_MODEL_FLAGS_VISIBLE_RANGE)
     {
-      UDisksObject *object = UDISKS_OBJECT (l->data);
+      g_hash_table_iter_init (&hash_iter, model->visible_paths);
+      while (g_hash_table_iter_next (&hash_iter, (gpointer *) &object_path, NULL))
+        {
+          if (g_hash_table_remove (model->stale_paths, object_path))
+            g_ptr_array_add (paths, g_strdup (object_path));
+        }
+    }
+  else
+    {
+      g_hash_table_iter_init (&hash_iter, model->stale_paths);
+      while (g_hash_table_iter_next (&hash_iter, (gpointer *) &object_path, NULL))
+        {
+          g_ptr_array_add (paths, g_strdup (object_path));
+          g_hash_table_iter_remove (&hash_iter);
+        }
+    }
+
+  for (n = 0; n < paths->len; n++)
+    materialize_row (model, g_ptr_array_index (paths, n));
+  g_ptr_array_unref (paths);
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+/* Instead of rescanning all objects whenever anything changes, the
+ * object manager events mark the object they are about as pending,
+ * together with the objects whose rows show something derived from
+ * it - e.g. a drive row shows whether jobs are running on any of its
+ * partitions. A single idle pass then adds, removes or updates the
+ * rows of just the pending objects. It runs at a higher priority than
+ * GTK+ relayouts and redraws so a burst of events costs one pass per
+ * frame.
+ */
 
-      g_assert (g_list_find (model->current_blocks, object) != NULL);
+/* Adds or removes the rows for @object_path depending on what the
+ * object currently looks like and refreshes them
+ */
+static void
+sync_object (GduDeviceTreeModel *model,
+             const gchar        *object_path)
+{
+  UDisksObject *object;
+  UDisksObject *current;
+  gboolean is_drive = FALSE;
+  gboolean is_block = FALSE;
 
-      model->current_blocks = g_list_remove (model->current_blocks, object);
-      remove_block (model, object);
-      g_object_unref (object);
+  object = udisks_client_peek_object (model->client, object_path);
+  if (object != NULL)
+    {
+      is_drive = (udisks_object_peek_drive (object) != NULL);
+      is_block = (udisks_object_peek_block (object) != NULL && should_include_block (object));
     }
-  for (l = added_blocks; l != NULL; l = l->next)
+
+  current = g_hash_table_lookup (model->current_drives, object_path);
+  if (current != NULL && (!is_drive || current != object))
     {
-      UDisksObject *object = UDISKS_OBJECT (l->data);
-      model->current_blocks = g_list_prepend (model->current_blocks, g_object_ref (object));
-      add_block (model, object, get_block_header_iter (model));
+      remove_drive (model, current);
+      g_hash_table_remove (model->current_drives, object_path);
+      current = NULL;
+    }
+  if (is_drive)
+    {
+      if (current == NULL)
+        {
+          add_drive (model, object, get_drive_header_iter (model));
+          g_hash_table_insert (model->current_drives, g_strdup (object_path), g_object_ref (object));
+        }
+      invalidate_row (model, object);
     }
 
-  for (l = model->current_blocks; l != NULL; l = l->next)
+  current = g_hash_table_lookup (model->current_blocks, object_path);
+  if (current != NULL && (!is_block || current != object))
     {
-      UDisksObject *object = UDISKS_OBJECT (l->data);
-      update_block (model, object, FALSE);
+      remove_block (model, current);
+      g_hash_table_remove (model->current_blocks, object_path);
+      current = NULL;
+    }
+  if (is_block)
+    {
+      if (current == NULL)
+        {
+          add_block (model, object, get_block_header_iter (model));
+          g_hash_table_insert (model->current_blocks, g_strdup (object_path), g_object_ref (object));
+        }
+      invalidate_row (model, object);
     }
+}
 
-  if (g_list_length (model->current_blocks) == 0)
+static void
+sync_headers (GduDeviceTreeModel *model)
+{
+  if (g_hash_table_size (model->current_drives) == 0)
+    nuke_drive_header (model);
+  if (g_hash_table_size (model->current_blocks) == 0)
     nuke_block_header (model);
+}
+
+static gboolean
+on_pending_idle (gpointer user_data)
+{
+  GduDeviceTreeModel *model = GDU_DEVICE_TREE_MODEL (user_data);
+  GHashTable *pending_paths;
+  GHashTableIter hash_iter;
+  const gchar *object_path;
+  UDisksObject *object;
+
+  model->pending_idle_id = 0;
+
+  /* updating rows may queue more work, that goes into a new pass */
+  pending_paths = model->pending_paths;
+  model->pending_paths = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+  g_hash_table_iter_init (&hash_iter, pending_paths);
+  while (g_hash_table_iter_next (&hash_iter, (gpointer *) &object_path, NULL))
+    sync_object (model, object_path);
+  sync_headers (model);
+  materialize_visible_rows (model);
+
+  /* the drive may be new or have changed its PM settings - drives that
+   * are gone are dropped when the timeout fires. This comes after the
+   * visible rows are known.
+   */
+  g_hash_table_iter_init (&hash_iter, pending_paths);
+  while (g_hash_table_iter_next (&hash_iter, (gpointer *) &object_path, NULL))
+    {
+      object = g_hash_table_lookup (model->current_drives, object_path);
+      if (object != NULL)
+        schedule_power_state_check (model, object);
+    }
+
+  g_hash_table_unref (pending_paths);
+  return FALSE; /* remove source */
+}
+
+/* Returns FALSE if @object_path was already pending */
+static gboolean
+queue_path (GduDeviceTreeModel *model,
+            const gchar        *object_path)
+{
+  if (object_path == NULL || g_strcmp0 (object_path, "/") == 0)
+    return FALSE;
 
-  g_list_free (added_blocks);
-  g_list_free (removed_blocks);
-  g_list_foreach (blocks, (GFunc) g_object_unref, NULL);
-  g_list_free (blocks);
+  if (!g_hash_table_add (model->pending_paths, g_strdup (object_path)))
+    return FALSE;
 
-  g_list_foreach (objects, (GFunc) g_object_unref, NULL);
-  g_list_free (objects);
+  if (model->pending_idle_id == 0)
+    model->pending_idle_id = g_idle_add_full (G_PRIORITY_HIGH_IDLE,
+                                              on_pending_idle,
+                                              model,
+                                              NULL);
+  return TRUE;
 }
 
-/* ---------------------------------------------------------------------------------------------------- */
+static void queue_object (GduDeviceTreeModel *model,
+                          UDisksObject       *object);
 
 static void
-update_all (GduDeviceTreeModel *model)
+queue_object_path (GduDeviceTreeModel *model,
+                   const gchar        *object_path)
 {
-  /* TODO: if this is CPU intensive we could coalesce all updates / schedule timeouts */
-  update_drives (model);
-  update_blocks (model);
+  UDisksObject *object;
+
+  if (object_path == NULL || g_strcmp0 (object_path, "/") == 0)
+    return;
+
+  object = udisks_client_peek_object (model->client, object_path);
+  if (object != NULL)
+    queue_object (model, object);
+  else
+    queue_path (model, object_path);
+}
+
+/* Queues @object and everything shown in rows depending on it */
+static void
+queue_object (GduDeviceTreeModel *model,
+              UDisksObject       *object)
+{
+  UDisksBlock *block;
+  UDisksPartition *partition;
+  UDisksJob *job;
+
+  if (!queue_path (model, g_dbus_object_get_object_path (G_DBUS_OBJECT (object))))
+    return;
+
+  /* drive rows show their block device, jobs on it, its partitions
+   * and what is unlocked from it
+   */
+  block = udisks_object_peek_block (object);
+  if (block != NULL)
+    {
+      queue_object_path (model, udisks_block_get_drive (block));
+      queue_object_path (model, udisks_block_get_crypto_backing_device (block));
+
+      /* ... and the other way round, the unlocked device is named after its crypto device */
+      if (udisks_object_peek_encrypted (object) != NULL)
+        {
+          UDisksBlock *cleartext_block;
+          GDBusObject *cleartext_object;
+
+          cleartext_block = udisks_client_get_cleartext_block (model->client, block);
+          if (cleartext_block != NULL)
+            {
+              cleartext_object = g_dbus_interface_get_object (G_DBUS_INTERFACE (cleartext_block));
+              if (cleartext_object != NULL)
+                queue_object (model, UDISKS_OBJECT (cleartext_object));
+              g_object_unref (cleartext_block);
+            }
+        }
+    }
+
+  partition = udisks_object_peek_partition (object);
+  if (partition != NULL)
+    queue_object_path (model, udisks_partition_get_table (partition));
+
+  job = udisks_object_peek_job (object);
+  if (job != NULL)
+    {
+      const gchar *const *job_objects;
+      guint n;
+
+      job_objects = udisks_job_get_objects (job);
+      for (n = 0; job_objects != NULL && job_objects[n] != NULL; n++)
+        queue_object_path (model, job_objects[n]);
+    }
 }
 
 static void
 coldplug (GduDeviceTreeModel *model)
 {
-  update_all (model);
+  GDBusObjectManager *object_manager;
+  GList *objects;
+  GList *l;
+
+  object_manager = udisks_client_get_object_manager (model->client);
+  objects = g_dbus_object_manager_get_objects (object_manager);
+  for (l = objects; l != NULL; l = l->next)
+    sync_object (model, g_dbus_object_get_object_path (G_DBUS_OBJECT (l->data)));
+  sync_headers (model);
+  g_list_free_full (objects, g_object_unref);
 }
 
 static void
-on_client_changed (UDisksClient  *client,
-                   gpointer       user_data)
+on_object_added (GDBusObjectManager *manager,
+                 GDBusObject        *object,
+                 gpointer            user_data)
 {
-  GduDeviceTreeModel *model = GDU_DEVICE_TREE_MODEL (user_data);
-  update_all (model);
+  queue_object (GDU_DEVICE_TREE_MODEL (user_data), UDISKS_OBJECT (object));
+}
+
+static void
+on_object_removed (GDBusObjectManager *manager,
+                   GDBusObject        *object,
+                   gpointer            user_data)
+{
+  /* the interfaces are still around so the dependencies can be queued */
+  queue_object (GDU_DEVICE_TREE_MODEL (user_data), UDISKS_OBJECT (object));
+}
+
+static void
+on_interface_added (GDBusObjectManager *manager,
+                    GDBusObject        *object,
+                    GDBusInterface     *interface,
+                    gpointer            user_data)
+{
+  queue_object (GDU_DEVICE_TREE_MODEL (user_data), UDISKS_OBJECT (object));
+}
+
+static void
+on_interface_removed (GDBusObjectManager *manager,
+                      GDBusObject        *object,
+                      GDBusInterface     *interface,
+                      gpointer            user_data)
+{
+  queue_object (GDU_DEVICE_TREE_MODEL (user_data), UDISKS_OBJECT (object));
+}
+
+static void
+on_interface_proxy_properties_changed (GDBusObjectManagerClient *manager,
+                                       GDBusObjectProxy         *object_proxy,
+                                       GDBusProxy               *interface_proxy,
+                                       GVariant                 *changed_properties,
+                                       const gchar *const       *invalidated_properties,
+                                       gpointer                  user_data)
+{
+  queue_object (GDU_DEVICE_TREE_MODEL (user_data), UDISKS_OBJECT (object_proxy));
+}
+
+static void
+on_local_jobs_changed (GduApplication *application,
+                       UDisksObject   *object,
+                       gpointer        user_data)
+{
+  queue_object (GDU_DEVICE_TREE_MODEL (user_data), object);
 }
 
 /* ---------------------------------------------------------------------------------------------------- */
@@ -1371,51 +1805,6 @@ gdu_device_tree_model_toggle_selected (GduDeviceTreeModel *model,
 
 /* ---------------------------------------------------------------------------------------------------- */
 
-/* It's pretty expensive to compute the UDisksObjectInfo on _each_
- * comparison when sorting ... so we use a simple memoization
- * technique
- */
-
-static void
-sort_begin (GduDeviceTreeModel *model)
-{
-  g_assert (model->sort_mz == NULL);
-  model->sort_mz = g_hash_table_new_full (g_direct_hash,
-                                          g_direct_equal,
-                                          g_object_unref,
-                                          g_object_unref);
-}
-
-static UDisksObjectInfo *
-sort_get_object_info (GduDeviceTreeModel *model,
-                      UDisksObject       *object)
-{
-  UDisksObjectInfo *ret;
-
-  g_assert (model->sort_mz != NULL);
-
-  ret = g_hash_table_lookup (model->sort_mz, object);
-  if (ret != NULL)
-    {
-      g_object_ref (ret);
-      goto out;
-    }
-
-  ret = udisks_client_get_object_info (model->client, object);
-  g_hash_table_insert (model->sort_mz, g_object_ref (object), g_object_ref (ret));
-
- out:
-  return ret;
-}
-
-static void
-sort_end (GduDeviceTreeModel *model)
-{
-  g_assert (model->sort_mz != NULL);
-  g_hash_table_destroy (model->sort_mz);
-  model->sort_mz = NULL;
-}
-
 static gint
 sort_func (gconstpointer a,
            gconstpointer b,
@@ -1432,14 +1821,14 @@ sort_func (gconstpointer a,
       oa = (UDisksObject *) g_dbus_interface_get_object (G_DBUS_INTERFACE (UDISKS_BLOCK (a)));
       ob = (UDisksObject *) g_dbus_interface_get_object (G_DBUS_INTERFACE (UDISKS_BLOCK (b)));
       if (oa != NULL)
-        ia = sort_get_object_info (model, oa);
+        ia = gdu_application_get_object_info (model->application, oa);
       if (ob != NULL)
-        ib = sort_get_object_info (model, ob);
+        ib = gdu_application_get_object_info (model->application, ob);
     }
   else
     {
-      ia = sort_get_object_info (model, UDISKS_OBJECT (a));
-      ib = sort_get_object_info (model, UDISKS_OBJECT (b));
+      ia = gdu_application_get_object_info (model->application, UDISKS_OBJECT (a));
+      ib = gdu_application_get_object_info (model->application, UDISKS_OBJECT (b));
     }
 
   ret = g_strcmp0 (ia != NULL ? udisks_object_info_get_sort_key (ia) : NULL,
@@ -1505,9 +1894,7 @@ gdu_device_tree_model_get_selected (GduDeviceTreeModel *model)
 
   gtk_tree_model_foreach (GTK_TREE_MODEL (model), get_selected_cb, &ret);
 
-  sort_begin (model);
   ret = g_list_sort_with_data (ret, sort_func_object, model);
-  sort_end (model);
 
   return ret;
 }
@@ -1526,8 +1913,8 @@ get_selected_blocks_cb (GtkTreeModel  *model,
 
   gtk_tree_model_get (model,
                       iter,
-                      GDU_DEVICE_TREE_MODEL_COLUMN_BLOCK, &block,
                       GDU_DEVICE_TREE_MODEL_COLUMN_SELECTED, &selected,
+                      GDU_DEVICE_TREE_MODEL_COLUMN_BLOCK, &block,
                       -1);
 
   if (selected && block != NULL)
@@ -1551,11 +1938,144 @@ gdu_device_tree_model_get_selected_blocks (GduDeviceTreeModel *model)
 
   gtk_tree_model_foreach (GTK_TREE_MODEL (model), get_selected_blocks_cb, &ret);
 
-  sort_begin (model);
   ret = g_list_sort_with_data (ret, sort_func_block, model);
-  sort_end (model);
 
   return ret;
 }
 
 /* ---------------------------------------------------------------------------------------------------- */
+
+static void
+append_search_text (GString     *str,
+                    const gchar *text)
+{
+  if (text == NULL || strlen (text) == 0)
+    return;
+  g_string_append (str, text);
+  g_string_append_c (str, '\n');
+}
+
+/* Everything a row can be looked up by, built the first time it is searched */
+static const gchar *
+get_search_text (GduDeviceTreeModel *model,
+                 UDisksObject       *object)
+{
+  const gchar *object_path;
+  const gchar *ret;
+  UDisksObjectInfo *info;
+  UDisksDrive *drive;
+  UDisksBlock *block;
+  guint64 size = 0;
+  GString *str;
+  gchar *s;
+  guint n;
+
+  object_path = g_dbus_object_get_object_path (G_DBUS_OBJECT (object));
+  ret = g_hash_table_lookup (model->search_texts, object_path);
+  if (ret != NULL)
+    goto out;
+
+  str = g_string_new (NULL);
+
+  info = gdu_application_get_object_info (model->application, object);
+  append_search_text (str, udisks_object_info_get_description (info));
+  append_search_text (str, udisks_object_info_get_name (info));
+  g_object_unref (info);
+
+  drive = udisks_object_peek_drive (object);
+  if (drive != NULL)
+    {
+      append_search_text (str, udisks_drive_get_vendor (drive));
+      append_search_text (str, udisks_drive_get_model (drive));
+      append_search_text (str, udisks_drive_get_serial (drive));
+      append_search_text (str, udisks_drive_get_wwn (drive));
+      append_search_text (str, udisks_drive_get_id (drive));
+      size = udisks_drive_get_size (drive);
+    }
+
+  block = udisks_object_peek_block (object);
+  if (block != NULL)
+    {
+      const gchar *const *symlinks;
+
+      append_search_text (str, udisks_block_get_preferred_device (block));
+      append_search_text (str, udisks_block_get_device (block));
+      append_search_text (str, udisks_block_get_id_label (block));
+      append_search_text (str, udisks_block_get_id_uuid (block));
+      /* e.g. wwn-0x5000c500a1b2c3d4 and dm-uuid-mpath-... for multipath devices */
+      symlinks = udisks_block_get_symlinks (block);
+      for (n = 0; symlinks != NULL && symlinks[n] != NULL; n++)
+        append_search_text (str, symlinks[n]);
+      size = udisks_block_get_size (block);
+    }
+
+  if (size > 0)
+    {
+      s = udisks_client_get_size_for_display (model->client, size, FALSE, TRUE);
+      append_search_text (str, s);
+      g_free (s);
+    }
+
+  s = g_utf8_casefold (str->str, -1);
+  g_string_free (str, TRUE);
+  g_hash_table_insert (model->search_texts, g_strdup (object_path), s);
+  ret = s;
+
+ out:
+  return ret;
+}
+
+/**
+ * gdu_device_tree_model_iter_matches:
+ * @model: A #GduDeviceTreeModel.
+ * @iter: A #GtkTreeIter.
+ * @key: The text to look for.
+ *
+ * Checks whether each word in @key, ignoring case, is part of the name,
+ * device file, serial number, WWN, label or size of the device at @iter.
+ *
+ * Returns: %TRUE if the row at @iter matches @key.
+ */
+gboolean
+gdu_device_tree_model_iter_matches (GduDeviceTreeModel *model,
+                                    GtkTreeIter        *iter,
+                                    const gchar        *key)
+{
+  UDisksObject *object = NULL;
+  const gchar *text;
+  gchar *key_folded = NULL;
+  gchar **words = NULL;
+  gboolean ret = FALSE;
+  guint n;
+
+  g_return_val_if_fail (GDU_IS_DEVICE_TREE_MODEL (model), FALSE);
+  g_return_val_if_fail (iter != NULL, FALSE);
+  g_return_val_if_fail (key != NULL, FALSE);
+
+  gtk_tree_model_get (GTK_TREE_MODEL (model),
+                      iter,
+                      GDU_DEVICE_TREE_MODEL_COLUMN_OBJECT, &object,
+                      -1);
+  if (object == NULL)
+    goto out;
+
+  text = get_search_text (model, object);
+
+  key_folded = g_utf8_casefold (key, -1);
+  words = g_strsplit_set (key_folded, " \t", -1);
+  ret = TRUE;
+  for (n = 0; words[n] != NULL; n++)
+    {
+      if (strlen (words[n]) > 0 && strstr (text, words[n]) == NULL)
+        {
+          ret = FALSE;
+          break;
+        }
+    }
+
+ out:
+  g_strfreev (words);
+  g_free (key_folded);
+  g_clear_object (&object);
+  return ret;
+}
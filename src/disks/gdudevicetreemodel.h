@@ -52,6 +52,17 @@ void                gdu_device_tree_model_toggle_selected     (GduDeviceTreeMode
 GList              *gdu_device_tree_model_get_selected        (GduDeviceTreeModel *model);
 GList              *gdu_device_tree_model_get_selected_blocks (GduDeviceTreeModel *model);
 
+void                gdu_device_tree_model_set_power_state_paused (GduDeviceTreeModel *model,
+                                                                  gboolean            paused);
+void                gdu_device_tree_model_set_visible_range   (GduDeviceTreeModel *model,
+                                                               GtkTreePath        *start_path,
+                                                               GtkTreePath        *end_path);
+void                gdu_device_tree_model_update_power_state  (GduDeviceTreeModel *model,
+                                                               UDisksObject       *object);
+gboolean            gdu_device_tree_model_iter_matches        (GduDeviceTreeModel *model,
+                                                               GtkTreeIter        *iter,
+                                                               const gchar        *key);
+
 
 G_END_DECLS
 
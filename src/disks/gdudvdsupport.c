@@ -12,10 +12,12 @@
 #include <gmodule.h>
 #include <glib-unix.h>
 #include <sys/ioctl.h>
+#include <unistd.h>
 #include <linux/fs.h>
 
 #include <dvdread/dvd_reader.h>
 #include <dvdread/dvd_udf.h>
+#include <dvdread/ifo_read.h>
 
 #include "gdudvdsupport.h"
 
@@ -117,21 +119,251 @@ struct GduDVDSupport
   guint num_ranges;
 
   Range *last_read_range;
+
+  /* the block libdvdcss will read next or -1 if not known */
+  gint dvdcss_block;
 };
 
 /* ---------------------------------------------------------------------------------------------------- */
 
+/* Finding the VOB files and retrieving their CSS keys can take minutes on
+ * slow drives so the resulting scrambled ranges are cached, keyed by the
+ * disc ID. The keys themselves are cached by libdvdcss (see DVDCSS_CACHE)
+ * and are retrieved on demand by gdu_dvd_support_read().
+ */
+
+#define RANGES_CACHE_VERSION 1
+
+static gchar *
+get_ranges_cache_filename (dvd_reader_t *dvd)
+{
+  gchar *ret = NULL;
+  gchar *cache_dir = NULL;
+  unsigned char disc_id[16];
+  GString *str;
+  guint n;
+
+  if (DVDDiscID (dvd, disc_id) != 0)
+    goto out;
+
+  cache_dir = g_strdup_printf ("%s/mate-disks/dvd", g_get_user_cache_dir ());
+  if (g_mkdir_with_parents (cache_dir, 0777) != 0)
+    {
+      g_warning ("Error creating directory %s: %m", cache_dir);
+      goto out;
+    }
+
+  str = g_string_new (cache_dir);
+  g_string_append_c (str, '/');
+  for (n = 0; n < sizeof disc_id; n++)
+    g_string_append_printf (str, "%02x", disc_id[n]);
+  g_string_append (str, ".ranges");
+  ret = g_string_free (str, FALSE);
+
+ out:
+  g_free (cache_dir);
+  return ret;
+}
+
+/* Returns TRUE and the scrambled ranges in @out_ranges if @filename has a usable cache */
+static gboolean
+load_ranges (const gchar  *filename,
+             guint64       device_size,
+             GList       **out_ranges)
+{
+  gboolean ret = FALSE;
+  gchar *contents = NULL;
+  gsize length;
+  GVariant *value = NULL;
+  GVariantIter *iter = NULL;
+  guint32 version;
+  guint64 start, end;
+  GList *ranges = NULL;
+
+  if (!g_file_get_contents (filename, &contents, &length, NULL))
+    goto out;
+
+  value = g_variant_new_from_data (G_VARIANT_TYPE ("(ua(tt))"), contents, length, FALSE, NULL, NULL);
+  g_variant_ref_sink (value);
+  if (!g_variant_is_normal_form (value))
+    goto out;
+
+  g_variant_get (value, "(ua(tt))", &version, &iter);
+  if (version != RANGES_CACHE_VERSION)
+    goto out;
+
+  while (g_variant_iter_next (iter, "(tt)", &start, &end))
+    {
+      Range *range;
+
+      if (start >= end || end > device_size || (start & 0x7ff) != 0 || (end & 0x7ff) != 0)
+        goto out;
+
+      range = g_new0 (Range, 1);
+      range->start = start;
+      range->end = end;
+      range->scrambled = TRUE;
+      ranges = g_list_prepend (ranges, range);
+    }
+
+  *out_ranges = g_list_reverse (ranges);
+  ranges = NULL;
+  ret = TRUE;
+
+ out:
+  g_list_free_full (ranges, g_free);
+  if (iter != NULL)
+    g_variant_iter_free (iter);
+  if (value != NULL)
+    g_variant_unref (value);
+  g_free (contents);
+  return ret;
+}
+
+static void
+save_ranges (const gchar *filename,
+             GList       *ranges)
+{
+  GVariantBuilder builder;
+  GVariant *value;
+  GError *error = NULL;
+  GList *l;
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(tt)"));
+  for (l = ranges; l != NULL; l = l->next)
+    {
+      Range *range = l->data;
+      g_variant_builder_add (&builder, "(tt)", range->start, range->end);
+    }
+  value = g_variant_new ("(ua(tt))", (guint32) RANGES_CACHE_VERSION, &builder);
+  g_variant_ref_sink (value);
+
+  if (!g_file_set_contents (filename,
+                            g_variant_get_data (value),
+                            g_variant_get_size (value),
+                            &error))
+    {
+      g_warning ("Error saving DVD ranges to %s: %s (%s, %d)",
+                 filename, error->message, g_quark_to_string (error->domain), error->code);
+      g_error_free (error);
+    }
+  g_variant_unref (value);
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+/* Looks up the given VOB file and retrieves its key, returns FALSE on error */
+static gboolean
+add_vob_range (GduDVDSupport  *support,
+               const gchar    *vob_filename,
+               gboolean       *out_found,
+               GList         **ranges)
+{
+  uint32_t vob_sector_offset;
+  uint32_t vob_size;
+  guint64 rounded_vob_size;
+  Range *range;
+
+  *out_found = FALSE;
+
+  vob_sector_offset = UDFFindFile (support->dvd, (char *) vob_filename, &vob_size);
+  if (vob_sector_offset == 0)
+    return TRUE;
+
+  *out_found = TRUE;
+
+  if (dvdcss_seek (support->dvdcss, vob_sector_offset, DVDCSS_SEEK_KEY) != (int) vob_sector_offset)
+    return FALSE;
+
+  if (vob_size == 0)
+    return TRUE;
+
+  /* round up VOB size to nearest 2048-byte sector */
+  rounded_vob_size = vob_size + 0x7ff;
+  rounded_vob_size &= ~0x7ff;
+
+  range = g_new0 (Range, 1);
+  range->start = vob_sector_offset * 2048ULL;
+  range->end = range->start + rounded_vob_size;
+  range->scrambled = TRUE;
+
+  if (G_UNLIKELY (support->debug))
+    {
+      g_print ("%s: %10" G_GUINT64_FORMAT " -> %10" G_GUINT64_FORMAT ": scrambled=%d\n",
+               vob_filename, range->start, range->end, range->scrambled);
+    }
+
+  *ranges = g_list_prepend (*ranges, range);
+  return TRUE;
+}
+
+/* Returns FALSE on error, otherwise the unsorted scrambled ranges in @out_ranges */
+static gboolean
+find_vob_ranges (GduDVDSupport  *support,
+                 GList         **out_ranges)
+{
+  GList *ranges = NULL;
+  ifo_handle_t *vmg;
+  guint num_title_sets;
+  guint title;
+  gboolean found;
+
+  /* The title sets on the disc are listed in VIDEO_TS.IFO so only
+   * those need to be looked at - if it can't be read, try them all
+   */
+  num_title_sets = 99;
+  vmg = ifoOpenVMGI (support->dvd);
+  if (vmg != NULL)
+    {
+      if (vmg->vmgi_mat != NULL && vmg->vmgi_mat->vmg_nr_of_title_sets <= 99)
+        num_title_sets = vmg->vmgi_mat->vmg_nr_of_title_sets;
+      ifoClose (vmg);
+    }
+
+  if (!add_vob_range (support, "/VIDEO_TS/VIDEO_TS.VOB", &found, &ranges))
+    goto fail;
+
+  for (title = 1; title <= num_title_sets; title++)
+    {
+      gint part;
+
+      for (part = 0; part <= 9; part++)
+        {
+          gchar vob_filename[64];
+
+          snprintf (vob_filename, sizeof vob_filename, "/VIDEO_TS/VTS_%02u_%d.VOB", title, part);
+          if (!add_vob_range (support, vob_filename, &found, &ranges))
+            goto fail;
+
+          /* VTS_NN_0.VOB (the menu) is optional but the title parts
+           * VTS_NN_1.VOB, VTS_NN_2.VOB, ... are numbered without gaps
+           */
+          if (!found && part > 0)
+            break;
+        }
+    }
+
+  *out_ranges = ranges;
+  return TRUE;
+
+ fail:
+  g_list_free_full (ranges, g_free);
+  return FALSE;
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
 GduDVDSupport *
 gdu_dvd_support_new  (const gchar *device_file,
                       guint64      device_size)
 {
   GduDVDSupport *support = NULL;
-  guint title;
   GList *scrambled_ranges = NULL;
   GList *l;
   guint64 pos;
   GArray *a;
   Range *prev_range;
+  gchar *cache_filename = NULL;
 
   /* We use dlopen() to access libdvdcss since it's normally not
    * shipped (so we can't hard-depend on it) but it may be installed
@@ -141,6 +373,7 @@ gdu_dvd_support_new  (const gchar *device_file,
     goto out;
 
   support = g_new0 (GduDVDSupport, 1);
+  support->dvdcss_block = -1;
 
   if (g_getenv ("GDU_DEBUG") != NULL)
     support->debug = TRUE;
@@ -182,61 +415,24 @@ gdu_dvd_support_new  (const gchar *device_file,
    * fact that VOB files are in a known format, e.g. title 0 is always
    * VIDEO_TS.VOB and title 1 through 99 are always of the form
    * VTS_NN_M.VOB where 01 <= N <= 99 and 0 <= M <= 9. This way we can
-   * simply use libdvdread's UDFFindFile() function on all 991
-   * possible filenames...
+   * simply use libdvdread's UDFFindFile() function on the possible
+   * filenames of the title sets listed in VIDEO_TS.IFO, see
+   * find_vob_ranges()...
    *
    * See http://en.wikipedia.org/wiki/VOB for how VOB files work.
    */
-  for (title = 0; title <= 99; title++)
+  cache_filename = get_ranges_cache_filename (support->dvd);
+  if (cache_filename != NULL && load_ranges (cache_filename, device_size, &scrambled_ranges))
     {
-      gint part;
-      Range *range;
-
-      for (part = 0; part <= 9; part++)
-        {
-          gchar vob_filename[64];
-          uint32_t vob_sector_offset;
-          uint32_t vob_size;
-          guint64 rounded_vob_size;
-
-          if (title == 0)
-            {
-              if (part > 0)
-                break;
-              snprintf (vob_filename, sizeof vob_filename, "/VIDEO_TS/VIDEO_TS.VOB");
-            }
-          else
-            {
-              snprintf (vob_filename, sizeof vob_filename, "/VIDEO_TS/VTS_%02u_%d.VOB", title, part);
-            }
-
-          vob_sector_offset = UDFFindFile (support->dvd, vob_filename, &vob_size);
-          if (vob_sector_offset == 0)
-            continue;
-
-          if (dvdcss_seek (support->dvdcss, vob_sector_offset, DVDCSS_SEEK_KEY) != (int) vob_sector_offset)
-            goto fail;
-
-          if (vob_size == 0)
-            continue;
-
-          /* round up VOB size to nearest 2048-byte sector */
-          rounded_vob_size = vob_size + 0x7ff;
-          rounded_vob_size &= ~0x7ff;
-
-          range = g_new0 (Range, 1);
-          range->start = vob_sector_offset * 2048ULL;
-          range->end = range->start + rounded_vob_size;
-          range->scrambled = TRUE;
-
-          if (G_UNLIKELY (support->debug))
-            {
-              g_print ("%s: %10" G_GUINT64_FORMAT " -> %10" G_GUINT64_FORMAT ": scrambled=%d\n",
-                       vob_filename, range->start, range->end, range->scrambled);
-            }
-
-          scrambled_ranges = g_list_prepend (scrambled_ranges, range);
-        }
+      if (G_UNLIKELY (support->debug))
+        g_print ("Using cached ranges from %s\n", cache_filename);
+    }
+  else
+    {
+      if (!find_vob_ranges (support, &scrambled_ranges))
+        goto fail;
+      if (cache_filename != NULL)
+        save_ranges (cache_filename, scrambled_ranges);
     }
 
   /* If there are no VOB files on the disc, we don't need to decrypt - just bail */
@@ -320,6 +516,7 @@ gdu_dvd_support_new  (const gchar *device_file,
 
  out:
   g_list_free_full (scrambled_ranges, g_free);
+  g_free (cache_filename);
   return support;
 
  fail:
@@ -341,6 +538,30 @@ gdu_dvd_support_free (GduDVDSupport *support)
 
 /* ---------------------------------------------------------------------------------------------------- */
 
+/* Returns the index of the range containing @offset or support->num_ranges if there is none */
+static guint
+find_range (GduDVDSupport *support,
+            guint64        offset)
+{
+  guint low = 0;
+  guint high = support->num_ranges;
+
+  /* the ranges are sorted and don't overlap */
+  while (low < high)
+    {
+      guint mid = low + (high - low) / 2;
+      Range *range = support->ranges + mid;
+
+      if (offset < range->start)
+        high = mid;
+      else if (offset >= range->end)
+        low = mid + 1;
+      else
+        return mid;
+    }
+  return support->num_ranges;
+}
+
 gssize
 gdu_dvd_support_read (GduDVDSupport *support,
                       int            fd,
@@ -369,13 +590,7 @@ gdu_dvd_support_read (GduDVDSupport *support,
     }
   else
     {
-      /* Otherwise look through all ranges, starting form the first */
-      for (n = 0; n < support->num_ranges; n++)
-        {
-          if (offset >= support->ranges[n].start &&
-              offset < support->ranges[n].end)
-            break;
-        }
+      n = find_range (support, offset);
     }
 
   /* Break the read request into multiple requests not crossing any of
@@ -431,8 +646,16 @@ gdu_dvd_support_read (GduDVDSupport *support,
               support->last_read_range = r;
             }
 
-          if (dvdcss_seek (support->dvdcss, block_offset, flags) != block_offset)
-            goto out;
+          /* no need to seek if the previous read ended here */
+          if (flags != 0 || support->dvdcss_block != block_offset)
+            {
+              if (dvdcss_seek (support->dvdcss, block_offset, flags) != block_offset)
+                {
+                  support->dvdcss_block = -1;
+                  goto out;
+                }
+              support->dvdcss_block = block_offset;
+            }
 
         dvdcss_read_again:
           num_blocks_read = dvdcss_read (support->dvdcss,
@@ -444,24 +667,25 @@ gdu_dvd_support_read (GduDVDSupport *support,
               if (errno == EAGAIN || errno == EINTR)
                 goto dvdcss_read_again;
               /* treat as partial read */
+              support->dvdcss_block = -1;
               ret = size - num_left;
               goto out;
             }
           if (num_blocks_read == 0)
             {
               /* treat as partial read */
+              support->dvdcss_block = -1;
               ret = size - num_left;
               goto out;
             }
           g_assert (num_blocks_read <= num_blocks_to_request);
+          support->dvdcss_block += num_blocks_read;
           num_bytes_read = num_blocks_read * 2048;
         }
       else
         {
-          if (lseek (fd, cur_offset, SEEK_SET) == (off_t) -1)
-            goto out;
         read_again:
-          num_bytes_read = read (fd, cur_buffer, num_to_read_in_range);
+          num_bytes_read = pread (fd, cur_buffer, num_to_read_in_range, cur_offset);
           if (num_bytes_read < 0)
             {
               if (errno == EAGAIN || errno == EINTR)
@@ -39,8 +39,58 @@ typedef enum
   GDU_DEVICE_TREE_MODEL_FLAGS_ONE_LINE_NAME       = (1<<3),
   GDU_DEVICE_TREE_MODEL_FLAGS_INCLUDE_DEVICE_NAME = (1<<4),
   GDU_DEVICE_TREE_MODEL_FLAGS_INCLUDE_NONE_ITEM   = (1<<5),
+  GDU_DEVICE_TREE_MODEL_FLAGS_VISIBLE_RANGE       = (1<<6),
 } GduDeviceTreeModelFlags;
 
+typedef enum
+{
+  GDU_BENCHMARK_STATE_NONE,
+  GDU_BENCHMARK_STATE_OPENING_DEVICE,
+  GDU_BENCHMARK_STATE_TRANSFER_RATE,
+  GDU_BENCHMARK_STATE_ACCESS_TIME
+} GduBenchmarkState;
+
+typedef enum
+{
+  GDU_FILESYSTEM_BENCHMARK_STATE_NONE,
+  GDU_FILESYSTEM_BENCHMARK_STATE_PREPARING,
+  GDU_FILESYSTEM_BENCHMARK_STATE_DIRECT,
+  GDU_FILESYSTEM_BENCHMARK_STATE_BUFFERED,
+  GDU_FILESYSTEM_BENCHMARK_STATE_RANDOM_WRITES,
+  GDU_FILESYSTEM_BENCHMARK_STATE_CREATING_FILES,
+  GDU_FILESYSTEM_BENCHMARK_STATE_DELETING_FILES
+} GduFilesystemBenchmarkState;
+
+typedef enum
+{
+  GDU_BENCHMARK_REGRESSION_FLAGS_NONE         = 0,
+  GDU_BENCHMARK_REGRESSION_FLAGS_READ_RATE    = (1<<0),
+  GDU_BENCHMARK_REGRESSION_FLAGS_WRITE_RATE   = (1<<1),
+  GDU_BENCHMARK_REGRESSION_FLAGS_ACCESS_TIME  = (1<<2)
+} GduBenchmarkRegressionFlags;
+
+typedef enum
+{
+  GDU_SMART_TREND_REALLOCATED_SECTORS,
+  GDU_SMART_TREND_PENDING_SECTORS,
+  GDU_SMART_TREND_TEMPERATURE,
+  GDU_SMART_TREND_POWER_ON_HOURS,
+  GDU_SMART_TREND_PERCENTAGE_USED,
+  GDU_SMART_TREND_MEDIA_ERRORS,
+  GDU_SMART_TREND_THERMAL_THROTTLE,
+  GDU_SMART_TREND_DATA_WRITTEN
+} GduSmartTrend;
+
+typedef enum
+{
+  GDU_ERASE_METHOD_NONE,
+  GDU_ERASE_METHOD_ZERO,
+  GDU_ERASE_METHOD_DISCARD,
+  GDU_ERASE_METHOD_ATA_SECURE_ERASE,
+  GDU_ERASE_METHOD_ATA_SECURE_ERASE_ENHANCED,
+  GDU_ERASE_METHOD_NVME_SANITIZE
+} GduEraseMethod;
+
 G_END_DECLS
 
 #endif /* __GDU_ENUMS_H__ */
@@ -0,0 +1,915 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*-
+ *
+ * Copyright (C) 2008-2013 Red Hat, Inc.
+ *
+ * Licensed under GPL version 2 or later.
+ *
+ * Author: David Zeuthen <zeuthen@gmail.com>
+ */
+
+#include "config.h"
+
+#include <glib/gi18n.h>
+#include <gio/gunixfdlist.h>
+
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "gduerase.h"
+#include "gdubenchmark.h"
+#include "gduestimator.h"
+
+/* Erase methods are either carried out by udisks, as part of the
+ * Format() method or by the drive itself, or locally on a file
+ * descriptor obtained from udisks. Either way the result can be checked
+ * by reading back samples from random offsets. A zero-filled device must
+ * read back zeroes and every sample of a discarded device must at least
+ * consist of a single repeated byte, as the firmware may fill discarded
+ * blocks with a pattern other than zeroes. Whether it does is up to the
+ * disk, so discarding is always checked.
+ *
+ * For the commands carried out by the drive the completion status is
+ * all there is - a self-encrypting drive only replaces its key and the
+ * old data reads back as noise - so only reading the samples has to
+ * succeed.
+ */
+
+/* discard and zero out in chunks so progress can be reported and
+ * cancellation noticed
+ */
+#define DISCARD_CHUNK_SIZE (1024ULL * 1024 * 1024)
+#define ZERO_OUT_CHUNK_SIZE (256ULL * 1024 * 1024)
+
+/* size of each write when the disk can't zero out blocks itself */
+#define ZERO_BUFFER_SIZE (8 * 1024 * 1024)
+
+/* Neither the kernel nor the disk tell how long discarding takes, so
+ * the estimate is a rough heuristic rather than a measurement: a fixed
+ * cost per discard request - a TRIM or Deallocate command usually
+ * completes within a few milliseconds, the erase of an eMMC or SD erase
+ * group can take longer - plus the cost of updating the flash
+ * translation layer for each unit of discard_granularity. It is only
+ * shown as an approximation, see populate_erase_combobox() in
+ * gduformatdiskdialog.c.
+ */
+#define DISCARD_REQUEST_USEC 2000
+#define DISCARD_GRANULE_NSEC 20
+
+#define VERIFY_NUM_SAMPLES 64
+#define VERIFY_SAMPLE_SIZE (1024 * 1024)
+
+typedef struct
+{
+  UDisksBlock *block;
+  GduEraseMethod method;
+  gboolean erase;   /* FALSE to only verify */
+  gboolean verify;
+  GduEraseProgressFunc progress_func;
+  gpointer progress_data;
+
+  /* only used on the erase thread */
+  GduEstimator *estimator;
+  gint64 last_update_usec;
+} EraseData;
+
+static void
+erase_data_free (EraseData *data)
+{
+  g_object_unref (data->block);
+  g_clear_object (&data->estimator);
+  g_free (data);
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+const gchar *
+gdu_erase_method_get_name (GduEraseMethod method)
+{
+  switch (method)
+    {
+    case GDU_ERASE_METHOD_NONE:
+      return _("Don’t overwrite existing data");
+    case GDU_ERASE_METHOD_ZERO:
+      return _("Overwrite existing data with zeroes");
+    case GDU_ERASE_METHOD_DISCARD:
+      /* Translators: Erase method telling the disk that all blocks are unused (TRIM) */
+      return _("Discard all blocks");
+    case GDU_ERASE_METHOD_ATA_SECURE_ERASE:
+      return _("ATA Secure Erase");
+    case GDU_ERASE_METHOD_ATA_SECURE_ERASE_ENHANCED:
+      return _("ATA Enhanced Secure Erase");
+    case GDU_ERASE_METHOD_NVME_SANITIZE:
+      /* Translators: Erase method using the Sanitize command of NVMe disks */
+      return _("NVMe Sanitize");
+    default:
+      g_assert_not_reached ();
+    }
+  return NULL;
+}
+
+/* Returns the value for the "erase" option of the Block.Format() method
+ * or NULL if @method is not carried out by Format()
+ */
+const gchar *
+gdu_erase_method_get_udisks_type (GduEraseMethod method)
+{
+  switch (method)
+    {
+    case GDU_ERASE_METHOD_ZERO:
+      return "zero";
+    case GDU_ERASE_METHOD_ATA_SECURE_ERASE:
+      return "ata-secure-erase";
+    case GDU_ERASE_METHOD_ATA_SECURE_ERASE_ENHANCED:
+      return "ata-secure-erase-enhanced";
+    default:
+      return NULL;
+    }
+}
+
+/* Returns TRUE if @method is carried out by gdu_erase_block() */
+gboolean
+gdu_erase_method_is_local (GduEraseMethod method)
+{
+  return method == GDU_ERASE_METHOD_ZERO || method == GDU_ERASE_METHOD_DISCARD;
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+/* Returns the value of a request queue limit, e.g. "discard_max_bytes" or 0 if not known */
+static guint64
+get_queue_limit (UDisksBlock *block,
+                 const gchar *limit)
+{
+  gchar *name;
+  gchar *filename;
+  gchar *contents = NULL;
+  guint64 ret = 0;
+
+  /* only whole disks have a queue/ directory */
+  name = g_path_get_basename (udisks_block_get_device (block));
+  filename = g_strdup_printf ("/sys/class/block/%s/queue/%s", name, limit);
+  if (g_file_get_contents (filename, &contents, NULL, NULL))
+    ret = g_ascii_strtoull (contents, NULL, 10);
+  g_free (contents);
+  g_free (filename);
+  g_free (name);
+
+  return ret;
+}
+
+gboolean
+gdu_erase_block_supports_discard (UDisksBlock *block)
+{
+  return get_queue_limit (block, "discard_max_bytes") > 0;
+}
+
+/* Whether discarded blocks read back as erased is checked afterwards */
+static GduEraseMethod
+get_fastest_local_method (UDisksBlock *block)
+{
+  if (gdu_erase_block_supports_discard (block))
+    return GDU_ERASE_METHOD_DISCARD;
+  return GDU_ERASE_METHOD_ZERO;
+}
+
+/* Picks the fastest method that still erases all data on the disk -
+ * commands carried out by the drive itself also erase remapped sectors
+ * and over-provisioned flash that can't be reached from the host. The
+ * drive may still reject them, see gdu_erase_get_fallback_method().
+ */
+GduEraseMethod
+gdu_erase_get_fastest_method (UDisksClient *client,
+                              UDisksBlock  *block)
+{
+  GduEraseMethod ret;
+  UDisksDrive *drive;
+  UDisksObject *drive_object = NULL;
+  UDisksDriveAta *ata = NULL;
+
+  drive = udisks_client_get_drive_for_block (client, block);
+  if (drive != NULL)
+    drive_object = (UDisksObject *) g_dbus_interface_get_object (G_DBUS_INTERFACE (drive));
+
+#if UDISKS_CHECK_VERSION(2, 10, 0)
+  /* an empty status means the controller doesn't support sanitize */
+  if (drive_object != NULL && udisks_object_peek_nvme_controller (drive_object) != NULL)
+    {
+      UDisksNVMeController *controller = udisks_object_peek_nvme_controller (drive_object);
+      const gchar *status = udisks_nvme_controller_get_sanitize_status (controller);
+      if (status != NULL && strlen (status) > 0)
+        {
+          ret = GDU_ERASE_METHOD_NVME_SANITIZE;
+          goto out;
+        }
+    }
+#endif
+
+  if (drive_object != NULL)
+    ata = udisks_object_peek_drive_ata (drive_object);
+  if (ata != NULL && !udisks_drive_ata_get_security_frozen (ata))
+    {
+      if (udisks_drive_ata_get_security_enhanced_erase_unit_minutes (ata) > 0)
+        {
+          ret = GDU_ERASE_METHOD_ATA_SECURE_ERASE_ENHANCED;
+          goto out;
+        }
+      if (udisks_drive_ata_get_security_erase_unit_minutes (ata) > 0)
+        {
+          ret = GDU_ERASE_METHOD_ATA_SECURE_ERASE;
+          goto out;
+        }
+    }
+
+  ret = get_fastest_local_method (block);
+
+ out:
+  g_clear_object (&drive);
+  return ret;
+}
+
+/* Returns the method to use after the drive rejected @method or
+ * %GDU_ERASE_METHOD_NONE if there is nothing else to try. Controllers
+ * don't have to support Sanitize and udisks doesn't tell which of its
+ * actions they do, so the only way to find out is to try.
+ */
+GduEraseMethod
+gdu_erase_get_fallback_method (UDisksBlock    *block,
+                               GduEraseMethod  method)
+{
+  switch (method)
+    {
+    case GDU_ERASE_METHOD_NVME_SANITIZE:
+      return get_fastest_local_method (block);
+    default:
+      return GDU_ERASE_METHOD_NONE;
+    }
+}
+
+/* Returns TRUE if @error means the drive or udisks failed to carry out
+ * the command - as opposed to the user canceling it or not being allowed to
+ */
+gboolean
+gdu_erase_error_is_rejection (const GError *error)
+{
+  return !(g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED) ||
+           g_error_matches (error, UDISKS_ERROR, UDISKS_ERROR_CANCELLED) ||
+           g_error_matches (error, UDISKS_ERROR, UDISKS_ERROR_DEVICE_BUSY) ||
+           g_error_matches (error, UDISKS_ERROR, UDISKS_ERROR_NOT_AUTHORIZED) ||
+           g_error_matches (error, UDISKS_ERROR, UDISKS_ERROR_NOT_AUTHORIZED_CAN_OBTAIN) ||
+           g_error_matches (error, UDISKS_ERROR, UDISKS_ERROR_NOT_AUTHORIZED_DISMISSED));
+}
+
+/* Returns the expected duration of erasing @block with @method in
+ * micro-seconds or 0 if it can't be estimated. Drives report how long
+ * Secure Erase takes; for overwriting, the write rate measured by the
+ * last benchmark of the disk is used, if any. Nothing reports how long
+ * discarding takes, so it is derived from the number of requests the
+ * kernel splits it into and the number of units the disk unmaps.
+ */
+gint64
+gdu_erase_estimate_duration_usec (UDisksClient   *client,
+                                  UDisksBlock    *block,
+                                  GduEraseMethod  method)
+{
+  gint64 ret = 0;
+  UDisksDrive *drive;
+  UDisksObject *drive_object = NULL;
+  UDisksDriveAta *ata = NULL;
+  GduBenchmark *bm;
+  gchar *filename;
+  gdouble write_avg = 0.0;
+  guint64 size;
+  guint64 max_bytes;
+  guint64 granularity;
+
+  drive = udisks_client_get_drive_for_block (client, block);
+  if (drive != NULL)
+    drive_object = (UDisksObject *) g_dbus_interface_get_object (G_DBUS_INTERFACE (drive));
+  if (drive_object != NULL)
+    ata = udisks_object_peek_drive_ata (drive_object);
+
+  switch (method)
+    {
+    case GDU_ERASE_METHOD_ATA_SECURE_ERASE:
+      if (ata != NULL)
+        ret = udisks_drive_ata_get_security_erase_unit_minutes (ata) * 60LL * G_USEC_PER_SEC;
+      break;
+
+    case GDU_ERASE_METHOD_ATA_SECURE_ERASE_ENHANCED:
+      if (ata != NULL)
+        ret = udisks_drive_ata_get_security_enhanced_erase_unit_minutes (ata) * 60LL * G_USEC_PER_SEC;
+      break;
+
+    case GDU_ERASE_METHOD_ZERO:
+      filename = gdu_benchmark_get_filename_for_block (block);
+      if (filename != NULL)
+        {
+          bm = gdu_benchmark_new ();
+          if (gdu_benchmark_load (bm, filename, NULL))
+            gdu_benchmark_get_max_min_avg (bm->write_samples, bm->num_write_samples, NULL, NULL, &write_avg);
+          gdu_benchmark_free (bm);
+        }
+      g_free (filename);
+      if (write_avg > 0.0)
+        ret = udisks_block_get_size (block) / write_avg * G_USEC_PER_SEC;
+      break;
+
+    case GDU_ERASE_METHOD_DISCARD:
+      size = udisks_block_get_size (block);
+      max_bytes = MIN (get_queue_limit (block, "discard_max_bytes"), DISCARD_CHUNK_SIZE);
+      granularity = MAX (get_queue_limit (block, "discard_granularity"), 512);
+      if (max_bytes > 0)
+        ret = (size + max_bytes - 1) / max_bytes * DISCARD_REQUEST_USEC +
+          size / granularity * DISCARD_GRANULE_NSEC / 1000;
+      break;
+
+    default:
+      break;
+    }
+
+  g_clear_object (&drive);
+  return ret;
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+static gboolean
+get_size (gint      fd,
+          guint64  *out_size,
+          GError  **error)
+{
+  if (ioctl (fd, BLKGETSIZE64, out_size) != 0)
+    {
+      g_set_error (error,
+                   G_IO_ERROR,
+                   g_io_error_from_errno (errno),
+                   C_("erase", "Error getting size of device: %m"));
+      return FALSE;
+    }
+  return TRUE;
+}
+
+/* Returns a write-only file descriptor for @block or -1 if @error is set */
+static gint
+open_for_erase (UDisksBlock   *block,
+                GCancellable  *cancellable,
+                GError       **error)
+{
+  GUnixFDList *fd_list = NULL;
+  GVariant *fd_index = NULL;
+  gint fd = -1;
+
+  if (!udisks_block_call_open_for_restore_sync (block,
+                                                g_variant_new ("a{sv}", NULL), /* options */
+                                                NULL, /* fd_list */
+                                                &fd_index,
+                                                &fd_list,
+                                                cancellable,
+                                                error))
+    goto out;
+
+  fd = g_unix_fd_list_get (fd_list, g_variant_get_handle (fd_index), error);
+
+ out:
+  if (fd_index != NULL)
+    g_variant_unref (fd_index);
+  g_clear_object (&fd_list);
+  return fd;
+}
+
+/* Shared by all erase threads - only ever read from */
+static const guchar *
+get_zero_buffer (void)
+{
+  static gsize once = 0;
+  static guchar *buffer = NULL;
+
+  if (g_once_init_enter (&once))
+    {
+      long page_size;
+      guchar *buffer_unaligned;
+
+      page_size = sysconf (_SC_PAGESIZE);
+      if (page_size < 1)
+        page_size = 4096;
+
+      /* the device is written with O_DIRECT - never freed */
+      buffer_unaligned = g_new0 (guchar, ZERO_BUFFER_SIZE + page_size);
+      buffer = (guchar*) (((gintptr) (buffer_unaligned + page_size)) & (~(page_size - 1)));
+      g_once_init_leave (&once, 1);
+    }
+
+  return buffer;
+}
+
+/* Update progress - but only every 200 ms */
+static void
+report_progress (EraseData *data,
+                 guint64    num_bytes_completed,
+                 gboolean   force)
+{
+  gint64 now_usec;
+
+  now_usec = g_get_monotonic_time ();
+  if (!force && now_usec - data->last_update_usec < 200 * G_USEC_PER_SEC / 1000)
+    return;
+
+  gdu_estimator_add_sample (data->estimator, num_bytes_completed);
+  if (data->progress_func != NULL)
+    data->progress_func (data->estimator, data->progress_data);
+  data->last_update_usec = now_usec;
+}
+
+static gboolean
+discard_blocks (EraseData     *data,
+                gint           fd,
+                guint64        size,
+                GCancellable  *cancellable,
+                GError       **error)
+{
+  guint64 offset;
+
+  for (offset = 0; offset < size; offset += DISCARD_CHUNK_SIZE)
+    {
+      guint64 range[2];
+
+      if (g_cancellable_set_error_if_cancelled (cancellable, error))
+        return FALSE;
+
+      range[0] = offset;
+      range[1] = MIN (DISCARD_CHUNK_SIZE, size - offset);
+      if (ioctl (fd, BLKDISCARD, range) != 0)
+        {
+          gchar *s = g_format_size_full (offset, G_FORMAT_SIZE_LONG_FORMAT);
+          g_set_error (error,
+                       G_IO_ERROR,
+                       g_io_error_from_errno (errno),
+                       /* Translators: The %s is the offset, e.g. "1.0 GB (1000000000 bytes)" */
+                       C_("erase", "Error discarding blocks at offset %s: %m"),
+                       s);
+          g_free (s);
+          return FALSE;
+        }
+
+      report_progress (data, offset + range[1], FALSE);
+    }
+
+  return TRUE;
+}
+
+/* Disks that support WRITE ZEROES or WRITE SAME zero out blocks without
+ * the data going over the bus. Otherwise write large blocks of zeroes
+ * with O_DIRECT so the page cache doesn't get in the way.
+ */
+static gboolean
+zero_blocks (EraseData     *data,
+             gint           fd,
+             guint64        size,
+             GCancellable  *cancellable,
+             GError       **error)
+{
+  const guchar *zero_buffer;
+  gboolean use_zero_out;
+  guint64 offset = 0;
+  gint flags;
+
+  use_zero_out = get_queue_limit (data->block, "write_zeroes_max_bytes") > 0;
+  while (use_zero_out && offset < size)
+    {
+      guint64 range[2];
+
+      if (g_cancellable_set_error_if_cancelled (cancellable, error))
+        return FALSE;
+
+      range[0] = offset;
+      range[1] = MIN (ZERO_OUT_CHUNK_SIZE, size - offset);
+      if (ioctl (fd, BLKZEROOUT, range) != 0)
+        {
+          gchar *s;
+
+          /* the limit may be advertised but not work, e.g. behind some USB bridges */
+          if (errno == EOPNOTSUPP || errno == EINVAL || errno == ENOTTY)
+            {
+              use_zero_out = FALSE;
+              break;
+            }
+
+          s = g_format_size_full (offset, G_FORMAT_SIZE_LONG_FORMAT);
+          g_set_error (error,
+                       G_IO_ERROR,
+                       g_io_error_from_errno (errno),
+                       /* Translators: The %s is the offset, e.g. "1.0 GB (1000000000 bytes)" */
+                       C_("erase", "Error zeroing out blocks at offset %s: %m"),
+                       s);
+          g_free (s);
+          return FALSE;
+        }
+
+      offset += range[1];
+      report_progress (data, offset, FALSE);
+    }
+
+  /* not fatal, the writes just go through the page cache */
+  flags = fcntl (fd, F_GETFL);
+  if (flags != -1 && fcntl (fd, F_SETFL, flags | O_DIRECT) != 0)
+    g_warning ("Error enabling O_DIRECT: %m");
+
+  zero_buffer = get_zero_buffer ();
+  while (offset < size)
+    {
+      gsize num_bytes_to_write;
+      ssize_t num_bytes_written;
+
+      if (g_cancellable_set_error_if_cancelled (cancellable, error))
+        return FALSE;
+
+      num_bytes_to_write = MIN (ZERO_BUFFER_SIZE, size - offset);
+
+    write_again:
+      num_bytes_written = pwrite (fd, zero_buffer, num_bytes_to_write, offset);
+      if (num_bytes_written <= 0)
+        {
+          gchar *s;
+
+          if (num_bytes_written < 0 && (errno == EAGAIN || errno == EINTR))
+            goto write_again;
+
+          s = g_format_size_full (offset, G_FORMAT_SIZE_LONG_FORMAT);
+          g_set_error (error,
+                       G_IO_ERROR,
+                       num_bytes_written < 0 ? g_io_error_from_errno (errno) : G_IO_ERROR_FAILED,
+                       /* Translators: The %s is the offset, e.g. "1.0 GB (1000000000 bytes)" */
+                       C_("erase", "Error writing zeroes at offset %s"),
+                       s);
+          g_free (s);
+          return FALSE;
+        }
+
+      offset += num_bytes_written;
+      report_progress (data, offset, FALSE);
+    }
+
+  if (fdatasync (fd) != 0)
+    {
+      g_set_error (error,
+                   G_IO_ERROR,
+                   g_io_error_from_errno (errno),
+                   C_("erase", "Error flushing device: %m"));
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+/* Reads back samples at random offsets - always including the start and
+ * the end of the device where left-over metadata is most likely to be
+ * found - and checks that they look like @method left them, see above
+ */
+static gboolean
+verify_samples (gint            fd,
+                guint64         size,
+                GduEraseMethod  method,
+                GCancellable   *cancellable,
+                GError        **error)
+{
+  gboolean ret = FALSE;
+  guchar *buffer_unaligned = NULL;
+  guchar *buffer;
+  GRand *rand;
+  long page_size;
+  gsize sample_size;
+  guint n;
+
+  page_size = sysconf (_SC_PAGESIZE);
+  if (page_size < 1)
+    page_size = 4096;
+
+  sample_size = MIN (VERIFY_SAMPLE_SIZE, size) & ~(page_size - 1);
+  if (sample_size == 0)
+    return TRUE;
+
+  /* the device is opened with O_DIRECT */
+  buffer_unaligned = g_new0 (guchar, sample_size + page_size);
+  buffer = (guchar*) (((gintptr) (buffer_unaligned + page_size)) & (~(page_size - 1)));
+
+  rand = g_rand_new ();
+  for (n = 0; n < VERIFY_NUM_SAMPLES; n++)
+    {
+      guint64 offset;
+      ssize_t num_read;
+
+      if (g_cancellable_set_error_if_cancelled (cancellable, error))
+        goto out;
+
+      if (n == 0)
+        offset = 0;
+      else if (n == 1)
+        offset = size - sample_size;
+      else
+        offset = (guint64) (g_rand_double (rand) * (size - sample_size));
+      offset &= ~((guint64) page_size - 1);
+
+      num_read = pread (fd, buffer, sample_size, offset);
+      if (num_read < (ssize_t) sample_size)
+        {
+          gchar *s = g_format_size_full (offset, G_FORMAT_SIZE_LONG_FORMAT);
+          g_set_error (error,
+                       G_IO_ERROR,
+                       num_read < 0 ? g_io_error_from_errno (errno) : G_IO_ERROR_FAILED,
+                       /* Translators: The %s is the offset, e.g. "1.0 GB (1000000000 bytes)" */
+                       C_("erase", "Error reading back erased data at offset %s"),
+                       s);
+          g_free (s);
+          goto out;
+        }
+
+      if (!gdu_erase_method_is_local (method))
+        continue;
+
+      /* all bytes are equal to the first one */
+      if ((method == GDU_ERASE_METHOD_ZERO && buffer[0] != 0) ||
+          memcmp (buffer, buffer + 1, sample_size - 1) != 0)
+        {
+          gchar *s = g_format_size_full (offset, G_FORMAT_SIZE_LONG_FORMAT);
+          g_set_error (error,
+                       G_IO_ERROR,
+                       G_IO_ERROR_INVALID_DATA,
+                       /* Translators: The %s is the offset, e.g. "1.0 GB (1000000000 bytes)" */
+                       C_("erase", "Data at offset %s was not erased"),
+                       s);
+          g_free (s);
+          goto out;
+        }
+    }
+
+  ret = TRUE;
+
+ out:
+  g_rand_free (rand);
+  g_free (buffer_unaligned);
+  return ret;
+}
+
+static gboolean
+erase (EraseData     *data,
+       GCancellable  *cancellable,
+       GError       **error)
+{
+  gboolean ret = FALSE;
+  GError *error2 = NULL;
+  guint64 size;
+  gint fd;
+
+  fd = open_for_erase (data->block, cancellable, error);
+  if (fd == -1)
+    goto out;
+
+  if (!get_size (fd, &size, error))
+    goto out;
+
+  if (size == 0)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED, _("Device is size 0"));
+      goto out;
+    }
+
+  data->estimator = gdu_estimator_new (size);
+  data->last_update_usec = g_get_monotonic_time ();
+
+  switch (data->method)
+    {
+    case GDU_ERASE_METHOD_ZERO:
+      if (!zero_blocks (data, fd, size, cancellable, error))
+        goto out;
+      break;
+
+    case GDU_ERASE_METHOD_DISCARD:
+      if (!discard_blocks (data, fd, size, cancellable, error))
+        goto out;
+      break;
+
+    default:
+      g_assert_not_reached ();
+    }
+
+  report_progress (data, size, TRUE);
+  ret = TRUE;
+
+ out:
+  if (fd != -1)
+    {
+      if (close (fd) != 0)
+        g_warning ("Error closing fd: %m");
+
+      /* the partition table and filesystems are gone - or partially so if we failed */
+      if (!udisks_block_call_rescan_sync (data->block,
+                                          g_variant_new ("a{sv}", NULL), /* options */
+                                          NULL, /* cancellable */
+                                          &error2))
+        {
+          g_warning ("Error rescanning device: %s (%s, %d)",
+                     error2->message, g_quark_to_string (error2->domain), error2->code);
+          g_clear_error (&error2);
+        }
+    }
+  return ret;
+}
+
+static gboolean
+verify (EraseData     *data,
+        GCancellable  *cancellable,
+        GError       **error)
+{
+  gboolean ret = FALSE;
+  guint64 size;
+  gint fd;
+
+  fd = gdu_benchmark_open_block (data->block, FALSE, cancellable, error);
+  if (fd == -1)
+    goto out;
+
+  if (!get_size (fd, &size, error))
+    goto out;
+
+  if (!verify_samples (fd, size, data->method, cancellable, error))
+    goto out;
+
+  ret = TRUE;
+
+ out:
+  if (fd != -1)
+    close (fd);
+  return ret;
+}
+
+static void
+erase_thread (GTask        *task,
+              gpointer      source_object,
+              gpointer      task_data,
+              GCancellable *cancellable)
+{
+  EraseData *data = task_data;
+  GError *error = NULL;
+
+  /* the device is opened for writing via OpenForRestore() which doesn't allow reading it back */
+  if (data->erase && !erase (data, cancellable, &error))
+    goto out;
+
+  if (data->verify && !verify (data, cancellable, &error))
+    goto out;
+
+ out:
+  if (error != NULL)
+    g_task_return_error (task, error);
+  else
+    g_task_return_boolean (task, TRUE);
+}
+
+static void
+run_erase_thread (EraseData           *data,
+                  GCancellable        *cancellable,
+                  GAsyncReadyCallback  callback,
+                  gpointer             user_data)
+{
+  GTask *task;
+
+  task = g_task_new (G_OBJECT (data->block), cancellable, callback, user_data);
+  g_task_set_task_data (task, data, (GDestroyNotify) erase_data_free);
+  g_task_run_in_thread (task, erase_thread);
+  g_object_unref (task);
+}
+
+/* Erases @block using @method which must be a local method, see
+ * gdu_erase_method_is_local(). The block must not be in use. Discarding
+ * is checked even if @verify is FALSE.
+ */
+void
+gdu_erase_block (UDisksBlock           *block,
+                 GduEraseMethod         method,
+                 gboolean               verify,
+                 GduEraseProgressFunc   progress_func,
+                 gpointer               progress_data,
+                 GCancellable          *cancellable,
+                 GAsyncReadyCallback    callback,
+                 gpointer               user_data)
+{
+  EraseData *data;
+
+  g_return_if_fail (gdu_erase_method_is_local (method));
+
+  data = g_new0 (EraseData, 1);
+  data->block = g_object_ref (block);
+  data->method = method;
+  data->erase = TRUE;
+  data->verify = verify || method == GDU_ERASE_METHOD_DISCARD;
+  data->progress_func = progress_func;
+  data->progress_data = progress_data;
+  run_erase_thread (data, cancellable, callback, user_data);
+}
+
+/* Checks that @block was erased by @method, e.g. after Block.Format() */
+void
+gdu_erase_verify_block (UDisksBlock           *block,
+                        GduEraseMethod         method,
+                        GCancellable          *cancellable,
+                        GAsyncReadyCallback    callback,
+                        gpointer               user_data)
+{
+  EraseData *data;
+
+  data = g_new0 (EraseData, 1);
+  data->block = g_object_ref (block);
+  data->method = method;
+  data->verify = TRUE;
+  run_erase_thread (data, cancellable, callback, user_data);
+}
+
+gboolean
+gdu_erase_finish (UDisksBlock   *block,
+                  GAsyncResult  *res,
+                  GError       **error)
+{
+  g_return_val_if_fail (g_task_is_valid (res, block), FALSE);
+  return g_task_propagate_boolean (G_TASK (res), error);
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+#if UDISKS_CHECK_VERSION(2, 10, 0)
+/* The Sanitize actions in the order they are tried. Overwrite is left
+ * out as the controller takes longer for it than overwriting from the
+ * host and it wears out flash.
+ */
+static const gchar *sanitize_actions[] = { "block-erase", "crypto-erase", NULL };
+
+static void sanitize_start (GTask *task);
+
+static void
+sanitize_start_cb (GObject      *source_object,
+                   GAsyncResult *res,
+                   gpointer      user_data)
+{
+  GTask *task = G_TASK (user_data);
+  guint n = GPOINTER_TO_UINT (g_task_get_task_data (task));
+  GError *error = NULL;
+
+  if (!udisks_nvme_controller_call_sanitize_start_finish (UDISKS_NVME_CONTROLLER (source_object), res, &error))
+    {
+      if (sanitize_actions[n + 1] != NULL && gdu_erase_error_is_rejection (error))
+        {
+          g_clear_error (&error);
+          g_task_set_task_data (task, GUINT_TO_POINTER (n + 1), NULL);
+          sanitize_start (task);
+          return;
+        }
+      g_task_return_error (task, error);
+    }
+  else
+    {
+      g_task_return_boolean (task, TRUE);
+    }
+  g_object_unref (task);
+}
+
+static void
+sanitize_start (GTask *task)
+{
+  guint n = GPOINTER_TO_UINT (g_task_get_task_data (task));
+
+  udisks_nvme_controller_call_sanitize_start (UDISKS_NVME_CONTROLLER (g_task_get_source_object (task)),
+                                              sanitize_actions[n],
+                                              g_variant_new ("a{sv}", NULL), /* options */
+                                              g_task_get_cancellable (task),
+                                              sanitize_start_cb,
+                                              task);
+}
+
+/* Sanitizes all namespaces attached to @controller with the first Sanitize action
+ * it doesn't reject. The error of the last action tried is returned.
+ */
+void
+gdu_erase_sanitize (UDisksNVMeController  *controller,
+                    GCancellable          *cancellable,
+                    GAsyncReadyCallback    callback,
+                    gpointer               user_data)
+{
+  GTask *task;
+
+  task = g_task_new (G_OBJECT (controller), cancellable, callback, user_data);
+  g_task_set_task_data (task, GUINT_TO_POINTER (0), NULL);
+  sanitize_start (task);
+}
+
+gboolean
+gdu_erase_sanitize_finish (UDisksNVMeController  *controller,
+                           GAsyncResult          *res,
+                           GError               **error)
+{
+  g_return_val_if_fail (g_task_is_valid (res, controller), FALSE);
+  return g_task_propagate_boolean (G_TASK (res), error);
+}
+#endif
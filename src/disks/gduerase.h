@@ -0,0 +1,65 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*-
+ *
+ * Copyright (C) 2008-2013 Red Hat, Inc.
+ *
+ * Licensed under GPL version 2 or later.
+ *
+ * Author: David Zeuthen <zeuthen@gmail.com>
+ */
+
+#ifndef __GDU_ERASE_H__
+#define __GDU_ERASE_H__
+
+#include <gtk/gtk.h>
+#include "gdutypes.h"
+
+G_BEGIN_DECLS
+
+/* Called from the erase thread at most every 200 ms - @estimator must only be used from the callback */
+typedef void (*GduEraseProgressFunc) (GduEstimator *estimator,
+                                      gpointer      user_data);
+
+const gchar    *gdu_erase_method_get_name        (GduEraseMethod method);
+const gchar    *gdu_erase_method_get_udisks_type (GduEraseMethod method);
+gboolean        gdu_erase_method_is_local        (GduEraseMethod method);
+
+gboolean        gdu_erase_block_supports_discard (UDisksBlock    *block);
+GduEraseMethod  gdu_erase_get_fastest_method     (UDisksClient   *client,
+                                                  UDisksBlock    *block);
+GduEraseMethod  gdu_erase_get_fallback_method    (UDisksBlock    *block,
+                                                  GduEraseMethod  method);
+gboolean        gdu_erase_error_is_rejection     (const GError   *error);
+gint64          gdu_erase_estimate_duration_usec (UDisksClient   *client,
+                                                  UDisksBlock    *block,
+                                                  GduEraseMethod  method);
+
+void            gdu_erase_block                  (UDisksBlock           *block,
+                                                  GduEraseMethod         method,
+                                                  gboolean               verify,
+                                                  GduEraseProgressFunc   progress_func,
+                                                  gpointer               progress_data,
+                                                  GCancellable          *cancellable,
+                                                  GAsyncReadyCallback    callback,
+                                                  gpointer               user_data);
+void            gdu_erase_verify_block           (UDisksBlock           *block,
+                                                  GduEraseMethod         method,
+                                                  GCancellable          *cancellable,
+                                                  GAsyncReadyCallback    callback,
+                                                  gpointer               user_data);
+gboolean        gdu_erase_finish                 (UDisksBlock           *block,
+                                                  GAsyncResult          *res,
+                                                  GError               **error);
+
+#if UDISKS_CHECK_VERSION(2, 10, 0)
+void            gdu_erase_sanitize               (UDisksNVMeController  *controller,
+                                                  GCancellable          *cancellable,
+                                                  GAsyncReadyCallback    callback,
+                                                  gpointer               user_data);
+gboolean        gdu_erase_sanitize_finish        (UDisksNVMeController  *controller,
+                                                  GAsyncResult          *res,
+                                                  GError               **error);
+#endif
+
+G_END_DECLS
+
+#endif /* __GDU_ERASE_H__ */
@@ -0,0 +1,996 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*-
+ *
+ * Copyright (C) 2008-2013 Red Hat, Inc.
+ *
+ * Licensed under GPL version 2 or later.
+ *
+ * Author: David Zeuthen <zeuthen@gmail.com>
+ */
+
+#include "config.h"
+
+#include <glib/gi18n.h>
+
+#include "gduapplication.h"
+#include "gduwindow.h"
+#include "gdudevicetreemodel.h"
+#include "gduerasemultipledisksdialog.h"
+#include "gduerase.h"
+#include "gduestimator.h"
+
+/* Erases several disks at the same time, each with the fastest method
+ * that still erases all data on it unless overwriting with zeroes was
+ * requested. Erasing with udisks or the drive itself is tracked through
+ * the udisks job on the disk, overwriting and discarding are done
+ * locally, see gduerase.c. Disks where discarded blocks don't read back
+ * as erased are overwritten with zeroes instead.
+ */
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+typedef struct DialogData DialogData;
+
+typedef enum
+{
+  DEVICE_STATE_WAITING,
+  DEVICE_STATE_ERASING,
+  DEVICE_STATE_VERIFYING,
+  DEVICE_STATE_DONE
+} DeviceState;
+
+typedef struct
+{
+  DialogData *data;
+
+  UDisksBlock *block;
+  UDisksObject *object;
+  UDisksObject *drive_object; /* may be NULL */
+
+  GduEraseMethod method;
+  DeviceState state;
+  GError *error;
+
+  /* progress of local methods - must hold data->lock when reading/writing this */
+  gdouble fraction;
+} DeviceData;
+
+struct DialogData
+{
+  volatile gint ref_count;
+
+  GduWindow *window;
+  GtkBuilder *builder;
+
+  GtkWidget *dialog;
+  GtkWidget *devices_treeview;
+  GtkWidget *erase_combobox;
+  GtkWidget *verify_checkbutton;
+  GtkWidget *status_label;
+
+  GtkWidget *erase_button;
+  GtkWidget *stop_button;
+
+  GduDeviceTreeModel *model;
+
+  gboolean closed;
+
+  /* UDisksBlock -> DeviceData for the disks in the current or last run */
+  GHashTable *devices;
+  gboolean in_progress;
+  gboolean verify;
+  guint num_running;
+
+  GCancellable *cancellable;
+
+  /* protects the fraction of each DeviceData */
+  GMutex lock;
+};
+
+static const struct {
+  goffset offset;
+  const gchar *name;
+} widget_mapping[] = {
+  {G_STRUCT_OFFSET (DialogData, devices_treeview), "devices-treeview"},
+  {G_STRUCT_OFFSET (DialogData, erase_combobox), "erase-combobox"},
+  {G_STRUCT_OFFSET (DialogData, verify_checkbutton), "verify-checkbutton"},
+  {G_STRUCT_OFFSET (DialogData, status_label), "status-label"},
+  {G_STRUCT_OFFSET (DialogData, erase_button), "erase-button"},
+  {G_STRUCT_OFFSET (DialogData, stop_button), "stop-button"},
+  {0, NULL}
+};
+
+static void update_dialog (DialogData *data);
+static void erase_device (DeviceData *device);
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+static void
+device_data_free (DeviceData *device)
+{
+  g_clear_object (&device->block);
+  g_clear_object (&device->object);
+  g_clear_object (&device->drive_object);
+  g_clear_error (&device->error);
+  g_free (device);
+}
+
+static DialogData *
+dialog_data_ref (DialogData *data)
+{
+  g_atomic_int_inc (&data->ref_count);
+  return data;
+}
+
+static void
+dialog_data_unref (DialogData *data)
+{
+  if (g_atomic_int_dec_and_test (&data->ref_count))
+    {
+      if (data->dialog != NULL)
+        {
+          gtk_widget_hide (data->dialog);
+          gtk_widget_destroy (data->dialog);
+          data->dialog = NULL;
+        }
+
+      g_clear_object (&data->window);
+      g_clear_object (&data->builder);
+      g_clear_object (&data->model);
+      g_clear_object (&data->cancellable);
+      g_hash_table_unref (data->devices);
+      g_mutex_clear (&data->lock);
+
+      g_free (data);
+    }
+}
+
+static void
+dialog_data_close (DialogData *data)
+{
+  /* udisks jobs carry on in the background and show up in the main window */
+  g_cancellable_cancel (data->cancellable);
+  data->closed = TRUE;
+  gtk_dialog_response (GTK_DIALOG (data->dialog), GTK_RESPONSE_CANCEL);
+  dialog_data_unref (data);
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+/* TRUE if the erase was stopped - by us or by canceling the udisks job */
+static gboolean
+error_is_abort (const GError *error)
+{
+  return g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED) ||
+         g_error_matches (error, UDISKS_ERROR, UDISKS_ERROR_CANCELLED);
+}
+
+/* The method used for @block in the current or last run or the one that
+ * would be used if it was erased now
+ */
+static GduEraseMethod
+get_method (DialogData  *data,
+            UDisksBlock *block)
+{
+  DeviceData *device;
+
+  device = g_hash_table_lookup (data->devices, block);
+  if (device != NULL)
+    return device->method;
+
+  if (g_strcmp0 (gtk_combo_box_get_active_id (GTK_COMBO_BOX (data->erase_combobox)), "zero") == 0)
+    return GDU_ERASE_METHOD_ZERO;
+
+  return gdu_erase_get_fastest_method (gdu_window_get_client (data->window), block);
+}
+
+static GList *
+get_jobs (DeviceData *device)
+{
+  UDisksClient *client = gdu_window_get_client (device->data->window);
+  GList *ret;
+
+  ret = udisks_client_get_jobs_for_object (client, device->object);
+  if (device->drive_object != NULL)
+    ret = g_list_concat (ret, udisks_client_get_jobs_for_object (client, device->drive_object));
+  return ret;
+}
+
+/* Returns -1.0 if the progress is not known */
+static gdouble
+get_progress (DeviceData *device)
+{
+  gdouble ret = -1.0;
+  GList *jobs;
+  GList *l;
+
+  if (gdu_erase_method_is_local (device->method))
+    {
+      g_mutex_lock (&device->data->lock);
+      ret = device->fraction;
+      g_mutex_unlock (&device->data->lock);
+      goto out;
+    }
+
+  /* erasing with Format() or the drive itself runs as a job on either the block or the drive */
+  jobs = get_jobs (device);
+  for (l = jobs; l != NULL; l = l->next)
+    {
+      UDisksJob *job = UDISKS_JOB (l->data);
+      if (udisks_job_get_progress_valid (job))
+        {
+          ret = udisks_job_get_progress (job);
+          break;
+        }
+    }
+  g_list_free_full (jobs, g_object_unref);
+
+ out:
+  return ret;
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+static void
+selected_cell_func (GtkTreeViewColumn *column,
+                    GtkCellRenderer   *renderer,
+                    GtkTreeModel      *model,
+                    GtkTreeIter       *iter,
+                    gpointer           user_data)
+{
+  DialogData *data = user_data;
+  UDisksBlock *block = NULL;
+  gboolean selected = FALSE;
+
+  gtk_tree_model_get (model,
+                      iter,
+                      GDU_DEVICE_TREE_MODEL_COLUMN_BLOCK, &block,
+                      GDU_DEVICE_TREE_MODEL_COLUMN_SELECTED, &selected,
+                      -1);
+
+  g_object_set (renderer,
+                "visible", block != NULL,
+                "active", selected,
+                "activatable", !data->in_progress,
+                NULL);
+
+  g_clear_object (&block);
+}
+
+static void
+method_cell_func (GtkTreeViewColumn *column,
+                  GtkCellRenderer   *renderer,
+                  GtkTreeModel      *model,
+                  GtkTreeIter       *iter,
+                  gpointer           user_data)
+{
+  DialogData *data = user_data;
+  UDisksBlock *block = NULL;
+  gboolean selected = FALSE;
+  const gchar *text = NULL;
+
+  gtk_tree_model_get (model,
+                      iter,
+                      GDU_DEVICE_TREE_MODEL_COLUMN_BLOCK, &block,
+                      GDU_DEVICE_TREE_MODEL_COLUMN_SELECTED, &selected,
+                      -1);
+
+  if (block != NULL && (selected || g_hash_table_contains (data->devices, block)))
+    text = gdu_erase_method_get_name (get_method (data, block));
+
+  g_object_set (renderer,
+                "text", text,
+                NULL);
+
+  g_clear_object (&block);
+}
+
+static void
+progress_cell_func (GtkTreeViewColumn *column,
+                    GtkCellRenderer   *renderer,
+                    GtkTreeModel      *model,
+                    GtkTreeIter       *iter,
+                    gpointer           user_data)
+{
+  DialogData *data = user_data;
+  UDisksBlock *block = NULL;
+  DeviceData *device = NULL;
+  const gchar *text = NULL;
+  gdouble progress = 0.0;
+
+  gtk_tree_model_get (model,
+                      iter,
+                      GDU_DEVICE_TREE_MODEL_COLUMN_BLOCK, &block,
+                      -1);
+
+  if (block != NULL)
+    device = g_hash_table_lookup (data->devices, block);
+
+  if (device != NULL)
+    {
+      switch (device->state)
+        {
+        case DEVICE_STATE_WAITING:
+          /* Translators: Shown while waiting for the disk to be unmounted etc. */
+          text = C_("erase-multiple-disks", "Waiting…");
+          break;
+
+        case DEVICE_STATE_ERASING:
+          progress = get_progress (device);
+          /* the renderer shows the percentage unless text is set */
+          if (progress < 0.0)
+            {
+              text = C_("erase-multiple-disks", "Erasing…");
+              progress = 0.0;
+            }
+          break;
+
+        case DEVICE_STATE_VERIFYING:
+          text = C_("erase-multiple-disks", "Verifying…");
+          progress = 1.0;
+          break;
+
+        case DEVICE_STATE_DONE:
+          if (device->error == NULL)
+            {
+              text = C_("erase-multiple-disks", "Erased");
+              progress = 1.0;
+            }
+          else if (error_is_abort (device->error))
+            {
+              text = C_("erase-multiple-disks", "Aborted");
+            }
+          else
+            {
+              text = C_("erase-multiple-disks", "Failed");
+            }
+          break;
+        }
+    }
+
+  g_object_set (renderer,
+                "visible", device != NULL,
+                "value", (gint) (progress * 100.0),
+                "text", text,
+                NULL);
+
+  g_clear_object (&block);
+}
+
+static void
+on_selected_toggled (GtkCellRendererToggle *renderer,
+                     const gchar           *path_string,
+                     gpointer               user_data)
+{
+  DialogData *data = user_data;
+  GtkTreePath *path;
+  GtkTreeIter iter;
+
+  if (data->in_progress)
+    return;
+
+  path = gtk_tree_path_new_from_string (path_string);
+  if (gtk_tree_model_get_iter (GTK_TREE_MODEL (data->model), &iter, path))
+    gdu_device_tree_model_toggle_selected (data->model, &iter);
+  gtk_tree_path_free (path);
+
+  update_dialog (data);
+}
+
+static void
+on_erase_combobox_changed (GtkComboBox *combobox,
+                           gpointer     user_data)
+{
+  DialogData *data = user_data;
+  update_dialog (data);
+}
+
+static void
+init_treeview (DialogData *data)
+{
+  GtkTreeViewColumn *column;
+  GtkCellRenderer *renderer;
+
+  data->model = gdu_device_tree_model_new (gdu_window_get_application (data->window),
+                                           GDU_DEVICE_TREE_MODEL_FLAGS_FLAT |
+                                           GDU_DEVICE_TREE_MODEL_FLAGS_ONE_LINE_NAME |
+                                           GDU_DEVICE_TREE_MODEL_FLAGS_INCLUDE_DEVICE_NAME);
+  gtk_tree_sortable_set_sort_column_id (GTK_TREE_SORTABLE (data->model),
+                                        GDU_DEVICE_TREE_MODEL_COLUMN_SORT_KEY,
+                                        GTK_SORT_ASCENDING);
+  gtk_tree_view_set_model (GTK_TREE_VIEW (data->devices_treeview), GTK_TREE_MODEL (data->model));
+
+  column = gtk_tree_view_column_new ();
+  /* Translators: Column header for the disks in the "Erase Multiple Disks" dialog */
+  gtk_tree_view_column_set_title (column, C_("erase-multiple-disks", "Disk"));
+  gtk_tree_view_column_set_expand (column, TRUE);
+  gtk_tree_view_append_column (GTK_TREE_VIEW (data->devices_treeview), column);
+
+  renderer = gtk_cell_renderer_toggle_new ();
+  gtk_tree_view_column_pack_start (column, renderer, FALSE);
+  gtk_tree_view_column_set_cell_data_func (column,
+                                           renderer,
+                                           selected_cell_func,
+                                           data,
+                                           NULL); /* user_data GDestroyNotify */
+  g_signal_connect (renderer,
+                    "toggled",
+                    G_CALLBACK (on_selected_toggled),
+                    data);
+
+  renderer = gtk_cell_renderer_text_new ();
+  gtk_tree_view_column_pack_start (column, renderer, FALSE);
+  gtk_tree_view_column_set_attributes (column,
+                                       renderer,
+                                       "markup", GDU_DEVICE_TREE_MODEL_COLUMN_HEADING_TEXT,
+                                       "visible", GDU_DEVICE_TREE_MODEL_COLUMN_IS_HEADING,
+                                       NULL);
+
+  renderer = gtk_cell_renderer_pixbuf_new ();
+  g_object_set (G_OBJECT (renderer),
+                "stock-size", GTK_ICON_SIZE_MENU,
+                NULL);
+  gtk_tree_view_column_pack_start (column, renderer, FALSE);
+  gtk_tree_view_column_set_attributes (column,
+                                       renderer,
+                                       "gicon", GDU_DEVICE_TREE_MODEL_COLUMN_ICON,
+                                       NULL);
+
+  renderer = gtk_cell_renderer_text_new ();
+  g_object_set (G_OBJECT (renderer),
+                "ellipsize", PANGO_ELLIPSIZE_MIDDLE,
+                NULL);
+  gtk_tree_view_column_pack_start (column, renderer, TRUE);
+  gtk_tree_view_column_set_attributes (column,
+                                       renderer,
+                                       "markup", GDU_DEVICE_TREE_MODEL_COLUMN_NAME,
+                                       NULL);
+
+  column = gtk_tree_view_column_new ();
+  /* Translators: Column header for the erase method used for each disk */
+  gtk_tree_view_column_set_title (column, C_("erase-multiple-disks", "Method"));
+  gtk_tree_view_append_column (GTK_TREE_VIEW (data->devices_treeview), column);
+
+  renderer = gtk_cell_renderer_text_new ();
+  gtk_tree_view_column_pack_start (column, renderer, FALSE);
+  gtk_tree_view_column_set_cell_data_func (column,
+                                           renderer,
+                                           method_cell_func,
+                                           data,
+                                           NULL); /* user_data GDestroyNotify */
+
+  column = gtk_tree_view_column_new ();
+  /* Translators: Column header for the progress of erasing each disk */
+  gtk_tree_view_column_set_title (column, C_("erase-multiple-disks", "Progress"));
+  gtk_tree_view_column_set_min_width (column, 120);
+  gtk_tree_view_append_column (GTK_TREE_VIEW (data->devices_treeview), column);
+
+  renderer = gtk_cell_renderer_progress_new ();
+  gtk_tree_view_column_pack_start (column, renderer, TRUE);
+  gtk_tree_view_column_set_cell_data_func (column,
+                                           renderer,
+                                           progress_cell_func,
+                                           data,
+                                           NULL); /* user_data GDestroyNotify */
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+static void
+update_dialog (DialogData *data)
+{
+  GHashTableIter hash_iter;
+  DeviceData *device;
+  DeviceData *failed = NULL;
+  GList *selected;
+  gchar *s;
+
+  if (data->closed)
+    goto out;
+
+  /* only report the first real error - the others may have been aborted */
+  g_hash_table_iter_init (&hash_iter, data->devices);
+  while (g_hash_table_iter_next (&hash_iter, NULL, (gpointer *) &device))
+    {
+      if (device->error != NULL &&
+          (failed == NULL || error_is_abort (failed->error)))
+        failed = device;
+    }
+
+  if (data->in_progress)
+    {
+      s = g_strdup_printf (g_dngettext (GETTEXT_PACKAGE,
+                                        "Erasing %u disk…",
+                                        "Erasing %u disks…",
+                                        data->num_running),
+                           data->num_running);
+      gtk_label_set_text (GTK_LABEL (data->status_label), s);
+      g_free (s);
+    }
+  else if (failed != NULL)
+    {
+      if (error_is_abort (failed->error))
+        {
+          gtk_label_set_text (GTK_LABEL (data->status_label), C_("erase-multiple-disks", "Erase aborted"));
+        }
+      else
+        {
+          /* Translators: The first %s is the device file, e.g. /dev/sdb, the second the error message */
+          s = g_strdup_printf (C_("erase-multiple-disks", "Error erasing %s: %s"),
+                               udisks_block_get_preferred_device (failed->block),
+                               failed->error->message);
+          gtk_label_set_text (GTK_LABEL (data->status_label), s);
+          g_free (s);
+        }
+    }
+  else if (g_hash_table_size (data->devices) > 0)
+    {
+      s = g_strdup_printf (g_dngettext (GETTEXT_PACKAGE,
+                                        "Erased %u disk",
+                                        "Erased %u disks",
+                                        g_hash_table_size (data->devices)),
+                           g_hash_table_size (data->devices));
+      gtk_label_set_text (GTK_LABEL (data->status_label), s);
+      g_free (s);
+    }
+  else
+    {
+      gtk_label_set_text (GTK_LABEL (data->status_label), "");
+    }
+
+  selected = gdu_device_tree_model_get_selected_blocks (data->model);
+  gtk_widget_set_sensitive (data->erase_button, selected != NULL);
+  g_list_free_full (selected, g_object_unref);
+
+  gtk_widget_set_visible (data->erase_button, !data->in_progress);
+  gtk_widget_set_visible (data->stop_button, data->in_progress);
+  gtk_widget_set_sensitive (data->erase_combobox, !data->in_progress);
+  gtk_widget_set_sensitive (data->verify_checkbutton, !data->in_progress);
+
+  gtk_widget_queue_draw (data->devices_treeview);
+
+ out:
+  ;
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+/* called on main / UI thread */
+static gboolean
+on_timeout (gpointer user_data)
+{
+  DialogData *data = user_data;
+
+  if (data->in_progress && !data->closed)
+    {
+      update_dialog (data);
+      return TRUE; /* keep running */
+    }
+
+  dialog_data_unref (data);
+  return FALSE; /* don't run again */
+}
+
+/* called on the erase thread */
+static void
+on_erase_progress (GduEstimator *estimator,
+                   gpointer      user_data)
+{
+  DeviceData *device = user_data;
+
+  g_mutex_lock (&device->data->lock);
+  device->fraction = ((gdouble) gdu_estimator_get_completed_bytes (estimator)) /
+    gdu_estimator_get_target_bytes (estimator);
+  g_mutex_unlock (&device->data->lock);
+}
+
+static void
+device_done (DeviceData *device,
+             GError     *error)
+{
+  DialogData *data = device->data;
+
+  device->state = DEVICE_STATE_DONE;
+  device->error = error;
+
+  data->num_running--;
+  if (data->num_running == 0)
+    data->in_progress = FALSE;
+
+  update_dialog (data);
+  dialog_data_unref (data);
+}
+
+static void
+verify_cb (GObject      *source_object,
+           GAsyncResult *res,
+           gpointer      user_data)
+{
+  DeviceData *device = user_data;
+  GError *error = NULL;
+
+  gdu_erase_finish (UDISKS_BLOCK (source_object), res, &error);
+  device_done (device, error);
+}
+
+/* called when @device has been erased - by us, udisks or the drive */
+static void
+erase_done (DeviceData *device)
+{
+  DialogData *data = device->data;
+
+  /* discarded blocks have already been checked by the erase thread */
+  if (!data->verify || device->method == GDU_ERASE_METHOD_DISCARD)
+    {
+      device_done (device, NULL);
+      return;
+    }
+
+  device->state = DEVICE_STATE_VERIFYING;
+  update_dialog (data);
+  gdu_erase_verify_block (device->block,
+                          device->method,
+                          data->cancellable,
+                          verify_cb,
+                          device);
+}
+
+static void
+format_cb (GObject      *source_object,
+           GAsyncResult *res,
+           gpointer      user_data)
+{
+  DeviceData *device = user_data;
+  GError *error = NULL;
+
+  if (!udisks_block_call_format_finish (UDISKS_BLOCK (source_object), res, &error))
+    {
+      device_done (device, error);
+      return;
+    }
+  erase_done (device);
+}
+
+#if UDISKS_CHECK_VERSION(2, 10, 0)
+static void
+sanitize_cb (GObject      *source_object,
+             GAsyncResult *res,
+             gpointer      user_data)
+{
+  DeviceData *device = user_data;
+  GError *error = NULL;
+
+  if (!gdu_erase_sanitize_finish (UDISKS_NVME_CONTROLLER (source_object), res, &error))
+    {
+      /* the controller may not support any of the Sanitize actions */
+      if (gdu_erase_error_is_rejection (error) &&
+          gdu_erase_get_fallback_method (device->block, device->method) != GDU_ERASE_METHOD_NONE)
+        {
+          g_clear_error (&error);
+          device->method = gdu_erase_get_fallback_method (device->block, device->method);
+          erase_device (device);
+          return;
+        }
+      device_done (device, error);
+      return;
+    }
+  erase_done (device);
+}
+#endif
+
+static void
+erase_cb (GObject      *source_object,
+          GAsyncResult *res,
+          gpointer      user_data)
+{
+  DeviceData *device = user_data;
+  GError *error = NULL;
+
+  if (!gdu_erase_finish (UDISKS_BLOCK (source_object), res, &error))
+    {
+      /* not every SSD returns zeroes or a fixed pattern for discarded blocks */
+      if (device->method == GDU_ERASE_METHOD_DISCARD &&
+          g_error_matches (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA))
+        {
+          g_clear_error (&error);
+          device->method = GDU_ERASE_METHOD_ZERO;
+          g_mutex_lock (&device->data->lock);
+          device->fraction = 0.0;
+          g_mutex_unlock (&device->data->lock);
+          erase_device (device);
+          return;
+        }
+      device_done (device, error);
+      return;
+    }
+  erase_done (device);
+}
+
+static void
+erase_device (DeviceData *device)
+{
+  DialogData *data = device->data;
+
+  device->state = DEVICE_STATE_ERASING;
+
+  if (gdu_erase_method_is_local (device->method))
+    {
+      /* verified separately so the progress shows it, see erase_done() */
+      gdu_erase_block (device->block,
+                       device->method,
+                       FALSE, /* verify */
+                       on_erase_progress,
+                       device,
+                       data->cancellable,
+                       erase_cb,
+                       device);
+    }
+#if UDISKS_CHECK_VERSION(2, 10, 0)
+  else if (device->method == GDU_ERASE_METHOD_NVME_SANITIZE)
+    {
+      /* aborting is done by canceling the job, see abort_erase() */
+      gdu_erase_sanitize (udisks_object_peek_nvme_controller (device->drive_object),
+                          NULL, /* GCancellable */
+                          sanitize_cb,
+                          device);
+    }
+#endif
+  else
+    {
+      GVariantBuilder options_builder;
+
+      g_variant_builder_init (&options_builder, G_VARIANT_TYPE_VARDICT);
+      g_variant_builder_add (&options_builder, "{sv}", "erase",
+                             g_variant_new_string (gdu_erase_method_get_udisks_type (device->method)));
+      udisks_block_call_format (device->block,
+                                "empty",
+                                g_variant_builder_end (&options_builder),
+                                NULL, /* GCancellable */
+                                format_cb,
+                                device);
+    }
+
+  update_dialog (data);
+}
+
+static void
+ensure_unused_cb (GduWindow     *window,
+                  GAsyncResult  *res,
+                  gpointer       user_data)
+{
+  DialogData *data = user_data;
+  GHashTableIter hash_iter;
+  DeviceData *device;
+  GError *error = NULL;
+
+  /* errors have already been shown by the window */
+  if (!gdu_window_ensure_unused_list_finish (window, res, &error))
+    {
+      g_hash_table_iter_init (&hash_iter, data->devices);
+      while (g_hash_table_iter_next (&hash_iter, NULL, (gpointer *) &device))
+        device_done (device, g_error_copy (error));
+      g_clear_error (&error);
+      goto out;
+    }
+
+  g_hash_table_iter_init (&hash_iter, data->devices);
+  while (g_hash_table_iter_next (&hash_iter, NULL, (gpointer *) &device))
+    erase_device (device);
+
+ out:
+  dialog_data_unref (data);
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+static void
+start_erase (DialogData *data)
+{
+  UDisksClient *client;
+  GList *blocks = NULL;
+  GList *objects = NULL;
+  GList *l;
+  GError *error = NULL;
+  gboolean have_secure_erase = FALSE;
+  GString *str = NULL;
+  DeviceData *device;
+
+  g_assert (!data->in_progress);
+
+  client = gdu_window_get_client (data->window);
+
+  blocks = gdu_device_tree_model_get_selected_blocks (data->model);
+  if (blocks == NULL)
+    goto out;
+
+  for (l = blocks; l != NULL; l = l->next)
+    {
+      UDisksBlock *block = UDISKS_BLOCK (l->data);
+      GduEraseMethod method;
+
+      if (udisks_block_get_read_only (block))
+        {
+          g_set_error (&error,
+                       G_IO_ERROR,
+                       G_IO_ERROR_READ_ONLY,
+                       /* Translators: %s is the device file, e.g. /dev/sdb */
+                       C_("erase-multiple-disks", "%s is read-only"),
+                       udisks_block_get_preferred_device (block));
+          gdu_utils_show_error (GTK_WINDOW (data->dialog),
+                                C_("erase-multiple-disks", "Error starting erase"),
+                                error);
+          g_clear_error (&error);
+          goto out;
+        }
+
+      method = get_method (data, block);
+      if (method == GDU_ERASE_METHOD_ATA_SECURE_ERASE ||
+          method == GDU_ERASE_METHOD_ATA_SECURE_ERASE_ENHANCED)
+        have_secure_erase = TRUE;
+
+      objects = g_list_append (objects, g_dbus_interface_get_object (G_DBUS_INTERFACE (block)));
+    }
+
+  /* Translators: warning used when erasing multiple disks */
+  str = g_string_new (_("All data on the selected disks will be erased and will likely not be recoverable by data recovery services"));
+  if (have_secure_erase)
+    {
+      g_string_append (str, "\n\n");
+      g_string_append (str, _("<b>WARNING</b>: The Secure Erase command may take a very long time to complete, can’t be canceled and may not work properly with some hardware. In the worst case, your drive may be rendered unusable or your system may crash or lock up. Before proceeding, please read the article about <a href='https://ata.wiki.kernel.org/index.php/ATA_Secure_Erase'>ATA Secure Erase</a> and make sure you understand the risks"));
+    }
+
+  if (!gdu_utils_show_confirmation (GTK_WINDOW (data->dialog),
+                                    g_dngettext (GETTEXT_PACKAGE,
+                                                 "Are you sure you want to erase the disk?",
+                                                 "Are you sure you want to erase the disks?",
+                                                 g_list_length (blocks)),
+                                    str->str,
+                                    _("_Erase"),
+                                    NULL, NULL,
+                                    client, objects))
+    goto out;
+
+  g_hash_table_remove_all (data->devices);
+  g_cancellable_reset (data->cancellable);
+  data->verify = gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (data->verify_checkbutton));
+  data->num_running = 0;
+
+  for (l = blocks; l != NULL; l = l->next)
+    {
+      UDisksBlock *block = UDISKS_BLOCK (l->data);
+      UDisksDrive *drive;
+
+      device = g_new0 (DeviceData, 1);
+      device->data = data;
+      device->block = g_object_ref (block);
+      device->object = (UDisksObject *) g_dbus_interface_dup_object (G_DBUS_INTERFACE (block));
+      drive = udisks_client_get_drive_for_block (client, block);
+      if (drive != NULL)
+        {
+          device->drive_object = (UDisksObject *) g_dbus_interface_dup_object (G_DBUS_INTERFACE (drive));
+          g_object_unref (drive);
+        }
+      device->method = get_method (data, block);
+      device->state = DEVICE_STATE_WAITING;
+
+      g_hash_table_insert (data->devices, device->block, device);
+      data->num_running++;
+
+      /* released in device_done() */
+      dialog_data_ref (data);
+    }
+
+  data->in_progress = TRUE;
+  g_timeout_add_seconds (1, on_timeout, dialog_data_ref (data));
+
+  /* ensure the disks are unused (e.g. unmounted) before erasing them... */
+  gdu_window_ensure_unused_list (data->window,
+                                 objects,
+                                 (GAsyncReadyCallback) ensure_unused_cb,
+                                 data->cancellable,
+                                 dialog_data_ref (data));
+
+ out:
+  if (str != NULL)
+    g_string_free (str, TRUE);
+  g_list_free (objects);
+  g_list_free_full (blocks, g_object_unref);
+  update_dialog (data);
+}
+
+static void
+abort_erase (DialogData *data)
+{
+  GHashTableIter hash_iter;
+  DeviceData *device;
+
+  g_cancellable_cancel (data->cancellable);
+
+  /* udisks carries on unless the jobs are canceled */
+  g_hash_table_iter_init (&hash_iter, data->devices);
+  while (g_hash_table_iter_next (&hash_iter, NULL, (gpointer *) &device))
+    {
+      GList *jobs;
+      GList *l;
+
+      if (device->state != DEVICE_STATE_ERASING || gdu_erase_method_is_local (device->method))
+        continue;
+
+      jobs = get_jobs (device);
+      for (l = jobs; l != NULL; l = l->next)
+        {
+          UDisksJob *job = UDISKS_JOB (l->data);
+          if (udisks_job_get_cancelable (job))
+            udisks_job_call_cancel (job,
+                                    g_variant_new ("a{sv}", NULL), /* options */
+                                    NULL, /* cancellable */
+                                    NULL, /* callback */
+                                    NULL); /* user_data */
+        }
+      g_list_free_full (jobs, g_object_unref);
+    }
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+void
+gdu_erase_multiple_disks_dialog_show (GduWindow *window)
+{
+  DialogData *data;
+  guint n;
+
+  data = g_new0 (DialogData, 1);
+  data->ref_count = 1;
+  data->window = g_object_ref (window);
+  data->cancellable = g_cancellable_new ();
+  data->devices = g_hash_table_new_full (g_direct_hash,
+                                         g_direct_equal,
+                                         NULL,
+                                         (GDestroyNotify) device_data_free);
+  g_mutex_init (&data->lock);
+
+  data->dialog = GTK_WIDGET (gdu_application_new_widget (gdu_window_get_application (window),
+                                                         "erase-multiple-disks-dialog.ui",
+                                                         "erase-multiple-disks-dialog",
+                                                         &data->builder));
+  for (n = 0; widget_mapping[n].name != NULL; n++)
+    {
+      gpointer *p = (gpointer *) ((char *) data + widget_mapping[n].offset);
+      *p = GTK_WIDGET (gtk_builder_get_object (data->builder, widget_mapping[n].name));
+    }
+
+  gtk_window_set_transient_for (GTK_WINDOW (data->dialog), GTK_WINDOW (window));
+
+  init_treeview (data);
+  g_signal_connect (data->erase_combobox,
+                    "changed",
+                    G_CALLBACK (on_erase_combobox_changed),
+                    data);
+
+  update_dialog (data);
+
+  while (TRUE)
+    {
+      gint response;
+      response = gtk_dialog_run (GTK_DIALOG (data->dialog));
+
+      if (response < 0)
+        break;
+
+      /* Keep in sync with .ui file */
+      switch (response)
+        {
+        case 0: /* erase */
+          start_erase (data);
+          break;
+
+        case 1: /* stop */
+          abort_erase (data);
+          break;
+
+        default:
+          g_assert_not_reached ();
+        }
+    }
+
+  dialog_data_close (data);
+}
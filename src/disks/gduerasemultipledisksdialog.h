@@ -0,0 +1,22 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*-
+ *
+ * Copyright (C) 2008-2013 Red Hat, Inc.
+ *
+ * Licensed under GPL version 2 or later.
+ *
+ * Author: David Zeuthen <zeuthen@gmail.com>
+ */
+
+#ifndef __GDU_ERASE_MULTIPLE_DISKS_DIALOG_H__
+#define __GDU_ERASE_MULTIPLE_DISKS_DIALOG_H__
+
+#include <gtk/gtk.h>
+#include "gdutypes.h"
+
+G_BEGIN_DECLS
+
+void   gdu_erase_multiple_disks_dialog_show (GduWindow *window);
+
+G_END_DECLS
+
+#endif /* __GDU_ERASE_MULTIPLE_DISKS_DIALOG_H__ */
@@ -0,0 +1,540 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*-
+ *
+ * Copyright (C) 2008-2013 Red Hat, Inc.
+ *
+ * Licensed under GPL version 2 or later.
+ *
+ * Author: David Zeuthen <zeuthen@gmail.com>
+ */
+
+#include "config.h"
+
+#include <glib/gi18n.h>
+
+#include "gduapplication.h"
+#include "gduwindow.h"
+#include "gdufilesystembenchmarkdialog.h"
+#include "gdubenchmark.h"
+
+/* Benchmarks the filesystem of a mounted volume, see
+ * gdu_filesystem_benchmark_run(). The results aren't saved - unlike
+ * the device they depend on how full and how fragmented the
+ * filesystem happens to be.
+ */
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+typedef struct
+{
+  volatile gint ref_count;
+
+  GduWindow *window;
+  UDisksObject *object;
+  gchar *directory;
+
+  GtkBuilder *builder;
+  GtkWidget *dialog;
+  GtkWidget *mount_point_label;
+  GtkWidget *num_samples_spinbutton;
+  GtkWidget *sample_size_spinbutton;
+  GtkWidget *num_files_spinbutton;
+  GtkWidget *direct_read_label;
+  GtkWidget *direct_write_label;
+  GtkWidget *direct_access_time_label;
+  GtkWidget *buffered_read_label;
+  GtkWidget *buffered_write_label;
+  GtkWidget *buffered_access_time_label;
+  GtkWidget *direct_random_write_label;
+  GtkWidget *buffered_random_write_label;
+  GtkWidget *create_label;
+  GtkWidget *delete_label;
+  GtkWidget *status_label;
+
+  GtkWidget *start_benchmark_button;
+  GtkWidget *stop_benchmark_button;
+
+  gboolean closed;
+
+  /* only used from the main / UI thread */
+  gboolean in_progress;
+
+  GCancellable *cancellable;
+
+  /* results are protected by the locks of the benchmark */
+  GduFilesystemBenchmark *bm;
+
+  /* protects the members below */
+  GMutex lock;
+  gboolean running;
+  GError *error;
+  gboolean update_timeout_pending;
+} DialogData;
+
+static const struct {
+  goffset offset;
+  const gchar *name;
+} widget_mapping[] = {
+  {G_STRUCT_OFFSET (DialogData, mount_point_label), "mount-point-label"},
+  {G_STRUCT_OFFSET (DialogData, num_samples_spinbutton), "num-samples-spinbutton"},
+  {G_STRUCT_OFFSET (DialogData, sample_size_spinbutton), "sample-size-spinbutton"},
+  {G_STRUCT_OFFSET (DialogData, num_files_spinbutton), "num-files-spinbutton"},
+  {G_STRUCT_OFFSET (DialogData, direct_read_label), "direct-read-label"},
+  {G_STRUCT_OFFSET (DialogData, direct_write_label), "direct-write-label"},
+  {G_STRUCT_OFFSET (DialogData, direct_access_time_label), "direct-access-time-label"},
+  {G_STRUCT_OFFSET (DialogData, buffered_read_label), "buffered-read-label"},
+  {G_STRUCT_OFFSET (DialogData, buffered_write_label), "buffered-write-label"},
+  {G_STRUCT_OFFSET (DialogData, buffered_access_time_label), "buffered-access-time-label"},
+  {G_STRUCT_OFFSET (DialogData, direct_random_write_label), "direct-random-write-label"},
+  {G_STRUCT_OFFSET (DialogData, buffered_random_write_label), "buffered-random-write-label"},
+  {G_STRUCT_OFFSET (DialogData, create_label), "create-label"},
+  {G_STRUCT_OFFSET (DialogData, delete_label), "delete-label"},
+  {G_STRUCT_OFFSET (DialogData, status_label), "status-label"},
+  {G_STRUCT_OFFSET (DialogData, start_benchmark_button), "start-benchmark-button"},
+  {G_STRUCT_OFFSET (DialogData, stop_benchmark_button), "stop-benchmark-button"},
+  {0, NULL}
+};
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+static DialogData *
+dialog_data_ref (DialogData *data)
+{
+  g_atomic_int_inc (&data->ref_count);
+  return data;
+}
+
+static void
+dialog_data_unref (DialogData *data)
+{
+  if (g_atomic_int_dec_and_test (&data->ref_count))
+    {
+      if (data->dialog != NULL)
+        {
+          gtk_widget_hide (data->dialog);
+          gtk_widget_destroy (data->dialog);
+          data->dialog = NULL;
+        }
+
+      g_clear_object (&data->window);
+      g_clear_object (&data->object);
+      g_clear_object (&data->builder);
+      g_clear_object (&data->cancellable);
+      gdu_filesystem_benchmark_free (data->bm);
+      g_clear_error (&data->error);
+      g_mutex_clear (&data->lock);
+      g_free (data->directory);
+
+      g_free (data);
+    }
+}
+
+static void
+dialog_data_close (DialogData *data)
+{
+  g_cancellable_cancel (data->cancellable);
+  data->closed = TRUE;
+  gtk_dialog_response (GTK_DIALOG (data->dialog), GTK_RESPONSE_CANCEL);
+  dialog_data_unref (data);
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+/* Sets the read rate, write rate and access time labels for @bm and
+ * returns how much of it is done, from 0.0 to 1.0
+ */
+static gdouble
+update_benchmark_labels (GduBenchmark *bm,
+                         gboolean      supported,
+                         GtkWidget    *read_label,
+                         GtkWidget    *write_label,
+                         GtkWidget    *access_time_label)
+{
+  gdouble read_avg, write_avg, access_time_avg;
+  guint num_done, num_total;
+  gchar *s;
+  gchar *s2;
+
+  if (!supported)
+    {
+      /* Translators: Shown instead of a result if the filesystem doesn't support O_DIRECT */
+      gtk_label_set_text (GTK_LABEL (read_label), C_("filesystem-benchmark", "Not supported"));
+      gtk_label_set_text (GTK_LABEL (write_label), C_("filesystem-benchmark", "Not supported"));
+      gtk_label_set_text (GTK_LABEL (access_time_label), C_("filesystem-benchmark", "Not supported"));
+      return 0.0;
+    }
+
+  gdu_benchmark_lock (bm);
+  gdu_benchmark_get_max_min_avg (bm->read_samples, bm->num_read_samples, NULL, NULL, &read_avg);
+  gdu_benchmark_get_max_min_avg (bm->write_samples, bm->num_write_samples, NULL, NULL, &write_avg);
+  gdu_benchmark_get_max_min_avg (bm->access_time_samples, bm->num_access_time_samples, NULL, NULL, &access_time_avg);
+  num_done = bm->num_read_samples + bm->num_write_samples + bm->num_access_time_samples;
+  num_total = bm->num_samples * 2 + bm->num_access_samples;
+  gdu_benchmark_unlock (bm);
+
+  if (read_avg > 0.0)
+    {
+      s2 = g_format_size ((guint64) read_avg);
+      /* Translators: %s is the formatted size, e.g. "42 MB" and the trailing "/s" means per second */
+      s = g_strdup_printf (C_("benchmark-transfer-rate", "%s/s"), s2);
+      gtk_label_set_text (GTK_LABEL (read_label), s);
+      g_free (s);
+      g_free (s2);
+    }
+  else
+    {
+      gtk_label_set_text (GTK_LABEL (read_label), "–");
+    }
+
+  if (write_avg > 0.0)
+    {
+      s2 = g_format_size ((guint64) write_avg);
+      /* Translators: %s is the formatted size, e.g. "42 MB" and the trailing "/s" means per second */
+      s = g_strdup_printf (C_("benchmark-transfer-rate", "%s/s"), s2);
+      gtk_label_set_text (GTK_LABEL (write_label), s);
+      g_free (s);
+      g_free (s2);
+    }
+  else
+    {
+      gtk_label_set_text (GTK_LABEL (write_label), "–");
+    }
+
+  if (access_time_avg > 0.0)
+    {
+      /* Translators: %d is number of milliseconds and msec means "milli-second" */
+      s = g_strdup_printf (C_("benchmark-access-time", "%.2f msec"), access_time_avg * 1000.0);
+      gtk_label_set_text (GTK_LABEL (access_time_label), s);
+      g_free (s);
+    }
+  else
+    {
+      gtk_label_set_text (GTK_LABEL (access_time_label), "–");
+    }
+
+  return num_total > 0 ? ((gdouble) num_done) / num_total : 0.0;
+}
+
+static void
+set_random_write_time (GtkWidget *label,
+                       gboolean   supported,
+                       gdouble    time)
+{
+  gchar *s;
+
+  if (!supported)
+    {
+      gtk_label_set_text (GTK_LABEL (label), C_("filesystem-benchmark", "Not supported"));
+    }
+  else if (time > 0.0)
+    {
+      /* Translators: %d is number of milliseconds and msec means "milli-second" */
+      s = g_strdup_printf (C_("benchmark-access-time", "%.2f msec"), time * 1000.0);
+      gtk_label_set_text (GTK_LABEL (label), s);
+      g_free (s);
+    }
+  else
+    {
+      gtk_label_set_text (GTK_LABEL (label), "–");
+    }
+}
+
+static void
+set_files_rate (GtkWidget *label,
+                gdouble    files_per_sec)
+{
+  gchar *s;
+
+  if (files_per_sec > 0.0)
+    {
+      /* Translators: %.0f is the number of files created or deleted per second */
+      s = g_strdup_printf (C_("filesystem-benchmark", "%.0f files/s"), files_per_sec);
+      gtk_label_set_text (GTK_LABEL (label), s);
+      g_free (s);
+    }
+  else
+    {
+      gtk_label_set_text (GTK_LABEL (label), "–");
+    }
+}
+
+static void
+update_dialog (DialogData *data)
+{
+  GduFilesystemBenchmarkState state;
+  gboolean direct_supported;
+  gdouble direct_random_write_time, buffered_random_write_time;
+  gdouble create_rate, delete_rate;
+  gdouble direct_done, buffered_done;
+  gint num_files_done, num_files, num_random_writes;
+  GError *error = NULL;
+  gchar *s = NULL;
+
+  if (data->closed)
+    goto out;
+
+  gdu_filesystem_benchmark_lock (data->bm);
+  state = data->bm->state;
+  /* only claim O_DIRECT is unsupported once the benchmark got past it */
+  direct_supported = data->bm->direct_supported ||
+                     (state < GDU_FILESYSTEM_BENCHMARK_STATE_BUFFERED &&
+                      data->bm->time_benchmarked_usec == 0);
+  direct_random_write_time = data->bm->direct_random_write_time;
+  buffered_random_write_time = data->bm->buffered_random_write_time;
+  create_rate = data->bm->create_rate;
+  delete_rate = data->bm->delete_rate;
+  num_files_done = data->bm->num_files_done;
+  num_files = data->bm->num_files;
+  num_random_writes = data->bm->num_access_samples;
+  gdu_filesystem_benchmark_unlock (data->bm);
+
+  g_mutex_lock (&data->lock);
+  if (data->error != NULL)
+    error = g_error_copy (data->error);
+  g_mutex_unlock (&data->lock);
+
+  direct_done = update_benchmark_labels (data->bm->direct,
+                                         direct_supported,
+                                         data->direct_read_label,
+                                         data->direct_write_label,
+                                         data->direct_access_time_label);
+  buffered_done = update_benchmark_labels (data->bm->buffered,
+                                           TRUE,
+                                           data->buffered_read_label,
+                                           data->buffered_write_label,
+                                           data->buffered_access_time_label);
+  set_random_write_time (data->direct_random_write_label, direct_supported, direct_random_write_time);
+  set_random_write_time (data->buffered_random_write_label, TRUE, buffered_random_write_time);
+  set_files_rate (data->create_label, create_rate);
+  set_files_rate (data->delete_label, delete_rate);
+
+  switch (state)
+    {
+    case GDU_FILESYSTEM_BENCHMARK_STATE_PREPARING:
+      s = g_strdup (C_("filesystem-benchmark", "Creating test file…"));
+      break;
+
+    case GDU_FILESYSTEM_BENCHMARK_STATE_DIRECT:
+      /* Translators: %2.1f is the percentage done */
+      s = g_strdup_printf (C_("filesystem-benchmark", "Measuring with direct I/O (%2.1f%% complete)…"),
+                           direct_done * 100.0);
+      break;
+
+    case GDU_FILESYSTEM_BENCHMARK_STATE_BUFFERED:
+      /* Translators: %2.1f is the percentage done */
+      s = g_strdup_printf (C_("filesystem-benchmark", "Measuring with buffered I/O (%2.1f%% complete)…"),
+                           buffered_done * 100.0);
+      break;
+
+    case GDU_FILESYSTEM_BENCHMARK_STATE_RANDOM_WRITES:
+      /* Translators: The first %d is the number of writes done so far, the second the total */
+      s = g_strdup_printf (C_("filesystem-benchmark", "Writing at random offsets (%d of %d)…"),
+                           num_files_done, num_random_writes);
+      break;
+
+    case GDU_FILESYSTEM_BENCHMARK_STATE_CREATING_FILES:
+      /* Translators: The first %d is the number of files created so far, the second the total */
+      s = g_strdup_printf (C_("filesystem-benchmark", "Creating files (%d of %d)…"),
+                           num_files_done, num_files);
+      break;
+
+    case GDU_FILESYSTEM_BENCHMARK_STATE_DELETING_FILES:
+      /* Translators: The first %d is the number of files deleted so far, the second the total */
+      s = g_strdup_printf (C_("filesystem-benchmark", "Deleting files (%d of %d)…"),
+                           num_files_done, num_files);
+      break;
+
+    case GDU_FILESYSTEM_BENCHMARK_STATE_NONE:
+      if (error != NULL)
+        {
+          if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+            s = g_strdup (C_("filesystem-benchmark", "Benchmark aborted"));
+          else
+            s = g_strdup (error->message);
+        }
+      break;
+
+    default:
+      g_assert_not_reached ();
+    }
+  gtk_label_set_text (GTK_LABEL (data->status_label), s != NULL ? s : "");
+
+  gtk_widget_set_visible (data->start_benchmark_button, !data->in_progress);
+  gtk_widget_set_visible (data->stop_benchmark_button, data->in_progress);
+  gtk_widget_set_sensitive (data->num_samples_spinbutton, !data->in_progress);
+  gtk_widget_set_sensitive (data->sample_size_spinbutton, !data->in_progress);
+  gtk_widget_set_sensitive (data->num_files_spinbutton, !data->in_progress);
+
+ out:
+  g_free (s);
+  g_clear_error (&error);
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+/* called on main / UI thread */
+static gboolean
+bmt_on_timeout (gpointer user_data)
+{
+  DialogData *data = user_data;
+
+  g_mutex_lock (&data->lock);
+  data->update_timeout_pending = FALSE;
+  if (!data->running)
+    data->in_progress = FALSE;
+  g_mutex_unlock (&data->lock);
+
+  update_dialog (data);
+  dialog_data_unref (data);
+  return FALSE; /* don't run again */
+}
+
+static void
+bmt_schedule_update (DialogData *data)
+{
+  /* rate-limit updates */
+  g_mutex_lock (&data->lock);
+  if (!data->update_timeout_pending)
+    {
+      g_timeout_add (200, /* ms */
+                     bmt_on_timeout,
+                     dialog_data_ref (data));
+      data->update_timeout_pending = TRUE;
+    }
+  g_mutex_unlock (&data->lock);
+}
+
+/* called on the benchmark thread */
+static void
+bmt_on_update (GduFilesystemBenchmark *benchmark,
+               gpointer                user_data)
+{
+  bmt_schedule_update (user_data);
+}
+
+static gpointer
+benchmark_thread (gpointer user_data)
+{
+  DialogData *data = user_data;
+  GError *error = NULL;
+
+  gdu_filesystem_benchmark_run (data->bm,
+                                data->directory,
+                                data->cancellable,
+                                bmt_on_update,
+                                data,
+                                &error);
+
+  g_mutex_lock (&data->lock);
+  data->error = error;
+  data->running = FALSE;
+  g_mutex_unlock (&data->lock);
+
+  bmt_schedule_update (data);
+  dialog_data_unref (data);
+  return NULL;
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+static void
+start_benchmark (DialogData *data)
+{
+  g_assert (!data->in_progress);
+
+  data->bm->num_samples = gtk_spin_button_get_value (GTK_SPIN_BUTTON (data->num_samples_spinbutton));
+  data->bm->sample_size_mib = gtk_spin_button_get_value (GTK_SPIN_BUTTON (data->sample_size_spinbutton));
+  data->bm->num_files = gtk_spin_button_get_value (GTK_SPIN_BUTTON (data->num_files_spinbutton));
+  data->bm->num_access_samples = 1000;
+
+  g_cancellable_reset (data->cancellable);
+  g_mutex_lock (&data->lock);
+  g_clear_error (&data->error);
+  data->running = TRUE;
+  g_mutex_unlock (&data->lock);
+  data->in_progress = TRUE;
+
+  g_thread_unref (g_thread_new ("filesystem-benchmark-thread",
+                                benchmark_thread,
+                                dialog_data_ref (data)));
+
+  update_dialog (data);
+}
+
+static void
+abort_benchmark (DialogData *data)
+{
+  g_cancellable_cancel (data->cancellable);
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+void
+gdu_filesystem_benchmark_dialog_show (GduWindow    *window,
+                                      UDisksObject *object)
+{
+  DialogData *data;
+  UDisksFilesystem *filesystem;
+  const gchar *const *mount_points;
+  gchar *s;
+  guint n;
+
+  filesystem = udisks_object_peek_filesystem (object);
+  g_return_if_fail (filesystem != NULL);
+  mount_points = udisks_filesystem_get_mount_points (filesystem);
+  g_return_if_fail (mount_points != NULL && mount_points[0] != NULL);
+
+  data = g_new0 (DialogData, 1);
+  data->ref_count = 1;
+  data->window = g_object_ref (window);
+  data->object = g_object_ref (object);
+  data->directory = g_strdup (mount_points[0]);
+  data->cancellable = g_cancellable_new ();
+  data->bm = gdu_filesystem_benchmark_new ();
+  g_mutex_init (&data->lock);
+
+  data->dialog = GTK_WIDGET (gdu_application_new_widget (gdu_window_get_application (window),
+                                                         "filesystem-benchmark-dialog.ui",
+                                                         "filesystem-benchmark-dialog",
+                                                         &data->builder));
+  for (n = 0; widget_mapping[n].name != NULL; n++)
+    {
+      gpointer *p = (gpointer *) ((char *) data + widget_mapping[n].offset);
+      *p = GTK_WIDGET (gtk_builder_get_object (data->builder, widget_mapping[n].name));
+    }
+
+  gtk_window_set_transient_for (GTK_WINDOW (data->dialog), GTK_WINDOW (window));
+
+  /* Translators: %s is the mount point, e.g. /media/foobar */
+  s = g_strdup_printf (C_("filesystem-benchmark", "Measures the filesystem mounted at %s using temporary files that are removed afterwards. The test file is as big as the number of samples times the sample size."),
+                       data->directory);
+  gtk_label_set_text (GTK_LABEL (data->mount_point_label), s);
+  g_free (s);
+
+  update_dialog (data);
+
+  while (TRUE)
+    {
+      gint response;
+      response = gtk_dialog_run (GTK_DIALOG (data->dialog));
+
+      if (response < 0)
+        break;
+
+      /* Keep in sync with .ui file */
+      switch (response)
+        {
+        case 0: /* start benchmark */
+          start_benchmark (data);
+          break;
+
+        case 1: /* abort benchmark */
+          abort_benchmark (data);
+          break;
+
+        default:
+          g_assert_not_reached ();
+        }
+    }
+
+  dialog_data_close (data);
+}
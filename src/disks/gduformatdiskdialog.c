@@ -15,6 +15,9 @@
 #include "gduwindow.h"
 #include "gduformatdiskdialog.h"
 #include "gduvolumegrid.h"
+#include "gduerase.h"
+#include "gdulocaljob.h"
+#include "gduestimator.h"
 
 /* ---------------------------------------------------------------------------------------------------- */
 
@@ -39,6 +42,18 @@ typedef struct
   GtkWidget *dialog;
   GtkWidget *type_combobox;
   GtkWidget *erase_combobox;
+
+  /* only used when erasing locally, see gdu_erase_method_is_local() */
+  GduEraseMethod method;
+  GduLocalJob *local_job;
+  GCancellable *cancellable;
+  guint update_id;
+  /* must hold lock when reading/writing these */
+  GMutex lock;
+  guint64 bytes_completed;
+  guint64 bytes_target;
+  guint64 bytes_per_sec;
+  guint64 usec_remaining;
 } FormatDiskData;
 
 static void
@@ -56,6 +71,8 @@ format_disk_data_free (FormatDiskData *data)
     }
   if (data->builder != NULL)
     g_object_unref (data->builder);
+  g_clear_object (&data->cancellable);
+  g_mutex_clear (&data->lock);
   g_free (data);
 }
 
@@ -124,6 +141,7 @@ populate_erase_combobox (FormatDiskData *data)
   GtkListStore *model;
   GtkCellRenderer *renderer;
   gchar *s, *s2;
+  gint64 duration_usec;
 
   model = gtk_list_store_new (MODEL_N_COLUMNS,
                               G_TYPE_STRING,
@@ -157,15 +175,84 @@ populate_erase_combobox (FormatDiskData *data)
   g_free (s);
 
   /* Full */
+  duration_usec = gdu_erase_estimate_duration_usec (gdu_window_get_client (data->window),
+                                                    data->block,
+                                                    GDU_ERASE_METHOD_ZERO);
+  if (duration_usec > 0)
+    s2 = get_erase_duration_string (MAX (duration_usec / (60LL * G_USEC_PER_SEC), 1));
+  else
+    s2 = g_strdup (_("Slow"));
   s = g_strdup_printf ("%s <span size=\"small\">(%s)</span>",
                        _("Overwrite existing data with zeroes"),
-                       _("Slow"));
+                       s2);
   gtk_list_store_insert_with_values (model, NULL /* out_iter */, G_MAXINT, /* position */
                                      MODEL_COLUMN_ID, "zero",
                                      MODEL_COLUMN_MARKUP, s,
                                      MODEL_COLUMN_SENSITIVE, TRUE,
                                      -1);
   g_free (s);
+  g_free (s2);
+
+  /* Discarding is only as good as what the disk returns for discarded
+   * blocks - this is checked afterwards, see gduerase.c
+   */
+  if (data->drive != NULL &&
+      (gdu_utils_is_flash (data->drive) || udisks_drive_get_rotation_rate (data->drive) == 0) &&
+      gdu_erase_block_supports_discard (data->block))
+    {
+      /* usually done in seconds, so don't round to minutes - the
+       * estimate is a heuristic, see gdu_erase_estimate_duration_usec()
+       */
+      duration_usec = gdu_erase_estimate_duration_usec (gdu_window_get_client (data->window),
+                                                        data->block,
+                                                        GDU_ERASE_METHOD_DISCARD);
+      if (duration_usec > 0)
+        {
+          gchar *s3 = gdu_utils_format_duration_usec (MAX (duration_usec, G_USEC_PER_SEC),
+                                                      GDU_FORMAT_DURATION_FLAGS_NONE);
+          /* Translators: Used to convey that something takes roughly
+           * some specificed duration, derived from what the disk reports
+           * rather than measured. The %s is a time duration e.g. "5 seconds"
+           */
+          s2 = g_strdup_printf (C_("discard-duration", "About %s"), s3);
+          g_free (s3);
+        }
+      else
+        {
+          s2 = g_strdup (_("Fast"));
+        }
+      s = g_strdup_printf ("%s <span size=\"small\">(%s)</span>",
+                           gdu_erase_method_get_name (GDU_ERASE_METHOD_DISCARD),
+                           s2);
+      gtk_list_store_insert_with_values (model, NULL /* out_iter */, G_MAXINT, /* position */
+                                         MODEL_COLUMN_ID, "discard",
+                                         MODEL_COLUMN_MARKUP, s,
+                                         MODEL_COLUMN_SENSITIVE, TRUE,
+                                         -1);
+      g_free (s);
+      g_free (s2);
+    }
+
+#if UDISKS_CHECK_VERSION(2, 10, 0)
+  if (gdu_erase_get_fastest_method (gdu_window_get_client (data->window), data->block) == GDU_ERASE_METHOD_NVME_SANITIZE)
+    {
+      /* separator */
+      gtk_list_store_insert_with_values (model, NULL /* out_iter */, G_MAXINT, /* position */
+                                         MODEL_COLUMN_SEPARATOR, TRUE,
+                                         MODEL_COLUMN_SENSITIVE, TRUE,
+                                         -1);
+
+      s = g_strdup_printf ("%s <span size=\"small\">(%s)</span>",
+                           gdu_erase_method_get_name (GDU_ERASE_METHOD_NVME_SANITIZE),
+                           _("Fast"));
+      gtk_list_store_insert_with_values (model, NULL /* out_iter */, G_MAXINT, /* position */
+                                         MODEL_COLUMN_ID, "nvme-sanitize",
+                                         MODEL_COLUMN_MARKUP, s,
+                                         MODEL_COLUMN_SENSITIVE, TRUE,
+                                         -1);
+      g_free (s);
+    }
+#endif
 
   /* TODO: include 7-pass and 35-pass (DoD 5220-22 M) */
 
@@ -330,6 +417,257 @@ format_cb (GObject      *source_object,
   format_disk_data_free (data);
 }
 
+static void
+format_disk (FormatDiskData *data,
+             const gchar    *erase_type)
+{
+  const gchar *partition_table_type;
+  GVariantBuilder options_builder;
+
+  partition_table_type = gtk_combo_box_get_active_id (GTK_COMBO_BOX (data->type_combobox));
+
+  g_variant_builder_init (&options_builder, G_VARIANT_TYPE_VARDICT);
+  if (erase_type != NULL && strlen (erase_type) > 0)
+    g_variant_builder_add (&options_builder, "{sv}", "erase", g_variant_new_string (erase_type));
+  udisks_block_call_format (data->block,
+                            partition_table_type,
+                            g_variant_builder_end (&options_builder),
+                            NULL, /* GCancellable */
+                            format_cb,
+                            data);
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+static gboolean
+on_update_job (gpointer user_data)
+{
+  FormatDiskData *data = user_data;
+  gdouble progress = 0.0;
+
+  g_mutex_lock (&data->lock);
+  udisks_job_set_bytes (UDISKS_JOB (data->local_job), data->bytes_target);
+  udisks_job_set_rate (UDISKS_JOB (data->local_job), data->bytes_per_sec);
+  if (data->bytes_target != 0)
+    progress = ((gdouble) data->bytes_completed) / ((gdouble) data->bytes_target);
+  udisks_job_set_progress (UDISKS_JOB (data->local_job), progress);
+  if (data->usec_remaining == 0)
+    udisks_job_set_expected_end_time (UDISKS_JOB (data->local_job), 0);
+  else
+    udisks_job_set_expected_end_time (UDISKS_JOB (data->local_job), data->usec_remaining + g_get_real_time ());
+  g_mutex_unlock (&data->lock);
+
+  return TRUE; /* keep running */
+}
+
+/* called on the erase thread */
+static void
+on_erase_progress (GduEstimator *estimator,
+                   gpointer      user_data)
+{
+  FormatDiskData *data = user_data;
+
+  g_mutex_lock (&data->lock);
+  data->bytes_completed = gdu_estimator_get_completed_bytes (estimator);
+  data->bytes_target = gdu_estimator_get_target_bytes (estimator);
+  data->bytes_per_sec = gdu_estimator_get_bytes_per_sec (estimator);
+  data->usec_remaining = gdu_estimator_get_usec_remaining (estimator);
+  g_mutex_unlock (&data->lock);
+}
+
+static void
+on_local_job_canceled (GduLocalJob  *job,
+                       gpointer      user_data)
+{
+  FormatDiskData *data = user_data;
+  g_cancellable_cancel (data->cancellable);
+}
+
+static void erase_disk (FormatDiskData *data,
+                        GduEraseMethod  method);
+
+/* Overwriting takes much longer than discarding or sanitizing, so don't
+ * switch without asking - @reason says why the other method didn't work
+ */
+static gboolean
+confirm_overwrite (FormatDiskData *data,
+                   const gchar    *reason)
+{
+  gboolean ret;
+  GList *objects;
+  gint64 duration_usec;
+  gchar *duration;
+  gchar *secondary;
+
+  duration_usec = gdu_erase_estimate_duration_usec (gdu_window_get_client (data->window),
+                                                    data->block,
+                                                    GDU_ERASE_METHOD_ZERO);
+  if (duration_usec > 0)
+    {
+      gchar *s = gdu_utils_format_duration_usec (MAX (duration_usec, 60LL * G_USEC_PER_SEC),
+                                                 GDU_FORMAT_DURATION_FLAGS_NO_SECONDS);
+      /* Translators: Follows the reason why the disk has to be overwritten.
+       * The %s is a time duration e.g. "2 hours and 2 minutes"
+       */
+      duration = g_strdup_printf (_("Overwriting it with zeroes erases all data but takes approximately %s."), s);
+      g_free (s);
+    }
+  else
+    {
+      /* Translators: Follows the reason why the disk has to be overwritten */
+      duration = g_strdup (_("Overwriting it with zeroes erases all data but may take a long time."));
+    }
+  secondary = g_strdup_printf ("%s %s", reason, duration);
+
+  objects = g_list_append (NULL, data->object);
+  ret = gdu_utils_show_confirmation (GTK_WINDOW (data->window),
+                                     _("Overwrite the disk with zeroes?"),
+                                     secondary,
+                                     _("_Overwrite"),
+                                     NULL, NULL,
+                                     gdu_window_get_client (data->window), objects);
+  g_list_free (objects);
+  g_free (secondary);
+  g_free (duration);
+  return ret;
+}
+
+static void
+erase_cb (GObject      *source_object,
+          GAsyncResult *res,
+          gpointer      user_data)
+{
+  FormatDiskData *data = user_data;
+  GError *error = NULL;
+
+  g_source_remove (data->update_id);
+  data->update_id = 0;
+  gdu_application_destroy_local_job (gdu_window_get_application (data->window), data->local_job);
+  data->local_job = NULL;
+  g_clear_object (&data->cancellable);
+
+  if (!gdu_erase_finish (UDISKS_BLOCK (source_object), res, &error))
+    {
+      /* not every SSD returns zeroes or a fixed pattern for discarded blocks */
+      if (data->method == GDU_ERASE_METHOD_DISCARD &&
+          g_error_matches (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA))
+        {
+          g_error_free (error);
+          /* Translators: Shown when discarded blocks of a disk still hold data */
+          if (confirm_overwrite (data, _("The disk doesn’t reliably erase discarded blocks.")))
+            erase_disk (data, GDU_ERASE_METHOD_ZERO);
+          else
+            format_disk_data_free (data);
+          return;
+        }
+
+      if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        gdu_utils_show_error (GTK_WINDOW (data->window), _("Error erasing disk"), error);
+      g_error_free (error);
+      format_disk_data_free (data);
+      return;
+    }
+
+  format_disk (data, NULL);
+}
+
+static void
+erase_disk (FormatDiskData *data,
+            GduEraseMethod  method)
+{
+  data->method = method;
+  data->bytes_completed = 0;
+  data->bytes_target = 0;
+  data->bytes_per_sec = 0;
+  data->usec_remaining = 0;
+
+  data->local_job = gdu_application_create_local_job (gdu_window_get_application (data->window),
+                                                      data->object);
+  if (method == GDU_ERASE_METHOD_DISCARD)
+    {
+      udisks_job_set_operation (UDISKS_JOB (data->local_job), "x-gdu-discard");
+      /* Translators: this is the description of the job */
+      gdu_local_job_set_description (data->local_job, _("Discarding Blocks"));
+    }
+  else
+    {
+      udisks_job_set_operation (UDISKS_JOB (data->local_job), "x-gdu-erase-zero");
+      /* Translators: this is the description of the job */
+      gdu_local_job_set_description (data->local_job, _("Erasing Disk"));
+    }
+  udisks_job_set_progress_valid (UDISKS_JOB (data->local_job), TRUE);
+  udisks_job_set_cancelable (UDISKS_JOB (data->local_job), TRUE);
+  g_signal_connect (data->local_job, "canceled",
+                    G_CALLBACK (on_local_job_canceled),
+                    data);
+
+  data->cancellable = g_cancellable_new ();
+  data->update_id = g_timeout_add (200, /* ms */
+                                   on_update_job,
+                                   data);
+  gdu_erase_block (data->block,
+                   method,
+                   TRUE, /* verify */
+                   on_erase_progress,
+                   data,
+                   data->cancellable,
+                   erase_cb,
+                   data);
+}
+
+#if UDISKS_CHECK_VERSION(2, 10, 0)
+static void
+sanitize_cb (GObject      *source_object,
+             GAsyncResult *res,
+             gpointer      user_data)
+{
+  FormatDiskData *data = user_data;
+  GduEraseMethod method;
+  GError *error = NULL;
+
+  if (!gdu_erase_sanitize_finish (UDISKS_NVME_CONTROLLER (source_object),
+                                  res,
+                                  &error))
+    {
+      /* the controller may not support any of the Sanitize actions */
+      method = GDU_ERASE_METHOD_NONE;
+      if (gdu_erase_error_is_rejection (error))
+        method = gdu_erase_get_fallback_method (data->block, GDU_ERASE_METHOD_NVME_SANITIZE);
+
+      if (method == GDU_ERASE_METHOD_DISCARD ||
+          /* Translators: Shown when an NVMe disk refused to sanitize itself */
+          (method == GDU_ERASE_METHOD_ZERO && confirm_overwrite (data, _("The disk doesn’t support the Sanitize command."))))
+        {
+          g_error_free (error);
+          erase_disk (data, method);
+          return;
+        }
+
+      if (method == GDU_ERASE_METHOD_NONE &&
+          !(g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED) ||
+            g_error_matches (error, UDISKS_ERROR, UDISKS_ERROR_CANCELLED)))
+        gdu_utils_show_error (GTK_WINDOW (data->window), _("Error sanitizing disk"), error);
+      g_error_free (error);
+      format_disk_data_free (data);
+      return;
+    }
+
+  format_disk (data, NULL);
+}
+
+static void
+sanitize_disk (FormatDiskData *data)
+{
+  GDBusObject *drive_object;
+
+  /* the job shows up on the drive */
+  drive_object = g_dbus_interface_get_object (G_DBUS_INTERFACE (data->drive));
+  gdu_erase_sanitize (udisks_object_peek_nvme_controller (UDISKS_OBJECT (drive_object)),
+                      NULL, /* GCancellable */
+                      sanitize_cb,
+                      data);
+}
+#endif
 
 static void
 ensure_unused_cb (GduWindow     *window,
@@ -337,10 +675,7 @@ ensure_unused_cb (GduWindow     *window,
                   gpointer       user_data)
 {
   FormatDiskData *data = user_data;
-  const gchar *partition_table_type;
   const gchar *erase_type;
-  GVariantBuilder options_builder;
-
 
   if (!gdu_window_ensure_unused_finish (window, res, NULL))
     {
@@ -348,18 +683,19 @@ ensure_unused_cb (GduWindow     *window,
       goto out;
     }
 
-  partition_table_type = gtk_combo_box_get_active_id (GTK_COMBO_BOX (data->type_combobox));
   erase_type = gtk_combo_box_get_active_id (GTK_COMBO_BOX (data->erase_combobox));
 
-  g_variant_builder_init (&options_builder, G_VARIANT_TYPE_VARDICT);
-  if (strlen (erase_type) > 0)
-    g_variant_builder_add (&options_builder, "{sv}", "erase", g_variant_new_string (erase_type));
-  udisks_block_call_format (data->block,
-                            partition_table_type,
-                            g_variant_builder_end (&options_builder),
-                            NULL, /* GCancellable */
-                            format_cb,
-                            data);
+  /* these are carried out before creating the partition table */
+  if (g_strcmp0 (erase_type, "zero") == 0)
+    erase_disk (data, GDU_ERASE_METHOD_ZERO);
+  else if (g_strcmp0 (erase_type, "discard") == 0)
+    erase_disk (data, GDU_ERASE_METHOD_DISCARD);
+#if UDISKS_CHECK_VERSION(2, 10, 0)
+  else if (g_strcmp0 (erase_type, "nvme-sanitize") == 0)
+    sanitize_disk (data);
+#endif
+  else
+    format_disk (data, erase_type);
 
  out:
   ;
@@ -373,6 +709,7 @@ gdu_format_disk_dialog_show (GduWindow    *window,
   gint response;
 
   data = g_new0 (FormatDiskData, 1);
+  g_mutex_init (&data->lock);
   data->window = g_object_ref (window);
   data->object = g_object_ref (object);
   data->block = udisks_object_get_block (object);
@@ -422,6 +759,11 @@ gdu_format_disk_dialog_show (GduWindow    *window,
           g_string_append (str, "\n\n");
           g_string_append (str, _("<b>Tip</b>: If you are planning to recycle, sell or give away your old computer or disk, you should use a more thorough erase type to keep your private information from falling into the wrong hands"));
         }
+      else if (g_strcmp0 (erase_type, "discard") == 0 || g_strcmp0 (erase_type, "nvme-sanitize") == 0)
+        {
+          /* Translators: warning used when the disk erases the data itself */
+          str = g_string_new (_("All data on the disk will be erased and will likely not be recoverable by data recovery services"));
+        }
       else
         {
           /* Translators: warning used when overwriting data */
@@ -0,0 +1,817 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*-
+ *
+ * Copyright (C) 2008-2013 Red Hat, Inc.
+ *
+ * Licensed under GPL version 2 or later.
+ *
+ * Author: David Zeuthen <zeuthen@gmail.com>
+ */
+
+#include "config.h"
+
+#include <glib/gi18n.h>
+
+#include <unistd.h>
+
+#include "gduapplication.h"
+#include "gduwindow.h"
+#include "gdudevicetreemodel.h"
+#include "gdumultibenchmarkdialog.h"
+#include "gdubenchmark.h"
+
+/* Benchmarks several disks at the same time. Each disk gets its own
+ * benchmark thread but the threads are kept in lock-step: none of them
+ * starts before all disks have been opened and none of them starts on
+ * a sample before the others have finished the previous one. This way
+ * the transfers actually overlap and the sum of the per-disk rates is
+ * what the controller, expander or bus shared by the disks can sustain.
+ */
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+typedef struct DialogData DialogData;
+
+typedef struct
+{
+  DialogData *data;
+
+  UDisksBlock *block;
+  UDisksObject *object;
+
+  /* the concurrent run - results protected by the lock of the benchmark */
+  GduBenchmark *bm;
+
+  /* the last run of the disk on its own, if any */
+  GduBenchmark *alone;
+
+  /* must hold data->lock when reading/writing this */
+  GError *error;
+} DeviceData;
+
+struct DialogData
+{
+  volatile gint ref_count;
+
+  GduWindow *window;
+  GtkBuilder *builder;
+
+  GtkWidget *dialog;
+  GtkWidget *devices_treeview;
+  GtkWidget *num_samples_spinbutton;
+  GtkWidget *sample_size_spinbutton;
+  GtkWidget *write_checkbutton;
+  GtkWidget *aggregate_read_label;
+  GtkWidget *aggregate_write_label;
+  GtkWidget *status_label;
+
+  GtkWidget *start_benchmark_button;
+  GtkWidget *stop_benchmark_button;
+
+  GduDeviceTreeModel *model;
+
+  gboolean closed;
+
+  /* UDisksBlock -> DeviceData for the disks in the current or last run -
+   * only used from the main / UI thread
+   */
+  GHashTable *devices;
+  gboolean in_progress;
+
+  GCancellable *cancellable;
+
+  /* protects the members below as well as the error of each DeviceData */
+  GMutex lock;
+  GCond cond;
+  guint num_opening;        /* threads still opening their disk */
+  guint num_running;        /* threads not yet done */
+  guint barrier_count;      /* threads waiting for the others to finish a sample */
+  guint barrier_generation;
+  gboolean update_timeout_pending;
+};
+
+static const struct {
+  goffset offset;
+  const gchar *name;
+} widget_mapping[] = {
+  {G_STRUCT_OFFSET (DialogData, devices_treeview), "devices-treeview"},
+  {G_STRUCT_OFFSET (DialogData, num_samples_spinbutton), "num-samples-spinbutton"},
+  {G_STRUCT_OFFSET (DialogData, sample_size_spinbutton), "sample-size-spinbutton"},
+  {G_STRUCT_OFFSET (DialogData, write_checkbutton), "write-checkbutton"},
+  {G_STRUCT_OFFSET (DialogData, aggregate_read_label), "aggregate-read-label"},
+  {G_STRUCT_OFFSET (DialogData, aggregate_write_label), "aggregate-write-label"},
+  {G_STRUCT_OFFSET (DialogData, status_label), "status-label"},
+  {G_STRUCT_OFFSET (DialogData, start_benchmark_button), "start-benchmark-button"},
+  {G_STRUCT_OFFSET (DialogData, stop_benchmark_button), "stop-benchmark-button"},
+  {0, NULL}
+};
+
+static void update_dialog (DialogData *data);
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+static void
+device_data_free (DeviceData *device)
+{
+  g_clear_object (&device->block);
+  g_clear_object (&device->object);
+  gdu_benchmark_free (device->bm);
+  if (device->alone != NULL)
+    gdu_benchmark_free (device->alone);
+  g_clear_error (&device->error);
+  g_free (device);
+}
+
+static DialogData *
+dialog_data_ref (DialogData *data)
+{
+  g_atomic_int_inc (&data->ref_count);
+  return data;
+}
+
+static void
+dialog_data_unref (DialogData *data)
+{
+  if (g_atomic_int_dec_and_test (&data->ref_count))
+    {
+      if (data->dialog != NULL)
+        {
+          gtk_widget_hide (data->dialog);
+          gtk_widget_destroy (data->dialog);
+          data->dialog = NULL;
+        }
+
+      g_clear_object (&data->window);
+      g_clear_object (&data->builder);
+      g_clear_object (&data->model);
+      g_clear_object (&data->cancellable);
+      g_hash_table_unref (data->devices);
+      g_mutex_clear (&data->lock);
+      g_cond_clear (&data->cond);
+
+      g_free (data);
+    }
+}
+
+static void
+dialog_data_close (DialogData *data)
+{
+  g_cancellable_cancel (data->cancellable);
+  data->closed = TRUE;
+  gtk_dialog_response (GTK_DIALOG (data->dialog), GTK_RESPONSE_CANCEL);
+  dialog_data_unref (data);
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+static gchar *
+format_transfer_rate (gdouble bytes_per_sec)
+{
+  gchar *ret = NULL;
+  gchar *s;
+
+  s = g_format_size ((guint64) bytes_per_sec);
+  /* Translators: %s is the formatted size, e.g. "42 MB" and the trailing "/s" means per second */
+  ret = g_strdup_printf (C_("benchmark-transfer-rate", "%s/s"), s);
+  g_free (s);
+  return ret;
+}
+
+/* Returns e.g. "310 MB/s <small>(450 MB/s)</small>" where the rate in
+ * parentheses is the one measured for the disk(s) on their own
+ */
+static gchar *
+format_rates (gdouble concurrent,
+              gdouble alone)
+{
+  gchar *ret;
+  gchar *s;
+  gchar *s2;
+
+  if (concurrent == 0.0)
+    return g_strdup ("–");
+
+  s = format_transfer_rate (concurrent);
+  if (alone == 0.0)
+    return s;
+
+  s2 = format_transfer_rate (alone);
+  ret = g_strdup_printf ("%s <small>(%s)</small>", s, s2);
+  g_free (s2);
+  g_free (s);
+  return ret;
+}
+
+static void
+get_averages (DeviceData *device,
+              gdouble    *out_read_avg,
+              gdouble    *out_write_avg,
+              gdouble    *out_alone_read_avg,
+              gdouble    *out_alone_write_avg)
+{
+  gdu_benchmark_lock (device->bm);
+  gdu_benchmark_get_max_min_avg (device->bm->read_samples,
+                                 device->bm->num_read_samples,
+                                 NULL, NULL, out_read_avg);
+  gdu_benchmark_get_max_min_avg (device->bm->write_samples,
+                                 device->bm->num_write_samples,
+                                 NULL, NULL, out_write_avg);
+  gdu_benchmark_unlock (device->bm);
+
+  *out_alone_read_avg = 0.0;
+  *out_alone_write_avg = 0.0;
+  if (device->alone != NULL)
+    {
+      gdu_benchmark_get_max_min_avg (device->alone->read_samples,
+                                     device->alone->num_read_samples,
+                                     NULL, NULL, out_alone_read_avg);
+      gdu_benchmark_get_max_min_avg (device->alone->write_samples,
+                                     device->alone->num_write_samples,
+                                     NULL, NULL, out_alone_write_avg);
+    }
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+static void
+selected_cell_func (GtkTreeViewColumn *column,
+                    GtkCellRenderer   *renderer,
+                    GtkTreeModel      *model,
+                    GtkTreeIter       *iter,
+                    gpointer           user_data)
+{
+  DialogData *data = user_data;
+  UDisksBlock *block = NULL;
+  gboolean selected = FALSE;
+
+  gtk_tree_model_get (model,
+                      iter,
+                      GDU_DEVICE_TREE_MODEL_COLUMN_BLOCK, &block,
+                      GDU_DEVICE_TREE_MODEL_COLUMN_SELECTED, &selected,
+                      -1);
+
+  g_object_set (renderer,
+                "visible", block != NULL,
+                "active", selected,
+                "activatable", !data->in_progress,
+                NULL);
+
+  g_clear_object (&block);
+}
+
+static void
+rate_cell_func (GtkTreeViewColumn *column,
+                GtkCellRenderer   *renderer,
+                GtkTreeModel      *model,
+                GtkTreeIter       *iter,
+                gpointer           user_data)
+{
+  DialogData *data = user_data;
+  gboolean is_write = GPOINTER_TO_INT (g_object_get_data (G_OBJECT (column), "is-write"));
+  UDisksBlock *block = NULL;
+  DeviceData *device = NULL;
+  gchar *markup = NULL;
+
+  gtk_tree_model_get (model,
+                      iter,
+                      GDU_DEVICE_TREE_MODEL_COLUMN_BLOCK, &block,
+                      -1);
+
+  if (block != NULL)
+    device = g_hash_table_lookup (data->devices, block);
+
+  if (device != NULL)
+    {
+      gdouble read_avg, write_avg, alone_read_avg, alone_write_avg;
+
+      get_averages (device, &read_avg, &write_avg, &alone_read_avg, &alone_write_avg);
+      if (is_write)
+        markup = format_rates (write_avg, alone_write_avg);
+      else
+        markup = format_rates (read_avg, alone_read_avg);
+    }
+
+  g_object_set (renderer,
+                "markup", markup,
+                NULL);
+
+  g_free (markup);
+  g_clear_object (&block);
+}
+
+static void
+on_selected_toggled (GtkCellRendererToggle *renderer,
+                     const gchar           *path_string,
+                     gpointer               user_data)
+{
+  DialogData *data = user_data;
+  GtkTreePath *path;
+  GtkTreeIter iter;
+
+  if (data->in_progress)
+    return;
+
+  path = gtk_tree_path_new_from_string (path_string);
+  if (gtk_tree_model_get_iter (GTK_TREE_MODEL (data->model), &iter, path))
+    gdu_device_tree_model_toggle_selected (data->model, &iter);
+  gtk_tree_path_free (path);
+
+  update_dialog (data);
+}
+
+static void
+add_rate_column (DialogData  *data,
+                 const gchar *title,
+                 gboolean     is_write)
+{
+  GtkTreeViewColumn *column;
+  GtkCellRenderer *renderer;
+
+  column = gtk_tree_view_column_new ();
+  gtk_tree_view_column_set_title (column, title);
+  g_object_set_data (G_OBJECT (column), "is-write", GINT_TO_POINTER (is_write));
+  gtk_tree_view_append_column (GTK_TREE_VIEW (data->devices_treeview), column);
+
+  renderer = gtk_cell_renderer_text_new ();
+  gtk_tree_view_column_pack_start (column, renderer, FALSE);
+  gtk_tree_view_column_set_cell_data_func (column,
+                                           renderer,
+                                           rate_cell_func,
+                                           data,
+                                           NULL); /* user_data GDestroyNotify */
+}
+
+static void
+init_treeview (DialogData *data)
+{
+  GtkTreeViewColumn *column;
+  GtkCellRenderer *renderer;
+
+  data->model = gdu_device_tree_model_new (gdu_window_get_application (data->window),
+                                           GDU_DEVICE_TREE_MODEL_FLAGS_FLAT |
+                                           GDU_DEVICE_TREE_MODEL_FLAGS_ONE_LINE_NAME |
+                                           GDU_DEVICE_TREE_MODEL_FLAGS_INCLUDE_DEVICE_NAME);
+  gtk_tree_sortable_set_sort_column_id (GTK_TREE_SORTABLE (data->model),
+                                        GDU_DEVICE_TREE_MODEL_COLUMN_SORT_KEY,
+                                        GTK_SORT_ASCENDING);
+  gtk_tree_view_set_model (GTK_TREE_VIEW (data->devices_treeview), GTK_TREE_MODEL (data->model));
+
+  column = gtk_tree_view_column_new ();
+  /* Translators: Column header for the disks in the "Benchmark Multiple Disks" dialog */
+  gtk_tree_view_column_set_title (column, C_("multi-benchmark", "Disk"));
+  gtk_tree_view_column_set_expand (column, TRUE);
+  gtk_tree_view_append_column (GTK_TREE_VIEW (data->devices_treeview), column);
+
+  renderer = gtk_cell_renderer_toggle_new ();
+  gtk_tree_view_column_pack_start (column, renderer, FALSE);
+  gtk_tree_view_column_set_cell_data_func (column,
+                                           renderer,
+                                           selected_cell_func,
+                                           data,
+                                           NULL); /* user_data GDestroyNotify */
+  g_signal_connect (renderer,
+                    "toggled",
+                    G_CALLBACK (on_selected_toggled),
+                    data);
+
+  renderer = gtk_cell_renderer_text_new ();
+  gtk_tree_view_column_pack_start (column, renderer, FALSE);
+  gtk_tree_view_column_set_attributes (column,
+                                       renderer,
+                                       "markup", GDU_DEVICE_TREE_MODEL_COLUMN_HEADING_TEXT,
+                                       "visible", GDU_DEVICE_TREE_MODEL_COLUMN_IS_HEADING,
+                                       NULL);
+
+  renderer = gtk_cell_renderer_pixbuf_new ();
+  g_object_set (G_OBJECT (renderer),
+                "stock-size", GTK_ICON_SIZE_MENU,
+                NULL);
+  gtk_tree_view_column_pack_start (column, renderer, FALSE);
+  gtk_tree_view_column_set_attributes (column,
+                                       renderer,
+                                       "gicon", GDU_DEVICE_TREE_MODEL_COLUMN_ICON,
+                                       NULL);
+
+  renderer = gtk_cell_renderer_text_new ();
+  g_object_set (G_OBJECT (renderer),
+                "ellipsize", PANGO_ELLIPSIZE_MIDDLE,
+                NULL);
+  gtk_tree_view_column_pack_start (column, renderer, TRUE);
+  gtk_tree_view_column_set_attributes (column,
+                                       renderer,
+                                       "markup", GDU_DEVICE_TREE_MODEL_COLUMN_NAME,
+                                       NULL);
+
+  /* Translators: Column header for the read rate measured while benchmarking multiple disks */
+  add_rate_column (data, C_("multi-benchmark", "Read Rate"), FALSE);
+  /* Translators: Column header for the write rate measured while benchmarking multiple disks */
+  add_rate_column (data, C_("multi-benchmark", "Write Rate"), TRUE);
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+static void
+update_dialog (DialogData *data)
+{
+  GHashTableIter hash_iter;
+  DeviceData *device;
+  GList *selected;
+  gdouble read_sum = 0.0, write_sum = 0.0;
+  gdouble alone_read_sum = 0.0, alone_write_sum = 0.0;
+  gboolean all_alone = TRUE;
+  guint num_samples_done = 0;
+  guint num_samples_total = 0;
+  GError *error = NULL;
+  gchar *s;
+
+  if (data->closed)
+    goto out;
+
+  g_hash_table_iter_init (&hash_iter, data->devices);
+  while (g_hash_table_iter_next (&hash_iter, NULL, (gpointer *) &device))
+    {
+      gdouble read_avg, write_avg, alone_read_avg, alone_write_avg;
+
+      get_averages (device, &read_avg, &write_avg, &alone_read_avg, &alone_write_avg);
+      read_sum += read_avg;
+      write_sum += write_avg;
+      alone_read_sum += alone_read_avg;
+      alone_write_sum += alone_write_avg;
+      if (device->alone == NULL)
+        all_alone = FALSE;
+
+      gdu_benchmark_lock (device->bm);
+      num_samples_done += device->bm->num_read_samples + device->bm->num_write_samples;
+      num_samples_total += device->bm->num_samples * (device->bm->do_write ? 2 : 1);
+      gdu_benchmark_unlock (device->bm);
+
+      /* only report the first real error - the others were cancelled because of it */
+      g_mutex_lock (&data->lock);
+      if (device->error != NULL &&
+          (error == NULL || g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)))
+        {
+          g_clear_error (&error);
+          error = g_error_copy (device->error);
+        }
+      g_mutex_unlock (&data->lock);
+    }
+
+  /* the sum over the disks on their own is only meaningful if we know all of them */
+  s = format_rates (read_sum, all_alone ? alone_read_sum : 0.0);
+  gtk_label_set_markup (GTK_LABEL (data->aggregate_read_label), s);
+  g_free (s);
+  s = format_rates (write_sum, all_alone ? alone_write_sum : 0.0);
+  gtk_label_set_markup (GTK_LABEL (data->aggregate_write_label), s);
+  g_free (s);
+
+  if (data->in_progress)
+    {
+      s = g_strdup_printf (g_dngettext (GETTEXT_PACKAGE,
+                                        "Measuring transfer rate of %u disk (%2.1f%% complete)…",
+                                        "Measuring transfer rate of %u disks (%2.1f%% complete)…",
+                                        g_hash_table_size (data->devices)),
+                           g_hash_table_size (data->devices),
+                           num_samples_total > 0 ? num_samples_done * 100.0 / num_samples_total : 0.0);
+      gtk_label_set_text (GTK_LABEL (data->status_label), s);
+      g_free (s);
+    }
+  else if (error != NULL)
+    {
+      if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        gtk_label_set_text (GTK_LABEL (data->status_label), C_("multi-benchmark", "Benchmark aborted"));
+      else
+        gtk_label_set_text (GTK_LABEL (data->status_label), error->message);
+    }
+  else if (g_hash_table_size (data->devices) > 0)
+    {
+      s = g_strdup_printf (g_dngettext (GETTEXT_PACKAGE,
+                                        "Benchmarked %u disk at the same time",
+                                        "Benchmarked %u disks at the same time",
+                                        g_hash_table_size (data->devices)),
+                           g_hash_table_size (data->devices));
+      gtk_label_set_text (GTK_LABEL (data->status_label), s);
+      g_free (s);
+    }
+  else
+    {
+      gtk_label_set_text (GTK_LABEL (data->status_label), "");
+    }
+
+  selected = gdu_device_tree_model_get_selected_blocks (data->model);
+  gtk_widget_set_sensitive (data->start_benchmark_button, g_list_length (selected) >= 2);
+  g_list_free_full (selected, g_object_unref);
+
+  gtk_widget_set_visible (data->start_benchmark_button, !data->in_progress);
+  gtk_widget_set_visible (data->stop_benchmark_button, data->in_progress);
+  gtk_widget_set_sensitive (data->num_samples_spinbutton, !data->in_progress);
+  gtk_widget_set_sensitive (data->sample_size_spinbutton, !data->in_progress);
+  gtk_widget_set_sensitive (data->write_checkbutton, !data->in_progress);
+
+  gtk_widget_queue_draw (data->devices_treeview);
+
+ out:
+  g_clear_error (&error);
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+/* called on main / UI thread */
+static gboolean
+bmt_on_timeout (gpointer user_data)
+{
+  DialogData *data = user_data;
+
+  g_mutex_lock (&data->lock);
+  data->update_timeout_pending = FALSE;
+  if (data->num_running == 0)
+    data->in_progress = FALSE;
+  g_mutex_unlock (&data->lock);
+
+  update_dialog (data);
+  dialog_data_unref (data);
+  return FALSE; /* don't run again */
+}
+
+static void
+bmt_schedule_update (DialogData *data)
+{
+  /* rate-limit updates */
+  g_mutex_lock (&data->lock);
+  if (!data->update_timeout_pending)
+    {
+      g_timeout_add (200, /* ms */
+                     bmt_on_timeout,
+                     dialog_data_ref (data));
+      data->update_timeout_pending = TRUE;
+    }
+  g_mutex_unlock (&data->lock);
+}
+
+/* must be called with data->lock held - releases the threads waiting
+ * in bmt_on_sample() once all running threads have arrived
+ */
+static void
+bmt_check_barrier (DialogData *data)
+{
+  if (data->barrier_count > 0 && data->barrier_count >= data->num_running)
+    {
+      data->barrier_count = 0;
+      data->barrier_generation++;
+      g_cond_broadcast (&data->cond);
+    }
+}
+
+/* must be called with data->lock held */
+static void
+bmt_wait (DialogData *data)
+{
+  /* wake up regularly to notice cancellation */
+  g_cond_wait_until (&data->cond, &data->lock, g_get_monotonic_time () + 100 * G_TIME_SPAN_MILLISECOND);
+}
+
+/* called on the benchmark threads after each sample */
+static void
+bmt_on_sample (GduBenchmark *benchmark,
+               gpointer      user_data)
+{
+  DialogData *data = user_data;
+  guint generation;
+
+  g_mutex_lock (&data->lock);
+  generation = data->barrier_generation;
+  data->barrier_count++;
+  bmt_check_barrier (data);
+  while (generation == data->barrier_generation && !g_cancellable_is_cancelled (data->cancellable))
+    bmt_wait (data);
+  g_mutex_unlock (&data->lock);
+
+  bmt_schedule_update (data);
+}
+
+static gpointer
+benchmark_thread (gpointer user_data)
+{
+  DeviceData *device = user_data;
+  DialogData *data = device->data;
+  GError *error = NULL;
+  gint fd;
+
+  fd = gdu_benchmark_open_block (device->block,
+                                 device->bm->do_write,
+                                 data->cancellable,
+                                 &error);
+
+  /* don't start until all disks are open - opening may take a while, e.g. for
+   * polkit authorization or spinning up the disk
+   */
+  g_mutex_lock (&data->lock);
+  data->num_opening--;
+  if (data->num_opening == 0)
+    g_cond_broadcast (&data->cond);
+  while (data->num_opening > 0 && !g_cancellable_is_cancelled (data->cancellable))
+    bmt_wait (data);
+  g_mutex_unlock (&data->lock);
+
+  if (fd == -1)
+    goto out;
+
+  if (!gdu_benchmark_run (device->bm,
+                          fd,
+                          NULL, /* don't mix concurrent results with the disk's own */
+                          data->cancellable,
+                          bmt_on_sample,
+                          data,
+                          &error))
+    goto out;
+
+ out:
+  if (fd != -1)
+    close (fd);
+
+  /* the aggregate is meaningless if one of the disks drops out */
+  if (error != NULL)
+    g_cancellable_cancel (data->cancellable);
+
+  g_mutex_lock (&data->lock);
+  device->error = error;
+  data->num_running--;
+  bmt_check_barrier (data);
+  g_mutex_unlock (&data->lock);
+
+  bmt_schedule_update (data);
+  dialog_data_unref (data);
+  return NULL;
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+static void
+start_benchmark (DialogData *data)
+{
+  UDisksClient *client;
+  GList *blocks = NULL;
+  GList *l;
+  GError *error = NULL;
+  gint num_samples;
+  gint sample_size_mib;
+  gboolean do_write;
+  GHashTableIter hash_iter;
+  DeviceData *device;
+
+  g_assert (!data->in_progress);
+
+  client = gdu_window_get_client (data->window);
+  num_samples = gtk_spin_button_get_value (GTK_SPIN_BUTTON (data->num_samples_spinbutton));
+  sample_size_mib = gtk_spin_button_get_value (GTK_SPIN_BUTTON (data->sample_size_spinbutton));
+  do_write = gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (data->write_checkbutton));
+
+  blocks = gdu_device_tree_model_get_selected_blocks (data->model);
+  if (g_list_length (blocks) < 2)
+    goto out;
+
+  /* The write benchmark needs exclusive access - unlike the single disk
+   * benchmark we don't offer to unmount everything, just refuse
+   */
+  if (do_write)
+    {
+      for (l = blocks; l != NULL; l = l->next)
+        {
+          UDisksBlock *block = UDISKS_BLOCK (l->data);
+          UDisksObject *object = (UDisksObject *) g_dbus_interface_get_object (G_DBUS_INTERFACE (block));
+
+          if (udisks_block_get_read_only (block) ||
+              (object != NULL && gdu_utils_is_in_use (client, object)))
+            {
+              g_set_error (&error,
+                           G_IO_ERROR,
+                           G_IO_ERROR_BUSY,
+                           /* Translators: %s is the device file, e.g. /dev/sdb */
+                           C_("multi-benchmark", "%s is read-only or in use. Uncheck “Perform write-benchmark” or stop using the disk."),
+                           udisks_block_get_preferred_device (block));
+              gdu_utils_show_error (GTK_WINDOW (data->dialog),
+                                    C_("multi-benchmark", "Error starting benchmark"),
+                                    error);
+              g_clear_error (&error);
+              goto out;
+            }
+        }
+    }
+
+  g_hash_table_remove_all (data->devices);
+  g_cancellable_reset (data->cancellable);
+  data->num_opening = 0;
+  data->num_running = 0;
+  data->barrier_count = 0;
+
+  for (l = blocks; l != NULL; l = l->next)
+    {
+      UDisksBlock *block = UDISKS_BLOCK (l->data);
+      gchar *filename;
+
+      device = g_new0 (DeviceData, 1);
+      device->data = data;
+      device->block = g_object_ref (block);
+      device->object = (UDisksObject *) g_dbus_interface_dup_object (G_DBUS_INTERFACE (block));
+      device->bm = gdu_benchmark_new ();
+      device->bm->num_samples = num_samples;
+      device->bm->sample_size_mib = sample_size_mib;
+      device->bm->do_write = do_write;
+      device->bm->num_access_samples = 0; /* access time doesn't add up */
+
+      filename = gdu_benchmark_get_filename_for_block (block);
+      if (filename != NULL)
+        {
+          device->alone = gdu_benchmark_new ();
+          if (!gdu_benchmark_load (device->alone, filename, NULL))
+            {
+              gdu_benchmark_free (device->alone);
+              device->alone = NULL;
+            }
+        }
+      g_free (filename);
+
+      g_hash_table_insert (data->devices, device->block, device);
+      data->num_opening++;
+      data->num_running++;
+    }
+
+  data->in_progress = TRUE;
+
+  g_hash_table_iter_init (&hash_iter, data->devices);
+  while (g_hash_table_iter_next (&hash_iter, NULL, (gpointer *) &device))
+    {
+      dialog_data_ref (data);
+      g_thread_unref (g_thread_new ("multi-benchmark-thread", benchmark_thread, device));
+    }
+
+ out:
+  g_list_free_full (blocks, g_object_unref);
+  update_dialog (data);
+}
+
+static void
+abort_benchmark (DialogData *data)
+{
+  g_cancellable_cancel (data->cancellable);
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+void
+gdu_multi_benchmark_dialog_show (GduWindow *window)
+{
+  DialogData *data;
+  guint n;
+
+  data = g_new0 (DialogData, 1);
+  data->ref_count = 1;
+  data->window = g_object_ref (window);
+  data->cancellable = g_cancellable_new ();
+  data->devices = g_hash_table_new_full (g_direct_hash,
+                                         g_direct_equal,
+                                         NULL,
+                                         (GDestroyNotify) device_data_free);
+  g_mutex_init (&data->lock);
+  g_cond_init (&data->cond);
+
+  data->dialog = GTK_WIDGET (gdu_application_new_widget (gdu_window_get_application (window),
+                                                         "multi-benchmark-dialog.ui",
+                                                         "multi-benchmark-dialog",
+                                                         &data->builder));
+  for (n = 0; widget_mapping[n].name != NULL; n++)
+    {
+      gpointer *p = (gpointer *) ((char *) data + widget_mapping[n].offset);
+      *p = GTK_WIDGET (gtk_builder_get_object (data->builder, widget_mapping[n].name));
+    }
+
+  gtk_window_set_transient_for (GTK_WINDOW (data->dialog), GTK_WINDOW (window));
+
+  init_treeview (data);
+
+  update_dialog (data);
+
+  while (TRUE)
+    {
+      gint response;
+      response = gtk_dialog_run (GTK_DIALOG (data->dialog));
+
+      if (response < 0)
+        break;
+
+      /* Keep in sync with .ui file */
+      switch (response)
+        {
+        case 0: /* start benchmark */
+          start_benchmark (data);
+          break;
+
+        case 1: /* abort benchmark */
+          abort_benchmark (data);
+          break;
+
+        default:
+          g_assert_not_reached ();
+        }
+    }
+
+  dialog_data_close (data);
+}
@@ -0,0 +1,622 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*-
+ *
+ * Copyright (C) 2008-2013 Red Hat, Inc.
+ *
+ * Licensed under GPL version 2 or later.
+ *
+ * Author: David Zeuthen <zeuthen@gmail.com>
+ */
+
+#include "config.h"
+
+#include <glib/gi18n.h>
+
+#include "gduapplication.h"
+#include "gduwindow.h"
+#include "gdunvmehealthdialog.h"
+#include "gdusmarthistory.h"
+
+#if UDISKS_CHECK_VERSION(2, 10, 0)
+
+typedef struct
+{
+  volatile guint ref_count;
+
+  UDisksObject *object;
+  UDisksNVMeController *controller;
+
+  GduWindow *window;
+  GtkBuilder *builder;
+
+  GtkWidget *dialog;
+  GtkWidget *updated_label;
+  GtkWidget *temperature_label;
+  GtkWidget *powered_on_label;
+  GtkWidget *percentage_used_label;
+  GtkWidget *available_spare_label;
+  GtkWidget *media_errors_label;
+  GtkWidget *data_written_label;
+  GtkWidget *data_read_label;
+  GtkWidget *thermal_throttling_label;
+  GtkWidget *unsafe_shutdowns_label;
+  GtkWidget *critical_warning_label;
+  GtkWidget *overall_assessment_label;
+  GtkWidget *trends_drawingarea;
+
+  gchar *history_filename;
+  goffset history_size;
+  GArray *history; /* of GduSmartSample, NULL if not loaded */
+} DialogData;
+
+static const struct {
+  goffset offset;
+  const gchar *name;
+} widget_mapping[] = {
+  {G_STRUCT_OFFSET (DialogData, updated_label), "updated-label"},
+  {G_STRUCT_OFFSET (DialogData, temperature_label), "temperature-label"},
+  {G_STRUCT_OFFSET (DialogData, powered_on_label), "powered-on-label"},
+  {G_STRUCT_OFFSET (DialogData, percentage_used_label), "percentage-used-label"},
+  {G_STRUCT_OFFSET (DialogData, available_spare_label), "available-spare-label"},
+  {G_STRUCT_OFFSET (DialogData, media_errors_label), "media-errors-label"},
+  {G_STRUCT_OFFSET (DialogData, data_written_label), "data-written-label"},
+  {G_STRUCT_OFFSET (DialogData, data_read_label), "data-read-label"},
+  {G_STRUCT_OFFSET (DialogData, thermal_throttling_label), "thermal-throttling-label"},
+  {G_STRUCT_OFFSET (DialogData, unsafe_shutdowns_label), "unsafe-shutdowns-label"},
+  {G_STRUCT_OFFSET (DialogData, critical_warning_label), "critical-warning-label"},
+  {G_STRUCT_OFFSET (DialogData, overall_assessment_label), "overall-assessment-label"},
+  {G_STRUCT_OFFSET (DialogData, trends_drawingarea), "trends-drawingarea"},
+  {0, NULL}
+};
+
+/* wear and throttling is what predicts the end of life of flash */
+static const GduSmartTrend trends[] =
+{
+  GDU_SMART_TREND_PERCENTAGE_USED,
+  GDU_SMART_TREND_DATA_WRITTEN,
+  GDU_SMART_TREND_MEDIA_ERRORS,
+  GDU_SMART_TREND_THERMAL_THROTTLE,
+  GDU_SMART_TREND_TEMPERATURE,
+  GDU_SMART_TREND_POWER_ON_HOURS
+};
+
+static void
+dialog_data_unref (DialogData *data)
+{
+  if (g_atomic_int_dec_and_test (&data->ref_count))
+    {
+      if (data->dialog != NULL)
+        {
+          gtk_widget_hide (data->dialog);
+          gtk_widget_destroy (data->dialog);
+        }
+      if (data->object != NULL)
+        g_object_unref (data->object);
+      if (data->window != NULL)
+        g_object_unref (data->window);
+      if (data->builder != NULL)
+        g_object_unref (data->builder);
+
+      if (data->history != NULL)
+        g_array_unref (data->history);
+      g_free (data->history_filename);
+      g_free (data);
+    }
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+gchar *
+gdu_nvme_health_format_temperature (UDisksNVMeController *controller)
+{
+  return gdu_smart_format_temperature (udisks_nvme_controller_get_smart_temperature (controller));
+}
+
+gchar *
+gdu_nvme_health_format_powered_on (UDisksNVMeController *controller)
+{
+  guint64 hours;
+  gchar *ret = NULL;
+
+  hours = udisks_nvme_controller_get_smart_power_on_hours (controller);
+  if (hours > 0)
+    ret = gdu_utils_format_duration_usec (hours * 3600 * G_USEC_PER_SEC,
+                                          GDU_FORMAT_DURATION_FLAGS_NO_SECONDS);
+  return ret;
+}
+
+/* All critical warnings except the temperature one mean the controller is
+ * degraded, see the SmartCriticalWarning property
+ */
+static gboolean
+has_critical_failure (UDisksNVMeController *controller)
+{
+  const gchar *const *warnings;
+  guint n;
+
+  warnings = udisks_nvme_controller_get_smart_critical_warning (controller);
+  for (n = 0; warnings != NULL && warnings[n] != NULL; n++)
+    {
+      if (g_strcmp0 (warnings[n], "temperature") != 0)
+        return TRUE;
+    }
+  return FALSE;
+}
+
+static gboolean
+has_critical_warning (UDisksNVMeController *controller,
+                      const gchar          *warning)
+{
+  const gchar *const *warnings;
+
+  warnings = udisks_nvme_controller_get_smart_critical_warning (controller);
+  return warnings != NULL && g_strv_contains (warnings, warning);
+}
+
+static gboolean
+selftest_failed (UDisksNVMeController *controller)
+{
+  const gchar *status;
+
+  status = udisks_nvme_controller_get_smart_selftest_status (controller);
+  return (g_strcmp0 (status, "fatal_error") == 0 ||
+          g_strcmp0 (status, "known_seg_fail") == 0 ||
+          g_strcmp0 (status, "unknown_seg_fail") == 0);
+}
+
+/* Keep in sync with gdu_ata_smart_get_overall_assessment() */
+static gchar *
+gdu_nvme_health_get_overall_assessment (UDisksNVMeController *controller,
+                                        GVariant             *attributes,
+                                        gboolean              one_liner,
+                                        gboolean             *out_warn)
+{
+  gchar *ret;
+  gboolean warn = FALSE;
+  gchar *selftest = NULL;
+  guint64 media_errors = 0;
+  guchar percent_used = 0;
+
+  if (attributes != NULL)
+    {
+      g_variant_lookup (attributes, "media_errors", "t", &media_errors);
+      g_variant_lookup (attributes, "percent_used", "y", &percent_used);
+    }
+
+  if (g_strcmp0 (udisks_nvme_controller_get_smart_selftest_status (controller), "inprogress") == 0)
+    {
+      selftest = g_strdup (_("Self-test in progress"));
+    }
+
+  /* If the controller reports it is degraded, always return that */
+  if (has_critical_failure (controller))
+    {
+      /* if doing a one-liner also include if a self-test is running */
+      if (one_liner && selftest != NULL)
+        {
+          ret = g_strdup_printf ("<span foreground=\"#ff0000\"><b>%s</b></span> — %s",
+                                 _("DISK IS LIKELY TO FAIL SOON"),
+                                 selftest);
+        }
+      else
+        {
+          ret = g_strdup_printf ("<span foreground=\"#ff0000\"><b>%s</b></span>",
+                                 _("DISK IS LIKELY TO FAIL SOON"));
+        }
+      warn = TRUE;
+      goto out;
+    }
+
+  /* Ok, the controller is healthy.. so if doing a self-test, prefer that on the one-liner */
+  if (one_liner && selftest != NULL)
+    {
+      ret = selftest;
+      selftest = NULL;
+      goto out;
+    }
+
+  /* Otherwise, if last self-test failed, return that */
+  if (selftest_failed (controller))
+    {
+      ret = g_strdup_printf ("<span foreground=\"#ff0000\"><b>%s</b></span>",
+                             _("SELF-TEST FAILED"));
+      warn = TRUE;
+      goto out;
+    }
+
+  /* Otherwise, if the disk is too hot, return that */
+  if (has_critical_warning (controller, "temperature"))
+    {
+      ret = g_strdup (_("Disk is OK, temperature above threshold"));
+      goto out;
+    }
+
+  /* Otherwise, if data could not be recovered, return that */
+  if (media_errors > 0)
+    {
+      ret = g_strdup_printf (dngettext (GETTEXT_PACKAGE,
+                                        "Disk is OK, one media error",
+                                        "Disk is OK, %d media errors",
+                                        media_errors),
+                             (gint) MIN (media_errors, G_MAXINT));
+      goto out;
+    }
+
+  /* Otherwise, if the rated endurance is used up, return that */
+  if (percent_used >= 100)
+    {
+      /* Translators: The %d is the percentage of the rated endurance used, 100 or more */
+      ret = g_strdup_printf (_("Disk is OK, %d%% of rated endurance used"), percent_used);
+      goto out;
+    }
+
+  /* Otherwise, it's all honky dory */
+
+  ret = g_strdup (_("Disk is OK"));
+
+ out:
+
+  if (one_liner)
+    {
+      gchar *s, *s1;
+      s = gdu_nvme_health_format_temperature (controller);
+      if (s != NULL)
+        {
+          /* Translators: Used to convey the status and temperature in one line.
+           * The first %s is the status of the drive.
+           * The second %s is the temperature of the drive.
+           */
+          s1 = g_strdup_printf (_("%s (%s)"), ret, s);
+          g_free (ret);
+          ret = s1;
+          g_free (s);
+        }
+    }
+
+  g_free (selftest);
+  if (out_warn != NULL)
+    *out_warn = warn;
+  return ret;
+}
+
+gchar *
+gdu_nvme_health_get_one_liner_assessment (UDisksNVMeController *controller,
+                                          GVariant             *attributes,
+                                          gboolean             *out_warn)
+{
+  return gdu_nvme_health_get_overall_assessment (controller, attributes, TRUE, out_warn);
+}
+
+gchar *
+gdu_nvme_health_get_assessment (UDisksNVMeController *controller,
+                                GVariant             *attributes,
+                                gboolean             *out_warn)
+{
+  return gdu_nvme_health_get_overall_assessment (controller, attributes, FALSE, out_warn);
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+static void
+update_updated_label (DialogData *data)
+{
+  gchar *s = NULL;
+  time_t updated;
+
+  updated = udisks_nvme_controller_get_smart_updated (data->controller);
+  if (updated > 0)
+    {
+      gchar *s2;
+
+      s2 = gdu_utils_format_duration_usec ((time (NULL) - updated) * G_USEC_PER_SEC,
+                                           GDU_FORMAT_DURATION_FLAGS_NO_SECONDS);
+      s = g_strdup_printf (_("%s ago"), s2);
+      g_free (s2);
+    }
+  else
+    {
+      s = g_strdup ("—");
+    }
+  gtk_label_set_text (GTK_LABEL (data->updated_label), s);
+  g_free (s);
+}
+
+static gchar *
+format_critical_warnings (UDisksNVMeController *controller)
+{
+  const gchar *const *warnings;
+  GString *str;
+  guint n;
+
+  warnings = udisks_nvme_controller_get_smart_critical_warning (controller);
+  if (warnings == NULL || warnings[0] == NULL)
+    {
+      /* Translators: Shown in the NVMe health dialog when no critical warnings are reported */
+      return g_strdup (C_("nvme-critical-warning", "None"));
+    }
+
+  str = g_string_new (NULL);
+  for (n = 0; warnings[n] != NULL; n++)
+    {
+      const gchar *s;
+
+      if (g_strcmp0 (warnings[n], "spare") == 0)
+        s = C_("nvme-critical-warning", "Available spare below threshold");
+      else if (g_strcmp0 (warnings[n], "temperature") == 0)
+        s = C_("nvme-critical-warning", "Temperature outside threshold");
+      else if (g_strcmp0 (warnings[n], "degraded") == 0)
+        s = C_("nvme-critical-warning", "Reliability degraded");
+      else if (g_strcmp0 (warnings[n], "readonly") == 0)
+        s = C_("nvme-critical-warning", "Media is read-only");
+      else if (g_strcmp0 (warnings[n], "volatile_mem") == 0)
+        s = C_("nvme-critical-warning", "Volatile memory backup failed");
+      else if (g_strcmp0 (warnings[n], "pmr_readonly") == 0)
+        s = C_("nvme-critical-warning", "Persistent memory region is read-only");
+      else
+        s = warnings[n];
+
+      if (str->len > 0)
+        g_string_append (str, ", ");
+      g_string_append (str, s);
+    }
+  return g_string_free (str, FALSE);
+}
+
+static void
+set_label (GtkWidget   *label,
+           const gchar *markup)
+{
+  gtk_label_set_markup (GTK_LABEL (label), markup != NULL ? markup : "—");
+}
+
+static void
+update_dialog (DialogData *data)
+{
+  GVariant *attributes = NULL;
+  GError *error = NULL;
+  guchar avail_spare, spare_thresh, percent_used;
+  guint64 value;
+  guint32 warning_temp_time, critical_temp_time;
+  gchar *s, *s2;
+
+  if (udisks_nvme_controller_get_smart_updated (data->controller) > 0 &&
+      !udisks_nvme_controller_call_smart_get_attributes_sync (data->controller,
+                                                              g_variant_new ("a{sv}", NULL), /* options */
+                                                              &attributes,
+                                                              NULL, /* GCancellable */
+                                                              &error))
+    {
+      g_warning ("Error getting NVMe health information: %s (%s, %d)",
+                 error->message, g_quark_to_string (error->domain), error->code);
+      g_clear_error (&error);
+    }
+
+  update_updated_label (data);
+
+  s = gdu_nvme_health_format_temperature (data->controller);
+  set_label (data->temperature_label, s);
+  g_free (s);
+
+  s = gdu_nvme_health_format_powered_on (data->controller);
+  set_label (data->powered_on_label, s);
+  g_free (s);
+
+  s = NULL;
+  if (attributes != NULL && g_variant_lookup (attributes, "percent_used", "y", &percent_used))
+    {
+      /* Translators: Percentage of the rated endurance of the disk that has been used. May exceed 100% */
+      s = g_strdup_printf (_("%d%%"), percent_used);
+    }
+  set_label (data->percentage_used_label, s);
+  g_free (s);
+
+  s = NULL;
+  if (attributes != NULL &&
+      g_variant_lookup (attributes, "avail_spare", "y", &avail_spare) &&
+      g_variant_lookup (attributes, "spare_thresh", "y", &spare_thresh))
+    {
+      /* Translators: The first %d is the percentage of spare capacity left,
+       * the second %d is the percentage below which the disk warns about it.
+       */
+      s = g_strdup_printf (_("%d%% (threshold %d%%)"), avail_spare, spare_thresh);
+    }
+  set_label (data->available_spare_label, s);
+  g_free (s);
+
+  s = NULL;
+  if (attributes != NULL && g_variant_lookup (attributes, "media_errors", "t", &value))
+    {
+      if (value > 0)
+        s = g_strdup_printf ("<span foreground=\"#ff0000\"><b>%" G_GUINT64_FORMAT "</b></span>", value);
+      else
+        s = g_strdup_printf ("%" G_GUINT64_FORMAT, value);
+    }
+  set_label (data->media_errors_label, s);
+  g_free (s);
+
+  s = NULL;
+  if (attributes != NULL && g_variant_lookup (attributes, "total_data_written", "t", &value))
+    s = g_format_size (value);
+  set_label (data->data_written_label, s);
+  g_free (s);
+
+  s = NULL;
+  if (attributes != NULL && g_variant_lookup (attributes, "total_data_read", "t", &value))
+    s = g_format_size (value);
+  set_label (data->data_read_label, s);
+  g_free (s);
+
+  s = NULL;
+  if (attributes != NULL &&
+      g_variant_lookup (attributes, "warning_temp_time", "u", &warning_temp_time) &&
+      g_variant_lookup (attributes, "critical_temp_time", "u", &critical_temp_time))
+    {
+      if (warning_temp_time + critical_temp_time == 0)
+        {
+          /* Translators: Shown in the NVMe health dialog if the disk never ran too hot */
+          s = g_strdup (C_("nvme-thermal-throttling", "Never"));
+        }
+      else
+        {
+          s2 = gdu_utils_format_duration_usec (((guint64) warning_temp_time + critical_temp_time) * 60 * G_USEC_PER_SEC,
+                                               GDU_FORMAT_DURATION_FLAGS_NO_SECONDS);
+          /* Translators: The %s is the time spent above the warning or critical temperature, e.g. "3 hours" */
+          s = g_strdup_printf (C_("nvme-thermal-throttling", "%s above the warning temperature"), s2);
+          g_free (s2);
+        }
+    }
+  set_label (data->thermal_throttling_label, s);
+  g_free (s);
+
+  s = NULL;
+  if (attributes != NULL && g_variant_lookup (attributes, "unsafe_shutdowns", "t", &value))
+    s = g_strdup_printf ("%" G_GUINT64_FORMAT, value);
+  set_label (data->unsafe_shutdowns_label, s);
+  g_free (s);
+
+  s = format_critical_warnings (data->controller);
+  set_label (data->critical_warning_label, s);
+  g_free (s);
+
+  s = gdu_nvme_health_get_assessment (data->controller, attributes, NULL);
+  set_label (data->overall_assessment_label, s);
+  g_free (s);
+
+  if (attributes != NULL)
+    g_variant_unref (attributes);
+}
+
+/* reloads the history if the recorder has appended to it */
+static void
+update_history (DialogData *data)
+{
+  if (gdu_smart_history_reload (data->history_filename, &data->history_size, &data->history))
+    gtk_widget_queue_draw (data->trends_drawingarea);
+}
+
+static gboolean
+on_trends_drawingarea_draw (GtkWidget *widget,
+                            cairo_t   *cr,
+                            gpointer   user_data)
+{
+  DialogData *data = user_data;
+  gdu_smart_history_draw (widget, cr, data->history, trends, G_N_ELEMENTS (trends));
+  return FALSE;
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+/* called when properties on the NVMe.Controller object changes */
+static void
+on_controller_notify (GObject     *object,
+                      GParamSpec  *pspec,
+                      gpointer     user_data)
+{
+  DialogData *data = user_data;
+  update_dialog (data);
+}
+
+/* called every second */
+static gboolean
+on_timeout (gpointer user_data)
+{
+  DialogData *data = user_data;
+  update_updated_label (data);
+  update_history (data);
+  return TRUE; /* keep timeout around */
+}
+
+static void
+refresh_cb (UDisksNVMeController *controller,
+            GAsyncResult         *res,
+            gpointer              user_data)
+{
+  GduWindow *window = GDU_WINDOW (user_data);
+  GError *error;
+
+  error = NULL;
+  if (!udisks_nvme_controller_call_smart_update_finish (controller, res, &error))
+    {
+      gdu_utils_show_error (GTK_WINDOW (window),
+                            _("Error refreshing SMART data"),
+                            error);
+      g_error_free (error);
+    }
+  g_object_unref (window);
+}
+
+static void
+refresh_do (DialogData *data)
+{
+  udisks_nvme_controller_call_smart_update (data->controller,
+                                            g_variant_new ("a{sv}", NULL), /* options */
+                                            NULL, /* GCancellable */
+                                            (GAsyncReadyCallback) refresh_cb,
+                                            g_object_ref (data->window));
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+void
+gdu_nvme_health_dialog_show (GduWindow    *window,
+                             UDisksObject *object)
+{
+  DialogData *data;
+  guint n;
+  gulong notify_id;
+  guint timeout_id;
+
+  data = g_new0 (DialogData, 1);
+  data->ref_count = 1;
+  data->object = g_object_ref (object);
+  data->controller = udisks_object_peek_nvme_controller (data->object);
+  data->window = g_object_ref (window);
+
+  data->dialog = GTK_WIDGET (gdu_application_new_widget (gdu_window_get_application (window),
+                                                         "nvme-health-dialog.ui",
+                                                         "nvme-health-dialog",
+                                                         &data->builder));
+  for (n = 0; widget_mapping[n].name != NULL; n++)
+    {
+      gpointer *p = (gpointer *) ((char *) data + widget_mapping[n].offset);
+      *p = GTK_WIDGET (gtk_builder_get_object (data->builder, widget_mapping[n].name));
+      g_warn_if_fail (*p != NULL);
+    }
+
+  gtk_window_set_transient_for (GTK_WINDOW (data->dialog), GTK_WINDOW (window));
+
+  notify_id = g_signal_connect (data->controller, "notify", G_CALLBACK (on_controller_notify), data);
+  timeout_id = g_timeout_add_seconds (1, on_timeout, data);
+
+  if (udisks_object_peek_drive (object) != NULL)
+    data->history_filename = gdu_smart_history_get_filename_for_drive (udisks_object_peek_drive (object));
+  g_signal_connect (data->trends_drawingarea, "draw", G_CALLBACK (on_trends_drawingarea_draw), data);
+  update_history (data);
+
+  update_dialog (data);
+
+  while (TRUE)
+    {
+      gint response;
+      response = gtk_dialog_run (GTK_DIALOG (data->dialog));
+
+      if (response < 0)
+        break;
+
+      /* Keep in sync with .ui file */
+      switch (response)
+        {
+        case 0:
+          refresh_do (data);
+          break;
+        default:
+          g_assert_not_reached ();
+        }
+    }
+
+  g_source_remove (timeout_id);
+  g_signal_handler_disconnect (data->controller, notify_id);
+
+  dialog_data_unref (data);
+}
+
+#endif /* UDISKS_CHECK_VERSION(2, 10, 0) */
@@ -0,0 +1,40 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*-
+ *
+ * Copyright (C) 2008-2013 Red Hat, Inc.
+ *
+ * Licensed under GPL version 2 or later.
+ *
+ * Author: David Zeuthen <zeuthen@gmail.com>
+ */
+
+#ifndef __GDU_NVME_HEALTH_DIALOG_H__
+#define __GDU_NVME_HEALTH_DIALOG_H__
+
+#include <gtk/gtk.h>
+#include "gdutypes.h"
+
+G_BEGIN_DECLS
+
+/* The NVMe interface only exists in udisks 2.10 and later */
+#if UDISKS_CHECK_VERSION(2, 10, 0)
+
+void   gdu_nvme_health_dialog_show (GduWindow    *window,
+                                    UDisksObject *object);
+
+/* @attributes is the result of SmartGetAttributes() or NULL if not available */
+gchar *gdu_nvme_health_get_one_liner_assessment (UDisksNVMeController *controller,
+                                                 GVariant             *attributes,
+                                                 gboolean             *out_warn);
+gchar *gdu_nvme_health_get_assessment           (UDisksNVMeController *controller,
+                                                 GVariant             *attributes,
+                                                 gboolean             *out_warn);
+
+/* returns NULL if not available */
+gchar *gdu_nvme_health_format_temperature       (UDisksNVMeController *controller);
+gchar *gdu_nvme_health_format_powered_on        (UDisksNVMeController *controller);
+
+#endif
+
+G_END_DECLS
+
+#endif /* __GDU_NVME_HEALTH_DIALOG_H__ */
@@ -538,7 +538,7 @@ restore_disk_image_populate (DialogData *data)
   if (data->object != NULL)
     {
       UDisksObjectInfo *info;
-      info = udisks_client_get_object_info (gdu_window_get_client (data->window), data->object);
+      info = gdu_application_get_object_info (gdu_window_get_application (data->window), data->object);
       gtk_label_set_text (GTK_LABEL (data->destination_label), udisks_object_info_get_one_liner (info));
       g_clear_object (&info);
 
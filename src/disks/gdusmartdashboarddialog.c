@@ -0,0 +1,630 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*-
+ *
+ * Copyright (C) 2008-2013 Red Hat, Inc.
+ *
+ * Licensed under GPL version 2 or later.
+ *
+ * Author: David Zeuthen <zeuthen@gmail.com>
+ */
+
+#include "config.h"
+
+#include <glib/gi18n.h>
+
+#include "gduapplication.h"
+#include "gduwindow.h"
+#include "gduatasmartdialog.h"
+#include "gdunvmehealthdialog.h"
+#include "gdusmartdashboarddialog.h"
+
+/* Shows the SMART status of all drives in one table. The values come
+ * from the properties udisks already keeps up to date so the table is
+ * filled without any D-Bus calls and rows are updated as the properties
+ * change. Refreshing asks udisks to update the SMART data of all drives
+ * at once, without waking up drives in standby.
+ */
+
+enum
+{
+  OBJECT_COLUMN,
+  ICON_COLUMN,
+  NAME_COLUMN,
+  ASSESSMENT_COLUMN,
+  TEMPERATURE_COLUMN,
+  POWERED_ON_COLUMN,
+  FAILING_COLUMN,
+  SORT_KEY_COLUMN,
+  N_COLUMNS
+};
+
+typedef struct
+{
+  volatile gint ref_count;
+
+  GduWindow *window;
+  UDisksClient *client;
+  GtkBuilder *builder;
+
+  GtkWidget *dialog;
+  GtkWidget *drives_treeview;
+  GtkWidget *status_label;
+  GtkWidget *refresh_button;
+
+  GtkListStore *store;
+
+  /* Maps from UDisksObject -> GtkTreeIter of its row */
+  GHashTable *rows;
+
+  GCancellable *cancellable;
+  guint num_refreshing;
+  guint num_asleep;
+  guint num_errors;
+} DialogData;
+
+static const struct {
+  goffset offset;
+  const gchar *name;
+} widget_mapping[] = {
+  {G_STRUCT_OFFSET (DialogData, drives_treeview), "drives-treeview"},
+  {G_STRUCT_OFFSET (DialogData, status_label), "status-label"},
+  {G_STRUCT_OFFSET (DialogData, refresh_button), "refresh-button"},
+  {0, NULL}
+};
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+static DialogData *
+dialog_data_ref (DialogData *data)
+{
+  g_atomic_int_inc (&data->ref_count);
+  return data;
+}
+
+static void
+dialog_data_unref (DialogData *data)
+{
+  if (g_atomic_int_dec_and_test (&data->ref_count))
+    {
+      if (data->dialog != NULL)
+        {
+          gtk_widget_hide (data->dialog);
+          gtk_widget_destroy (data->dialog);
+          data->dialog = NULL;
+        }
+      g_clear_object (&data->builder);
+      g_clear_object (&data->store);
+      g_hash_table_unref (data->rows);
+      g_object_unref (data->cancellable);
+      g_object_unref (data->client);
+      g_object_unref (data->window);
+      g_free (data);
+    }
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+static void
+update_status (DialogData *data)
+{
+  GtkTreeIter iter;
+  guint num_drives = 0;
+  guint num_warn = 0;
+  gchar *s;
+  gchar *s2;
+
+  if (data->num_refreshing > 0)
+    {
+      s = g_strdup_printf (dngettext (GETTEXT_PACKAGE,
+                                      "Refreshing SMART data of one disk…",
+                                      "Refreshing SMART data of %d disks…",
+                                      data->num_refreshing),
+                           data->num_refreshing);
+      gtk_label_set_text (GTK_LABEL (data->status_label), s);
+      g_free (s);
+      gtk_widget_set_sensitive (data->refresh_button, FALSE);
+      return;
+    }
+  gtk_widget_set_sensitive (data->refresh_button, TRUE);
+
+  if (gtk_tree_model_get_iter_first (GTK_TREE_MODEL (data->store), &iter))
+    {
+      do
+        {
+          gchar *sort_key;
+          gtk_tree_model_get (GTK_TREE_MODEL (data->store), &iter, SORT_KEY_COLUMN, &sort_key, -1);
+          /* see update_row() */
+          if (sort_key != NULL && sort_key[0] == '0')
+            num_warn++;
+          num_drives++;
+          g_free (sort_key);
+        }
+      while (gtk_tree_model_iter_next (GTK_TREE_MODEL (data->store), &iter));
+    }
+
+  s = g_strdup_printf (dngettext (GETTEXT_PACKAGE,
+                                  "One disk",
+                                  "%d disks",
+                                  num_drives),
+                       num_drives);
+  if (num_warn > 0)
+    {
+      s2 = g_strdup_printf (dngettext (GETTEXT_PACKAGE,
+                                       "%s, one needs attention",
+                                       "%s, %d need attention",
+                                       num_warn),
+                            s, num_warn);
+      g_free (s);
+      s = s2;
+    }
+  if (data->num_asleep > 0)
+    {
+      s2 = g_strdup_printf (dngettext (GETTEXT_PACKAGE,
+                                       "%s — one disk in standby was not refreshed",
+                                       "%s — %d disks in standby were not refreshed",
+                                       data->num_asleep),
+                            s, data->num_asleep);
+      g_free (s);
+      s = s2;
+    }
+  if (data->num_errors > 0)
+    {
+      s2 = g_strdup_printf (dngettext (GETTEXT_PACKAGE,
+                                       "%s — refreshing one disk failed",
+                                       "%s — refreshing %d disks failed",
+                                       data->num_errors),
+                            s, data->num_errors);
+      g_free (s);
+      s = s2;
+    }
+  gtk_label_set_text (GTK_LABEL (data->status_label), s);
+  g_free (s);
+}
+
+static void
+update_row (DialogData   *data,
+            UDisksObject *object,
+            GtkTreeIter  *iter)
+{
+  UDisksDriveAta *ata;
+  UDisksObjectInfo *info;
+  gchar *assessment = NULL;
+  gchar *temperature = NULL;
+  gchar *powered_on = NULL;
+  gchar *failing = NULL;
+  gchar *sort_key;
+  gboolean warn = FALSE;
+
+  ata = udisks_object_peek_drive_ata (object);
+  info = gdu_application_get_object_info (gdu_window_get_application (data->window), object);
+
+  if (ata != NULL)
+    {
+      assessment = gdu_ata_smart_get_assessment (ata, NULL, &warn);
+      temperature = gdu_ata_smart_format_temperature (ata);
+      powered_on = gdu_ata_smart_format_powered_on (ata);
+      if (udisks_drive_ata_get_smart_enabled (ata))
+        failing = g_strdup_printf ("%d", udisks_drive_ata_get_smart_num_attributes_failing (ata));
+      else
+        failing = g_strdup ("—");
+    }
+#if UDISKS_CHECK_VERSION(2, 10, 0)
+  else
+    {
+      UDisksNVMeController *controller = udisks_object_peek_nvme_controller (object);
+      const gchar *const *warnings;
+
+      /* only the properties, the health log attributes need a D-Bus call per drive */
+      assessment = gdu_nvme_health_get_assessment (controller, NULL /* attributes */, &warn);
+      temperature = gdu_nvme_health_format_temperature (controller);
+      powered_on = gdu_nvme_health_format_powered_on (controller);
+      /* the closest thing NVMe has to failing attributes */
+      warnings = udisks_nvme_controller_get_smart_critical_warning (controller);
+      failing = g_strdup_printf ("%u", warnings != NULL ? g_strv_length ((gchar **) warnings) : 0);
+    }
+#endif
+
+  /* disks needing attention first */
+  sort_key = g_strdup_printf ("%c%s", warn ? '0' : '1', udisks_object_info_get_sort_key (info));
+
+  gtk_list_store_set (data->store, iter,
+                      ICON_COLUMN, udisks_object_info_get_icon (info),
+                      NAME_COLUMN, udisks_object_info_get_one_liner (info),
+                      ASSESSMENT_COLUMN, assessment,
+                      TEMPERATURE_COLUMN, temperature != NULL ? temperature : "—",
+                      POWERED_ON_COLUMN, powered_on != NULL ? powered_on : "—",
+                      FAILING_COLUMN, failing != NULL ? failing : "—",
+                      SORT_KEY_COLUMN, sort_key,
+                      -1);
+
+  g_free (sort_key);
+  g_free (failing);
+  g_free (powered_on);
+  g_free (temperature);
+  g_free (assessment);
+  g_object_unref (info);
+}
+
+static gboolean
+has_smart (UDisksObject *object)
+{
+  if (udisks_object_peek_drive (object) == NULL)
+    return FALSE;
+#if UDISKS_CHECK_VERSION(2, 10, 0)
+  if (udisks_object_peek_nvme_controller (object) != NULL)
+    return TRUE;
+#endif
+  return udisks_object_peek_drive_ata (object) != NULL;
+}
+
+/* adds and removes rows so there's one for every drive with SMART support */
+static void
+sync_rows (DialogData *data)
+{
+  GList *objects, *l;
+  GHashTable *seen;
+  GHashTableIter hash_iter;
+  UDisksObject *object;
+  GtkTreeIter *iter;
+
+  seen = g_hash_table_new (g_direct_hash, g_direct_equal);
+  objects = g_dbus_object_manager_get_objects (udisks_client_get_object_manager (data->client));
+  for (l = objects; l != NULL; l = l->next)
+    {
+      object = UDISKS_OBJECT (l->data);
+      if (!has_smart (object))
+        continue;
+
+      g_hash_table_add (seen, object);
+      if (g_hash_table_contains (data->rows, object))
+        continue;
+
+      iter = g_new0 (GtkTreeIter, 1);
+      gtk_list_store_insert_with_values (data->store, iter, -1,
+                                         OBJECT_COLUMN, object,
+                                         -1);
+      g_hash_table_insert (data->rows, g_object_ref (object), iter);
+      update_row (data, object, iter);
+    }
+
+  g_hash_table_iter_init (&hash_iter, data->rows);
+  while (g_hash_table_iter_next (&hash_iter, (gpointer) &object, (gpointer) &iter))
+    {
+      if (!g_hash_table_contains (seen, object))
+        {
+          gtk_list_store_remove (data->store, iter);
+          g_hash_table_iter_remove (&hash_iter);
+        }
+    }
+
+  g_hash_table_unref (seen);
+  g_list_free_full (objects, g_object_unref);
+
+  update_status (data);
+}
+
+static gboolean
+is_smart_interface (gpointer interface)
+{
+#if UDISKS_CHECK_VERSION(2, 10, 0)
+  if (UDISKS_IS_NVME_CONTROLLER (interface))
+    return TRUE;
+#endif
+  return UDISKS_IS_DRIVE (interface) || UDISKS_IS_DRIVE_ATA (interface);
+}
+
+static void
+on_object_added_or_removed (GDBusObjectManager *manager,
+                            GDBusObject        *object,
+                            gpointer            user_data)
+{
+  DialogData *data = user_data;
+  sync_rows (data);
+}
+
+static void
+on_interface_added_or_removed (GDBusObjectManager *manager,
+                               GDBusObject        *object,
+                               GDBusInterface     *interface,
+                               gpointer            user_data)
+{
+  DialogData *data = user_data;
+  if (is_smart_interface (interface))
+    sync_rows (data);
+}
+
+static void
+on_interface_proxy_properties_changed (GDBusObjectManagerClient *manager,
+                                       GDBusObjectProxy         *object_proxy,
+                                       GDBusProxy               *interface_proxy,
+                                       GVariant                 *changed_properties,
+                                       const gchar *const       *invalidated_properties,
+                                       gpointer                  user_data)
+{
+  DialogData *data = user_data;
+  GtkTreeIter *iter;
+
+  if (!is_smart_interface (interface_proxy))
+    return;
+
+  iter = g_hash_table_lookup (data->rows, object_proxy);
+  if (iter != NULL)
+    {
+      update_row (data, UDISKS_OBJECT (object_proxy), iter);
+      update_status (data);
+    }
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+/* takes ownership of @error */
+static void
+smart_update_done (DialogData *data,
+                   GError     *error)
+{
+  if (error != NULL)
+    {
+      if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        {
+          g_clear_error (&error);
+          goto out;
+        }
+      if (g_error_matches (error, UDISKS_ERROR, UDISKS_ERROR_WOULD_WAKEUP))
+        {
+          data->num_asleep++;
+        }
+      else
+        {
+          g_warning ("Error refreshing SMART data: %s (%s, %d)",
+                     error->message, g_quark_to_string (error->domain), error->code);
+          data->num_errors++;
+        }
+      g_clear_error (&error);
+    }
+
+  data->num_refreshing--;
+  update_status (data);
+
+ out:
+  dialog_data_unref (data);
+}
+
+static void
+smart_update_cb (UDisksDriveAta *ata,
+                 GAsyncResult   *res,
+                 gpointer        user_data)
+{
+  GError *error = NULL;
+
+  udisks_drive_ata_call_smart_update_finish (ata, res, &error);
+  smart_update_done (user_data, error);
+}
+
+#if UDISKS_CHECK_VERSION(2, 10, 0)
+static void
+nvme_smart_update_cb (UDisksNVMeController *controller,
+                      GAsyncResult         *res,
+                      gpointer              user_data)
+{
+  GError *error = NULL;
+
+  udisks_nvme_controller_call_smart_update_finish (controller, res, &error);
+  smart_update_done (user_data, error);
+}
+#endif
+
+/* Fires off the update requests for all drives at once - udisks handles
+ * them in parallel and the rows are updated as the results come in
+ */
+static void
+refresh_all (DialogData *data)
+{
+  GHashTableIter hash_iter;
+  UDisksObject *object;
+
+  data->num_asleep = 0;
+  data->num_errors = 0;
+
+  g_hash_table_iter_init (&hash_iter, data->rows);
+  while (g_hash_table_iter_next (&hash_iter, (gpointer) &object, NULL))
+    {
+      UDisksDriveAta *ata = udisks_object_peek_drive_ata (object);
+      GVariantBuilder options_builder;
+
+      if (ata != NULL)
+        {
+          if (!udisks_drive_ata_get_smart_enabled (ata))
+            continue;
+
+          g_variant_builder_init (&options_builder, G_VARIANT_TYPE_VARDICT);
+          g_variant_builder_add (&options_builder, "{sv}", "nowakeup", g_variant_new_boolean (TRUE));
+          udisks_drive_ata_call_smart_update (ata,
+                                              g_variant_builder_end (&options_builder),
+                                              data->cancellable,
+                                              (GAsyncReadyCallback) smart_update_cb,
+                                              dialog_data_ref (data));
+        }
+#if UDISKS_CHECK_VERSION(2, 10, 0)
+      else
+        {
+          /* udisks has no "nowakeup" option for NVMe */
+          udisks_nvme_controller_call_smart_update (udisks_object_peek_nvme_controller (object),
+                                                    g_variant_new ("a{sv}", NULL), /* options */
+                                                    data->cancellable,
+                                                    (GAsyncReadyCallback) nvme_smart_update_cb,
+                                                    dialog_data_ref (data));
+        }
+#endif
+      data->num_refreshing++;
+    }
+
+  update_status (data);
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+static void
+on_row_activated (GtkTreeView       *tree_view,
+                  GtkTreePath       *path,
+                  GtkTreeViewColumn *column,
+                  gpointer           user_data)
+{
+  DialogData *data = user_data;
+  GtkTreeIter iter;
+  UDisksObject *object = NULL;
+
+  if (!gtk_tree_model_get_iter (GTK_TREE_MODEL (data->store), &iter, path))
+    return;
+
+  gtk_tree_model_get (GTK_TREE_MODEL (data->store), &iter, OBJECT_COLUMN, &object, -1);
+#if UDISKS_CHECK_VERSION(2, 10, 0)
+  if (udisks_object_peek_nvme_controller (object) != NULL)
+    gdu_nvme_health_dialog_show (data->window, object);
+  else
+#endif
+    gdu_ata_smart_dialog_show (data->window, object);
+  g_object_unref (object);
+}
+
+static void
+add_text_column (DialogData  *data,
+                 const gchar *title,
+                 gint         column_id,
+                 gboolean     use_markup)
+{
+  GtkTreeViewColumn *column;
+  GtkCellRenderer *renderer;
+
+  column = gtk_tree_view_column_new ();
+  gtk_tree_view_column_set_title (column, title);
+  gtk_tree_view_append_column (GTK_TREE_VIEW (data->drives_treeview), column);
+  renderer = gtk_cell_renderer_text_new ();
+  gtk_tree_view_column_pack_start (column, renderer, FALSE);
+  gtk_tree_view_column_set_attributes (column, renderer,
+                                       use_markup ? "markup" : "text", column_id,
+                                       NULL);
+}
+
+static void
+init_treeview (DialogData *data)
+{
+  GtkTreeViewColumn *column;
+  GtkCellRenderer *renderer;
+
+  data->store = gtk_list_store_new (N_COLUMNS,
+                                    UDISKS_TYPE_OBJECT, /* object */
+                                    G_TYPE_ICON,        /* icon */
+                                    G_TYPE_STRING,      /* name */
+                                    G_TYPE_STRING,      /* assessment */
+                                    G_TYPE_STRING,      /* temperature */
+                                    G_TYPE_STRING,      /* powered on */
+                                    G_TYPE_STRING,      /* failing attributes */
+                                    G_TYPE_STRING);     /* sort key */
+  gtk_tree_sortable_set_sort_column_id (GTK_TREE_SORTABLE (data->store),
+                                        SORT_KEY_COLUMN,
+                                        GTK_SORT_ASCENDING);
+  gtk_tree_view_set_model (GTK_TREE_VIEW (data->drives_treeview), GTK_TREE_MODEL (data->store));
+
+  column = gtk_tree_view_column_new ();
+  /* Translators: Column header for the disks in the "Disk Health" dialog */
+  gtk_tree_view_column_set_title (column, C_("smart-dashboard", "Disk"));
+  gtk_tree_view_column_set_expand (column, TRUE);
+  gtk_tree_view_append_column (GTK_TREE_VIEW (data->drives_treeview), column);
+
+  renderer = gtk_cell_renderer_pixbuf_new ();
+  g_object_set (G_OBJECT (renderer),
+                "stock-size", GTK_ICON_SIZE_MENU,
+                NULL);
+  gtk_tree_view_column_pack_start (column, renderer, FALSE);
+  gtk_tree_view_column_set_attributes (column, renderer,
+                                       "gicon", ICON_COLUMN,
+                                       NULL);
+
+  renderer = gtk_cell_renderer_text_new ();
+  g_object_set (G_OBJECT (renderer),
+                "ellipsize", PANGO_ELLIPSIZE_MIDDLE,
+                NULL);
+  gtk_tree_view_column_pack_start (column, renderer, TRUE);
+  gtk_tree_view_column_set_attributes (column, renderer,
+                                       "text", NAME_COLUMN,
+                                       NULL);
+
+  /* Translators: Column header for the overall SMART assessment in the "Disk Health" dialog */
+  add_text_column (data, C_("smart-dashboard", "Assessment"), ASSESSMENT_COLUMN, TRUE);
+  /* Translators: Column header for the temperature in the "Disk Health" dialog */
+  add_text_column (data, C_("smart-dashboard", "Temperature"), TEMPERATURE_COLUMN, FALSE);
+  /* Translators: Column header for the power-on time in the "Disk Health" dialog */
+  add_text_column (data, C_("smart-dashboard", "Powered On"), POWERED_ON_COLUMN, FALSE);
+  /* Translators: Column header for the number of failing SMART attributes in the "Disk Health" dialog */
+  add_text_column (data, C_("smart-dashboard", "Failing Attributes"), FAILING_COLUMN, FALSE);
+
+  g_signal_connect (data->drives_treeview, "row-activated", G_CALLBACK (on_row_activated), data);
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+void
+gdu_smart_dashboard_dialog_show (GduWindow *window)
+{
+  DialogData *data;
+  GDBusObjectManager *object_manager;
+  guint n;
+
+  data = g_new0 (DialogData, 1);
+  data->ref_count = 1;
+  data->window = g_object_ref (window);
+  data->client = g_object_ref (gdu_window_get_client (window));
+  data->cancellable = g_cancellable_new ();
+  data->rows = g_hash_table_new_full (g_direct_hash, g_direct_equal, g_object_unref, g_free);
+
+  data->dialog = GTK_WIDGET (gdu_application_new_widget (gdu_window_get_application (window),
+                                                         "smart-dashboard-dialog.ui",
+                                                         "smart-dashboard-dialog",
+                                                         &data->builder));
+  for (n = 0; widget_mapping[n].name != NULL; n++)
+    {
+      gpointer *p = (gpointer *) ((char *) data + widget_mapping[n].offset);
+      *p = GTK_WIDGET (gtk_builder_get_object (data->builder, widget_mapping[n].name));
+      g_warn_if_fail (*p != NULL);
+    }
+
+  gtk_window_set_transient_for (GTK_WINDOW (data->dialog), GTK_WINDOW (window));
+
+  init_treeview (data);
+  sync_rows (data);
+
+  object_manager = udisks_client_get_object_manager (data->client);
+  g_signal_connect (object_manager, "object-added", G_CALLBACK (on_object_added_or_removed), data);
+  g_signal_connect (object_manager, "object-removed", G_CALLBACK (on_object_added_or_removed), data);
+  g_signal_connect (object_manager, "interface-added", G_CALLBACK (on_interface_added_or_removed), data);
+  g_signal_connect (object_manager, "interface-removed", G_CALLBACK (on_interface_added_or_removed), data);
+  g_signal_connect (object_manager,
+                    "interface-proxy-properties-changed",
+                    G_CALLBACK (on_interface_proxy_properties_changed),
+                    data);
+
+  while (TRUE)
+    {
+      gint response;
+      response = gtk_dialog_run (GTK_DIALOG (data->dialog));
+
+      if (response < 0)
+        break;
+
+      /* Keep in sync with .ui file */
+      switch (response)
+        {
+        case 0: /* refresh */
+          refresh_all (data);
+          break;
+
+        default:
+          g_assert_not_reached ();
+        }
+    }
+
+  g_signal_handlers_disconnect_by_data (object_manager, data);
+  g_cancellable_cancel (data->cancellable);
+  /* pending refreshes keep a reference until they have been cancelled */
+  gtk_widget_hide (data->dialog);
+  dialog_data_unref (data);
+}
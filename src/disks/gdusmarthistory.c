@@ -0,0 +1,863 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*-
+ *
+ * Copyright (C) 2008-2013 Red Hat, Inc.
+ *
+ * Licensed under GPL version 2 or later.
+ *
+ * Author: David Zeuthen <zeuthen@gmail.com>
+ */
+
+#include "config.h"
+
+#include <glib/gi18n.h>
+#include <glib/gstdio.h>
+
+#include <sys/stat.h>
+#include <string.h>
+
+#include "gdusmarthistory.h"
+
+/* The history file contains a sample of the SMART data of a drive every
+ * time the recorder found it updated, one GduSmartSample record per
+ * sample. See gduhistoryfile.c for the file format.
+ *
+ * Version 1 files, which lack the NVMe fields, are still loaded and are
+ * rewritten in the current format before appending to them.
+ */
+
+#define HISTORY_MAGIC      "GDUSMART"
+#define HISTORY_VERSION    2
+
+static const GduHistoryFormat history_format =
+{
+  HISTORY_MAGIC,
+  HISTORY_VERSION,
+  "SMART",
+  sizeof (GduSmartSample),
+  NULL
+};
+
+typedef struct
+{
+  gint64  timestamp;
+  guint64 power_on_seconds;
+  gdouble temperature;
+  gint64  reallocated_sectors;
+  gint64  pending_sectors;
+} SampleV1;
+
+G_STATIC_ASSERT (sizeof (SampleV1) == 40);
+G_STATIC_ASSERT (sizeof (GduSmartSample) == 72);
+
+/* See smart_details[] in gduatasmartdialog.c */
+#define ATTRIBUTE_REALLOCATED_SECTOR_COUNT 5
+#define ATTRIBUTE_CURRENT_PENDING_SECTOR   197
+
+struct GduSmartRecorder
+{
+  UDisksClient *client;
+  GSettings *settings;
+  GCancellable *cancellable;
+  guint timeout_id;
+
+  /* Maps from history filename -> timestamp of the last sample in the file */
+  GHashTable *last_timestamps;
+};
+
+typedef struct
+{
+  GduSmartRecorder *recorder;
+  GCancellable *cancellable;
+  gchar *filename;
+  GduSmartSample sample;
+} SampleData;
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+/* returns NULL if it doesn't make sense to keep history for this drive */
+gchar *
+gdu_smart_history_get_filename_for_drive (UDisksDrive *drive)
+{
+  gchar *ret = NULL;
+  gchar *history_dir = NULL;
+  gchar *id = NULL;
+
+  /* the WWN is unique, the serial number is a good second best */
+  id = g_strdup (udisks_drive_get_wwn (drive));
+  if (id == NULL || strlen (id) == 0)
+    {
+      g_free (id);
+      id = g_strdup (udisks_drive_get_serial (drive));
+    }
+  if (id == NULL || strlen (id) == 0)
+    goto out;
+  g_strcanon (id, G_CSET_A_2_Z G_CSET_a_2_z G_CSET_DIGITS "-_.", '_');
+
+  history_dir = g_strdup_printf ("%s/mate-disks/smart-history", g_get_user_data_dir ());
+  if (g_mkdir_with_parents (history_dir, 0777) != 0)
+    {
+      g_warning ("Error creating directory %s: %m", history_dir);
+      goto out;
+    }
+
+  ret = g_strdup_printf ("%s/%s.mate-disks-smart", history_dir, id);
+
+ out:
+  g_free (history_dir);
+  g_free (id);
+  return ret;
+}
+
+/* rewrites a file from an older version in the current format */
+static gboolean
+upgrade_history (const gchar  *filename,
+                 GError      **error)
+{
+  gboolean ret = FALSE;
+  GArray *samples;
+
+  samples = gdu_smart_history_load (filename, error);
+  if (samples == NULL)
+    goto out;
+
+  ret = gdu_history_file_replace (filename,
+                                  &history_format,
+                                  samples->data,
+                                  samples->len * sizeof (GduSmartSample),
+                                  error);
+  g_array_unref (samples);
+
+ out:
+  return ret;
+}
+
+gboolean
+gdu_smart_history_append (const gchar           *filename,
+                          const GduSmartSample  *sample,
+                          GError               **error)
+{
+  GError *local_error = NULL;
+
+  if (gdu_history_file_append (filename, &history_format, sample, sizeof (GduSmartSample), &local_error))
+    return TRUE;
+
+  if (!g_error_matches (local_error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED))
+    {
+      g_propagate_error (error, local_error);
+      return FALSE;
+    }
+  g_clear_error (&local_error);
+
+  if (!upgrade_history (filename, error))
+    return FALSE;
+  return gdu_history_file_append (filename, &history_format, sample, sizeof (GduSmartSample), error);
+}
+
+/* Returns all samples in @filename, oldest first, as an array of
+ * GduSmartSample. A missing file is not an error.
+ */
+GArray *
+gdu_smart_history_load (const gchar  *filename,
+                        GError      **error)
+{
+  GArray *ret = NULL;
+  GError *local_error = NULL;
+  gchar *contents = NULL;
+  gsize length;
+  guint32 version;
+  guint num_samples;
+
+  ret = g_array_new (FALSE, FALSE, sizeof (GduSmartSample));
+
+  if (!g_file_get_contents (filename, &contents, &length, &local_error))
+    {
+      if (local_error->domain == G_FILE_ERROR && local_error->code == G_FILE_ERROR_NOENT)
+        {
+          g_clear_error (&local_error);
+          goto out;
+        }
+      g_propagate_error (error, local_error);
+      g_clear_pointer (&ret, g_array_unref);
+      goto out;
+    }
+
+  if (!gdu_history_file_check_header (filename, &history_format, contents, length, &version, error))
+    {
+      g_clear_pointer (&ret, g_array_unref);
+      goto out;
+    }
+  if (version == 1)
+    {
+      const SampleV1 *old_samples = (const SampleV1 *) (contents + GDU_HISTORY_FILE_HEADER_SIZE);
+      guint n;
+
+      num_samples = (length - GDU_HISTORY_FILE_HEADER_SIZE) / sizeof (SampleV1);
+      g_array_set_size (ret, num_samples);
+      for (n = 0; n < num_samples; n++)
+        {
+          GduSmartSample *sample = &g_array_index (ret, GduSmartSample, n);
+          sample->timestamp = old_samples[n].timestamp;
+          sample->power_on_seconds = old_samples[n].power_on_seconds;
+          sample->temperature = old_samples[n].temperature;
+          sample->reallocated_sectors = old_samples[n].reallocated_sectors;
+          sample->pending_sectors = old_samples[n].pending_sectors;
+          sample->percentage_used = -1;
+          sample->media_errors = -1;
+          sample->bytes_written = -1;
+          sample->thermal_throttle_minutes = -1;
+        }
+      goto out;
+    }
+  if (version != HISTORY_VERSION)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                   "Cannot decode version %d SMART history", version);
+      g_clear_pointer (&ret, g_array_unref);
+      goto out;
+    }
+
+  /* a truncated record at the end is simply ignored */
+  num_samples = (length - GDU_HISTORY_FILE_HEADER_SIZE) / sizeof (GduSmartSample);
+  g_array_append_vals (ret, contents + GDU_HISTORY_FILE_HEADER_SIZE, num_samples);
+
+ out:
+  g_free (contents);
+  return ret;
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+/* Formats a temperature in Kelvin as reported by udisks, returns NULL if not available */
+gchar *
+gdu_smart_format_temperature (gdouble temperature)
+{
+  gdouble celcius;
+  gdouble fahrenheit;
+
+  if (temperature <= 1.0)
+    return NULL;
+
+  celcius = temperature - 273.15;
+  fahrenheit = 9.0 * celcius / 5.0 + 32.0;
+  /* Translators: Used to format a temperature.
+   * The first %f is the temperature in degrees Celcius and
+   * the second %f is the temperature in degrees Fahrenheit.
+   */
+  return g_strdup_printf (_("%.0f° C / %.0f° F"), celcius, fahrenheit);
+}
+
+/* Reloads *@history if the recorder has appended to @filename since it
+ * was last loaded, returns %TRUE if it was reloaded
+ */
+gboolean
+gdu_smart_history_reload (const gchar  *filename,
+                          goffset      *size,
+                          GArray      **history)
+{
+  GStatBuf statbuf;
+  GError *error = NULL;
+
+  if (filename == NULL)
+    return FALSE;
+
+  if (g_stat (filename, &statbuf) != 0 || statbuf.st_size == *size)
+    return FALSE;
+
+  if (*history != NULL)
+    g_array_unref (*history);
+  *history = gdu_smart_history_load (filename, &error);
+  if (*history == NULL)
+    {
+      g_warning ("Error loading SMART history: %s (%s, %d)",
+                 error->message, g_quark_to_string (error->domain), error->code);
+      g_clear_error (&error);
+    }
+  *size = statbuf.st_size;
+  return TRUE;
+}
+
+static gboolean
+trend_get_value (const GduSmartSample *sample,
+                 GduSmartTrend         trend,
+                 gdouble              *out_value)
+{
+  gint64 value;
+
+  switch (trend)
+    {
+    case GDU_SMART_TREND_TEMPERATURE:
+      if (sample->temperature <= 1.0)
+        return FALSE;
+      *out_value = sample->temperature - 273.15;
+      return TRUE;
+    case GDU_SMART_TREND_POWER_ON_HOURS:
+      if (sample->power_on_seconds == 0)
+        return FALSE;
+      *out_value = sample->power_on_seconds / 3600.0;
+      return TRUE;
+    case GDU_SMART_TREND_REALLOCATED_SECTORS:
+      value = sample->reallocated_sectors;
+      break;
+    case GDU_SMART_TREND_PENDING_SECTORS:
+      value = sample->pending_sectors;
+      break;
+    case GDU_SMART_TREND_PERCENTAGE_USED:
+      value = sample->percentage_used;
+      break;
+    case GDU_SMART_TREND_MEDIA_ERRORS:
+      value = sample->media_errors;
+      break;
+    case GDU_SMART_TREND_THERMAL_THROTTLE:
+      value = sample->thermal_throttle_minutes;
+      break;
+    case GDU_SMART_TREND_DATA_WRITTEN:
+      value = sample->bytes_written;
+      break;
+    default:
+      g_assert_not_reached ();
+    }
+
+  if (value < 0)
+    return FALSE;
+  *out_value = value;
+  return TRUE;
+}
+
+static gchar *
+trend_format (GduSmartTrend trend,
+              gdouble       value)
+{
+  gchar *s, *ret;
+
+  switch (trend)
+    {
+    case GDU_SMART_TREND_REALLOCATED_SECTORS:
+      /* Translators: Title of a SMART trend graph. The %.0f is the current value */
+      return g_strdup_printf (C_("smart-trend", "Reallocated Sectors: %.0f"), value);
+    case GDU_SMART_TREND_PENDING_SECTORS:
+      /* Translators: Title of a SMART trend graph. The %.0f is the current value */
+      return g_strdup_printf (C_("smart-trend", "Pending Sectors: %.0f"), value);
+    case GDU_SMART_TREND_TEMPERATURE:
+      /* Translators: Title of a SMART trend graph. The %.0f is the current temperature in degrees Celcius */
+      return g_strdup_printf (C_("smart-trend", "Temperature: %.0f° C"), value);
+    case GDU_SMART_TREND_POWER_ON_HOURS:
+      /* Translators: Title of a SMART trend graph. The %.0f is the current number of hours */
+      return g_strdup_printf (C_("smart-trend", "Powered On: %.0f hours"), value);
+    case GDU_SMART_TREND_PERCENTAGE_USED:
+      /* Translators: Title of a SMART trend graph. The %.0f is the current percentage of the rated endurance used */
+      return g_strdup_printf (C_("smart-trend", "Percentage Used: %.0f%%"), value);
+    case GDU_SMART_TREND_MEDIA_ERRORS:
+      /* Translators: Title of a SMART trend graph. The %.0f is the current number of errors */
+      return g_strdup_printf (C_("smart-trend", "Media Errors: %.0f"), value);
+    case GDU_SMART_TREND_THERMAL_THROTTLE:
+      /* Translators: Title of a SMART trend graph. The %.0f is the number of minutes spent
+       * above the warning or critical temperature
+       */
+      return g_strdup_printf (C_("smart-trend", "Thermal Throttling: %.0f minutes"), value);
+    case GDU_SMART_TREND_DATA_WRITTEN:
+      s = g_format_size ((guint64) value);
+      /* Translators: Title of a SMART trend graph. The %s is the amount of data written, e.g. "12.3 TB" */
+      ret = g_strdup_printf (C_("smart-trend", "Data Written: %s"), s);
+      g_free (s);
+      return ret;
+    default:
+      g_assert_not_reached ();
+    }
+  return NULL;
+}
+
+static void
+draw_trend (GtkWidget     *widget,
+            cairo_t       *cr,
+            GArray        *history,
+            GduSmartTrend  trend,
+            gdouble        x,
+            gdouble        y,
+            gdouble        width,
+            gdouble        height,
+            GdkRGBA       *fg)
+{
+  const GduSmartSample *samples = (const GduSmartSample *) history->data;
+  guint num_samples = history->len;
+  gint64 first_time, last_time;
+  gdouble min_value = G_MAXDOUBLE, max_value = -G_MAXDOUBLE;
+  gdouble first_value = 0.0, last_value = 0.0, value;
+  gdouble gy, gh;
+  gboolean have_value = FALSE;
+  gboolean move = TRUE;
+  PangoLayout *layout;
+  gint layout_height;
+  gchar *s;
+  guint n;
+
+  first_time = samples[0].timestamp;
+  last_time = samples[num_samples - 1].timestamp;
+  for (n = 0; n < num_samples; n++)
+    {
+      if (!trend_get_value (&samples[n], trend, &value))
+        continue;
+      if (!have_value)
+        first_value = value;
+      last_value = value;
+      min_value = MIN (min_value, value);
+      max_value = MAX (max_value, value);
+      have_value = TRUE;
+    }
+
+  /* title with the current value */
+  if (have_value)
+    s = trend_format (trend, last_value);
+  else
+    s = g_strdup ("—");
+  layout = gtk_widget_create_pango_layout (widget, s);
+  g_free (s);
+  pango_layout_get_pixel_size (layout, NULL, &layout_height);
+  gdk_cairo_set_source_rgba (cr, fg);
+  cairo_move_to (cr, x, y);
+  pango_cairo_show_layout (cr, layout);
+  g_object_unref (layout);
+
+  gy = y + layout_height + 4;
+  gh = height - layout_height - 4;
+
+  cairo_set_line_width (cr, 1.0);
+  cairo_set_source_rgba (cr, fg->red, fg->green, fg->blue, 0.3);
+  cairo_rectangle (cr, x + 0.5, gy + 0.5, width - 1, gh - 1);
+  cairo_stroke (cr);
+
+  if (!have_value)
+    return;
+
+  /* growing error counts are what predicts a failing disk */
+  if ((trend == GDU_SMART_TREND_REALLOCATED_SECTORS ||
+       trend == GDU_SMART_TREND_PENDING_SECTORS ||
+       trend == GDU_SMART_TREND_MEDIA_ERRORS) && last_value > first_value)
+    cairo_set_source_rgb (cr, 1.0, 0.0, 0.0);
+  else
+    gdk_cairo_set_source_rgba (cr, fg);
+
+  /* leave some room so flat lines don't hug the frame */
+  if (max_value - min_value < 1.0)
+    {
+      min_value -= 0.5;
+      max_value += 0.5;
+    }
+  gy += 4;
+  gh -= 8;
+
+  cairo_set_line_width (cr, 2.0);
+  for (n = 0; n < num_samples; n++)
+    {
+      gdouble px, py;
+
+      if (!trend_get_value (&samples[n], trend, &value))
+        {
+          /* a gap in the data */
+          move = TRUE;
+          continue;
+        }
+      px = x + 4 + (width - 8) * (samples[n].timestamp - first_time) / MAX (last_time - first_time, 1);
+      py = gy + gh - gh * (value - min_value) / (max_value - min_value);
+      if (move)
+        cairo_move_to (cr, px, py);
+      else
+        cairo_line_to (cr, px, py);
+      move = FALSE;
+    }
+  cairo_stroke (cr);
+}
+
+/* Draws a graph for each of @trends in @history, two to a row, for use in
+ * a GtkDrawingArea::draw handler
+ */
+void
+gdu_smart_history_draw (GtkWidget           *widget,
+                        cairo_t             *cr,
+                        GArray              *history,
+                        const GduSmartTrend *trends,
+                        guint                num_trends)
+{
+  GtkStyleContext *context;
+  GdkRGBA fg;
+  gint width, height;
+  guint num_rows;
+  gdouble panel_width, panel_height;
+  PangoLayout *layout;
+  gint layout_width, layout_height;
+  GDateTime *first, *last;
+  gchar *first_str, *last_str;
+  gchar *s;
+  guint n;
+
+  context = gtk_widget_get_style_context (widget);
+  gtk_style_context_get_color (context, gtk_widget_get_state_flags (widget), &fg);
+  width = gtk_widget_get_allocated_width (widget);
+  height = gtk_widget_get_allocated_height (widget);
+
+  if (history == NULL || history->len < 2)
+    {
+      layout = gtk_widget_create_pango_layout (widget,
+                                               /* Translators: Shown instead of the SMART trend graphs */
+                                               C_("smart-trend", "Not enough SMART data has been recorded for this disk yet"));
+      pango_layout_get_pixel_size (layout, &layout_width, &layout_height);
+      gdk_cairo_set_source_rgba (cr, &fg);
+      cairo_move_to (cr, (width - layout_width) / 2, (height - layout_height) / 2);
+      pango_cairo_show_layout (cr, layout);
+      g_object_unref (layout);
+      return;
+    }
+
+  /* the period covered by the graphs at the bottom */
+  first = g_date_time_new_from_unix_local (g_array_index (history, GduSmartSample, 0).timestamp);
+  last = g_date_time_new_from_unix_local (g_array_index (history, GduSmartSample, history->len - 1).timestamp);
+  first_str = g_date_time_format (first, "%x");
+  last_str = g_date_time_format (last, "%x");
+  /* Translators: Shown below the SMART trend graphs.
+   * The first %s is the date of the first sample, the second %s the date of the last sample.
+   */
+  s = g_strdup_printf (C_("smart-trend", "From %s to %s"), first_str, last_str);
+  g_free (first_str);
+  g_free (last_str);
+  g_date_time_unref (first);
+  g_date_time_unref (last);
+  layout = gtk_widget_create_pango_layout (widget, s);
+  g_free (s);
+  pango_layout_get_pixel_size (layout, &layout_width, &layout_height);
+  cairo_set_source_rgba (cr, fg.red, fg.green, fg.blue, 0.6);
+  cairo_move_to (cr, (width - layout_width) / 2, height - layout_height);
+  pango_cairo_show_layout (cr, layout);
+  g_object_unref (layout);
+
+  /* two panels per row */
+  num_rows = MAX ((num_trends + 1) / 2, 1);
+  panel_width = (width - 12) / 2.0;
+  panel_height = (height - layout_height - 6 - 12 * num_rows) / (gdouble) num_rows;
+  for (n = 0; n < num_trends; n++)
+    {
+      draw_trend (widget, cr, history, trends[n],
+                  (n % 2) * (panel_width + 12),
+                  (n / 2) * (panel_height + 12),
+                  panel_width,
+                  panel_height,
+                  &fg);
+    }
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+static gint64
+get_last_timestamp (GduSmartRecorder *recorder,
+                    const gchar      *filename)
+{
+  gpointer value;
+  gint64 *timestamp;
+
+  if (!g_hash_table_lookup_extended (recorder->last_timestamps, filename, NULL, &value))
+    {
+      GArray *samples;
+      GError *error = NULL;
+
+      timestamp = g_new0 (gint64, 1);
+      samples = gdu_smart_history_load (filename, &error);
+      if (samples == NULL)
+        {
+          g_warning ("Error loading SMART history: %s (%s, %d)",
+                     error->message, g_quark_to_string (error->domain), error->code);
+          g_clear_error (&error);
+        }
+      else
+        {
+          if (samples->len > 0)
+            *timestamp = g_array_index (samples, GduSmartSample, samples->len - 1).timestamp;
+          g_array_unref (samples);
+        }
+      g_hash_table_insert (recorder->last_timestamps, g_strdup (filename), timestamp);
+      value = timestamp;
+    }
+
+  return *((gint64 *) value);
+}
+
+static void
+sample_data_free (SampleData *sample_data)
+{
+  g_object_unref (sample_data->cancellable);
+  g_free (sample_data->filename);
+  g_free (sample_data);
+}
+
+/* appends the completed sample to the history file */
+static void
+sample_data_complete (SampleData *sample_data)
+{
+  GError *error = NULL;
+  gint64 *timestamp;
+
+  /* the recorder is gone */
+  if (g_cancellable_is_cancelled (sample_data->cancellable))
+    goto out;
+
+  if (!gdu_smart_history_append (sample_data->filename, &sample_data->sample, &error))
+    {
+      g_warning ("Error appending to SMART history: %s (%s, %d)",
+                 error->message, g_quark_to_string (error->domain), error->code);
+      g_clear_error (&error);
+      goto out;
+    }
+  timestamp = g_new (gint64, 1);
+  *timestamp = sample_data->sample.timestamp;
+  g_hash_table_insert (sample_data->recorder->last_timestamps, g_strdup (sample_data->filename), timestamp);
+
+ out:
+  sample_data_free (sample_data);
+}
+
+static void
+get_attributes_cb (UDisksDriveAta *ata,
+                   GAsyncResult   *res,
+                   gpointer        user_data)
+{
+  SampleData *sample_data = user_data;
+  GVariant *attributes = NULL;
+  GError *error = NULL;
+  GVariantIter iter;
+  guchar id;
+  guint16 flags;
+  gint current, worst, threshold;
+  guint64 pretty;
+  gint pretty_unit;
+
+  if (!udisks_drive_ata_call_smart_get_attributes_finish (ata, &attributes, res, &error))
+    {
+      if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        g_warning ("Error getting ATA SMART attributes: %s (%s, %d)",
+                   error->message, g_quark_to_string (error->domain), error->code);
+      g_clear_error (&error);
+      sample_data_free (sample_data);
+      return;
+    }
+
+  g_variant_iter_init (&iter, attributes);
+  while (g_variant_iter_next (&iter, "(y&sqiiixia{sv})",
+                              &id, NULL, &flags,
+                              &current, &worst, &threshold,
+                              &pretty, &pretty_unit,
+                              NULL))
+    {
+      if (id == ATTRIBUTE_REALLOCATED_SECTOR_COUNT)
+        sample_data->sample.reallocated_sectors = pretty;
+      else if (id == ATTRIBUTE_CURRENT_PENDING_SECTOR)
+        sample_data->sample.pending_sectors = pretty;
+    }
+  g_variant_unref (attributes);
+
+  sample_data_complete (sample_data);
+}
+
+#if UDISKS_CHECK_VERSION(2, 10, 0)
+static void
+nvme_get_attributes_cb (UDisksNVMeController *controller,
+                        GAsyncResult         *res,
+                        gpointer              user_data)
+{
+  SampleData *sample_data = user_data;
+  GVariant *attributes = NULL;
+  GError *error = NULL;
+  guchar percent_used;
+  guint64 media_errors;
+  guint64 data_written;
+  guint32 warning_temp_time;
+  guint32 critical_temp_time;
+
+  if (!udisks_nvme_controller_call_smart_get_attributes_finish (controller, &attributes, res, &error))
+    {
+      if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        g_warning ("Error getting NVMe SMART attributes: %s (%s, %d)",
+                   error->message, g_quark_to_string (error->domain), error->code);
+      g_clear_error (&error);
+      sample_data_free (sample_data);
+      return;
+    }
+
+  if (g_variant_lookup (attributes, "percent_used", "y", &percent_used))
+    sample_data->sample.percentage_used = percent_used;
+  if (g_variant_lookup (attributes, "media_errors", "t", &media_errors))
+    sample_data->sample.media_errors = media_errors;
+  if (g_variant_lookup (attributes, "total_data_written", "t", &data_written))
+    sample_data->sample.bytes_written = data_written;
+  if (g_variant_lookup (attributes, "warning_temp_time", "u", &warning_temp_time) &&
+      g_variant_lookup (attributes, "critical_temp_time", "u", &critical_temp_time))
+    sample_data->sample.thermal_throttle_minutes = (gint64) warning_temp_time + critical_temp_time;
+  g_variant_unref (attributes);
+
+  sample_data_complete (sample_data);
+}
+#endif
+
+/* returns NULL if there is nothing new to record for @drive since the last sample */
+static SampleData *
+sample_data_new (GduSmartRecorder *recorder,
+                 UDisksDrive      *drive,
+                 gint64            updated)
+{
+  SampleData *sample_data = NULL;
+  gchar *filename;
+
+  if (updated == 0)
+    goto out;
+  filename = gdu_smart_history_get_filename_for_drive (drive);
+  if (filename == NULL || get_last_timestamp (recorder, filename) >= updated)
+    {
+      g_free (filename);
+      goto out;
+    }
+
+  sample_data = g_new0 (SampleData, 1);
+  sample_data->recorder = recorder;
+  sample_data->cancellable = g_object_ref (recorder->cancellable);
+  sample_data->filename = filename;
+  sample_data->sample.timestamp = updated;
+  sample_data->sample.reallocated_sectors = -1;
+  sample_data->sample.pending_sectors = -1;
+  sample_data->sample.percentage_used = -1;
+  sample_data->sample.media_errors = -1;
+  sample_data->sample.bytes_written = -1;
+  sample_data->sample.thermal_throttle_minutes = -1;
+
+ out:
+  return sample_data;
+}
+
+static void
+sample_drive (GduSmartRecorder *recorder,
+              UDisksObject     *object)
+{
+  UDisksDrive *drive;
+  UDisksDriveAta *ata;
+#if UDISKS_CHECK_VERSION(2, 10, 0)
+  UDisksNVMeController *controller;
+#endif
+  SampleData *sample_data;
+
+  drive = udisks_object_peek_drive (object);
+  ata = udisks_object_peek_drive_ata (object);
+#if UDISKS_CHECK_VERSION(2, 10, 0)
+  controller = udisks_object_peek_nvme_controller (object);
+#endif
+  if (drive == NULL)
+    return;
+
+  if (ata != NULL)
+    {
+      if (!udisks_drive_ata_get_smart_enabled (ata))
+        return;
+      sample_data = sample_data_new (recorder, drive, udisks_drive_ata_get_smart_updated (ata));
+      if (sample_data == NULL)
+        return;
+      sample_data->sample.power_on_seconds = udisks_drive_ata_get_smart_power_on_seconds (ata);
+      sample_data->sample.temperature = udisks_drive_ata_get_smart_temperature (ata);
+      udisks_drive_ata_call_smart_get_attributes (ata,
+                                                  g_variant_new ("a{sv}", NULL), /* options */
+                                                  recorder->cancellable,
+                                                  (GAsyncReadyCallback) get_attributes_cb,
+                                                  sample_data);
+    }
+#if UDISKS_CHECK_VERSION(2, 10, 0)
+  else if (controller != NULL)
+    {
+      sample_data = sample_data_new (recorder, drive, udisks_nvme_controller_get_smart_updated (controller));
+      if (sample_data == NULL)
+        return;
+      sample_data->sample.power_on_seconds = udisks_nvme_controller_get_smart_power_on_hours (controller) * 3600;
+      sample_data->sample.temperature = udisks_nvme_controller_get_smart_temperature (controller);
+      udisks_nvme_controller_call_smart_get_attributes (controller,
+                                                        g_variant_new ("a{sv}", NULL), /* options */
+                                                        recorder->cancellable,
+                                                        (GAsyncReadyCallback) nvme_get_attributes_cb,
+                                                        sample_data);
+    }
+#endif
+}
+
+static void
+sample_all_drives (GduSmartRecorder *recorder)
+{
+  GList *objects, *l;
+
+  objects = g_dbus_object_manager_get_objects (udisks_client_get_object_manager (recorder->client));
+  for (l = objects; l != NULL; l = l->next)
+    sample_drive (recorder, UDISKS_OBJECT (l->data));
+  g_list_free_full (objects, g_object_unref);
+}
+
+static gboolean
+on_timeout (gpointer user_data)
+{
+  GduSmartRecorder *recorder = user_data;
+  sample_all_drives (recorder);
+  return TRUE; /* keep timeout around */
+}
+
+static void
+schedule_sampling (GduSmartRecorder *recorder)
+{
+  guint interval;
+
+  if (recorder->timeout_id != 0)
+    {
+      g_source_remove (recorder->timeout_id);
+      recorder->timeout_id = 0;
+    }
+
+  /* 0 disables recording */
+  interval = g_settings_get_uint (recorder->settings, "smart-history-interval");
+  if (interval > 0)
+    {
+      recorder->timeout_id = g_timeout_add_seconds (interval, on_timeout, recorder);
+      sample_all_drives (recorder);
+    }
+}
+
+static void
+on_interval_changed (GSettings   *settings,
+                     const gchar *key,
+                     gpointer     user_data)
+{
+  GduSmartRecorder *recorder = user_data;
+  schedule_sampling (recorder);
+}
+
+/* Periodically records the SMART data of all drives, see gdu_smart_history_load() */
+GduSmartRecorder *
+gdu_smart_recorder_new (UDisksClient *client)
+{
+  GduSmartRecorder *recorder;
+
+  recorder = g_new0 (GduSmartRecorder, 1);
+  recorder->client = g_object_ref (client);
+  recorder->settings = g_settings_new ("org.mate.Disks");
+  recorder->cancellable = g_cancellable_new ();
+  recorder->last_timestamps = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+
+  g_signal_connect (recorder->settings,
+                    "changed::smart-history-interval",
+                    G_CALLBACK (on_interval_changed),
+                    recorder);
+  schedule_sampling (recorder);
+
+  return recorder;
+}
+
+void
+gdu_smart_recorder_free (GduSmartRecorder *recorder)
+{
+  g_cancellable_cancel (recorder->cancellable);
+  if (recorder->timeout_id != 0)
+    g_source_remove (recorder->timeout_id);
+  g_signal_handlers_disconnect_by_data (recorder->settings, recorder);
+  g_object_unref (recorder->settings);
+  g_object_unref (recorder->cancellable);
+  g_object_unref (recorder->client);
+  g_hash_table_unref (recorder->last_timestamps);
+  g_free (recorder);
+}
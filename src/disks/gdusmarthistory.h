@@ -0,0 +1,58 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*-
+ *
+ * Copyright (C) 2008-2013 Red Hat, Inc.
+ *
+ * Licensed under GPL version 2 or later.
+ *
+ * Author: David Zeuthen <zeuthen@gmail.com>
+ */
+
+#ifndef __GDU_SMART_HISTORY_H__
+#define __GDU_SMART_HISTORY_H__
+
+#include <gtk/gtk.h>
+#include "gdutypes.h"
+
+G_BEGIN_DECLS
+
+typedef struct
+{
+  gint64  timestamp;                /* seconds since Epoch when udisks collected the data */
+  guint64 power_on_seconds;         /* 0 if unknown */
+  gdouble temperature;              /* in Kelvin, 0 if unknown */
+
+  /* ATA only, -1 if unknown */
+  gint64  reallocated_sectors;
+  gint64  pending_sectors;
+
+  /* NVMe only, -1 if unknown */
+  gint64  percentage_used;
+  gint64  media_errors;
+  gint64  bytes_written;
+  gint64  thermal_throttle_minutes; /* above the warning or critical temperature */
+} GduSmartSample;
+
+GduSmartRecorder *gdu_smart_recorder_new                   (UDisksClient          *client);
+void              gdu_smart_recorder_free                  (GduSmartRecorder      *recorder);
+
+gchar            *gdu_smart_history_get_filename_for_drive (UDisksDrive           *drive);
+gboolean          gdu_smart_history_append                 (const gchar           *filename,
+                                                            const GduSmartSample  *sample,
+                                                            GError               **error);
+GArray           *gdu_smart_history_load                   (const gchar           *filename,
+                                                            GError               **error);
+gboolean          gdu_smart_history_reload                 (const gchar           *filename,
+                                                            goffset               *size,
+                                                            GArray               **history);
+
+gchar            *gdu_smart_format_temperature             (gdouble                temperature);
+
+void              gdu_smart_history_draw                   (GtkWidget             *widget,
+                                                            cairo_t               *cr,
+                                                            GArray                *history,
+                                                            const GduSmartTrend   *trends,
+                                                            guint                  num_trends);
+
+G_END_DECLS
+
+#endif /* __GDU_SMART_HISTORY_H__ */
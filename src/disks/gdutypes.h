@@ -49,6 +49,15 @@ typedef struct GduLocalJob GduLocalJob;
 struct GduXzDecompressor;
 typedef struct GduXzDecompressor GduXzDecompressor;
 
+struct GduBenchmark;
+typedef struct GduBenchmark GduBenchmark;
+
+struct GduFilesystemBenchmark;
+typedef struct GduFilesystemBenchmark GduFilesystemBenchmark;
+
+struct GduSmartRecorder;
+typedef struct GduSmartRecorder GduSmartRecorder;
+
 G_END_DECLS
 
 #endif /* __GDU_TYPES_H__ */
@@ -64,6 +64,12 @@ struct GridElement
   gboolean show_padlock_closed;
   gboolean show_mounted;
   gboolean show_configured;
+
+  /* cached layout for ->text, see grid_element_get_layout() */
+  PangoLayout *layout;
+
+  /* copy of the element from before recompute_grid() reused it */
+  GridElement *old;
 };
 
 static GridElement *
@@ -81,6 +87,8 @@ grid_element_free (GridElement *element)
   if (element->object != NULL)
     g_object_unref (element->object);
   g_free (element->text);
+  if (element->layout != NULL)
+    g_object_unref (element->layout);
   g_list_foreach (element->embedded_elements, (GFunc) grid_element_free, NULL);
   g_list_free (element->embedded_elements);
 
@@ -106,6 +114,32 @@ struct _GduVolumeGrid
   gboolean animating_spinner;
 
   gchar *no_media_string;
+
+  /* elements from the previous recompute_grid() not (yet) reused,
+   * see grid_element_obtain()
+   */
+  GHashTable *element_pool;
+  gboolean elements_changed;
+
+  PangoFontDescription *font_desc;
+
+  /* Offscreen copy of everything except the spinners - only
+   * repainted when the grid, the widget state or the selection
+   * changes, see gdu_volume_grid_draw()
+   */
+  cairo_surface_t *surface;
+  gboolean surface_valid;
+  gint surface_width;
+  gint surface_height;
+  gint surface_scale;
+  GtkStateFlags surface_state;
+  gboolean surface_has_focus;
+  GridElement *surface_selected;
+  GridElement *surface_focused;
+  /* how far frames may extend into the neighbouring element */
+  gint surface_overhang;
+  /* reused elements whose text or icons changed */
+  GList *dirty_elements;
 };
 
 struct _GduVolumeGridClass
@@ -154,6 +188,8 @@ static gboolean gdu_volume_grid_draw (GtkWidget *widget,
 static void on_client_changed (UDisksClient   *client,
                                gpointer        user_data);
 
+static void invalidate_surface (GduVolumeGrid *grid);
+
 static void
 gdu_volume_grid_finalize (GObject *object)
 {
@@ -172,6 +208,11 @@ gdu_volume_grid_finalize (GObject *object)
 
   g_free (grid->no_media_string);
 
+  pango_font_description_free (grid->font_desc);
+  if (grid->surface != NULL)
+    cairo_surface_destroy (grid->surface);
+  g_list_free (grid->dirty_elements);
+
   G_OBJECT_CLASS (gdu_volume_grid_parent_class)->finalize (object);
 }
 
@@ -517,6 +558,35 @@ gdu_volume_grid_get_preferred_height (GtkWidget *widget,
   *minimal_height = *natural_height = 120;
 }
 
+static void
+clear_layouts (GList *elements)
+{
+  GList *l;
+
+  for (l = elements; l != NULL; l = l->next)
+    {
+      GridElement *element = l->data;
+      if (element->layout != NULL)
+        {
+          g_object_unref (element->layout);
+          element->layout = NULL;
+        }
+      clear_layouts (element->embedded_elements);
+    }
+}
+
+static void
+gdu_volume_grid_style_updated (GtkWidget *widget)
+{
+  GduVolumeGrid *grid = GDU_VOLUME_GRID (widget);
+
+  GTK_WIDGET_CLASS (gdu_volume_grid_parent_class)->style_updated (widget);
+
+  /* fonts, colors and borders may all have changed */
+  clear_layouts (grid->elements);
+  invalidate_surface (grid);
+}
+
 static void
 gdu_volume_grid_class_init (GduVolumeGridClass *klass)
 {
@@ -536,6 +606,7 @@ gdu_volume_grid_class_init (GduVolumeGridClass *klass)
   gtkwidget_class->get_preferred_width  = gdu_volume_grid_get_preferred_width;
   gtkwidget_class->get_preferred_height = gdu_volume_grid_get_preferred_height;
   gtkwidget_class->draw                 = gdu_volume_grid_draw;
+  gtkwidget_class->style_updated        = gdu_volume_grid_style_updated;
 
   g_object_class_install_property (gobject_class,
                                    PROP_APPLICATION,
@@ -585,6 +656,7 @@ gdu_volume_grid_init (GduVolumeGrid *grid)
 {
   gtk_widget_set_can_focus (GTK_WIDGET (grid), TRUE);
   gtk_widget_set_app_paintable (GTK_WIDGET (grid), TRUE);
+  grid->font_desc = pango_font_description_from_string ("Sans 7.0");
 }
 
 GtkWidget *
@@ -715,6 +787,7 @@ recompute_size_for_slice (GList          *elements,
 
       element->x = x + offset_x;
       element->y = offset_y;
+      element->edge_flags = GRID_EDGE_NONE;
       element->width = element_width;
       if (element_depth > 0)
         {
@@ -762,8 +835,54 @@ recompute_size (GduVolumeGrid *grid,
                             0);
 }
 
-/* returns true if an animation timeout is needed */
-static gboolean
+static void
+invalidate_surface (GduVolumeGrid *grid)
+{
+  grid->surface_valid = FALSE;
+  grid->surface_selected = NULL;
+  grid->surface_focused = NULL;
+  g_list_free (grid->dirty_elements);
+  grid->dirty_elements = NULL;
+  gtk_widget_queue_draw (GTK_WIDGET (grid));
+}
+
+/* Returns the layout for the element's text, creating it if needed.
+ * Elements normally keep their text and width between draws so the
+ * (expensive) shaping done by Pango is only redone when either changes.
+ */
+static PangoLayout *
+grid_element_get_layout (GduVolumeGrid *grid,
+                         GridElement   *element,
+                         gdouble        width)
+{
+  const gchar *text;
+  gint pango_width;
+
+  text = element->text;
+  if (text == NULL)
+    text = grid->no_media_string;
+  if (text == NULL)
+    text = "";
+
+  if (element->layout == NULL)
+    {
+      element->layout = gtk_widget_create_pango_layout (GTK_WIDGET (grid), NULL);
+      pango_layout_set_font_description (element->layout, grid->font_desc);
+      pango_layout_set_alignment (element->layout, PANGO_ALIGN_CENTER);
+      pango_layout_set_ellipsize (element->layout, PANGO_ELLIPSIZE_END);
+    }
+
+  if (g_strcmp0 (pango_layout_get_text (element->layout), text) != 0)
+    pango_layout_set_text (element->layout, text, -1);
+
+  pango_width = pango_units_from_double (width);
+  if (pango_layout_get_width (element->layout) != pango_width)
+    pango_layout_set_width (element->layout, pango_width);
+
+  return element->layout;
+}
+
+static void
 render_element (GduVolumeGrid *grid,
                 cairo_t       *cr,
                 GridElement   *element,
@@ -771,9 +890,7 @@ render_element (GduVolumeGrid *grid,
                 gboolean       is_focused,
                 gboolean       is_grid_focused)
 {
-  gboolean animate_spinner;
   PangoLayout *layout;
-  PangoFontDescription *desc;
   gint text_width, text_height;
   GPtrArray *icons_to_render;
   guint n;
@@ -782,9 +899,6 @@ render_element (GduVolumeGrid *grid,
   GtkStateFlags state;
   GtkJunctionSides sides;
   GtkBorder border;
-  const gchar *text;
-
-  animate_spinner = FALSE;
 
   cairo_save (cr);
 
@@ -810,6 +924,7 @@ render_element (GduVolumeGrid *grid,
   gtk_style_context_save (context);
   gtk_style_context_add_class (context, "mate-disk-utility-grid");
   gtk_style_context_get_border (context, state, &border);
+  grid->surface_overhang = MAX (grid->surface_overhang, MAX (border.right, border.bottom));
   sides = GTK_JUNCTION_NONE;
   if (!(element->edge_flags & GRID_EDGE_TOP))
     {
@@ -908,97 +1023,205 @@ render_element (GduVolumeGrid *grid,
     }
   g_ptr_array_free (icons_to_render, TRUE);
 
-  /* spinner */
-  if (element->show_spinner)
-    {
-      gtk_style_context_save (context);
-      gtk_style_context_add_class (context, GTK_STYLE_CLASS_SPINNER);
-      gtk_render_activity (context, cr,
-                           ceil (element->x) + 4,
-                           ceil (element->y + element->height - 16 - 4),
-                           16, 16);
-      gtk_style_context_restore (context);
-      animate_spinner = TRUE;
-    }
-
   /* text */
-  layout = pango_cairo_create_layout (cr);
-  text = element->text;
-  if (text == NULL)
-    text = grid->no_media_string;
-  pango_layout_set_text (layout, text, -1);
-  desc = pango_font_description_from_string ("Sans 7.0");
-  pango_layout_set_font_description (layout, desc);
-  pango_font_description_free (desc);
-  pango_layout_set_alignment (layout, PANGO_ALIGN_CENTER);
-  pango_layout_set_width (layout, pango_units_from_double (w));
-  pango_layout_set_ellipsize (layout, PANGO_ELLIPSIZE_END);
+  layout = grid_element_get_layout (grid, element, w);
   pango_layout_get_size (layout, &text_width, &text_height);
   gtk_render_layout (context, cr, x, y + floor (h / 2.0 - text_height/2/PANGO_SCALE), layout);
-  g_object_unref (layout);
 
   gtk_style_context_restore (context);
   cairo_restore (cr);
+}
 
-  return animate_spinner;
+/* Renders @elements (recursively), skipping elements entirely outside @area if not %NULL */
+static void
+render_slice (GduVolumeGrid      *grid,
+              cairo_t            *cr,
+              GList              *elements,
+              const GdkRectangle *area)
+{
+  GList *l;
+  gboolean is_grid_focused;
+
+  is_grid_focused = gtk_widget_has_focus (GTK_WIDGET (grid));
+  for (l = elements; l != NULL; l = l->next)
+    {
+      GridElement *element = l->data;
+      GdkRectangle rect;
+
+      rect.x = element->x;
+      rect.y = element->y;
+      rect.width = element->width + grid->surface_overhang;
+      rect.height = element->height + grid->surface_overhang;
+      if (area == NULL || gdk_rectangle_intersect (area, &rect, NULL))
+        {
+          render_element (grid,
+                          cr,
+                          element,
+                          element == grid->selected,
+                          element == grid->focused && is_grid_focused,
+                          is_grid_focused);
+        }
+
+      render_slice (grid, cr, element->embedded_elements, area);
+    }
 }
 
+/* returns true if an animation timeout is needed */
 static gboolean
-render_slice (GduVolumeGrid *grid,
-              cairo_t       *cr,
-              GList         *elements)
+render_spinners (GduVolumeGrid *grid,
+                 cairo_t       *cr,
+                 GList         *elements)
 {
+  GtkStyleContext *context;
   GList *l;
   gboolean animate_spinner;
 
   animate_spinner = FALSE;
+  context = gtk_widget_get_style_context (GTK_WIDGET (grid));
   for (l = elements; l != NULL; l = l->next)
     {
       GridElement *element = l->data;
-      gboolean is_selected;
-      gboolean is_focused;
-      gboolean is_grid_focused;
-
-      is_selected = FALSE;
-      is_focused = FALSE;
-      is_grid_focused = gtk_widget_has_focus (GTK_WIDGET (grid));
-
-      if (element == grid->selected)
-        is_selected = TRUE;
 
-      if (element == grid->focused)
+      if (element->show_spinner)
         {
-          if (is_grid_focused)
-            is_focused = TRUE;
+          GtkStateFlags state;
+
+          state = gtk_widget_get_state_flags (GTK_WIDGET (grid));
+          state &= ~(GTK_STATE_FLAG_SELECTED | GTK_STATE_FLAG_FOCUSED);
+          if (element == grid->selected)
+            state |= GTK_STATE_FLAG_SELECTED;
+          if (gtk_widget_has_focus (GTK_WIDGET (grid)))
+            state |= GTK_STATE_FLAG_FOCUSED;
+          gtk_style_context_save (context);
+          gtk_style_context_set_state (context, state | GTK_STATE_FLAG_ACTIVE);
+          gtk_style_context_add_class (context, GTK_STYLE_CLASS_SPINNER);
+          gtk_render_activity (context, cr,
+                               ceil (element->x) + 4,
+                               ceil (element->y + element->height - 16 - 4),
+                               16, 16);
+          gtk_style_context_restore (context);
+          animate_spinner = TRUE;
         }
 
-      animate_spinner |= render_element (grid,
-                                         cr,
-                                         element,
-                                         is_selected,
-                                         is_focused,
-                                         is_grid_focused);
-
-      animate_spinner |= render_slice (grid,
-                                       cr,
-                                       element->embedded_elements);
+      animate_spinner |= render_spinners (grid, cr, element->embedded_elements);
     }
 
   return animate_spinner;
 }
 
+/* Repaints the part of grid->surface covered by @element, or all of it if %NULL */
+static void
+repaint_surface (GduVolumeGrid *grid,
+                 GridElement   *element)
+{
+  cairo_t *cr;
+  GdkRectangle area;
+
+  cr = cairo_create (grid->surface);
+  if (element != NULL)
+    {
+      /* neighbouring frames overlap by up to surface_overhang pixels */
+      area.x = (gint) element->x - grid->surface_overhang;
+      area.y = (gint) element->y - grid->surface_overhang;
+      area.width = element->width + 2 * grid->surface_overhang;
+      area.height = element->height + 2 * grid->surface_overhang;
+      gdk_cairo_rectangle (cr, &area);
+      cairo_clip (cr);
+    }
+  else
+    {
+      grid->surface_overhang = 0;
+    }
+
+  cairo_save (cr);
+  cairo_set_operator (cr, CAIRO_OPERATOR_CLEAR);
+  cairo_paint (cr);
+  cairo_restore (cr);
+
+  render_slice (grid, cr, grid->elements, element != NULL ? &area : NULL);
+  cairo_destroy (cr);
+}
+
+static void
+repaint_element (GduVolumeGrid *grid,
+                 GridElement   *element)
+{
+  if (element != NULL)
+    repaint_surface (grid, element);
+}
+
 static gboolean
 gdu_volume_grid_draw (GtkWidget *widget,
                       cairo_t   *cr)
 {
   GduVolumeGrid *grid = GDU_VOLUME_GRID (widget);
   GtkAllocation allocation;
+  GtkStateFlags state;
+  gboolean has_focus;
+  gint scale;
   gboolean animate_spinner;
 
   gtk_widget_get_allocation (widget, &allocation);
-  recompute_size (grid, allocation.width, allocation.height);
+  scale = gtk_widget_get_scale_factor (widget);
+  state = gtk_widget_get_state_flags (widget);
+  state &= ~(GTK_STATE_FLAG_SELECTED | GTK_STATE_FLAG_FOCUSED | GTK_STATE_FLAG_ACTIVE);
+  has_focus = gtk_widget_has_focus (widget);
+
+  if (grid->surface == NULL ||
+      grid->surface_width != allocation.width ||
+      grid->surface_height != allocation.height ||
+      grid->surface_scale != scale)
+    {
+      if (grid->surface != NULL)
+        cairo_surface_destroy (grid->surface);
+      grid->surface = gdk_window_create_similar_surface (gtk_widget_get_window (widget),
+                                                         CAIRO_CONTENT_COLOR_ALPHA,
+                                                         MAX (allocation.width, 1),
+                                                         MAX (allocation.height, 1));
+      grid->surface_width = allocation.width;
+      grid->surface_height = allocation.height;
+      grid->surface_scale = scale;
+      grid->surface_valid = FALSE;
+    }
+
+  if (!grid->surface_valid ||
+      grid->surface_state != state ||
+      grid->surface_has_focus != has_focus)
+    {
+      recompute_size (grid, allocation.width, allocation.height);
+      repaint_surface (grid, NULL);
+    }
+  else
+    {
+      GList *l;
 
-  animate_spinner = render_slice (grid, cr, grid->elements);
+      for (l = grid->dirty_elements; l != NULL; l = l->next)
+        repaint_element (grid, l->data);
+
+      /* only the elements whose selection or focus changed need repainting */
+      if (grid->surface_selected != grid->selected)
+        {
+          repaint_element (grid, grid->surface_selected);
+          repaint_element (grid, grid->selected);
+        }
+      if (grid->surface_focused != grid->focused)
+        {
+          repaint_element (grid, grid->surface_focused);
+          repaint_element (grid, grid->focused);
+        }
+    }
+  g_list_free (grid->dirty_elements);
+  grid->dirty_elements = NULL;
+  grid->surface_valid = TRUE;
+  grid->surface_state = state;
+  grid->surface_has_focus = has_focus;
+  grid->surface_selected = grid->selected;
+  grid->surface_focused = grid->focused;
+
+  cairo_set_source_surface (cr, grid->surface, 0, 0);
+  cairo_paint (cr);
+
+  animate_spinner = render_spinners (grid, cr, grid->elements);
 
   if (animate_spinner != grid->animating_spinner)
     {
@@ -1111,40 +1334,138 @@ partition_sort_by_offset_func (UDisksObject *a,
 static void grid_element_set_details (GduVolumeGrid  *grid,
                                       GridElement    *element);
 
-static UDisksObject *
-lookup_cleartext_device_for_crypto_device (GduVolumeGrid *grid,
-                                           const gchar   *object_path)
+/* ---------------------------------------------------------------------------------------------------- */
+
+/* Elements are identified across recompute_grid() calls by type, object and offset */
+static guint
+grid_element_hash (gconstpointer key)
+{
+  const GridElement *element = key;
+  return g_direct_hash (element->object) ^ g_int64_hash (&element->offset) ^ element->type;
+}
+
+static gboolean
+grid_element_equal (gconstpointer a,
+                    gconstpointer b)
+{
+  const GridElement *ea = a;
+  const GridElement *eb = b;
+  return ea->type == eb->type && ea->object == eb->object && ea->offset == eb->offset;
+}
+
+static void
+add_elements_to_pool (GduVolumeGrid *grid,
+                      GList         *elements)
 {
-  GDBusObjectManager *object_manager;
-  UDisksObject *ret;
-  GList *objects;
   GList *l;
 
-  ret = NULL;
+  for (l = elements; l != NULL; l = l->next)
+    {
+      GridElement *element = l->data;
 
-  object_manager = udisks_client_get_object_manager (grid->client);
-  objects = g_dbus_object_manager_get_objects (object_manager);
-  for (l = objects; l != NULL; l = l->next)
+      add_elements_to_pool (grid, element->embedded_elements);
+      g_list_free (element->embedded_elements);
+      element->embedded_elements = NULL;
+
+      if (g_hash_table_contains (grid->element_pool, element))
+        grid_element_free (element);
+      else
+        g_hash_table_add (grid->element_pool, element);
+    }
+}
+
+/* Returns the element from the previous grid with the same @type, @object and
+ * @offset - reset as if just created but with its cached layout - or a new one.
+ */
+static GridElement *
+grid_element_obtain (GduVolumeGrid            *grid,
+                     GduVolumeGridElementType  type,
+                     UDisksObject             *object,
+                     gint64                    offset)
+{
+  GridElement key;
+  GridElement *element;
+
+  key.type = type;
+  key.object = object;
+  key.offset = offset;
+  element = g_hash_table_lookup (grid->element_pool, &key);
+  if (element != NULL)
     {
-      UDisksObject *object = UDISKS_OBJECT (l->data);
-      UDisksBlock *block;
+      g_hash_table_remove (grid->element_pool, element);
+
+      /* keep the old state around to compare with in finish_elements() */
+      element->old = g_new (GridElement, 1);
+      *element->old = *element;
+
+      element->fixed_width = 0;
+      element->size_ratio = 1.0;
+      element->size = 0;
+      element->unused = 0;
+      element->parent = NULL;
+      element->prev = NULL;
+      element->next = NULL;
+      element->text = NULL;
+      element->show_spinner = FALSE;
+      element->show_padlock_open = FALSE;
+      element->show_padlock_closed = FALSE;
+      element->show_mounted = FALSE;
+      element->show_configured = FALSE;
+    }
+  else
+    {
+      element = grid_element_new (type);
+      element->object = object != NULL ? g_object_ref (object) : NULL;
+      element->offset = offset;
+      grid->elements_changed = TRUE;
+    }
+
+  return element;
+}
+
+/* Compares reused elements with their old state. A change in geometry
+ * means the whole grid must be laid out again while other changes only
+ * need the element itself to be repainted.
+ */
+static void
+finish_elements (GduVolumeGrid *grid,
+                 GList         *elements)
+{
+  GList *l;
 
-      block = udisks_object_peek_block (object);
-      if (block == NULL)
-        continue;
+  for (l = elements; l != NULL; l = l->next)
+    {
+      GridElement *element = l->data;
+      GridElement *old = element->old;
 
-      if (g_strcmp0 (udisks_block_get_crypto_backing_device (block),
-                     object_path) == 0)
+      if (old != NULL)
         {
-          ret = g_object_ref (object);
-          goto out;
+          if (old->size != element->size ||
+              old->size_ratio != element->size_ratio ||
+              old->fixed_width != element->fixed_width ||
+              old->parent != element->parent ||
+              old->prev != element->prev ||
+              old->next != element->next)
+            {
+              grid->elements_changed = TRUE;
+            }
+          else if (old->unused != element->unused ||
+                   g_strcmp0 (old->text, element->text) != 0 ||
+                   old->show_spinner != element->show_spinner ||
+                   old->show_padlock_open != element->show_padlock_open ||
+                   old->show_padlock_closed != element->show_padlock_closed ||
+                   old->show_mounted != element->show_mounted ||
+                   old->show_configured != element->show_configured)
+            {
+              grid->dirty_elements = g_list_prepend (grid->dirty_elements, element);
+            }
+          g_free (old->text);
+          g_free (old);
+          element->old = NULL;
         }
-    }
 
- out:
-  g_list_foreach (objects, (GFunc) g_object_unref, NULL);
-  g_list_free (objects);
-  return ret;
+      finish_elements (grid, element->embedded_elements);
+    }
 }
 
 static GridElement *
@@ -1168,8 +1489,7 @@ maybe_add_crypto (GduVolumeGrid    *grid,
       UDisksObject *cleartext_object;
       GridElement *embedded_cleartext_element;
 
-      cleartext_object = lookup_cleartext_device_for_crypto_device (grid,
-                                                                    g_dbus_object_get_object_path (G_DBUS_OBJECT (element->object)));
+      cleartext_object = gdu_utils_get_cleartext_object (grid->client, element->object);
       if (cleartext_object == NULL)
         {
           element->show_padlock_closed = TRUE;
@@ -1177,9 +1497,8 @@ maybe_add_crypto (GduVolumeGrid    *grid,
       else
         {
           element->show_padlock_open = TRUE;
-          cleartext_element = grid_element_new (GDU_VOLUME_GRID_ELEMENT_TYPE_DEVICE);
+          cleartext_element = grid_element_obtain (grid, GDU_VOLUME_GRID_ELEMENT_TYPE_DEVICE, cleartext_object, 0);
           cleartext_element->parent = element;
-          cleartext_element->object = g_object_ref (cleartext_object);
           cleartext_element->size = udisks_block_get_size (udisks_object_peek_block (cleartext_object));
           grid_element_set_details (grid, cleartext_element);
 
@@ -1237,11 +1556,10 @@ recompute_grid_add_partitions (GduVolumeGrid  *grid,
 
       if (begin - prev_end > free_space_slack)
         {
-          element = grid_element_new (GDU_VOLUME_GRID_ELEMENT_TYPE_FREE_SPACE);
+          element = grid_element_obtain (grid, GDU_VOLUME_GRID_ELEMENT_TYPE_FREE_SPACE, NULL, prev_end);
           element->parent = parent;
           element->size_ratio = ((gdouble) (begin - prev_end)) / top_size;
           element->prev = prev_element;
-          element->offset = prev_end;
           element->size = begin - prev_end;
           if (prev_element != NULL)
             prev_element->next = element;
@@ -1250,11 +1568,9 @@ recompute_grid_add_partitions (GduVolumeGrid  *grid,
           grid_element_set_details (grid, element);
         }
 
-      element = grid_element_new (GDU_VOLUME_GRID_ELEMENT_TYPE_DEVICE);
+      element = grid_element_obtain (grid, GDU_VOLUME_GRID_ELEMENT_TYPE_DEVICE, object, begin);
       element->parent = parent;
       element->size_ratio = ((gdouble) size) / top_size;
-      element->object = g_object_ref (object);
-      element->offset = begin;
       element->size = size;
       element->prev = prev_element;
       if (prev_element != NULL)
@@ -1286,11 +1602,10 @@ recompute_grid_add_partitions (GduVolumeGrid  *grid,
     }
   if (top_size + top_offset - prev_end > free_space_slack)
     {
-      element = grid_element_new (GDU_VOLUME_GRID_ELEMENT_TYPE_FREE_SPACE);
+      element = grid_element_obtain (grid, GDU_VOLUME_GRID_ELEMENT_TYPE_FREE_SPACE, NULL, prev_end);
       element->parent = parent;
       element->size_ratio = ((gdouble) (top_size - prev_end)) / top_size;
       element->prev = prev_element;
-      element->offset = prev_end;
       element->size = top_size + top_offset - prev_end;
       if (prev_element != NULL)
         prev_element->next = element;
@@ -1337,8 +1652,10 @@ recompute_grid (GduVolumeGrid *grid)
       cur_focused_object = grid->focused->object;
     }
 
-  /* delete all old elements */
-  g_list_foreach (grid->elements, (GFunc) grid_element_free, NULL);
+  /* move all old elements to the pool so unchanged ones can be reused */
+  grid->element_pool = g_hash_table_new (grid_element_hash, grid_element_equal);
+  grid->elements_changed = FALSE;
+  add_elements_to_pool (grid, grid->elements);
   g_list_free (grid->elements);
   grid->elements = NULL;
 
@@ -1348,7 +1665,7 @@ recompute_grid (GduVolumeGrid *grid)
 
   if (grid->block_object == NULL)
     {
-      element = grid_element_new (GDU_VOLUME_GRID_ELEMENT_TYPE_NO_MEDIA);
+      element = grid_element_obtain (grid, GDU_VOLUME_GRID_ELEMENT_TYPE_NO_MEDIA, NULL, 0);
       if (grid->elements != NULL)
         {
           ((GridElement *) grid->elements->data)->next = element;
@@ -1411,14 +1728,13 @@ recompute_grid (GduVolumeGrid *grid)
           if (drive != NULL && !udisks_drive_get_media_change_detected (drive))
             {
               /* If we can't detect media change, just always assume media */
-              element = grid_element_new (GDU_VOLUME_GRID_ELEMENT_TYPE_DEVICE);
-              element->object = g_object_ref (grid->block_object);
+              element = grid_element_obtain (grid, GDU_VOLUME_GRID_ELEMENT_TYPE_DEVICE, grid->block_object, 0);
               grid->elements = g_list_append (grid->elements, element);
               grid_element_set_details (grid, element);
             }
           else
             {
-              element = grid_element_new (GDU_VOLUME_GRID_ELEMENT_TYPE_NO_MEDIA);
+              element = grid_element_obtain (grid, GDU_VOLUME_GRID_ELEMENT_TYPE_NO_MEDIA, NULL, 0);
               element->size = top_size;
               if (grid->elements != NULL)
                 {
@@ -1433,9 +1749,8 @@ recompute_grid (GduVolumeGrid *grid)
       else
         {
           GridElement *cleartext_element;
-          element = grid_element_new (GDU_VOLUME_GRID_ELEMENT_TYPE_DEVICE);
+          element = grid_element_obtain (grid, GDU_VOLUME_GRID_ELEMENT_TYPE_DEVICE, grid->block_object, 0);
           element->size = top_size;
-          element->object = g_object_ref (grid->block_object);
           if (grid->elements != NULL)
             {
               ((GridElement *) grid->elements->data)->next = element;
@@ -1482,7 +1797,7 @@ recompute_grid (GduVolumeGrid *grid)
   /* ensure we have at least one element */
   if (grid->elements == NULL)
     {
-      element = grid_element_new (GDU_VOLUME_GRID_ELEMENT_TYPE_NO_MEDIA);
+      element = grid_element_obtain (grid, GDU_VOLUME_GRID_ELEMENT_TYPE_NO_MEDIA, NULL, 0);
       grid->elements = g_list_append (NULL, element);
       grid_element_set_details (grid, element);
     }
@@ -1495,8 +1810,25 @@ recompute_grid (GduVolumeGrid *grid)
 
   gdu_volume_grid_set_accessible_name_for_grid_element (grid, grid->selected);
 
-  /* queue a redraw */
-  gtk_widget_queue_draw (GTK_WIDGET (grid));
+  /* free elements that are gone and find out what to repaint */
+  finish_elements (grid, grid->elements);
+  if (g_hash_table_size (grid->element_pool) > 0)
+    {
+      GHashTableIter iter;
+      GridElement *old_element;
+
+      g_hash_table_iter_init (&iter, grid->element_pool);
+      while (g_hash_table_iter_next (&iter, (gpointer) &old_element, NULL))
+        grid_element_free (old_element);
+      grid->elements_changed = TRUE;
+    }
+  g_hash_table_unref (grid->element_pool);
+  grid->element_pool = NULL;
+
+  if (grid->elements_changed)
+    invalidate_surface (grid);
+  else if (grid->dirty_elements != NULL)
+    gtk_widget_queue_draw (GTK_WIDGET (grid));
 
   g_signal_emit (grid, signals[CHANGED_SIGNAL], 0);
 }
@@ -2002,7 +2334,7 @@ gdu_volume_grid_set_no_media_string   (GduVolumeGrid       *grid,
 
   g_object_notify (G_OBJECT (grid), "no-media-string");
 
-  gtk_widget_queue_draw (GTK_WIDGET (grid));
+  invalidate_surface (grid);
 
  out:
   ;
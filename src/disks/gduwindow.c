@@ -24,7 +24,9 @@
 #include "gdudevicetreemodel.h"
 #include "gduvolumegrid.h"
 #include "gduatasmartdialog.h"
+#include "gdunvmehealthdialog.h"
 #include "gdubenchmarkdialog.h"
+#include "gdufilesystembenchmarkdialog.h"
 #include "gducrypttabdialog.h"
 #include "gdufstabdialog.h"
 #include "gdufilesystemdialog.h"
@@ -41,6 +43,13 @@
 
 #define JOB_SENSITIVITY_DELAY_MS 300
 
+typedef enum
+{
+  UPDATE_FLAGS_NONE = 0,
+  UPDATE_FLAGS_JOBS = (1<<0), /* only the progress of the jobs being shown */
+  UPDATE_FLAGS_ALL  = (1<<1)
+} UpdateFlags;
+
 struct _GduWindow
 {
   HdyApplicationWindow parent_instance;
@@ -57,6 +66,22 @@ struct _GduWindow
   gboolean has_volume_job;
   guint delay_job_update_id;
 
+  /* updates of the details page are coalesced to one per frame, see queue_update() */
+  guint update_tick_id;
+  UpdateFlags pending_update;
+  gboolean pending_delayed_job_update;
+  /* set when udisks objects changed in a way that needs update_all() */
+  gboolean client_dirty;
+
+  /* what the details page was last rendered from - the grid object is only compared */
+  UDisksJob *shown_drive_job;
+  UDisksJob *shown_volume_job;
+  GduVolumeGridElementType shown_grid_type;
+  UDisksObject *shown_grid_object;
+  guint64 shown_grid_offset;
+  guint64 shown_grid_size;
+  GduPowerStateFlags shown_power_state;
+
   GtkWidget *volume_grid;
 
   GtkWidget *toolbutton_volume_menu;
@@ -221,6 +246,7 @@ typedef enum
   SHOW_FLAGS_VOLUME_MENU_RESIZE                = (1<<9),
   SHOW_FLAGS_VOLUME_MENU_REPAIR                = (1<<10),
   SHOW_FLAGS_VOLUME_MENU_CHECK                 = (1<<11),
+  SHOW_FLAGS_VOLUME_MENU_BENCHMARK_FILESYSTEM  = (1<<12),
 } ShowFlagsVolumeMenu;
 
 typedef struct
@@ -322,6 +348,9 @@ static void on_volume_menu_item_restore_volume_image (GSimpleAction *action,
 static void on_volume_menu_item_benchmark (GSimpleAction *action,
                                            GVariant      *parameter,
                                            gpointer       user_data);
+static void on_volume_menu_item_benchmark_filesystem (GSimpleAction *action,
+                                                      GVariant      *parameter,
+                                                      gpointer       user_data);
 
 static void on_devtab_loop_autoclear_switch_notify_active (GObject    *object,
                                                            GParamSpec *pspec,
@@ -368,7 +397,8 @@ static const GActionEntry actions[] = {
 	{ "configure-crypttab", on_volume_menu_item_configure_crypttab },
 	{ "create-partition-image", on_volume_menu_item_create_volume_image },
 	{ "restore-partition-image", on_volume_menu_item_restore_volume_image },
-	{ "benchmark-partition", on_volume_menu_item_benchmark }
+	{ "benchmark-partition", on_volume_menu_item_benchmark },
+	{ "benchmark-filesystem", on_volume_menu_item_benchmark_filesystem }
 };
 
 static void
@@ -378,6 +408,22 @@ gdu_window_init (GduWindow *window)
 
 static void on_client_changed (UDisksClient  *client,
                                gpointer       user_data);
+static void on_local_jobs_changed (GduApplication *application,
+                                   UDisksObject   *object,
+                                   gpointer        user_data);
+static void on_object_added_or_removed (GDBusObjectManager *manager,
+                                        GDBusObject        *object,
+                                        gpointer            user_data);
+static void on_interface_added_or_removed (GDBusObjectManager *manager,
+                                           GDBusObject        *object,
+                                           GDBusInterface     *interface,
+                                           gpointer            user_data);
+static void on_interface_proxy_properties_changed (GDBusObjectManagerClient *manager,
+                                                   GDBusObjectProxy         *object_proxy,
+                                                   GDBusProxy               *interface_proxy,
+                                                   GVariant                 *changed_properties,
+                                                   const gchar *const       *invalidated_properties,
+                                                   gpointer                  user_data);
 
 static
 gboolean
@@ -400,9 +446,15 @@ gdu_window_finalize (GObject *object)
   g_signal_handlers_disconnect_by_func (window->client,
                                         G_CALLBACK (on_client_changed),
                                         window);
+  g_signal_handlers_disconnect_by_data (udisks_client_get_object_manager (window->client), window);
+  g_signal_handlers_disconnect_by_func (window->application,
+                                        G_CALLBACK (on_local_jobs_changed),
+                                        window);
 
   if (window->current_object != NULL)
     g_object_unref (window->current_object);
+  g_clear_object (&window->shown_drive_job);
+  g_clear_object (&window->shown_volume_job);
 
   g_object_unref (window->builder);
   g_object_unref (window->model);
@@ -444,6 +496,81 @@ on_row_inserted (GtkTreeModel *tree_model,
   gtk_tree_view_expand_all (GTK_TREE_VIEW (window->device_tree_treeview));
 }
 
+static void queue_update (GduWindow   *window,
+                          UpdateFlags  flags);
+
+/* The drive menu offers Standby or Resume depending on the power state */
+static void
+on_row_changed (GtkTreeModel *tree_model,
+                GtkTreePath  *path,
+                GtkTreeIter  *iter,
+                gpointer      user_data)
+{
+  GduWindow *window = GDU_WINDOW (user_data);
+  UDisksObject *object = NULL;
+  GduPowerStateFlags flags = GDU_POWER_STATE_FLAGS_NONE;
+
+  if (window->current_object == NULL)
+    return;
+
+  gtk_tree_model_get (tree_model,
+                      iter,
+                      GDU_DEVICE_TREE_MODEL_COLUMN_OBJECT, &object,
+                      GDU_DEVICE_TREE_MODEL_COLUMN_POWER_STATE_FLAGS, &flags,
+                      -1);
+  if (object == window->current_object &&
+      (flags & GDU_POWER_STATE_FLAGS_STANDBY) != (window->shown_power_state & GDU_POWER_STATE_FLAGS_STANDBY))
+    queue_update (window, UPDATE_FLAGS_ALL);
+  g_clear_object (&object);
+}
+
+/* Only check the power state of the drives that are on screen */
+static void
+update_power_state_polling (GduWindow *window)
+{
+  GtkTreePath *start_path = NULL;
+  GtkTreePath *end_path = NULL;
+  GdkWindow *gdk_window;
+  gboolean paused;
+
+  gdk_window = gtk_widget_get_window (GTK_WIDGET (window));
+  paused = (!gtk_widget_get_mapped (GTK_WIDGET (window)) ||
+            (gdk_window != NULL && (gdk_window_get_state (gdk_window) & GDK_WINDOW_STATE_ICONIFIED)));
+  gdu_device_tree_model_set_power_state_paused (window->model, paused);
+
+  if (!gtk_tree_view_get_visible_range (GTK_TREE_VIEW (window->device_tree_treeview), &start_path, &end_path))
+    start_path = end_path = NULL;
+  gdu_device_tree_model_set_visible_range (window->model, start_path, end_path);
+  if (start_path != NULL)
+    gtk_tree_path_free (start_path);
+  if (end_path != NULL)
+    gtk_tree_path_free (end_path);
+}
+
+static void
+on_device_tree_adjustment_changed (GtkAdjustment *adjustment,
+                                   gpointer       user_data)
+{
+  update_power_state_polling (GDU_WINDOW (user_data));
+}
+
+static void
+on_map_or_unmap (GtkWidget *widget,
+                 gpointer   user_data)
+{
+  update_power_state_polling (GDU_WINDOW (widget));
+}
+
+static gboolean
+on_window_state_event (GtkWidget           *widget,
+                       GdkEventWindowState *event,
+                       gpointer             user_data)
+{
+  if (event->changed_mask & GDK_WINDOW_STATE_ICONIFIED)
+    update_power_state_polling (GDU_WINDOW (widget));
+  return FALSE; /* propagate event */
+}
+
 static void
 update_for_show_flags (GduWindow *window,
                        ShowFlags *show_flags)
@@ -528,6 +655,9 @@ update_for_show_flags (GduWindow *window,
   g_simple_action_set_enabled (G_SIMPLE_ACTION (g_action_map_lookup_action (G_ACTION_MAP (window),
                               "benchmark-partition")),
                               show_flags->volume_menu & SHOW_FLAGS_VOLUME_MENU_BENCHMARK);
+  g_simple_action_set_enabled (G_SIMPLE_ACTION (g_action_map_lookup_action (G_ACTION_MAP (window),
+                              "benchmark-filesystem")),
+                              show_flags->volume_menu & SHOW_FLAGS_VOLUME_MENU_BENCHMARK_FILESYSTEM);
 
   /* TODO: don't show the button bringing up the popup menu if it has no items */
 }
@@ -962,6 +1092,17 @@ gdu_window_select_object (GduWindow    *window,
   return ret;
 }
 
+static gboolean
+device_tree_search_equal_func (GtkTreeModel *model,
+                               gint          column,
+                               const gchar  *key,
+                               GtkTreeIter  *iter,
+                               gpointer      user_data)
+{
+  /* FALSE means the row matches */
+  return !gdu_device_tree_model_iter_matches (GDU_DEVICE_TREE_MODEL (model), iter, key);
+}
+
 static void
 power_state_cell_func (GtkTreeViewColumn *column,
                        GtkCellRenderer   *renderer,
@@ -971,7 +1112,6 @@ power_state_cell_func (GtkTreeViewColumn *column,
 {
   gboolean visible = FALSE;
   GduPowerStateFlags flags;
-  GduWindow *window = GDU_WINDOW (user_data);
 
   gtk_tree_model_get (model,
                       iter,
@@ -982,7 +1122,6 @@ power_state_cell_func (GtkTreeViewColumn *column,
     visible = TRUE;
 
   gtk_cell_renderer_set_visible (renderer, visible);
-  update_all (window, FALSE);
 }
 
 static void
@@ -1052,6 +1191,8 @@ gdu_window_constructed (GObject *object)
   guint n;
   GtkBuilder *builder;
   GMenuModel *model;
+  GtkAdjustment *vadjustment;
+  GDBusObjectManager *object_manager;
 
   init_css (window);
 
@@ -1128,7 +1269,8 @@ gdu_window_constructed (GObject *object)
   window->model = gdu_device_tree_model_new (window->application,
                                              GDU_DEVICE_TREE_MODEL_FLAGS_UPDATE_POWER_STATE |
                                              GDU_DEVICE_TREE_MODEL_FLAGS_UPDATE_PULSE |
-                                             GDU_DEVICE_TREE_MODEL_FLAGS_FLAT);
+                                             GDU_DEVICE_TREE_MODEL_FLAGS_FLAT |
+                                             GDU_DEVICE_TREE_MODEL_FLAGS_VISIBLE_RANGE);
 
   gtk_tree_view_set_model (GTK_TREE_VIEW (window->device_tree_treeview), GTK_TREE_MODEL (window->model));
   gtk_tree_sortable_set_sort_column_id (GTK_TREE_SORTABLE (window->model),
@@ -1150,9 +1292,22 @@ gdu_window_constructed (GObject *object)
 
   /* -------------------- */
 
+  /* With fixed-height mode only the rows on screen are measured and
+   * drawn, so only those are computed by the model
+   */
   column = gtk_tree_view_column_new ();
   gtk_tree_view_column_set_expand (column, TRUE);
+  gtk_tree_view_column_set_sizing (column, GTK_TREE_VIEW_COLUMN_FIXED);
   gtk_tree_view_append_column (GTK_TREE_VIEW (window->device_tree_treeview), column);
+  gtk_tree_view_set_fixed_height_mode (GTK_TREE_VIEW (window->device_tree_treeview), TRUE);
+
+  /* type-ahead search by name, serial, WWN, size etc. */
+  gtk_tree_view_set_search_column (GTK_TREE_VIEW (window->device_tree_treeview),
+                                   GDU_DEVICE_TREE_MODEL_COLUMN_SORT_KEY);
+  gtk_tree_view_set_search_equal_func (GTK_TREE_VIEW (window->device_tree_treeview),
+                                       device_tree_search_equal_func,
+                                       NULL,  /* user_data */
+                                       NULL); /* GDestroyNotify */
 
   renderer = gtk_cell_renderer_text_new ();
   gtk_tree_view_column_pack_start (column, renderer, FALSE);
@@ -1214,6 +1369,41 @@ gdu_window_constructed (GObject *object)
                     window);
   gtk_tree_view_expand_all (GTK_TREE_VIEW (window->device_tree_treeview));
 
+  /* pause power state checks for rows scrolled out of view and while hidden */
+  vadjustment = gtk_scrollable_get_vadjustment (GTK_SCROLLABLE (window->device_tree_treeview));
+  g_signal_connect_object (vadjustment,
+                           "value-changed",
+                           G_CALLBACK (on_device_tree_adjustment_changed),
+                           window,
+                           0);
+  g_signal_connect_object (vadjustment,
+                           "changed",
+                           G_CALLBACK (on_device_tree_adjustment_changed),
+                           window,
+                           0);
+  g_signal_connect (window, "map", G_CALLBACK (on_map_or_unmap), NULL);
+  g_signal_connect (window, "unmap", G_CALLBACK (on_map_or_unmap), NULL);
+  g_signal_connect (window, "window-state-event", G_CALLBACK (on_window_state_event), NULL);
+
+  g_signal_connect (window->model,
+                    "row-changed",
+                    G_CALLBACK (on_row_changed),
+                    window);
+
+  /* see on_client_changed() for how these are used */
+  object_manager = udisks_client_get_object_manager (window->client);
+  g_signal_connect (object_manager, "object-added", G_CALLBACK (on_object_added_or_removed), window);
+  g_signal_connect (object_manager, "object-removed", G_CALLBACK (on_object_added_or_removed), window);
+  g_signal_connect (object_manager, "interface-added", G_CALLBACK (on_interface_added_or_removed), window);
+  g_signal_connect (object_manager, "interface-removed", G_CALLBACK (on_interface_added_or_removed), window);
+  g_signal_connect (object_manager,
+                    "interface-proxy-properties-changed",
+                    G_CALLBACK (on_interface_proxy_properties_changed),
+                    window);
+  g_signal_connect (window->application,
+                    "local-jobs-changed",
+                    G_CALLBACK (on_local_jobs_changed),
+                    window);
   g_signal_connect (window->client,
                     "changed",
                     G_CALLBACK (on_client_changed),
@@ -1490,7 +1680,8 @@ set_markup (GduWindow      *window,
 
   /* TODO: utf-8 validate */
 
-  gtk_label_set_markup (GTK_LABEL (label), markup);
+  if (g_strcmp0 (gtk_label_get_label (GTK_LABEL (label)), markup) != 0)
+    gtk_label_set_markup (GTK_LABEL (label), markup);
   gtk_widget_show (key_label);
   gtk_widget_show (label);
 
@@ -1590,12 +1781,21 @@ typedef enum
   DETAILS_PAGE_DEVICE,
 } DetailsPage;
 
+static void update_shown_jobs (GduWindow *window);
+
 static void
 update_all (GduWindow *window, gboolean is_delayed_job_update)
 {
   ShowFlags show_flags = {0};
   DetailsPage page = DETAILS_PAGE_NOT_IMPLEMENTED;
 
+  /* anything queued is covered by this */
+  window->pending_update = UPDATE_FLAGS_NONE;
+  window->pending_delayed_job_update = FALSE;
+  window->shown_power_state = GDU_POWER_STATE_FLAGS_NONE;
+  g_clear_object (&window->shown_drive_job);
+  g_clear_object (&window->shown_volume_job);
+
   /* figure out page to display */
   if (window->current_object != NULL)
     {
@@ -1634,15 +1834,111 @@ update_all (GduWindow *window, gboolean is_delayed_job_update)
       g_assert_not_reached ();
     }
   update_for_show_flags (window, &show_flags);
+
+  window->shown_grid_type = gdu_volume_grid_get_selected_type (GDU_VOLUME_GRID (window->volume_grid));
+  window->shown_grid_object = gdu_volume_grid_get_selected_device (GDU_VOLUME_GRID (window->volume_grid));
+  window->shown_grid_offset = gdu_volume_grid_get_selected_offset (GDU_VOLUME_GRID (window->volume_grid));
+  window->shown_grid_size = gdu_volume_grid_get_selected_size (GDU_VOLUME_GRID (window->volume_grid));
+}
+
+static gboolean
+on_update_tick (GtkWidget     *widget,
+                GdkFrameClock *frame_clock,
+                gpointer       user_data)
+{
+  GduWindow *window = GDU_WINDOW (widget);
+
+  window->update_tick_id = 0;
+  if (window->pending_update & UPDATE_FLAGS_ALL)
+    update_all (window, window->pending_delayed_job_update);
+  else if (window->pending_update & UPDATE_FLAGS_JOBS)
+    update_shown_jobs (window);
+  window->pending_update = UPDATE_FLAGS_NONE;
+
+  return G_SOURCE_REMOVE;
+}
+
+/* Updates the details page once before the next frame is drawn, no
+ * matter how many changes come in until then. Nothing is drawn while
+ * the window is hidden so neither is the page updated.
+ */
+static void
+queue_update (GduWindow   *window,
+              UpdateFlags  flags)
+{
+  window->pending_update |= flags;
+  if (window->update_tick_id == 0)
+    window->update_tick_id = gtk_widget_add_tick_callback (GTK_WIDGET (window), on_update_tick, NULL, NULL);
 }
 
+static void
+on_object_added_or_removed (GDBusObjectManager *manager,
+                            GDBusObject        *object,
+                            gpointer            user_data)
+{
+  GDU_WINDOW (user_data)->client_dirty = TRUE;
+}
+
+static void
+on_interface_added_or_removed (GDBusObjectManager *manager,
+                               GDBusObject        *object,
+                               GDBusInterface     *interface,
+                               gpointer            user_data)
+{
+  GDU_WINDOW (user_data)->client_dirty = TRUE;
+}
+
+static void
+on_interface_proxy_properties_changed (GDBusObjectManagerClient *manager,
+                                       GDBusObjectProxy         *object_proxy,
+                                       GDBusProxy               *interface_proxy,
+                                       GVariant                 *changed_properties,
+                                       const gchar *const       *invalidated_properties,
+                                       gpointer                  user_data)
+{
+  GduWindow *window = GDU_WINDOW (user_data);
+
+  /* running jobs update their progress many times a second */
+  if (UDISKS_IS_JOB (interface_proxy))
+    queue_update (window, UPDATE_FLAGS_JOBS);
+  else
+    window->client_dirty = TRUE;
+}
+
+static void
+on_local_jobs_changed (GduApplication *application,
+                       UDisksObject   *object,
+                       gpointer        user_data)
+{
+  GduWindow *window = GDU_WINDOW (user_data);
+  GList *jobs;
+
+  /* progress of a job being shown, otherwise a job was added or removed */
+  jobs = gdu_application_get_local_jobs_for_object (application, object);
+  if (jobs != NULL &&
+      (UDISKS_JOB (jobs->data) == window->shown_drive_job ||
+       UDISKS_JOB (jobs->data) == window->shown_volume_job))
+    queue_update (window, UPDATE_FLAGS_JOBS);
+  else
+    window->client_dirty = TRUE;
+  g_list_free_full (jobs, g_object_unref);
+}
+
+/* UDisksClient::changed is emitted a little after the changes it covers
+ * and doesn't say what changed - the object manager signals above tell
+ * whether more than the progress of jobs needs to be shown.
+ */
 static void
 on_client_changed (UDisksClient   *client,
                    gpointer        user_data)
 {
   GduWindow *window = GDU_WINDOW (user_data);
   //g_debug ("on_client_changed");
-  update_all (window, FALSE);
+  if (window->client_dirty)
+    {
+      window->client_dirty = FALSE;
+      queue_update (window, UPDATE_FLAGS_ALL);
+    }
 }
 
 static void
@@ -1650,16 +1946,25 @@ on_volume_grid_changed (GduVolumeGrid  *grid,
                         gpointer        user_data)
 {
   GduWindow *window = GDU_WINDOW (user_data);
-  gboolean is_delayed_job_update = FALSE;
   //g_debug ("on_volume_grid_changed");
+
+  /* the grid is recomputed on every change, only its selection matters
+   * here - free space has no object so it is told apart by its offset
+   */
+  if (gdu_volume_grid_get_selected_type (grid) == window->shown_grid_type &&
+      gdu_volume_grid_get_selected_device (grid) == window->shown_grid_object &&
+      gdu_volume_grid_get_selected_offset (grid) == window->shown_grid_offset &&
+      gdu_volume_grid_get_selected_size (grid) == window->shown_grid_size)
+    return;
+
   if (window->delay_job_update_id != 0)
     {
       g_source_remove (window->delay_job_update_id);
       window->delay_job_update_id = 0;
-      is_delayed_job_update = TRUE;
+      window->pending_delayed_job_update = TRUE;
     }
 
-  update_all (window, is_delayed_job_update);
+  queue_update (window, UPDATE_FLAGS_ALL);
 }
 
 /* ---------------------------------------------------------------------------------------------------- */
@@ -1780,6 +2085,98 @@ delayed_job_update (gpointer user_data)
   return G_SOURCE_REMOVE;
 }
 
+/* Avoid relayouts for text that is the same as before */
+static void
+label_set_markup_if_changed (GtkWidget   *label,
+                             const gchar *markup)
+{
+  if (g_strcmp0 (gtk_label_get_label (GTK_LABEL (label)), markup) != 0)
+    gtk_label_set_markup (GTK_LABEL (label), markup);
+}
+
+static void
+label_set_text_if_changed (GtkWidget   *label,
+                           const gchar *text)
+{
+  if (g_strcmp0 (gtk_label_get_label (GTK_LABEL (label)), text) != 0)
+    gtk_label_set_text (GTK_LABEL (label), text);
+}
+
+static void
+update_job_progress (GduWindow *window,
+                     UDisksJob *job,
+                     gboolean   is_volume)
+{
+  GtkWidget *progressbar = window->devtab_drive_job_progressbar;
+  GtkWidget *remaining_label = window->devtab_drive_job_remaining_label;
+  GtkWidget *no_progress_label = window->devtab_drive_job_no_progress_label;
+  GtkWidget *cancel_button = window->devtab_drive_job_cancel_button;
+  gchar *s, *s2;
+
+  if (is_volume)
+    {
+      progressbar = window->devtab_job_progressbar;
+      remaining_label = window->devtab_job_remaining_label;
+      no_progress_label = window->devtab_job_no_progress_label;
+      cancel_button = window->devtab_job_cancel_button;
+    }
+
+  if (udisks_job_get_progress_valid (job))
+    {
+      gdouble progress = udisks_job_get_progress (job);
+      gtk_widget_show (progressbar);
+      gtk_widget_hide (no_progress_label);
+
+      if (gtk_progress_bar_get_fraction (GTK_PROGRESS_BAR (progressbar)) != progress)
+        gtk_progress_bar_set_fraction (GTK_PROGRESS_BAR (progressbar), progress);
+
+      if (GDU_IS_LOCAL_JOB (job))
+        s2 = g_strdup (gdu_local_job_get_description (GDU_LOCAL_JOB (job)));
+      else
+        s2 = udisks_client_get_job_description (window->client, job);
+      /* Translators: Used in job progress bar.
+       *              The %s is the job description (e.g. "Erasing Device").
+       *              The %f is the completion percentage (between 0.0 and 100.0).
+       */
+      s = g_strdup_printf (_("%s: %2.1f%%"),
+                            s2,
+                            100.0 * progress);
+      g_free (s2);
+      gtk_progress_bar_set_show_text (GTK_PROGRESS_BAR (progressbar), TRUE);
+      if (g_strcmp0 (gtk_progress_bar_get_text (GTK_PROGRESS_BAR (progressbar)), s) != 0)
+        gtk_progress_bar_set_text (GTK_PROGRESS_BAR (progressbar), s);
+      g_free (s);
+
+      s = get_job_progress_text (window, job);
+      if (s != NULL)
+        {
+          gtk_widget_show (remaining_label);
+          label_set_markup_if_changed (remaining_label, s);
+          g_free (s);
+        }
+      else
+        {
+          gtk_widget_hide (remaining_label);
+        }
+    }
+  else
+    {
+      gtk_widget_hide (progressbar);
+      gtk_widget_hide (remaining_label);
+      gtk_widget_show (no_progress_label);
+      if (GDU_IS_LOCAL_JOB (job))
+        s = g_strdup (gdu_local_job_get_description (GDU_LOCAL_JOB (job)));
+      else
+        s = udisks_client_get_job_description (window->client, job);
+      label_set_text_if_changed (no_progress_label, s);
+      g_free (s);
+    }
+  if (udisks_job_get_cancelable (job))
+    gtk_widget_show (cancel_button);
+  else
+    gtk_widget_hide (cancel_button);
+}
+
 static void
 update_jobs (GduWindow *window,
              GList     *jobs,
@@ -1788,10 +2185,7 @@ update_jobs (GduWindow *window,
 {
   GtkWidget *label = window->devtab_drive_job_label;
   GtkWidget *grid = window->devtab_drive_job_grid;
-  GtkWidget *progressbar = window->devtab_drive_job_progressbar;
-  GtkWidget *remaining_label = window->devtab_drive_job_remaining_label;
-  GtkWidget *no_progress_label = window->devtab_drive_job_no_progress_label;
-  GtkWidget *cancel_button = window->devtab_drive_job_cancel_button;
+  UDisksJob **shown_job;
   gboolean drive_sensitivity;
   gboolean selected_volume_sensitivity;
   gboolean gets_sensitive;
@@ -1800,10 +2194,6 @@ update_jobs (GduWindow *window,
     {
       label = window->devtab_job_label;
       grid = window->devtab_job_grid;
-      progressbar = window->devtab_job_progressbar;
-      remaining_label = window->devtab_job_remaining_label;
-      no_progress_label = window->devtab_job_no_progress_label;
-      cancel_button = window->devtab_job_cancel_button;
     }
 
   drive_sensitivity = !gdu_application_has_running_job (window->application, window->current_object);
@@ -1836,64 +2226,25 @@ update_jobs (GduWindow *window,
     }
   else
     {
-      UDisksJob *job = UDISKS_JOB (jobs->data);
-      gchar *s, *s2;
-
       gtk_widget_show (label);
       gtk_widget_show (grid);
-      if (udisks_job_get_progress_valid (job))
-        {
-          gdouble progress = udisks_job_get_progress (job);
-          gtk_widget_show (progressbar);
-          gtk_widget_hide (no_progress_label);
-
-          gtk_progress_bar_set_fraction (GTK_PROGRESS_BAR (progressbar), progress);
+      update_job_progress (window, UDISKS_JOB (jobs->data), is_volume);
+    }
 
-          if (GDU_IS_LOCAL_JOB (job))
-            s2 = g_strdup (gdu_local_job_get_description (GDU_LOCAL_JOB (job)));
-          else
-            s2 = udisks_client_get_job_description (window->client, job);
-          /* Translators: Used in job progress bar.
-           *              The %s is the job description (e.g. "Erasing Device").
-           *              The %f is the completion percentage (between 0.0 and 100.0).
-           */
-          s = g_strdup_printf (_("%s: %2.1f%%"),
-                                s2,
-                                100.0 * progress);
-          g_free (s2);
-          gtk_progress_bar_set_show_text (GTK_PROGRESS_BAR (progressbar), TRUE);
-          gtk_progress_bar_set_text (GTK_PROGRESS_BAR (progressbar), s);
-          g_free (s);
+  shown_job = is_volume ? &window->shown_volume_job : &window->shown_drive_job;
+  g_clear_object (shown_job);
+  if (jobs != NULL)
+    *shown_job = g_object_ref (UDISKS_JOB (jobs->data));
+}
 
-          s = get_job_progress_text (window, job);
-          if (s != NULL)
-            {
-              gtk_widget_show (remaining_label);
-              gtk_label_set_markup (GTK_LABEL (remaining_label), s);
-              g_free (s);
-            }
-          else
-            {
-              gtk_widget_hide (remaining_label);
-            }
-        }
-      else
-        {
-          gtk_widget_hide (progressbar);
-          gtk_widget_hide (remaining_label);
-          gtk_widget_show (no_progress_label);
-          if (GDU_IS_LOCAL_JOB (job))
-            s = g_strdup (gdu_local_job_get_description (GDU_LOCAL_JOB (job)));
-          else
-            s = udisks_client_get_job_description (window->client, job);
-          gtk_label_set_text (GTK_LABEL (no_progress_label), s);
-          g_free (s);
-        }
-      if (udisks_job_get_cancelable (job))
-        gtk_widget_show (cancel_button);
-      else
-        gtk_widget_hide (cancel_button);
-    }
+/* Only re-renders the progress of the jobs already shown, see on_update_tick() */
+static void
+update_shown_jobs (GduWindow *window)
+{
+  if (window->shown_drive_job != NULL)
+    update_job_progress (window, window->shown_drive_job, FALSE);
+  if (window->shown_volume_job != NULL)
+    update_job_progress (window, window->shown_volume_job, TRUE);
 }
 
 static void
@@ -2010,6 +2361,9 @@ update_device_page_for_drive (GduWindow      *window,
   UDisksObjectInfo *info = NULL;
   guint64 size;
   UDisksDriveAta *ata;
+#if UDISKS_CHECK_VERSION(2, 10, 0)
+  UDisksNVMeController *controller;
+#endif
   const gchar *our_seat;
   const gchar *serial;
   GList *jobs;
@@ -2032,7 +2386,7 @@ update_device_page_for_drive (GduWindow      *window,
 
   ata = udisks_object_peek_drive_ata (object);
 
-  info = udisks_client_get_object_info (window->client, object);
+  info = gdu_application_get_object_info (window->application, object);
 
   drive_vendor = udisks_drive_get_vendor (drive);
   drive_model = udisks_drive_get_model (drive);
@@ -2146,6 +2500,21 @@ update_device_page_for_drive (GduWindow      *window,
       g_free (s);
     }
 
+#if UDISKS_CHECK_VERSION(2, 10, 0)
+  /* the health log attributes need a D-Bus call so only use the properties here */
+  controller = udisks_object_peek_nvme_controller (object);
+  if (controller != NULL)
+    {
+      s = gdu_nvme_health_get_one_liner_assessment (controller, NULL /* attributes */, NULL /* out_warning */);
+      set_markup (window,
+                  "devtab-drive-smart-label",
+                  "devtab-drive-smart-value-label",
+                  s, SET_MARKUP_FLAGS_NONE);
+      show_flags->drive_menu |= SHOW_FLAGS_DRIVE_MENU_VIEW_SMART;
+      g_free (s);
+    }
+#endif
+
   if (gdu_disk_settings_dialog_should_show (object))
     show_flags->drive_menu |= SHOW_FLAGS_DRIVE_MENU_DISK_SETTINGS;
 
@@ -2164,6 +2533,7 @@ update_device_page_for_drive (GduWindow      *window,
                                   GDU_DEVICE_TREE_MODEL_COLUMN_POWER_STATE_FLAGS, &power_state_flags,
                                   -1);
             }
+          window->shown_power_state = power_state_flags;
           if (power_state_flags & GDU_POWER_STATE_FLAGS_STANDBY)
             show_flags->drive_menu |= SHOW_FLAGS_DRIVE_MENU_RESUME_NOW;
           else
@@ -2266,7 +2636,7 @@ update_device_page_for_loop (GduWindow      *window,
   gdu_volume_grid_set_no_media_string (GDU_VOLUME_GRID (window->volume_grid),
                                        _("Loop device is empty"));
 
-  info = udisks_client_get_object_info (window->client, object);
+  info = gdu_application_get_object_info (window->application, object);
   device_desc = get_device_file_for_display (block);
 
   hdy_header_bar_set_title (HDY_HEADER_BAR (window->right_header), udisks_object_info_get_description (info));
@@ -2322,7 +2692,7 @@ update_device_page_for_fake_block (GduWindow      *window,
   gdu_volume_grid_set_no_media_string (GDU_VOLUME_GRID (window->volume_grid),
                                        _("Block device is empty"));
 
-  info = udisks_client_get_object_info (window->client, object);
+  info = gdu_application_get_object_info (window->application, object);
   device_desc = get_device_file_for_display (block);
 
   hdy_header_bar_set_title (HDY_HEADER_BAR (window->right_header), udisks_object_info_get_description (info));
@@ -2567,9 +2937,15 @@ update_device_page_for_block (GduWindow          *window,
         }
 
       if (g_strv_length ((gchar **) mount_points) > 0)
-        show_flags->volume_buttons |= SHOW_FLAGS_VOLUME_BUTTONS_UNMOUNT;
+        {
+          show_flags->volume_buttons |= SHOW_FLAGS_VOLUME_BUTTONS_UNMOUNT;
+          if (!read_only)
+            show_flags->volume_menu |= SHOW_FLAGS_VOLUME_MENU_BENCHMARK_FILESYSTEM;
+        }
       else
-        show_flags->volume_buttons |= SHOW_FLAGS_VOLUME_BUTTONS_MOUNT;
+        {
+          show_flags->volume_buttons |= SHOW_FLAGS_VOLUME_BUTTONS_MOUNT;
+        }
 
       show_flags->volume_menu |= SHOW_FLAGS_VOLUME_MENU_CONFIGURE_FSTAB;
       if (!read_only)
@@ -2984,7 +3360,7 @@ fs_repair_cb (UDisksFilesystem *filesystem,
       object = UDISKS_OBJECT (g_dbus_interface_get_object (G_DBUS_INTERFACE (filesystem)));
       block = udisks_object_peek_block (object);
       g_assert (block != NULL);
-      info = udisks_client_get_object_info (window->client, object);
+      info = gdu_application_get_object_info (window->application, object);
       name = udisks_block_get_id_label (block);
 
       if (name == NULL || strlen (name) == 0)
@@ -3104,7 +3480,7 @@ fs_check_cb (UDisksFilesystem *filesystem,
       object = UDISKS_OBJECT (g_dbus_interface_get_object (G_DBUS_INTERFACE (filesystem)));
       block = udisks_object_peek_block (object);
       g_assert (block != NULL);
-      info = udisks_client_get_object_info (window->client, object);
+      info = gdu_application_get_object_info (window->application, object);
       name = udisks_block_get_id_label (block);
 
       if (name == NULL || strlen (name) == 0)
@@ -3366,6 +3742,19 @@ on_volume_menu_item_benchmark (GSimpleAction *action,
   gdu_benchmark_dialog_show (window, object);
 }
 
+static void
+on_volume_menu_item_benchmark_filesystem (GSimpleAction *action,
+                                          GVariant      *parameter,
+                                          gpointer       user_data)
+{
+  GduWindow *window = GDU_WINDOW (user_data);
+  UDisksObject *object;
+
+  object = gdu_volume_grid_get_selected_device (GDU_VOLUME_GRID (window->volume_grid));
+  g_assert (object != NULL);
+  gdu_filesystem_benchmark_dialog_show (window, object);
+}
+
 /* ---------------------------------------------------------------------------------------------------- */
 
 static void
@@ -3402,6 +3791,13 @@ on_drive_menu_item_view_smart (GSimpleAction *action,
                                gpointer       user_data)
 {
   GduWindow *window = GDU_WINDOW (user_data);
+#if UDISKS_CHECK_VERSION(2, 10, 0)
+  if (udisks_object_peek_nvme_controller (window->current_object) != NULL)
+    {
+      gdu_nvme_health_dialog_show (window, window->current_object);
+      return;
+    }
+#endif
   gdu_ata_smart_dialog_show (window, window->current_object);
 }
 
@@ -3434,6 +3830,12 @@ ata_pm_standby_cb (GObject      *source_object,
                             error);
       g_clear_error (&error);
     }
+  else
+    {
+      GDBusObject *object = g_dbus_interface_get_object (G_DBUS_INTERFACE (source_object));
+      if (object != NULL)
+        gdu_device_tree_model_update_power_state (window->model, UDISKS_OBJECT (object));
+    }
 
   g_object_unref (window);
 }
@@ -3481,6 +3883,12 @@ ata_pm_wakeup_cb (GObject      *source_object,
                             error);
       g_clear_error (&error);
     }
+  else
+    {
+      GDBusObject *object = g_dbus_interface_get_object (G_DBUS_INTERFACE (source_object));
+      if (object != NULL)
+        gdu_device_tree_model_update_power_state (window->model, UDISKS_OBJECT (object));
+    }
 
   g_object_unref (window);
 }
@@ -0,0 +1,312 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*-
+ *
+ * Copyright (C) 2008-2013 Red Hat, Inc.
+ *
+ * Licensed under GPL version 2 or later.
+ *
+ * Author: David Zeuthen <zeuthen@gmail.com>
+ */
+
+#include "config.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "gduhistoryfile.h"
+
+/* History files - the benchmark and SMART history - are append-only.
+ * They start with a HistoryHeader followed by records in host
+ * byte-order, files written on a host with another byte-order are
+ * rejected. Records are either of a fixed size or tell their own size,
+ * see GduHistoryFormat.
+ *
+ * Each record is written with a single write() so a crash can at most
+ * leave a truncated record at the end of the file. It is ignored when
+ * loading and cut off before the next record is appended so later
+ * records remain readable. Files with another magic or version are
+ * never appended to.
+ */
+
+#define HISTORY_BYTE_ORDER 0x01020304
+
+typedef struct
+{
+  gchar   magic[8];
+  guint32 version;
+  guint32 byte_order;
+} HistoryHeader;
+
+G_STATIC_ASSERT (sizeof (HistoryHeader) == GDU_HISTORY_FILE_HEADER_SIZE);
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+/**
+ * gdu_history_file_get_record_size:
+ * @format: The format of the file.
+ * @contents: The contents of the file.
+ * @length: The length of @contents.
+ * @pos: The offset of a record in @contents.
+ *
+ * Returns: The size of the complete record at @pos or 0 if there is
+ *     none, e.g. because it was truncated by a crash.
+ */
+gsize
+gdu_history_file_get_record_size (const GduHistoryFormat *format,
+                                  const gchar            *contents,
+                                  gsize                   length,
+                                  gsize                   pos)
+{
+  if (pos >= length)
+    return 0;
+
+  if (format->record_size > 0)
+    return length - pos >= format->record_size ? format->record_size : 0;
+
+  return format->get_record_size (contents + pos, length - pos);
+}
+
+/**
+ * gdu_history_file_check_header:
+ * @filename: The name of the file, for error messages.
+ * @format: The format of the file.
+ * @contents: The contents of the file.
+ * @length: The length of @contents.
+ * @out_version: (out): Return location for the version of the file.
+ * @error: Return location for error or %NULL.
+ *
+ * Checks that @contents is a history file in @format. Files from older
+ * versions of the format are accepted, the caller has to decode their
+ * records itself.
+ *
+ * Returns: %TRUE if the records starting at
+ *     %GDU_HISTORY_FILE_HEADER_SIZE can be read, %FALSE if @error is set.
+ */
+gboolean
+gdu_history_file_check_header (const gchar             *filename,
+                               const GduHistoryFormat  *format,
+                               const gchar             *contents,
+                               gsize                    length,
+                               guint32                 *out_version,
+                               GError                 **error)
+{
+  const HistoryHeader *header = (const HistoryHeader *) contents;
+
+  if (length < sizeof (HistoryHeader) ||
+      memcmp (header->magic, format->magic, sizeof header->magic) != 0 ||
+      header->byte_order != HISTORY_BYTE_ORDER)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                   "%s is not a %s history file", filename, format->name);
+      return FALSE;
+    }
+
+  if (header->version > format->version)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                   "Cannot decode version %d %s history", header->version, format->name);
+      return FALSE;
+    }
+
+  *out_version = header->version;
+  return TRUE;
+}
+
+static void
+init_header (HistoryHeader          *header,
+             const GduHistoryFormat *format)
+{
+  memset (header, 0, sizeof (HistoryHeader));
+  memcpy (header->magic, format->magic, sizeof header->magic);
+  header->version = format->version;
+  header->byte_order = HISTORY_BYTE_ORDER;
+}
+
+/**
+ * gdu_history_file_replace:
+ * @filename: The history file.
+ * @format: The format of the file.
+ * @records: The records to write.
+ * @size: The size of @records.
+ * @error: Return location for error or %NULL.
+ *
+ * Atomically replaces @filename with a file containing @records in the
+ * current version of @format, e.g. when converting a file from an older
+ * version.
+ *
+ * Returns: %TRUE if @filename was replaced, %FALSE if @error is set.
+ */
+gboolean
+gdu_history_file_replace (const gchar             *filename,
+                          const GduHistoryFormat  *format,
+                          gconstpointer            records,
+                          gsize                    size,
+                          GError                 **error)
+{
+  gboolean ret;
+  HistoryHeader header;
+  GByteArray *contents;
+
+  init_header (&header, format);
+  contents = g_byte_array_sized_new (sizeof header + size);
+  g_byte_array_append (contents, (const guint8 *) &header, sizeof header);
+  g_byte_array_append (contents, records, size);
+  ret = g_file_set_contents (filename, (const gchar *) contents->data, contents->len, error);
+  g_byte_array_unref (contents);
+  return ret;
+}
+
+/* Returns the offset just past the last complete record in @fd */
+static gboolean
+find_end (gint                     fd,
+          const gchar             *filename,
+          const GduHistoryFormat  *format,
+          gsize                    file_size,
+          gsize                   *out_end,
+          GError                 **error)
+{
+  GMappedFile *mapped_file;
+  const gchar *contents;
+  gsize record_size;
+  gsize pos;
+
+  pos = sizeof (HistoryHeader);
+  if (format->record_size > 0)
+    {
+      pos += ((file_size - pos) / format->record_size) * format->record_size;
+      goto out;
+    }
+
+  mapped_file = g_mapped_file_new_from_fd (fd, FALSE, error);
+  if (mapped_file == NULL)
+    {
+      g_prefix_error (error, "Error mapping %s: ", filename);
+      return FALSE;
+    }
+  contents = g_mapped_file_get_contents (mapped_file);
+  while ((record_size = gdu_history_file_get_record_size (format, contents, file_size, pos)) > 0)
+    pos += record_size;
+  g_mapped_file_unref (mapped_file);
+
+ out:
+  *out_end = pos;
+  return TRUE;
+}
+
+/**
+ * gdu_history_file_append:
+ * @filename: The history file, created if it doesn't exist.
+ * @format: The format of the file.
+ * @record: The record to append.
+ * @size: The size of @record.
+ * @error: Return location for error or %NULL.
+ *
+ * Appends @record to @filename, cutting off a record left truncated by
+ * a crash first. Fails with %G_IO_ERROR_NOT_SUPPORTED if the file is in
+ * an older version of @format - the caller may rewrite it in the current
+ * version and try again.
+ *
+ * Returns: %TRUE if @record was appended, %FALSE if @error is set.
+ */
+gboolean
+gdu_history_file_append (const gchar             *filename,
+                         const GduHistoryFormat  *format,
+                         gconstpointer            record,
+                         gsize                    size,
+                         GError                 **error)
+{
+  gboolean ret = FALSE;
+  struct stat statbuf;
+  HistoryHeader header;
+  guchar *buf = NULL;
+  gsize buf_size = 0;
+  gsize offset = 0;
+  gssize num_written;
+  gint fd = -1;
+
+  g_return_val_if_fail (strlen (format->magic) == sizeof header.magic, FALSE);
+  g_return_val_if_fail (format->record_size == 0 || format->record_size == size, FALSE);
+
+  fd = open (filename, O_RDWR | O_CREAT | O_CLOEXEC, 0666);
+  if (fd == -1 || fstat (fd, &statbuf) != 0)
+    {
+      g_set_error (error,
+                   G_IO_ERROR,
+                   g_io_error_from_errno (errno),
+                   "Error opening %s: %m",
+                   filename);
+      goto out;
+    }
+
+  buf = g_malloc (sizeof header + size);
+  if ((gsize) statbuf.st_size < sizeof header)
+    {
+      /* new, or a crash while writing the header - start over */
+      init_header (&header, format);
+      memcpy (buf, &header, sizeof header);
+      buf_size += sizeof header;
+    }
+  else
+    {
+      guint32 version;
+
+      if (pread (fd, &header, sizeof header, 0) != sizeof header)
+        {
+          g_set_error (error,
+                       G_IO_ERROR,
+                       g_io_error_from_errno (errno),
+                       "Error reading %s: %m",
+                       filename);
+          goto out;
+        }
+      /* don't append to a file we can't read back */
+      if (!gdu_history_file_check_header (filename, format, (const gchar *) &header, sizeof header,
+                                          &version, error))
+        goto out;
+      if (version < format->version)
+        {
+          g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                       "%s is a version %d %s history file", filename, version, format->name);
+          goto out;
+        }
+
+      if (!find_end (fd, filename, format, statbuf.st_size, &offset, error))
+        goto out;
+    }
+
+  /* cut off a record truncated by a crash so the new one lines up */
+  if ((gsize) statbuf.st_size != offset && ftruncate (fd, offset) != 0)
+    {
+      g_set_error (error,
+                   G_IO_ERROR,
+                   g_io_error_from_errno (errno),
+                   "Error truncating %s: %m",
+                   filename);
+      goto out;
+    }
+  memcpy (buf + buf_size, record, size);
+  buf_size += size;
+
+  do
+    num_written = pwrite (fd, buf, buf_size, offset);
+  while (num_written < 0 && errno == EINTR);
+  if (num_written != (gssize) buf_size)
+    {
+      g_set_error (error,
+                   G_IO_ERROR,
+                   num_written < 0 ? g_io_error_from_errno (errno) : G_IO_ERROR_NO_SPACE,
+                   "Error writing to %s: %s",
+                   filename, num_written < 0 ? strerror (errno) : "Short write");
+      goto out;
+    }
+
+  ret = TRUE;
+
+ out:
+  if (fd != -1)
+    close (fd);
+  g_free (buf);
+  return ret;
+}
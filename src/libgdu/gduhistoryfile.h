@@ -0,0 +1,61 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*-
+ *
+ * Copyright (C) 2008-2013 Red Hat, Inc.
+ *
+ * Licensed under GPL version 2 or later.
+ *
+ * Author: David Zeuthen <zeuthen@gmail.com>
+ */
+
+#ifndef __GDU_HISTORY_FILE_H__
+#define __GDU_HISTORY_FILE_H__
+
+#include "libgdutypes.h"
+
+G_BEGIN_DECLS
+
+/* Records start right after the header, 8-byte aligned */
+#define GDU_HISTORY_FILE_HEADER_SIZE 16
+
+/* Returns the size of the complete record at @data with @length bytes
+ * left in the file or 0 if the record is truncated
+ */
+typedef gsize (*GduHistoryRecordSizeFunc) (gconstpointer data,
+                                           gsize         length);
+
+typedef struct
+{
+  const gchar *magic;                        /* exactly 8 characters */
+  guint32 version;                           /* the version written */
+  const gchar *name;                         /* used in error messages, e.g. "SMART" */
+  gsize record_size;                         /* 0 if records vary in size */
+  GduHistoryRecordSizeFunc get_record_size;  /* used if record_size is 0 */
+} GduHistoryFormat;
+
+gboolean gdu_history_file_append       (const gchar             *filename,
+                                        const GduHistoryFormat  *format,
+                                        gconstpointer            record,
+                                        gsize                    size,
+                                        GError                 **error);
+
+gboolean gdu_history_file_replace      (const gchar             *filename,
+                                        const GduHistoryFormat  *format,
+                                        gconstpointer            records,
+                                        gsize                    size,
+                                        GError                 **error);
+
+gboolean gdu_history_file_check_header (const gchar             *filename,
+                                        const GduHistoryFormat  *format,
+                                        const gchar             *contents,
+                                        gsize                    length,
+                                        guint32                 *out_version,
+                                        GError                 **error);
+
+gsize    gdu_history_file_get_record_size (const GduHistoryFormat *format,
+                                           const gchar            *contents,
+                                           gsize                   length,
+                                           gsize                   pos);
+
+G_END_DECLS
+
+#endif /* __GDU_HISTORY_FILE_H__ */
@@ -893,14 +893,46 @@ gdu_utils_is_ntfs_available (UDisksClient *client)
 
 /* ---------------------------------------------------------------------------------------------------- */
 
+/* Whether filesystems can be resized, repaired and checked is asked for
+ * every time the window updates. The answers are cached for all
+ * supported filesystems and filled in the background by
+ * gdu_utils_prefetch_capabilities() - a blocking D-Bus call is only made
+ * for a filesystem that has no answer at all yet. Flushing the cache
+ * doesn't drop the answers, they are used until the new ones arrive.
+ */
 
 typedef struct
 {
   gboolean available;
   gchar *missing_util;
   ResizeFlags mode;
+  guint generation; /* capabilities_generation when it was asked for */
 } UtilCacheEntry;
 
+typedef enum
+{
+  CAPABILITY_RESIZE,
+  CAPABILITY_REPAIR,
+  CAPABILITY_CHECK,
+  N_CAPABILITIES
+} Capability;
+
+typedef struct
+{
+  Capability capability;
+  gchar *fstype;
+  guint generation;
+} PrefetchData;
+
+G_LOCK_DEFINE_STATIC (capabilities_lock);
+
+/* fstype -> UtilCacheEntry, one per Capability */
+static GHashTable *capabilities[N_CAPABILITIES];
+/* bumped on every flush - older entries are refreshed and answers to
+ * calls made before are dropped
+ */
+static guint capabilities_generation = 0;
+
 static void
 util_cache_entry_free (UtilCacheEntry *data)
 {
@@ -908,148 +940,326 @@ util_cache_entry_free (UtilCacheEntry *data)
   g_free (data);
 }
 
-G_LOCK_DEFINE (can_resize_lock);
+static UtilCacheEntry *
+util_cache_entry_new (Capability  capability,
+                      GVariant   *out_available,
+                      guint       generation)
+{
+  UtilCacheEntry *entry;
 
-/* Uses an internal cache, set flush to rebuild it first */
-gboolean
-gdu_utils_can_resize (UDisksClient *client,
-                      const gchar  *fstype,
-                      gboolean      flush,
-                      ResizeFlags  *mode_out,
-                      gchar       **missing_util_out)
+  entry = g_new0 (UtilCacheEntry, 1);
+  entry->generation = generation;
+  if (out_available == NULL)
+    {
+      /* the call failed - remember that instead of retrying every time */
+    }
+  else if (capability == CAPABILITY_RESIZE)
+    {
+      guint64 m = 0;
+      g_variant_get (out_available, "(bts)", &entry->available, &m, &entry->missing_util);
+      entry->mode = (ResizeFlags) m;
+    }
+  else
+    {
+      g_variant_get (out_available, "(bs)", &entry->available, &entry->missing_util);
+    }
+  return entry;
+}
+
+/* must be called with capabilities_lock held */
+static void
+capabilities_ensure_unlocked (gboolean flush)
 {
-  static GHashTable *cache = NULL;
-  const gchar *const *supported_fs;
-  UtilCacheEntry *result;
+  guint n;
 
-  G_LOCK (can_resize_lock);
   if (flush)
-    g_clear_pointer (&cache, g_hash_table_destroy);
+    capabilities_generation++;
 
-  if (cache == NULL)
+  for (n = 0; n < N_CAPABILITIES; n++)
     {
-      cache = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) util_cache_entry_free);
-      supported_fs = udisks_manager_get_supported_filesystems (udisks_client_get_manager (client));
-      for (gsize i = 0; supported_fs[i] != NULL; i++)
-        {
-          GVariant *out_available;
+      if (capabilities[n] == NULL)
+        capabilities[n] = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) util_cache_entry_free);
+    }
+}
 
-          if (udisks_manager_call_can_resize_sync (udisks_client_get_manager (client),
-                                                   supported_fs[i], &out_available, NULL, NULL))
-            {
-              UtilCacheEntry *entry;
-              guint64 m = 0;
-
-              entry = g_new0 (UtilCacheEntry, 1);
-              g_variant_get (out_available, "(bts)", &entry->available, &m, &entry->missing_util);
-              g_variant_unref (out_available);
-              entry->mode = (ResizeFlags) m;
-              g_hash_table_insert (cache, g_strdup (supported_fs[i]), entry);
-            }
-        }
+static void
+capability_call (UDisksManager       *manager,
+                 Capability           capability,
+                 const gchar         *fstype,
+                 GAsyncReadyCallback  callback,
+                 gpointer             user_data)
+{
+  switch (capability)
+    {
+    case CAPABILITY_RESIZE:
+      udisks_manager_call_can_resize (manager, fstype, NULL, callback, user_data);
+      break;
+    case CAPABILITY_REPAIR:
+      udisks_manager_call_can_repair (manager, fstype, NULL, callback, user_data);
+      break;
+    case CAPABILITY_CHECK:
+    default:
+      udisks_manager_call_can_check (manager, fstype, NULL, callback, user_data);
+      break;
     }
-  G_UNLOCK (can_resize_lock);
+}
 
-  result = g_hash_table_lookup (cache, fstype);
-  if (mode_out != NULL)
-    *mode_out = result ? result->mode : 0;
+static gboolean
+capability_call_finish (UDisksManager  *manager,
+                        Capability      capability,
+                        GVariant      **out_available,
+                        GAsyncResult   *res)
+{
+  switch (capability)
+    {
+    case CAPABILITY_RESIZE:
+      return udisks_manager_call_can_resize_finish (manager, out_available, res, NULL);
+    case CAPABILITY_REPAIR:
+      return udisks_manager_call_can_repair_finish (manager, out_available, res, NULL);
+    case CAPABILITY_CHECK:
+    default:
+      return udisks_manager_call_can_check_finish (manager, out_available, res, NULL);
+    }
+}
 
-  if (missing_util_out != NULL)
-    *missing_util_out = result ? g_strdup (result->missing_util) : NULL;
+static gboolean
+capability_call_sync (UDisksManager  *manager,
+                      Capability      capability,
+                      const gchar    *fstype,
+                      GVariant      **out_available)
+{
+  switch (capability)
+    {
+    case CAPABILITY_RESIZE:
+      return udisks_manager_call_can_resize_sync (manager, fstype, out_available, NULL, NULL);
+    case CAPABILITY_REPAIR:
+      return udisks_manager_call_can_repair_sync (manager, fstype, out_available, NULL, NULL);
+    case CAPABILITY_CHECK:
+    default:
+      return udisks_manager_call_can_check_sync (manager, fstype, out_available, NULL, NULL);
+    }
+}
+
+static void
+prefetch_cb (GObject      *source_object,
+             GAsyncResult *res,
+             gpointer      user_data)
+{
+  PrefetchData *data = user_data;
+  GVariant *out_available = NULL;
+  UtilCacheEntry *entry;
 
-  return result ? result->available : FALSE;
+  if (!capability_call_finish (UDISKS_MANAGER (source_object), data->capability, &out_available, res))
+    out_available = NULL;
+
+  G_LOCK (capabilities_lock);
+  entry = g_hash_table_lookup (capabilities[data->capability], data->fstype);
+  if (data->generation == capabilities_generation &&
+      (entry == NULL || entry->generation != data->generation))
+    {
+      g_hash_table_replace (capabilities[data->capability],
+                            g_strdup (data->fstype),
+                            util_cache_entry_new (data->capability, out_available, data->generation));
+    }
+  G_UNLOCK (capabilities_lock);
+
+  if (out_available != NULL)
+    g_variant_unref (out_available);
+  g_free (data->fstype);
+  g_slice_free (PrefetchData, data);
 }
 
-G_LOCK_DEFINE (can_repair_lock);
+static void
+on_capabilities_changed (UDisksClient *client)
+{
+  G_LOCK (capabilities_lock);
+  capabilities_ensure_unlocked (TRUE);
+  G_UNLOCK (capabilities_lock);
 
-gboolean
-gdu_utils_can_repair (UDisksClient *client,
-                      const gchar  *fstype,
-                      gboolean      flush,
-                      gchar       **missing_util_out)
+  gdu_utils_prefetch_capabilities (client);
+}
+
+static void
+on_manager_notify_supported_filesystems (GObject    *object,
+                                         GParamSpec *pspec,
+                                         gpointer    user_data)
+{
+  on_capabilities_changed (UDISKS_CLIENT (user_data));
+}
+
+static void
+on_manager_interface_added_or_removed (GDBusObjectManager *manager,
+                                       GDBusObject        *object,
+                                       GDBusInterface     *interface,
+                                       gpointer            user_data)
+{
+  UDisksClient *client = UDISKS_CLIENT (user_data);
+
+  /* udisks modules, e.g. for LVM or Btrfs, add interfaces to the manager object when loaded */
+  if (g_strcmp0 (g_dbus_object_get_object_path (object),
+                 g_dbus_proxy_get_object_path (G_DBUS_PROXY (udisks_client_get_manager (client)))) == 0)
+    on_capabilities_changed (client);
+}
+
+/* Fills the capability cache in the background, or refreshes it after a
+ * flush. Call once the client is available; the cache is refreshed by
+ * itself when the supported filesystems or the loaded udisks modules
+ * change.
+ */
+void
+gdu_utils_prefetch_capabilities (UDisksClient *client)
 {
-  static GHashTable *cache = NULL;
+  UDisksManager *manager;
   const gchar *const *supported_fs;
-  UtilCacheEntry *result;
+  guint generation;
+  guint n;
 
-  G_LOCK (can_repair_lock);
-  if (flush)
-    g_clear_pointer (&cache, g_hash_table_destroy);
+  manager = udisks_client_get_manager (client);
+
+  if (g_object_get_data (G_OBJECT (client), "gdu-capabilities-watched") == NULL)
+    {
+      g_signal_connect_object (manager,
+                               "notify::supported-filesystems",
+                               G_CALLBACK (on_manager_notify_supported_filesystems),
+                               client,
+                               0);
+      g_signal_connect_object (udisks_client_get_object_manager (client),
+                               "interface-added",
+                               G_CALLBACK (on_manager_interface_added_or_removed),
+                               client,
+                               0);
+      g_signal_connect_object (udisks_client_get_object_manager (client),
+                               "interface-removed",
+                               G_CALLBACK (on_manager_interface_added_or_removed),
+                               client,
+                               0);
+      g_object_set_data (G_OBJECT (client), "gdu-capabilities-watched", GINT_TO_POINTER (1));
+    }
+
+  supported_fs = udisks_manager_get_supported_filesystems (manager);
+  if (supported_fs == NULL)
+    return;
 
-  if (cache == NULL)
+  G_LOCK (capabilities_lock);
+  capabilities_ensure_unlocked (FALSE);
+  generation = capabilities_generation;
+  for (n = 0; n < N_CAPABILITIES; n++)
     {
-      cache = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) util_cache_entry_free);
-      supported_fs = udisks_manager_get_supported_filesystems (udisks_client_get_manager (client));
-      for (gsize i = 0; supported_fs[i] != NULL; i++)
+      gsize i;
+      for (i = 0; supported_fs[i] != NULL; i++)
         {
-          GVariant *out_available;
+          PrefetchData *data;
+          UtilCacheEntry *entry;
 
-          if (udisks_manager_call_can_repair_sync (udisks_client_get_manager (client),
-                                                   supported_fs[i], &out_available, NULL, NULL))
-            {
-              UtilCacheEntry *entry;
+          entry = g_hash_table_lookup (capabilities[n], supported_fs[i]);
+          if (entry != NULL && entry->generation == generation)
+            continue;
 
-              entry = g_new0 (UtilCacheEntry, 1);
-              g_variant_get (out_available, "(bs)", &entry->available, &entry->missing_util);
-              g_variant_unref (out_available);
-              g_hash_table_insert (cache, g_strdup (supported_fs[i]), entry);
-            }
+          data = g_slice_new0 (PrefetchData);
+          data->capability = n;
+          data->fstype = g_strdup (supported_fs[i]);
+          data->generation = generation;
+          capability_call (manager, n, supported_fs[i], prefetch_cb, data);
         }
     }
-  G_UNLOCK (can_repair_lock);
+  G_UNLOCK (capabilities_lock);
+}
 
-  result = g_hash_table_lookup (cache, fstype);
-  if (missing_util_out != NULL)
-    *missing_util_out = result ? g_strdup (result->missing_util) : NULL;
+static gboolean
+is_supported_filesystem (UDisksClient *client,
+                         const gchar  *fstype)
+{
+  const gchar *const *supported_fs;
+  gsize i;
 
-  return result ? result->available : FALSE;
+  supported_fs = udisks_manager_get_supported_filesystems (udisks_client_get_manager (client));
+  for (i = 0; fstype != NULL && supported_fs != NULL && supported_fs[i] != NULL; i++)
+    {
+      if (g_strcmp0 (supported_fs[i], fstype) == 0)
+        return TRUE;
+    }
+  return FALSE;
 }
 
-G_LOCK_DEFINE (can_check_lock);
-
-gboolean
-gdu_utils_can_check (UDisksClient *client,
-                     const gchar  *fstype,
-                     gboolean      flush,
-                     gchar       **missing_util_out)
+static gboolean
+lookup_capability (UDisksClient  *client,
+                   Capability     capability,
+                   const gchar   *fstype,
+                   gboolean       flush,
+                   ResizeFlags   *mode_out,
+                   gchar        **missing_util_out)
 {
-  static GHashTable *cache = NULL;
-  const gchar *const *supported_fs;
-  UtilCacheEntry *result;
+  UtilCacheEntry *entry;
+  gboolean ret = FALSE;
 
-  G_LOCK (can_check_lock);
-  if (flush && cache != NULL)
-    g_clear_pointer (&cache, g_hash_table_destroy);
+  G_LOCK (capabilities_lock);
+  capabilities_ensure_unlocked (flush);
+  entry = fstype != NULL ? g_hash_table_lookup (capabilities[capability], fstype) : NULL;
+  G_UNLOCK (capabilities_lock);
 
-  if (cache == NULL)
+  /* after a flush the old answer, if any, is used until the new one arrives */
+  if (entry == NULL && is_supported_filesystem (client, fstype))
     {
-      cache = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) util_cache_entry_free);
-      supported_fs = udisks_manager_get_supported_filesystems (udisks_client_get_manager (client));
-      for (gsize i = 0; supported_fs[i] != NULL; i++)
-        {
-          GVariant *out_available;
+      GVariant *out_available = NULL;
 
-          if (udisks_manager_call_can_check_sync (udisks_client_get_manager (client),
-                                                  supported_fs[i], &out_available, NULL, NULL))
-            {
-              UtilCacheEntry *entry;
-              guint64 m = 0;
-
-              entry = g_new0 (UtilCacheEntry, 1);
-              g_variant_get (out_available, "(bs)", &entry->available, &entry->missing_util);
-              g_variant_unref (out_available);
-              entry->mode = (ResizeFlags) m;
-              g_hash_table_insert (cache, g_strdup (supported_fs[i]), entry);
-            }
-        }
+      /* not prefetched yet, just ask for this one */
+      if (!capability_call_sync (udisks_client_get_manager (client), capability, fstype, &out_available))
+        out_available = NULL;
+
+      G_LOCK (capabilities_lock);
+      if (!g_hash_table_contains (capabilities[capability], fstype))
+        g_hash_table_insert (capabilities[capability],
+                             g_strdup (fstype),
+                             util_cache_entry_new (capability, out_available, capabilities_generation));
+      G_UNLOCK (capabilities_lock);
+
+      if (out_available != NULL)
+        g_variant_unref (out_available);
     }
-  G_UNLOCK (can_check_lock);
 
-  result = g_hash_table_lookup (cache, fstype);
+  G_LOCK (capabilities_lock);
+  entry = fstype != NULL ? g_hash_table_lookup (capabilities[capability], fstype) : NULL;
+  if (mode_out != NULL)
+    *mode_out = entry ? entry->mode : 0;
   if (missing_util_out != NULL)
-    *missing_util_out = result ? g_strdup (result->missing_util) : NULL;
+    *missing_util_out = entry ? g_strdup (entry->missing_util) : NULL;
+  ret = entry ? entry->available : FALSE;
+  G_UNLOCK (capabilities_lock);
+
+  /* refresh the cache in the background */
+  if (flush)
+    gdu_utils_prefetch_capabilities (client);
+
+  return ret;
+}
+
+/* Uses an internal cache, set flush to refresh it in the background */
+gboolean
+gdu_utils_can_resize (UDisksClient *client,
+                      const gchar  *fstype,
+                      gboolean      flush,
+                      ResizeFlags  *mode_out,
+                      gchar       **missing_util_out)
+{
+  return lookup_capability (client, CAPABILITY_RESIZE, fstype, flush, mode_out, missing_util_out);
+}
+
+gboolean
+gdu_utils_can_repair (UDisksClient *client,
+                      const gchar  *fstype,
+                      gboolean      flush,
+                      gchar       **missing_util_out)
+{
+  return lookup_capability (client, CAPABILITY_REPAIR, fstype, flush, NULL, missing_util_out);
+}
 
-  return result ? result->available : FALSE;
+gboolean
+gdu_utils_can_check (UDisksClient *client,
+                     const gchar  *fstype,
+                     gboolean      flush,
+                     gchar       **missing_util_out)
+{
+  return lookup_capability (client, CAPABILITY_CHECK, fstype, flush, NULL, missing_util_out);
 }
 
 
@@ -1166,82 +1376,336 @@ gdu_utils_get_pretty_uri (GFile *file)
 
 /* ---------------------------------------------------------------------------------------------------- */
 
+/* Finding what a device contains - its block device, partitions and
+ * unlocked cleartext devices - otherwise means looking at every object
+ * known to the client for each step. Instead the links between objects
+ * are kept in a graph that is updated as objects and their properties
+ * change. There is one graph per UDisksClient, created on first use.
+ */
+
+typedef struct
+{
+  gchar *drive;           /* whole-disk block device -> its drive */
+  gchar *table;           /* partition -> its partition table */
+  gchar *crypto_backing;  /* cleartext device -> its crypto device */
+} DeviceLinks;
+
+typedef struct
+{
+  UDisksClient *client; /* borrowed - the graph is owned by the client */
+  GDBusObjectManager *object_manager;
+
+  /* object path -> DeviceLinks */
+  GHashTable *links;
+  /* drive object path -> GPtrArray of object paths of its block devices,
+   * more than one e.g. for multipath - the first one is used
+   */
+  GHashTable *drive_blocks;
+  /* partition table object path -> GPtrArray of partition object paths */
+  GHashTable *partitions;
+  /* crypto device object path -> object path of its cleartext device */
+  GHashTable *cleartext;
+} DeviceGraph;
+
+static void
+device_links_free (DeviceLinks *links)
+{
+  g_free (links->drive);
+  g_free (links->table);
+  g_free (links->crypto_backing);
+  g_slice_free (DeviceLinks, links);
+}
+
+static gboolean
+is_object_path_set (const gchar *object_path)
+{
+  return object_path != NULL && object_path[0] != '\0' && g_strcmp0 (object_path, "/") != 0;
+}
+
+/* Adds @object_path to the GPtrArray for @key in @table */
+static void
+path_array_add (GHashTable  *table,
+                const gchar *key,
+                const gchar *object_path)
+{
+  GPtrArray *p;
+
+  p = g_hash_table_lookup (table, key);
+  if (p == NULL)
+    {
+      p = g_ptr_array_new_with_free_func (g_free);
+      g_hash_table_insert (table, g_strdup (key), p);
+    }
+  g_ptr_array_add (p, g_strdup (object_path));
+}
+
+/* Removes @object_path from the GPtrArray for @key in @table */
+static void
+path_array_remove (GHashTable  *table,
+                   const gchar *key,
+                   const gchar *object_path)
+{
+  GPtrArray *p;
+  guint n;
+
+  p = g_hash_table_lookup (table, key);
+  if (p == NULL)
+    return;
+
+  for (n = 0; n < p->len; n++)
+    {
+      if (g_strcmp0 (p->pdata[n], object_path) == 0)
+        {
+          /* keep the order so the first block device of a drive stays first */
+          g_ptr_array_remove_index (p, n);
+          break;
+        }
+    }
+  if (p->len == 0)
+    g_hash_table_remove (table, key);
+}
+
+static void
+device_graph_update (DeviceGraph *graph,
+                     GDBusObject *object,
+                     gboolean     removed)
+{
+  const gchar *object_path;
+  DeviceLinks *links;
+  UDisksBlock *block;
+  UDisksPartition *partition;
+
+  object_path = g_dbus_object_get_object_path (object);
+
+  /* first remove the old links, if any ... */
+  links = g_hash_table_lookup (graph->links, object_path);
+  if (links != NULL)
+    {
+      if (links->drive != NULL)
+        path_array_remove (graph->drive_blocks, links->drive, object_path);
+      if (links->table != NULL)
+        path_array_remove (graph->partitions, links->table, object_path);
+      if (links->crypto_backing != NULL &&
+          g_strcmp0 (g_hash_table_lookup (graph->cleartext, links->crypto_backing), object_path) == 0)
+        g_hash_table_remove (graph->cleartext, links->crypto_backing);
+      g_hash_table_remove (graph->links, object_path);
+    }
+
+  if (removed)
+    goto out;
+
+  /* ... then add the current ones */
+  block = udisks_object_peek_block (UDISKS_OBJECT (object));
+  if (block == NULL)
+    goto out;
+  partition = udisks_object_peek_partition (UDISKS_OBJECT (object));
+
+  links = g_slice_new0 (DeviceLinks);
+  if (partition != NULL)
+    {
+      if (is_object_path_set (udisks_partition_get_table (partition)))
+        {
+          links->table = udisks_partition_dup_table (partition);
+          path_array_add (graph->partitions, links->table, object_path);
+        }
+    }
+  else if (is_object_path_set (udisks_block_get_drive (block)))
+    {
+      /* all block devices are kept so another one takes over when the
+       * first one goes away
+       */
+      links->drive = udisks_block_dup_drive (block);
+      path_array_add (graph->drive_blocks, links->drive, object_path);
+    }
+  if (is_object_path_set (udisks_block_get_crypto_backing_device (block)))
+    {
+      links->crypto_backing = udisks_block_dup_crypto_backing_device (block);
+      g_hash_table_replace (graph->cleartext, g_strdup (links->crypto_backing), g_strdup (object_path));
+    }
+  g_hash_table_insert (graph->links, g_strdup (object_path), links);
+
+ out:
+  ;
+}
+
+static void
+on_graph_object_added (GDBusObjectManager *manager,
+                       GDBusObject        *object,
+                       gpointer            user_data)
+{
+  device_graph_update (user_data, object, FALSE);
+}
+
+static void
+on_graph_object_removed (GDBusObjectManager *manager,
+                         GDBusObject        *object,
+                         gpointer            user_data)
+{
+  device_graph_update (user_data, object, TRUE);
+}
+
+static void
+on_graph_interface_added_or_removed (GDBusObjectManager *manager,
+                                     GDBusObject        *object,
+                                     GDBusInterface     *interface,
+                                     gpointer            user_data)
+{
+  if (UDISKS_IS_BLOCK (interface) || UDISKS_IS_PARTITION (interface))
+    device_graph_update (user_data, object, FALSE);
+}
+
+static void
+on_graph_interface_proxy_properties_changed (GDBusObjectManagerClient *manager,
+                                             GDBusObjectProxy         *object_proxy,
+                                             GDBusProxy               *interface_proxy,
+                                             GVariant                 *changed_properties,
+                                             const gchar *const       *invalidated_properties,
+                                             gpointer                  user_data)
+{
+  if (UDISKS_IS_BLOCK (interface_proxy) || UDISKS_IS_PARTITION (interface_proxy))
+    device_graph_update (user_data, G_DBUS_OBJECT (object_proxy), FALSE);
+}
+
+static void
+device_graph_free (DeviceGraph *graph)
+{
+  g_signal_handlers_disconnect_by_data (graph->object_manager, graph);
+  g_object_unref (graph->object_manager);
+  g_hash_table_unref (graph->links);
+  g_hash_table_unref (graph->drive_blocks);
+  g_hash_table_unref (graph->partitions);
+  g_hash_table_unref (graph->cleartext);
+  g_slice_free (DeviceGraph, graph);
+}
+
+static DeviceGraph *
+device_graph_get (UDisksClient *client)
+{
+  DeviceGraph *graph;
+  GList *objects, *l;
+
+  graph = g_object_get_data (G_OBJECT (client), "gdu-device-graph");
+  if (graph != NULL)
+    goto out;
+
+  graph = g_slice_new0 (DeviceGraph);
+  graph->client = client;
+  graph->object_manager = g_object_ref (udisks_client_get_object_manager (client));
+  graph->links = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) device_links_free);
+  graph->drive_blocks = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) g_ptr_array_unref);
+  graph->partitions = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) g_ptr_array_unref);
+  graph->cleartext = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+
+  objects = g_dbus_object_manager_get_objects (graph->object_manager);
+  for (l = objects; l != NULL; l = l->next)
+    device_graph_update (graph, G_DBUS_OBJECT (l->data), FALSE);
+  g_list_free_full (objects, g_object_unref);
+
+  g_signal_connect (graph->object_manager, "object-added", G_CALLBACK (on_graph_object_added), graph);
+  g_signal_connect (graph->object_manager, "object-removed", G_CALLBACK (on_graph_object_removed), graph);
+  g_signal_connect (graph->object_manager, "interface-added", G_CALLBACK (on_graph_interface_added_or_removed), graph);
+  g_signal_connect (graph->object_manager, "interface-removed", G_CALLBACK (on_graph_interface_added_or_removed), graph);
+  g_signal_connect (graph->object_manager,
+                    "interface-proxy-properties-changed",
+                    G_CALLBACK (on_graph_interface_proxy_properties_changed),
+                    graph);
+
+  g_object_set_data_full (G_OBJECT (client), "gdu-device-graph", graph, (GDestroyNotify) device_graph_free);
+
+ out:
+  return graph;
+}
+
+static UDisksObject *
+device_graph_get_object (DeviceGraph *graph,
+                         const gchar *object_path)
+{
+  if (object_path == NULL)
+    return NULL;
+  return udisks_client_get_object (graph->client, object_path);
+}
+
+/* Like udisks_client_get_cleartext_block() but returns the object and
+ * doesn't look at every block device
+ */
+UDisksObject *
+gdu_utils_get_cleartext_object (UDisksClient *client,
+                                UDisksObject *object)
+{
+  DeviceGraph *graph;
+
+  graph = device_graph_get (client);
+  return device_graph_get_object (graph,
+                                  g_hash_table_lookup (graph->cleartext,
+                                                       g_dbus_object_get_object_path (G_DBUS_OBJECT (object))));
+}
+
+/* Returns the block device for @object, its partitions and the cleartext
+ * devices of any of these that are unlocked, in that order
+ */
 GList *
 gdu_utils_get_all_contained_objects (UDisksClient *client,
                                      UDisksObject *object)
 {
-  UDisksBlock *block = NULL;
-  UDisksDrive *drive = NULL;
+  DeviceGraph *graph;
   UDisksObject *block_object = NULL;
-  UDisksPartitionTable *partition_table = NULL;
-  GList *partitions = NULL;
+  GQueue objects_to_check = G_QUEUE_INIT;
   GList *l;
-  GList *objects_to_check = NULL;
 
-  drive = udisks_object_get_drive (object);
-  if (drive != NULL)
+  graph = device_graph_get (client);
+
+  if (udisks_object_peek_drive (object) != NULL)
     {
-      block = udisks_client_get_block_for_drive (client,
-                                                 drive,
-                                                 FALSE /* get_physical */);
+      GPtrArray *p;
+
+      /* the first block device wins, like udisks_client_get_block_for_drive() */
+      p = g_hash_table_lookup (graph->drive_blocks, g_dbus_object_get_object_path (G_DBUS_OBJECT (object)));
+      if (p != NULL)
+        block_object = device_graph_get_object (graph, p->pdata[0]);
     }
-  else
+  else if (udisks_object_peek_block (object) != NULL)
     {
-      block = udisks_object_get_block (object);
+      block_object = g_object_ref (object);
     }
 
-  if (block != NULL)
+  if (block_object != NULL)
     {
-      block_object = (UDisksObject *) g_dbus_interface_dup_object (G_DBUS_INTERFACE (block));
-      if (block_object != NULL)
+      g_queue_push_tail (&objects_to_check, block_object);
+
+      /* if we're a partitioned block device, add all partitions */
+      if (udisks_object_peek_partition_table (block_object) != NULL)
         {
-          objects_to_check = g_list_prepend (objects_to_check, g_object_ref (block_object));
+          GPtrArray *p;
 
-          /* if we're a partitioned block device, add all partitions */
-          partition_table = udisks_object_get_partition_table (block_object);
-          if (partition_table != NULL)
+          p = g_hash_table_lookup (graph->partitions,
+                                   g_dbus_object_get_object_path (G_DBUS_OBJECT (block_object)));
+          if (p != NULL)
             {
-              partitions = udisks_client_get_partitions (client, partition_table);
-              for (l = partitions; l != NULL; l = l->next)
+              guint n;
+              for (n = 0; n < p->len; n++)
                 {
-                  UDisksPartition *partition = UDISKS_PARTITION (l->data);
                   UDisksObject *partition_object;
-                  partition_object = (UDisksObject *) g_dbus_interface_dup_object (G_DBUS_INTERFACE (partition));
+                  partition_object = device_graph_get_object (graph, p->pdata[n]);
                   if (partition_object != NULL)
-                    objects_to_check = g_list_append (objects_to_check, partition_object);
+                    g_queue_push_tail (&objects_to_check, partition_object);
                 }
             }
         }
     }
 
-  /* Add LUKS objects */
-  for (l = objects_to_check; l != NULL; l = l->next)
+  /* Add LUKS objects - appending to the list we are walking means
+   * that cleartext devices inside cleartext devices are found too
+   */
+  for (l = objects_to_check.head; l != NULL; l = l->next)
     {
-      UDisksObject *object_iter = UDISKS_OBJECT (l->data);
-      UDisksBlock *block_for_object;
-      block_for_object = udisks_object_peek_block (object_iter);
-      if (block_for_object != NULL)
-        {
-          UDisksBlock *cleartext;
-          cleartext = udisks_client_get_cleartext_block (client, block_for_object);
-          if (cleartext != NULL)
-            {
-              UDisksObject *cleartext_object;
-              cleartext_object = (UDisksObject *) g_dbus_interface_dup_object (G_DBUS_INTERFACE (cleartext));
-              if (cleartext_object != NULL)
-                objects_to_check = g_list_append (objects_to_check, cleartext_object);
-              g_object_unref (cleartext);
-            }
-        }
-    }
+      UDisksObject *cleartext_object;
 
-  g_clear_object (&partition_table);
-  g_list_free_full (partitions, g_object_unref);
-  g_clear_object (&block_object);
-  g_clear_object (&block);
-  g_clear_object (&drive);
+      cleartext_object = gdu_utils_get_cleartext_object (client, UDISKS_OBJECT (l->data));
+      if (cleartext_object != NULL)
+        g_queue_push_tail (&objects_to_check, cleartext_object);
+    }
 
-  return objects_to_check;
+  return objects_to_check.head;
 }
 
 /* ---------------------------------------------------------------------------------------------------- */
@@ -1267,12 +1731,9 @@ gdu_utils_is_in_use_full (UDisksClient      *client,
   for (l = objects_to_check; l != NULL; l = l->next)
     {
       UDisksObject *object_iter = UDISKS_OBJECT (l->data);
-      UDisksBlock *block_for_object;
       UDisksFilesystem *filesystem_for_object;
       UDisksEncrypted *encrypted_for_object;
 
-      block_for_object = udisks_object_peek_block (object_iter);
-
       filesystem_for_object = udisks_object_peek_filesystem (object_iter);
       if (filesystem_for_object != NULL)
         {
@@ -1293,11 +1754,11 @@ gdu_utils_is_in_use_full (UDisksClient      *client,
       encrypted_for_object = udisks_object_peek_encrypted (object_iter);
       if (encrypted_for_object != NULL)
         {
-          UDisksBlock *cleartext;
-          cleartext = udisks_client_get_cleartext_block (client, block_for_object);
-          if (cleartext != NULL)
+          UDisksObject *cleartext_object;
+          cleartext_object = gdu_utils_get_cleartext_object (client, object_iter);
+          if (cleartext_object != NULL)
             {
-              g_object_unref (cleartext);
+              g_object_unref (cleartext_object);
 
               if (ret)
                 {
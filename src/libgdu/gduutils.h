@@ -102,6 +102,8 @@ gboolean gdu_utils_can_check  (UDisksClient *client,
                                gboolean      flush,
                                gchar       **missing_util_out);
 
+void gdu_utils_prefetch_capabilities (UDisksClient *client);
+
 
 guint gdu_utils_get_max_label_length (const gchar *fstype);
 
@@ -116,6 +118,9 @@ gchar *gdu_utils_get_pretty_uri (GFile *file);
 GList *gdu_utils_get_all_contained_objects (UDisksClient *client,
                                             UDisksObject *object);
 
+UDisksObject *gdu_utils_get_cleartext_object (UDisksClient *client,
+                                              UDisksObject *object);
+
 gboolean gdu_utils_is_in_use (UDisksClient *client,
                               UDisksObject *object);
 
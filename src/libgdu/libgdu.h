@@ -13,6 +13,7 @@
 #include "libgdutypes.h"
 #include "libgduenums.h"
 #include "libgduenumtypes.h"
+#include "gduhistoryfile.h"
 #include "gduutils.h"
 
 #endif /* __LIB_GDU_H__ */